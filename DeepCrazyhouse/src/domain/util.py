@@ -22,6 +22,7 @@ from DeepCrazyhouse.src.domain.variants.constants import (
     MAX_NB_PRISONERS,
     NB_CHANNELS_TOTAL,
     NB_CHANNELS_POS,
+    NB_LABELS,
     POCKETS_SIZE_PIECE_TYPE,
     chess,
 )
@@ -105,6 +106,48 @@ def get_dic_sorted_by_key(dic):
     return [dic[key] for key in sorted(dic)]
 
 
+def unpack_planes(x_packed, x_scalars, board_height=BOARD_HEIGHT, board_width=BOARD_WIDTH):
+    """
+    Restores the dense plane representation of the packed format of the C++ TrainDataExporter.
+    Each plane is given by a 64-bit mask of its non-zero squares (bit index = row * board_width + col)
+    and the value of these squares.
+
+    :param x_packed: uint64 array of shape (nb_samples, nb_channels)
+    :param x_scalars: int16 array of shape (nb_samples, nb_channels)
+    :param board_height: Number of rows of a plane
+    :param board_width: Number of columns of a plane
+    :return: int16 array of shape (nb_samples, nb_channels, board_height, board_width)
+    """
+    nb_squares = board_height * board_width
+    masks = np.ascontiguousarray(x_packed, dtype="<u8")
+    bits = np.unpackbits(masks.view(np.uint8).reshape(masks.shape + (8,)), axis=-1, bitorder="little")[..., :nb_squares]
+    x = bits.astype(np.int16) * np.asarray(x_scalars, dtype=np.int16)[..., np.newaxis]
+    return x.reshape(masks.shape + (board_height, board_width))
+
+
+def sparse_to_dense_policy(y_policy_indices, y_policy_values, y_policy_offsets, nb_labels=NB_LABELS):
+    """
+    Restores the dense policy targets of the sparse format of the C++ TrainDataExporter.
+    The entries of sample i are stored in the flat arrays between y_policy_offsets[i-1] (0 for the first sample)
+    and y_policy_offsets[i].
+
+    :param y_policy_indices: int16 array of the policy indices of all entries
+    :param y_policy_values: float32 array of the probabilities of all entries
+    :param y_policy_offsets: int64 array of the exclusive end offset of the entries of each sample
+    :param nb_labels: Length of a dense policy vector
+    :return: float32 array of shape (nb_samples, nb_labels)
+    """
+    # samples which haven't been written yet have the offset 0 and therefore no entries
+    ends = np.maximum.accumulate(np.asarray(y_policy_offsets, dtype=np.int64))
+    nb_samples = len(ends)
+    nb_entries = int(ends[-1]) if nb_samples > 0 else 0
+    starts = np.concatenate(([0], ends[:-1]))
+    sample_idx = np.repeat(np.arange(nb_samples), ends - starts)
+    y_policy = np.zeros((nb_samples, nb_labels), dtype=np.float32)
+    y_policy[sample_idx, np.asarray(y_policy_indices[:nb_entries], dtype=np.int64)] = y_policy_values[:nb_entries]
+    return y_policy
+
+
 def get_numpy_arrays(pgn_dataset):
     """
     Loads the content of the dataset file into numpy arrays
@@ -122,9 +165,16 @@ def get_numpy_arrays(pgn_dataset):
     """
     # Get the data
     start_indices = np.array(pgn_dataset["start_indices"])
-    x = np.array(pgn_dataset["x"])
+    if "x_packed" in pgn_dataset:
+        x = unpack_planes(np.array(pgn_dataset["x_packed"]), np.array(pgn_dataset["x_scalars"]))
+    else:
+        x = np.array(pgn_dataset["x"])
     y_value = np.array(pgn_dataset["y_value"])
-    y_policy = np.array(pgn_dataset["y_policy"])
+    if "y_policy_offsets" in pgn_dataset:
+        y_policy = sparse_to_dense_policy(np.array(pgn_dataset["y_policy_indices"]), np.array(pgn_dataset["y_policy_values"]),
+                                          np.array(pgn_dataset["y_policy_offsets"]))
+    else:
+        y_policy = np.array(pgn_dataset["y_policy"])
 
     possible_entries = ["plys_to_end", "y_best_move_q"]
     entries = [None] * 2
@@ -72,6 +72,8 @@ Action Agent::get_best_action()
 
 void Agent::perform_action()
 {
+    lock_guard<mutex> lock(actionMutex);
+    apply_net_swaps();
     evalInfo->start = chrono::steady_clock::now();
     this->evaluate_board_state();
     evalInfo->end = chrono::steady_clock::now();
@@ -81,6 +83,26 @@ void Agent::perform_action()
     info_bestmove(StateConstants::action_to_uci(evalInfo->bestMove, state->is_chess960()));
 }
 
+void Agent::apply_net_swaps()
+{
+    apply_net_swap();
+}
+
+bool Agent::try_apply_net_swaps()
+{
+    unique_lock<mutex> lock(actionMutex, try_to_lock);
+    if (!lock.owns_lock()) {
+        return false;
+    }
+    apply_net_swaps();
+    return true;
+}
+
+bool Agent::has_pending_net_swaps() const
+{
+    return has_pending_net_swap();
+}
+
 void run_agent_thread(Agent* agent)
 {
     agent->perform_action();
@@ -28,6 +28,7 @@
 #ifndef AGENT_H
 #define AGENT_H
 
+#include <mutex>
 #include "../stateobj.h"
 #include "../evalinfo.h"
 #include "config/searchlimits.h"
@@ -59,6 +60,13 @@ protected:
     StateObj* state;
     EvalInfo* evalInfo;
     bool verbose;
+    // locked while an action is performed, so that requested network swaps are only applied in between
+    mutex actionMutex;
+
+    /**
+     * @brief apply_net_swaps Applies all requested network swaps of the agent
+     */
+    virtual void apply_net_swaps();
 
 public:
     Agent(NeuralNetAPI* net, PlaySettings* playSettings, bool verbose);
@@ -100,6 +108,17 @@ public:
      * @return Action
      */
     Action get_best_action();
+
+    /**
+     * @brief try_apply_net_swaps Applies all requested network swaps if the agent doesn't perform an action at the moment
+     * @return True, if the agent was idle
+     */
+    bool try_apply_net_swaps();
+
+    /**
+     * @brief has_pending_net_swaps Returns true if a requested network swap hasn't been applied yet
+     */
+    virtual bool has_pending_net_swaps() const;
 };
 }
 
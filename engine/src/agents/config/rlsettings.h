@@ -29,6 +29,7 @@
 #define RLSETTINGS_H
 
 #include <stddef.h>
+#include <string>
 
 struct RLSettings
 {
@@ -60,6 +61,34 @@ struct RLSettings
     float resignThreshold;
     // boolean indicating if the search tree is reused during selfplay game generation
     bool reuseTreeForSelpay;
+    // number of games which are generated concurrently, the leaf evaluations of all games are batched together
+    size_t numberParallelGames;
+    // stores the planes of the training data as bit masks and values instead of dense int16 planes
+    bool packPlanes;
+    // compressor of the exported training data, "raw" or a blosc codec (e.g. "lz4", "zstd")
+    std::string exportCompressor;
+    // compression level of the blosc codec (0-9)
+    int exportCompressionLevel;
+    // stores only the non-zero entries of the policy targets as index/value pairs
+    bool sparsePolicy;
+    // file of a memory-mapped replay buffer which receives the samples in addition to the data set (e.g. in /dev/shm), "" to disable it
+    std::string replayBufferFile;
+    // number of samples in the replay buffer
+    size_t replayBufferCapacity;
+    // number of starting positions which are pre-generated by a background thread (0 generates each opening on demand)
+    size_t openingPoolSize;
+    // number of openings which are generated concurrently by the opening pool with batched raw policy evaluations
+    size_t openingBatchSize;
+    // a checkpoint of the data set and the pgn file is saved after this many games, so that a crashed run can be resumed (0 disables it)
+    size_t checkpointGames;
+    // number of arena game pairs which are played concurrently
+    size_t arenaParallelPairs;
+    // the arena match stops early if a sequential probability ratio test of H1: elo >= sprtElo1 against H0: elo <= sprtElo0
+    // is decided with the error rates sprtAlpha and sprtBeta (disabled if sprtElo1 <= sprtElo0)
+    float sprtElo0;
+    float sprtElo1;
+    float sprtAlpha;
+    float sprtBeta;
 };
 
 #endif // RLSETTINGS_H
@@ -33,7 +33,7 @@ SearchSettings::SearchSettings():
         nodePolicyTemperature(1.0f),
         qValueWeight(0.7f),
         virtualLoss(3.0f),
-        verbose(true),
+        verbose(false),
         enhanceChecks(true),
         enhanceCaptures(true),
         useTranspositionTable(true),
@@ -49,7 +49,11 @@ SearchSettings::SearchSettings():
         threshCheck(0.1f),
         checkFactor(0.5f),
         threshCapture(0.02f),
-        captureFactor(0.05f)
+        captureFactor(0.05f),
+        useSubtreeAffinity(false),
+        useMultiVisit(false),
+        useAdaptiveBatchSize(false),
+        useSparsePolicy(false)
 {
 
 }
@@ -41,6 +41,7 @@ struct SearchSettings
     float nodePolicyTemperature;
     float qValueWeight;
     float virtualLoss;
+    // prints additional statistics after each search, e.g. the hash table locks per rollout and the batch utilization
     bool verbose;
     bool enhanceChecks;
     bool enhanceCaptures;
@@ -73,6 +74,14 @@ struct SearchSettings
     bool useTablebase;
     // If true ranom root exploration is used
     bool useRandomPlayout;
+    // If true each search thread prefers its own root subtree and steals rollouts from other subtrees when idle
+    bool useSubtreeAffinity;
+    // If true a descent applies as many visits on the best child as it would receive before the second best child overtakes it
+    bool useMultiVisit;
+    // If true the number of leaves per neural network request is adjusted during search (batchSize is the upper bound)
+    bool useAdaptiveBatchSize;
+    // If true only the policy entries of the legal moves are gathered and normalized by the neural network back-end
+    bool useSparsePolicy;
     SearchSettings();
 
 };
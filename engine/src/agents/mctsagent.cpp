@@ -25,6 +25,7 @@
 
 #include <thread>
 #include <fstream>
+#include <stdexcept>
 #include "mctsagent.h"
 #include "../evalinfo.h"
 #include "../constants.h"
@@ -48,17 +49,25 @@ MCTSAgent::MCTSAgent(NeuralNetAPI *netSingle, vector<unique_ptr<NeuralNetAPI>>&
     reusedFullTree(false),
     isRunning(false),
     overallNPS(0.0f),
+    collisionRate(0.0f),
+    effectiveRollouts(0),
+    hashTableLocksPerDescent(0.0f),
+    batchUtilization(0.0f),
     nbNPSentries(0),
     threadManager(nullptr),
+    subtreeScheduler(nullptr),
     gcThread()
 {
     mapWithMutex.hashTable.reserve(1e6);
 
+    if (searchSettings->useSubtreeAffinity) {
+        subtreeScheduler = make_unique<SubtreeScheduler>(searchSettings->threads, searchSettings->batchSize);
+    }
     for (auto i = 0; i < searchSettings->threads; ++i) {
         searchThreads.emplace_back(new SearchThread(netBatches[i].get(), searchSettings, &mapWithMutex));
+        searchThreads.back()->set_subtree_scheduler(subtreeScheduler.get(), i);
     }
     timeManager = make_unique<TimeManager>(searchSettings->randomMoveFactor);
-    generator = default_random_engine(r());
 }
 
 MCTSAgent::~MCTSAgent()
@@ -246,6 +255,10 @@ void MCTSAgent::update_stats()
     avgDepth = get_avg_depth(searchThreads);
     maxDepth = get_max_depth(searchThreads);
     tbHits = get_tb_hits(searchThreads);
+    collisionRate = get_collision_rate(searchThreads);
+    effectiveRollouts = get_effective_rollouts(searchThreads);
+    hashTableLocksPerDescent = get_hash_table_locks_per_descent(searchThreads);
+    batchUtilization = get_batch_utilization(searchThreads);
 }
 
 void MCTSAgent::evaluate_board_state()
@@ -275,6 +288,15 @@ void MCTSAgent::evaluate_board_state()
         info_string("run mcts search");
         run_mcts_search();
         update_stats();
+        if (searchSettings->verbose) {
+            info_string("hash table locks per rollout:", hashTableLocksPerDescent);
+            info_string("batch utilization:", batchUtilization);
+        }
+        if (searchSettings->useMultiVisit) {
+            const float elapsedS = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - evalInfo->start).count() / 1000.0f;
+            info_string("collision rate:", collisionRate);
+            info_string("effective rollouts/s:", size_t(effectiveRollouts / max(elapsedS, 0.001f)));
+        }
     }
     update_eval_info(*evalInfo, rootNode, tbHits, maxDepth, searchSettings->multiPV);
     lastValueEval = evalInfo->bestMoveQ[0];
@@ -285,6 +307,9 @@ void MCTSAgent::evaluate_board_state()
 void MCTSAgent::run_mcts_search()
 {
     thread** threads = new thread*[searchSettings->threads];
+    if (subtreeScheduler != nullptr) {
+        subtreeScheduler->reset(rootNode);
+    }
     for (size_t i = 0; i < searchSettings->threads; ++i) {
         searchThreads[i]->set_root_node(rootNode);
         searchThreads[i]->set_root_state(rootState);
@@ -305,6 +330,43 @@ void MCTSAgent::run_mcts_search()
     tManager->join();
     delete[] threads;
     isRunning = false;
+    if (subtreeScheduler != nullptr) {
+        info_string("subtree rollouts own/stolen/default:", to_string(subtreeScheduler->get_own_rollouts()) + "/" +
+                    to_string(subtreeScheduler->get_stolen_rollouts()) + "/" + to_string(subtreeScheduler->get_default_rollouts()));
+    }
+}
+
+void MCTSAgent::request_net_swap(NeuralNetAPI* netSingle, vector<unique_ptr<NeuralNetAPI>>& netBatches)
+{
+    if (netBatches.size() < searchThreads.size()) {
+        throw invalid_argument("The new model requires " + to_string(searchThreads.size()) + " batch networks but only " +
+                               to_string(netBatches.size()) + " were given");
+    }
+    NeuralNetAPIUser::request_net_swap(netSingle);
+    for (size_t i = 0; i < searchThreads.size(); ++i) {
+        searchThreads[i]->request_net_swap(netBatches[i].get());
+    }
+}
+
+bool MCTSAgent::has_pending_net_swaps() const
+{
+    if (has_pending_net_swap()) {
+        return true;
+    }
+    for (const SearchThread* searchThread : searchThreads) {
+        if (searchThread->has_pending_net_swap()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MCTSAgent::apply_net_swaps()
+{
+    apply_net_swap();
+    for (SearchThread* searchThread : searchThreads) {
+        searchThread->apply_net_swap();
+    }
 }
 
 void MCTSAgent::stop()
@@ -44,6 +44,7 @@
 #include "../searchthread.h"
 #include "../manager/timemanager.h"
 #include "../manager/threadmanager.h"
+#include "../manager/subtreescheduler.h"
 #include "util/gcthread.h"
 
 
@@ -78,9 +79,16 @@ private:
     size_t avgDepth;
     size_t maxDepth;
     size_t tbHits;
+    float collisionRate;
+    size_t effectiveRollouts;
+    float hashTableLocksPerDescent;
+    // filled batch slots per computed neural network sample
+    float batchUtilization;
     size_t nbNPSentries;
 
     unique_ptr<ThreadManager> threadManager;
+    // only allocated if searchSettings->useSubtreeAffinity is enabled
+    unique_ptr<SubtreeScheduler> subtreeScheduler;
     GCThread<Node> gcThread;
 
 public:
@@ -160,7 +168,17 @@ public:
     bool is_running() const;
 
     /**
-     * @brief update_stats Updates the avg depth, max depth and tablebase hits statistics
+     * @brief request_net_swap Requests to replace the networks of the agent and all search threads.
+     * The search threads switch at their next mini-batch, so that an ongoing search continues with the new networks.
+     * @param netSingle Network with batch size 1 which is used to evaluate the root node
+     * @param netBatches One network per search thread
+     */
+    void request_net_swap(NeuralNetAPI* netSingle, vector<unique_ptr<NeuralNetAPI>>& netBatches);
+
+    bool has_pending_net_swaps() const override;
+
+    /**
+     * @brief update_stats Updates the avg depth, max depth, tablebase hits, collision rate, effective rollouts and hash table lock statistics
      */
     void update_stats();
 
@@ -205,6 +223,8 @@ private:
      * @param curNPS New NPS measurement
      */
     void update_nps_measurement(float curNPS);
+
+    void apply_net_swaps() override;
 };
 
 /**
@@ -17,25 +17,79 @@
   along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
-#ifdef TENSORRT
 #ifndef MODE_POMMERMAN
 #include "chessbatchstream.h"
+#include <cctype>
+#include <fstream>
 #include "uci.h"
+#include "movegen.h"
 #include "stateobj.h"
+#include "util/communication.h"
 
+#ifdef TENSORRT
 ChessBatchStream::ChessBatchStream(int batchSize, int maxBatches):
     mBatchSize{batchSize},
     mMaxBatches{maxBatches},
     mDims{batchSize, StateConstants::NB_CHANNELS_TOTAL(), StateConstants::BOARD_HEIGHT(), StateConstants::BOARD_WIDTH()}
+{
+    mData = generate_sample_planes(batchSize * maxBatches);
+    mData.resize(StateConstants::NB_VALUES_TOTAL() * batchSize * maxBatches);
+}
+
+void ChessBatchStream::reset(int firstBatch)
+{
+    mBatchCount = firstBatch;
+}
+
+bool ChessBatchStream::next()
+{
+    if (mBatchCount >= mMaxBatches)
+    {
+        return false;
+    }
+    ++mBatchCount;
+    return true;
+}
+
+void ChessBatchStream::skip(int skipCount)
+{
+    mBatchCount += skipCount;
+}
+
+float* ChessBatchStream::getBatch()
+{
+    return mData.data() + (mBatchCount * mBatchSize * samplesCommon::volume(mDims));
+}
+
+float* ChessBatchStream::getLabels()
+{
+    // ignore lables
+    return nullptr;
+}
+
+int ChessBatchStream::getBatchesRead() const
+{
+    return mBatchCount;
+}
+
+int ChessBatchStream::getBatchSize() const
+{
+    return mBatchSize;
+}
+
+nvinfer1::Dims ChessBatchStream::getDims() const
+{
+    return Dims{4, {mBatchSize, mDims.d[0], mDims.d[1], mDims.d[2]}, {}};
+}
+#endif
+
+vector<float> generate_sample_planes(size_t numberSamples)
 {
     Bitboards::init();
     Position::init();
     Bitbases::init();
     Board pos;
     auto uiThread = make_shared<Thread>(0);
-
-    // allocate memory
-    mData.resize(StateConstants::NB_VALUES_TOTAL() * batchSize * maxBatches);
     StateListPtr states = StateListPtr(new std::deque<StateInfo>(1));
     reset_to_startpos(pos, uiThread.get(), states);
 
@@ -97,9 +151,11 @@ ChessBatchStream::ChessBatchStream(int batchSize, int maxBatches):
     vector<string> curUciMoves = uciMoves;
     size_t offset = 0;
 
-    for (size_t idx = 0; idx < size_t(batchSize * maxBatches); ++idx) {
+    numberSamples = min(numberSamples, uciMoves.size() + uciMoves2.size());
+    vector<float> planes(StateConstants::NB_VALUES_TOTAL() * numberSamples);
+    for (size_t idx = 0; idx < numberSamples; ++idx) {
         states->emplace_back();
-        board_to_planes(&pos, pos.number_repetitions(), true, mData.data() + StateConstants::NB_VALUES_TOTAL() * idx);
+        board_to_planes(&pos, pos.number_repetitions(), true, planes.data() + StateConstants::NB_VALUES_TOTAL() * idx);
         if (idx == curUciMoves.size()) {
             reset_to_startpos(pos, uiThread.get(), states);
             offset = curUciMoves.size();
@@ -107,52 +163,112 @@ ChessBatchStream::ChessBatchStream(int batchSize, int maxBatches):
         }
         pos.do_move(UCI::to_move(pos, curUciMoves[idx-offset]), states->back());
     }
+    return planes;
 }
 
-void ChessBatchStream::reset(int firstBatch)
+/**
+ * @brief normalize_san Removes check marks, annotations and promotion signs from a move in SAN notation
+ */
+string normalize_san(const string& san)
 {
-    mBatchCount = firstBatch;
-}
-
-bool ChessBatchStream::next()
-{
-    if (mBatchCount >= mMaxBatches)
-    {
-        return false;
+    string normalized;
+    for (char c : san) {
+        if (c == '0') {
+            // castling is sometimes written with zeros
+            normalized += 'O';
+        }
+        else if (c != '+' && c != '#' && c != '!' && c != '?' && c != '=') {
+            normalized += c;
+        }
     }
-    ++mBatchCount;
-    return true;
+    return normalized;
 }
 
-void ChessBatchStream::skip(int skipCount)
+vector<float> read_pgn_planes(const string& pgnFile, size_t maxSamples)
 {
-    mBatchCount += skipCount;
-}
-
-float* ChessBatchStream::getBatch()
-{
-    return mData.data() + (mBatchCount * mBatchSize * samplesCommon::volume(mDims));
-}
-
-float* ChessBatchStream::getLabels()
-{
-    // ignore lables
-    return nullptr;
-}
-
-int ChessBatchStream::getBatchesRead() const
-{
-    return mBatchCount;
-}
-
-int ChessBatchStream::getBatchSize() const
-{
-    return mBatchSize;
-}
+    ifstream file(pgnFile);
+    if (!file) {
+        throw invalid_argument("The PGN file " + pgnFile + " couldn't be opened.");
+    }
+    Board pos;
+    auto uiThread = make_shared<Thread>(0);
+    StateListPtr states;
+    reset_to_startpos(pos, uiThread.get(), states);
 
-nvinfer1::Dims ChessBatchStream::getDims() const
-{
-    return Dims{4, {mBatchSize, mDims.d[0], mDims.d[1], mDims.d[2]}, {}};
+    vector<float> planes;
+    size_t numberSamples = 0;
+    // depth of the current comment and variation, moves inside are ignored
+    size_t commentDepth = 0;
+    size_t variationDepth = 0;
+    bool skipGame = false;
+    string line;
+    while (numberSamples < maxSamples && getline(file, line)) {
+        if (commentDepth == 0 && !line.empty() && line[0] == '[') {
+            const string fenTag = "[FEN \"";
+            if (line.compare(0, fenTag.size(), fenTag) == 0) {
+                const string fen = line.substr(fenTag.size(), line.find('"', fenTag.size()) - fenTag.size());
+                states = StateListPtr(new std::deque<StateInfo>(1));
+                pos.set(fen, false, pos.variant(), &states->back(), uiThread.get());
+            }
+            continue;
+        }
+        string token;
+        for (size_t idx = 0; idx <= line.size() && numberSamples < maxSamples; ++idx) {
+            const char c = idx < line.size() ? line[idx] : ' ';
+            if (commentDepth != 0) {
+                commentDepth -= c == '}';
+                continue;
+            }
+            if (c != '{' && c != '(' && c != ')' && c != ';' && !isspace(c)) {
+                token += c;
+                continue;
+            }
+            if (!token.empty() && variationDepth == 0) {
+                if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*") {
+                    reset_to_startpos(pos, uiThread.get(), states);
+                    skipGame = false;
+                }
+                else {
+                    // remove move numbers e.g. "12." or "12..."
+                    size_t moveStart = token.find_first_not_of("0123456789");
+                    moveStart = moveStart != 0 && moveStart != string::npos && token[moveStart] == '.' ? token.find_first_not_of('.', moveStart) : 0;
+                    if (!skipGame && moveStart != string::npos && token[moveStart] != '$') {
+                        const string san = normalize_san(token.substr(moveStart));
+                        vector<Action> legalMoves;
+                        for (const ExtMove& move : MoveList<LEGAL>(pos)) {
+                            legalMoves.push_back(Action(move));
+                        }
+                        Move move = MOVE_NONE;
+                        for (Action action : legalMoves) {
+                            if (normalize_san(pgn_move(Move(action), pos.is_chess960(), pos, legalMoves)) == san) {
+                                move = Move(action);
+                                break;
+                            }
+                        }
+                        if (move == MOVE_NONE) {
+                            info_string("skip game after unknown pgn move:", token);
+                            skipGame = true;
+                        }
+                        else {
+                            planes.resize(StateConstants::NB_VALUES_TOTAL() * (numberSamples + 1));
+                            board_to_planes(&pos, pos.number_repetitions(), true, planes.data() + StateConstants::NB_VALUES_TOTAL() * numberSamples);
+                            ++numberSamples;
+                            states->emplace_back();
+                            pos.do_move(move, states->back());
+                        }
+                    }
+                }
+            }
+            token.clear();
+            commentDepth += c == '{';
+            variationDepth += c == '(';
+            variationDepth -= c == ')' && variationDepth > 0;
+            if (c == ';') {
+                break;
+            }
+        }
+    }
+    return planes;
 }
 
 void reset_to_startpos(Board& pos, Thread* uiThread, StateListPtr& states)
@@ -165,4 +281,3 @@ void reset_to_startpos(Board& pos, Thread* uiThread, StateListPtr& states)
 #endif
 }
 #endif
-#endif
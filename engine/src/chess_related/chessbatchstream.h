@@ -23,22 +23,25 @@
  * @author: queensgambit
  *
  * Calibration stream data for INT8 quantization.
- * The calibration data is generated using sample chess positions.
+ * The calibration data is generated using sample chess positions or read from a PGN file.
  */
 
 #ifndef CHESSBATCHSTREAM_H
 #define CHESSBATCHSTREAM_H
 
-#ifdef TENSORRT
 #ifndef MODE_POMMERMAN
 
+#include <string>
+#include <vector>
 #include "thread.h"
-#include "EntropyCalibrator.h"
-#include "BatchStream.h"
 #include "chess_related/inputrepresentation.h"
 #include "chess_related/variants.h"
 #include "constants.h"
 
+#ifdef TENSORRT
+#include "EntropyCalibrator.h"
+#include "BatchStream.h"
+
 /**
  * @brief The ChessBatchStream class
  * Provides batches of example chess position for calibration.
@@ -73,9 +76,25 @@ private:
     std::vector<float> mData;
     std::vector<float> mLabels{};
 };
+#endif
 
 void reset_to_startpos(Board& pos, Thread* uiThread, StateListPtr& states);
-#endif
+
+/**
+ * @brief generate_sample_planes Returns the input planes of the built-in sample games which are used for calibration
+ * @param numberSamples Number of requested positions. It is reduced to the number of available positions if necessary.
+ * @return Input planes of all positions one after another
+ */
+std::vector<float> generate_sample_planes(size_t numberSamples);
+
+/**
+ * @brief read_pgn_planes Returns the input planes of all positions of the main lines in the given PGN file.
+ * Comments, variations and annotations are ignored. Games with unknown moves are skipped from that move on.
+ * @param pgnFile Path to the PGN file
+ * @param maxSamples Maximum number of positions which are returned
+ * @return Input planes of all positions one after another
+ */
+std::vector<float> read_pgn_planes(const std::string& pgnFile, size_t maxSamples);
 #endif
 
 #endif // CHESSBATCHSTREAM_H
@@ -25,6 +25,10 @@
 
 #include "crazyara.h"
 
+#include <chrono>
+#include <exception>
+#include <iomanip>
+#include <thread>
 #include "bitboard.h"
 #include "position.h"
 #include "search.h"
@@ -41,10 +45,13 @@
 #include "optionsuci.h"
 #include "../tests/benchmarkpositions.h"
 #include "util/communication.h"
+#include "util/threadbudget.h"
 #ifdef MXNET
 #include "nn/mxnetapi.h"
 #elif defined TENSORRT
 #include "nn/tensorrtapi.h"
+#elif defined NATIVE_CPU
+#include "nn/nativecpuapi.h"
 #endif
 
 CrazyAra::CrazyAra():
@@ -66,6 +73,7 @@ CrazyAra::CrazyAra():
     useRawNetwork(false),      // will be initialized in init_search_settings()
     networkLoaded(false),
     ongoingSearch(false),
+    isLoadingModel(false),
 #ifdef SUPPORT960
     is960(true),
 #else
@@ -76,6 +84,7 @@ CrazyAra::CrazyAra():
 
 CrazyAra::~CrazyAra()
 {
+    wait_for_model_loader();
 }
 
 void CrazyAra::welcome()
@@ -116,6 +125,13 @@ void CrazyAra::uci_loop(int argc, char *argv[])
         token.clear(); // Avoid a stale if getline() returns empty or blank line
         is >> skipws >> token;
 
+        // searches continue on the current networks during a model swap,
+        // only the commands which recreate the networks or agents wait for it
+        if (token == "setoption" || token == "ucinewgame" || token == "benchthreads"
+                || token == "selfplay" || token == "arena") {
+            wait_for_model_loader();
+        }
+
         if (token == "stop" || token == "quit") {
             if (mctsAgent != nullptr) {
                 mctsAgent->stop();
@@ -138,13 +154,16 @@ void CrazyAra::uci_loop(int argc, char *argv[])
 
         // Additional custom non-UCI commands, mainly for debugging
         else if (token == "benchmark")  benchmark(is);
+        else if (token == "benchthreads") benchmark_thread_budget(is);
         else if (token == "root")       mctsAgent->print_root_node();
         else if (token == "tree")      export_search_tree(is);
+        else if (token == "loadmodel")  load_model(is);
         else if (token == "flip")       state->flip();
         else if (token == "d")          cout << *(state.get()) << endl;
 #ifdef USE_RL
         else if (token == "selfplay")   selfplay(is);
         else if (token == "arena")      arena(is);
+        else if (token == "benchexport") benchmark_exporter(is);
 #endif
         else
             cout << "Unknown command: " << cmd << endl;
@@ -298,6 +317,75 @@ void CrazyAra::benchmark(istringstream &is)
     cout << "PV-Depth:\t" << setw(2) << totalDepth /  benchmark.positions.size() << endl;
 }
 
+void CrazyAra::benchmark_thread_budget(istringstream &is)
+{
+    if (!is_inference_budget_adjustable()) {
+        info_string("benchthreads requires the native CPU back-end, the other back-ends don't apply the inference threads of the budget");
+        return;
+    }
+    string moveTime;
+    is >> moveTime;
+    const string goCommand = "go movetime " + moveTime;
+    const vector<int> inferenceShares = {10, 25, 50, 75, 90};
+    vector<int> threadCounts;
+    for (int threads = 1; threads <= max(1, int(thread::hardware_concurrency())); threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    const string initialShare = to_string(int(Options["Centi_Inference_Cores"]));
+    const string initialThreads = to_string(int(Options["Threads"]));
+    BenchmarkPositions benchmark;
+    EvalInfo evalInfo;
+    vector<vector<int>> nps(inferenceShares.size(), vector<int>(threadCounts.size()));
+    int maxNPS = 1;
+
+    for (size_t row = 0; row < inferenceShares.size(); ++row) {
+        for (size_t col = 0; col < threadCounts.size(); ++col) {
+            Options["Centi_Inference_Cores"] = to_string(inferenceShares[row]);
+            Options["Threads"] = to_string(threadCounts[col]);
+            reload_networks();
+            int totalNPS = 0;
+            for (const TestPosition& pos : benchmark.positions) {
+                go(pos.fen, goCommand, evalInfo);
+                totalNPS += evalInfo.calculate_nps();
+            }
+            nps[row][col] = totalNPS / int(benchmark.positions.size());
+            maxNPS = max(maxNPS, nps[row][col]);
+        }
+    }
+    Options["Centi_Inference_Cores"] = initialShare;
+    Options["Threads"] = initialThreads;
+    reload_networks();
+
+    // the shade of each cell relates to its NPS compared to the best split
+    const string shades = " .:-=+*#%@";
+    cout << endl << "NPS heatmap (rows: inference cores in %, columns: search threads)" << endl;
+    cout << "The inference threads of each cell are applied by recreating the networks." << endl;
+    cout << setw(6) << "";
+    for (int threads : threadCounts) {
+        cout << setw(10) << threads;
+    }
+    cout << endl;
+    for (size_t row = 0; row < inferenceShares.size(); ++row) {
+        cout << setw(5) << inferenceShares[row] << "%";
+        for (size_t col = 0; col < threadCounts.size(); ++col) {
+            const size_t shadeIdx = size_t(nps[row][col]) * (shades.size() - 1) / size_t(maxNPS);
+            cout << setw(8) << nps[row][col] << " " << shades[shadeIdx];
+        }
+        cout << endl;
+    }
+}
+
+void CrazyAra::reload_networks()
+{
+    wait_to_finish_last_search();
+    mctsAgent.reset();
+    rawAgent.reset();
+    netBatches.clear();
+    netSingle.reset();
+    networkLoaded = false;
+    is_ready();
+}
+
 void CrazyAra::export_search_tree(istringstream &is)
 {
     string depth, filename;
@@ -320,27 +408,108 @@ void CrazyAra::selfplay(istringstream &is)
     SearchLimits searchLimits;
     searchLimits.nodes = size_t(Options["Nodes"]);
     SelfPlay selfPlay(rawAgent.get(), mctsAgent.get(), &searchLimits, &playSettings, &rlSettings);
+    // the opening pool uses its own network, so that the openings of a whole batch of games are evaluated at once
+    unique_ptr<NeuralNetAPI> netOpenings;
+    unique_ptr<OpeningPool> openingPool;
+    if (rlSettings.openingPoolSize > 0) {
+        netOpenings = create_new_net_single(Options["Model_Directory"], rlSettings.openingBatchSize);
+        openingPool = make_unique<OpeningPool>(netOpenings.get(), &playSettings, variant, rlSettings.rawPolicyProbabilityTemperature,
+                                               rlSettings.openingPoolSize);
+        selfPlay.set_opening_pool(openingPool.get());
+    }
     size_t numberOfGames;
     is >> numberOfGames;
-    selfPlay.go(numberOfGames, variant);
+    if (rlSettings.numberParallelGames > 1) {
+        selfplay_parallel(selfPlay, numberOfGames);
+    }
+    else {
+        selfPlay.go(numberOfGames, variant);
+    }
+    if (openingPool != nullptr) {
+        info_string("game starts waiting for an opening:", openingPool->get_number_waits());
+    }
     cout << "readyok" << endl;
 }
 
+vector<MCTSAgent*> SharedBatchAgents::get_agents() const
+{
+    vector<MCTSAgent*> agentPointers;
+    for (const unique_ptr<MCTSAgent>& agent : agents) {
+        agentPointers.push_back(agent.get());
+    }
+    return agentPointers;
+}
+
+void SharedBatchAgents::print_average_batch_size() const
+{
+    for (const unique_ptr<SharedBatchServer>& server : servers) {
+        info_string("average shared batch size:", server->get_average_batch_size());
+    }
+}
+
+unique_ptr<SharedBatchAgents> CrazyAra::create_shared_batch_agents(const string& modelDirectory, size_t numberAgents, size_t numberClients)
+{
+    unique_ptr<SharedBatchAgents> shared = make_unique<SharedBatchAgents>();
+    // the search threads with the same index of all agents share one network which evaluates all of their batches at once
+    shared->sharedNets = create_new_net_batches(modelDirectory, numberAgents * searchSettings.batchSize);
+    for (unique_ptr<NeuralNetAPI>& sharedNet : shared->sharedNets) {
+        shared->servers.emplace_back(make_unique<SharedBatchServer>(sharedNet.get(), numberClients));
+    }
+    shared->searchSettings.assign(numberAgents, searchSettings);
+    shared->netBatches.resize(numberAgents);
+    for (size_t agentIdx = 0; agentIdx < numberAgents; ++agentIdx) {
+        shared->netSingles.emplace_back(make_unique<SharedBatchAPI>(shared->servers.front().get(), 1));
+        for (unique_ptr<SharedBatchServer>& server : shared->servers) {
+            shared->netBatches[agentIdx].emplace_back(make_unique<SharedBatchAPI>(server.get(), searchSettings.batchSize));
+        }
+        shared->agents.emplace_back(make_unique<MCTSAgent>(shared->netSingles.back().get(), shared->netBatches[agentIdx],
+                                                           &shared->searchSettings[agentIdx], &playSettings));
+    }
+    return shared;
+}
+
+void CrazyAra::selfplay_parallel(SelfPlay& selfPlay, size_t numberOfGames)
+{
+    const size_t numberGames = rlSettings.numberParallelGames;
+    unique_ptr<SharedBatchAgents> gameAgents = create_shared_batch_agents(Options["Model_Directory"], numberGames, numberGames);
+    info_string("parallel selfplay games:", numberGames);
+    selfPlay.go_parallel(numberOfGames, variant, gameAgents->get_agents());
+    gameAgents->print_average_batch_size();
+}
+
 void CrazyAra::arena(istringstream &is)
 {
     SearchLimits searchLimits;
     searchLimits.nodes = size_t(Options["Nodes"]);
     SelfPlay selfPlay(rawAgent.get(), mctsAgent.get(), &searchLimits, &playSettings, &rlSettings);
-    netSingle = create_new_net_single(Options["Model_Directory_Contender"]);
-    netBatches = create_new_net_batches(Options["Model_Directory_Contender"]);
-    mctsAgentContender = create_new_mcts_agent(netSingle.get(), netBatches);
     size_t numberOfGames;
     is >> numberOfGames;
-    TournamentResult tournamentResult = selfPlay.go_arena(mctsAgentContender.get(), numberOfGames, variant);
+    TournamentResult tournamentResult;
+    const size_t numberPairs = rlSettings.arenaParallelPairs;
+    if (numberPairs > 1) {
+        // in each game pair only one of the two networks searches at a time
+        const size_t numberClients = (numberPairs + 1) / 2;
+        unique_ptr<SharedBatchAgents> contenders = create_shared_batch_agents(Options["Model_Directory_Contender"], numberPairs, numberClients);
+        unique_ptr<SharedBatchAgents> producers = create_shared_batch_agents(Options["Model_Directory"], numberPairs, numberClients);
+        info_string("parallel arena game pairs:", numberPairs);
+        tournamentResult = selfPlay.go_arena_parallel(numberOfGames, variant, contenders->get_agents(), producers->get_agents());
+        contenders->print_average_batch_size();
+        producers->print_average_batch_size();
+    }
+    else {
+        netSingleContender = create_new_net_single(Options["Model_Directory_Contender"]);
+        netBatchesContender = create_new_net_batches(Options["Model_Directory_Contender"]);
+        mctsAgentContender = create_new_mcts_agent(netSingleContender.get(), netBatchesContender);
+        tournamentResult = selfPlay.go_arena(mctsAgentContender.get(), numberOfGames, variant);
+    }
 
     cout << "Arena summary" << endl;
     cout << "Score of Contender vs Producer: " << tournamentResult << endl;
-    if (tournamentResult.score() > 0.5f) {
+    if (tournamentResult.sprtResult != SPRT_UNDECIDED) {
+        cout << "SPRT " << (tournamentResult.sprtResult == SPRT_ACCEPTED ? "accepted" : "rejected")
+             << " the contender, games saved: " << tournamentResult.numberGamesSaved << endl;
+    }
+    if (tournamentResult.sprtResult == SPRT_ACCEPTED || (tournamentResult.sprtResult == SPRT_UNDECIDED && tournamentResult.score() > 0.5f)) {
         cout << "replace" << endl;
     }
     else {
@@ -349,6 +518,57 @@ void CrazyAra::arena(istringstream &is)
     write_tournament_result_to_csv(tournamentResult, "arena_results.csv");
 }
 
+void CrazyAra::benchmark_exporter(istringstream& is)
+{
+    size_t numberGames = 20;
+    is >> numberGames;
+    const size_t maxPlies = 150;
+    const size_t chunkSize = size_t(Options["Selfplay_Chunk_Size"]);
+    TrainDataExporter exporter("bench_export.zarr", (numberGames * maxPlies + chunkSize - 1) / chunkSize, chunkSize,
+                               Options["Selfplay_Pack_Planes"], string(Options["Selfplay_Compressor"]), int(Options["Selfplay_Compression_Level"]),
+                               Options["Selfplay_Sparse_Policy"]);
+    GameSamples game(GAME_SAMPLES_CAPACITY, Options["Selfplay_Sparse_Policy"]);
+    GamePGN gamePGN;
+    size_t totalSamples = 0;
+    chrono::nanoseconds saveTime(0);
+    chrono::nanoseconds exportTime(0);
+
+    for (size_t gameIdx = 0; gameIdx < numberGames; ++gameIdx) {
+        // random games with a uniform policy over the legal moves
+        unique_ptr<StateObj> benchState = init_state(variant, false, gamePGN);
+        Result gameResult = NO_RESULT;
+        for (size_t ply = 0; ply < maxPlies && gameResult == NO_RESULT; ++ply) {
+            EvalInfo eval;
+            eval.legalMoves = benchState->legal_actions();
+            eval.policyProbSmall = DynamicVector<float>(eval.legalMoves.size(), 1.0f / eval.legalMoves.size());
+            eval.bestMoveQ = {0.0f};
+            eval.bestMove = eval.legalMoves[size_t(rand()) % eval.legalMoves.size()];
+
+            const chrono::steady_clock::time_point saveStart = chrono::steady_clock::now();
+            exporter.save_sample(game, benchState.get(), eval);
+            saveTime += chrono::steady_clock::now() - saveStart;
+
+            const bool givesCheck = benchState->gives_check(eval.bestMove);
+            benchState->do_action(eval.bestMove);
+            gameResult = benchState->check_result(givesCheck);
+        }
+        totalSamples += game.numberSamples;
+        const chrono::steady_clock::time_point exportStart = chrono::steady_clock::now();
+        exporter.export_game_samples(game, gameResult == NO_RESULT ? DRAWN : gameResult);
+        exportTime += chrono::steady_clock::now() - exportStart;
+    }
+    // the games are written by the writer thread of the exporter
+    const chrono::steady_clock::time_point flushStart = chrono::steady_clock::now();
+    exporter.flush();
+    const chrono::nanoseconds flushTime = chrono::steady_clock::now() - flushStart;
+
+    cout << "Games:\t\t\t" << numberGames << endl
+         << "Samples:\t\t" << totalSamples << endl
+         << "Save (us/sample):\t" << chrono::duration_cast<chrono::nanoseconds>(saveTime).count() / 1000.0 / totalSamples << endl
+         << "Export (us/sample):\t" << chrono::duration_cast<chrono::nanoseconds>(exportTime).count() / 1000.0 / totalSamples << endl
+         << "Flush (ms):\t\t" << chrono::duration_cast<chrono::milliseconds>(flushTime).count() << endl;
+}
+
 void CrazyAra::init_rl_settings()
 {
     rlSettings.numberChunks = Options["Selfplay_Number_Chunks"];
@@ -363,6 +583,21 @@ void CrazyAra::init_rl_settings()
     rlSettings.resignProbability = Options["Centi_Resign_Probability"] / 100.0f;
     rlSettings.resignThreshold = Options["Centi_Resign_Threshold"] / 100.0f;
     rlSettings.reuseTreeForSelpay = Options["Reuse_Tree"];
+    rlSettings.numberParallelGames = Options["Selfplay_Parallel_Games"];
+    rlSettings.packPlanes = Options["Selfplay_Pack_Planes"];
+    rlSettings.exportCompressor = string(Options["Selfplay_Compressor"]);
+    rlSettings.exportCompressionLevel = Options["Selfplay_Compression_Level"];
+    rlSettings.sparsePolicy = Options["Selfplay_Sparse_Policy"];
+    rlSettings.replayBufferFile = string(Options["Selfplay_Replay_Buffer"]) == "<empty>" ? "" : string(Options["Selfplay_Replay_Buffer"]);
+    rlSettings.replayBufferCapacity = Options["Selfplay_Replay_Buffer_Size"];
+    rlSettings.openingPoolSize = Options["Selfplay_Opening_Pool_Size"];
+    rlSettings.openingBatchSize = Options["Selfplay_Opening_Batch_Size"];
+    rlSettings.checkpointGames = Options["Selfplay_Checkpoint_Games"];
+    rlSettings.arenaParallelPairs = Options["Arena_Parallel_Pairs"];
+    rlSettings.sprtElo0 = Options["SPRT_Elo0"];
+    rlSettings.sprtElo1 = Options["SPRT_Elo1"];
+    rlSettings.sprtAlpha = Options["Centi_SPRT_Alpha"] / 100.0f;
+    rlSettings.sprtBeta = Options["Centi_SPRT_Beta"] / 100.0f;
 }
 #endif
 
@@ -384,10 +619,20 @@ bool CrazyAra::is_ready()
 #ifdef USE_RL
         init_rl_settings();
 #endif
+        set_thread_budget(create_thread_budget(size_t(Options["Centi_Inference_Cores"]), searchSettings.threads, Options["Pin_Threads"]));
+        const chrono::steady_clock::time_point loadStart = chrono::steady_clock::now();
         netSingle = create_new_net_single(Options["Model_Directory"]);
+        const chrono::steady_clock::time_point singleEnd = chrono::steady_clock::now();
         netBatches = create_new_net_batches(Options["Model_Directory"]);
+        const chrono::steady_clock::time_point batchesEnd = chrono::steady_clock::now();
         mctsAgent = create_new_mcts_agent(netSingle.get(), netBatches);
         rawAgent = make_unique<RawNetAgent>(netSingle.get(), &playSettings, false);
+        const chrono::steady_clock::time_point agentsEnd = chrono::steady_clock::now();
+        info_string("single network construction time (ms):", chrono::duration_cast<chrono::milliseconds>(singleEnd - loadStart).count());
+        info_string("batch networks construction time (ms):", chrono::duration_cast<chrono::milliseconds>(batchesEnd - singleEnd).count());
+        info_string("agent construction time (ms):", chrono::duration_cast<chrono::milliseconds>(agentsEnd - batchesEnd).count());
+        info_string("network loading time (ms):", chrono::duration_cast<chrono::milliseconds>(agentsEnd - loadStart).count());
+        info_string("resident memory (MiB):", get_resident_memory_mb());
         StateConstants::init(mctsAgent->is_policy_map());
         networkLoaded = true;
     }
@@ -411,35 +656,157 @@ string CrazyAra::engine_info()
     return ss.str();
 }
 
-unique_ptr<NeuralNetAPI> CrazyAra::create_new_net_single(const string& modelDirectory)
+void CrazyAra::load_model(istringstream& is)
+{
+    string modelDirectory;
+    is >> modelDirectory;
+    if (!networkLoaded) {
+        info_string("the initial model must be loaded by isready before it can be swapped");
+        return;
+    }
+    if (isLoadingModel) {
+        info_string("another model is still being loaded");
+        return;
+    }
+    wait_for_model_loader();
+    isLoadingModel = true;
+    modelLoader = thread(&CrazyAra::swap_model, this, modelDirectory);
+}
+
+void CrazyAra::wait_for_model_loader()
+{
+    if (!modelLoader.joinable()) {
+        return;
+    }
+    if (isLoadingModel) {
+        info_string("waiting for the model swap to finish");
+    }
+    modelLoader.join();
+}
+
+void CrazyAra::swap_model(const string& modelDirectory)
+{
+    const chrono::steady_clock::time_point loadStart = chrono::steady_clock::now();
+    unique_ptr<NeuralNetAPI> newNetSingle;
+    vector<unique_ptr<NeuralNetAPI>> newNetBatches;
+    try {
+        newNetSingle = create_new_net_single(modelDirectory);
+        newNetBatches = create_new_net_batches(modelDirectory);
+        if (newNetSingle->is_policy_map() != netSingle->is_policy_map()) {
+            throw invalid_argument("the new model must use the same policy representation as the current model");
+        }
+        mctsAgent->request_net_swap(newNetSingle.get(), newNetBatches);
+        rawAgent->request_net_swap(newNetSingle.get());
+    }
+    catch (const exception& e) {
+        info_string("model swap failed:", e.what());
+        isLoadingModel = false;
+        return;
+    }
+    info_string("model loading time (ms):", chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - loadStart).count());
+
+    // idle agents switch immediately, search threads switch at their next mini-batch
+    while (true) {
+        mctsAgent->try_apply_net_swaps();
+        rawAgent->try_apply_net_swaps();
+        if (!mctsAgent->has_pending_net_swaps() && !rawAgent->has_pending_net_swaps()) {
+            break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    netSingle.swap(newNetSingle);
+    netBatches.swap(newNetBatches);
+    // free the old model
+    newNetSingle.reset();
+    newNetBatches.clear();
+    info_string("swapped model to", modelDirectory);
+    info_string("resident memory (MiB):", get_resident_memory_mb());
+    isLoadingModel = false;
+}
+
+#ifdef NATIVE_CPU
+/**
+ * @brief calibration_file Returns the PGN file which is used for the int8 calibration or "" to use the built-in positions
+ */
+string calibration_file()
+{
+    const string pgnFile = Options["Calibration_PGN"];
+    return pgnFile == "<empty>" ? "" : pgnFile;
+}
+#endif
+
+unique_ptr<NeuralNetAPI> CrazyAra::create_new_net_single(const string& modelDirectory, unsigned int batchSize)
 {
 #ifdef MXNET
-    return make_unique<MXNetAPI>(Options["Context"], int(Options["First_Device_ID"]), 1, modelDirectory, false);
+    return make_unique<MXNetAPI>(Options["Context"], int(Options["First_Device_ID"]), batchSize, modelDirectory, false);
 #elif defined TENSORRT
-    return make_unique<TensorrtAPI>(int(Options["First_Device_ID"]), 1, modelDirectory, Options["Precision"]);
+    return make_unique<TensorrtAPI>(int(Options["First_Device_ID"]), batchSize, modelDirectory, Options["Precision"]);
+#elif defined NATIVE_CPU
+    return make_unique<NativeCPUAPI>(int(Options["First_Device_ID"]), batchSize, modelDirectory, 1, Options["Precision"], calibration_file());
 #endif
     return nullptr;
 }
 
-vector<unique_ptr<NeuralNetAPI>> CrazyAra::create_new_net_batches(const string& modelDirectory)
+vector<unique_ptr<NeuralNetAPI>> CrazyAra::create_new_net_batches(const string& modelDirectory, unsigned int batchSize)
 {
-    vector<unique_ptr<NeuralNetAPI>> netBatches;
+    // read all options before the networks are constructed in parallel
+    vector<int> deviceIds;
+    for (int deviceId = int(Options["First_Device_ID"]); deviceId <= int(Options["Last_Device_ID"]); ++deviceId) {
+        for (size_t i = 0; i < size_t(Options["Threads"]); ++i) {
+            deviceIds.push_back(deviceId);
+        }
+    }
+    vector<unique_ptr<NeuralNetAPI>> netBatches(deviceIds.size());
+    if (batchSize == 0) {
+        batchSize = searchSettings.batchSize;
+    }
 #ifdef MXNET
     #ifdef TENSORRT
         const bool useTensorRT = bool(Options["Use_TensorRT"]);
     #else
         const bool useTensorRT = false;
     #endif
-#endif
-    for (int deviceId = int(Options["First_Device_ID"]); deviceId <= int(Options["Last_Device_ID"]); ++deviceId) {
-        for (size_t i = 0; i < size_t(Options["Threads"]); ++i) {
-    #ifdef MXNET
-            netBatches.push_back(make_unique<MXNetAPI>(Options["Context"], deviceId, searchSettings.batchSize, modelDirectory, useTensorRT));
-    #elif defined TENSORRT
-            netBatches.push_back(make_unique<TensorrtAPI>(deviceId, searchSettings.batchSize, modelDirectory, Options["Precision"]));
+    // the MXNet C-API isn't thread safe, so that the networks are constructed sequentially
+    const string context = Options["Context"];
+    for (size_t idx = 0; idx < deviceIds.size(); ++idx) {
+        netBatches[idx] = make_unique<MXNetAPI>(context, deviceIds[idx], batchSize, modelDirectory, useTensorRT);
+    }
+#elif defined TENSORRT || defined NATIVE_CPU
+    #if defined TENSORRT
+    const string precision = Options["Precision"];
+    #elif defined NATIVE_CPU
+    const string precision = Options["Precision"];
+    const string calibrationFile = calibration_file();
+    // the calling search thread evaluates the first chunk of each batch in addition to the inference threads
+    const size_t inferenceThreads = get_thread_budget().enabled ? get_thread_budget().inferenceThreadsPerNet + 1 : size_t(Options["Inference_Threads"]);
     #endif
+    // the model is parsed by the first network and shared with all others (see get_shared_model())
+    vector<exception_ptr> errors(deviceIds.size());
+    vector<thread> threads;
+    for (size_t idx = 0; idx < deviceIds.size(); ++idx) {
+        threads.emplace_back([&, idx]() {
+            try {
+    #if defined TENSORRT
+                netBatches[idx] = make_unique<TensorrtAPI>(deviceIds[idx], batchSize, modelDirectory, precision);
+    #elif defined NATIVE_CPU
+                netBatches[idx] = make_unique<NativeCPUAPI>(deviceIds[idx], batchSize, modelDirectory, inferenceThreads,
+                                                            precision, calibrationFile);
+    #endif
+            }
+            catch (...) {
+                errors[idx] = current_exception();
+            }
+        });
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    for (const exception_ptr& error : errors) {
+        if (error != nullptr) {
+            rethrow_exception(error);
         }
     }
+#endif
     return netBatches;
 }
 
@@ -478,6 +845,11 @@ void CrazyAra::init_search_settings()
 #endif
     searchSettings.useNPSTimemanager = Options["Use_NPS_Time_Manager"];
     searchSettings.useRandomPlayout = Options["Random_Playout"];
+    searchSettings.useSubtreeAffinity = Options["Subtree_Affinity"];
+    searchSettings.useMultiVisit = Options["Multi_Visit"];
+    searchSettings.useAdaptiveBatchSize = Options["Adaptive_Batch_Size"];
+    searchSettings.useSparsePolicy = Options["Sparse_Policy"];
+    searchSettings.verbose = Options["Search_Statistics"];
     if (string(Options["SyzygyPath"]).empty() || string(Options["SyzygyPath"]) == "<empty>") {
         searchSettings.useTablebase = false;
     }
@@ -29,6 +29,7 @@
 #define CRAZYARA_H
 
 #include <iostream>
+#include <atomic>
 
 #include "agents/rawnetagent.h"
 #include "agents/mctsagent.h"
@@ -41,10 +42,36 @@
 #ifdef USE_RL
 #include "rl/selfplay.h"
 #include "agents/config/rlsettings.h"
+#include "nn/sharedbatchapi.h"
 #endif
 
 using namespace crazyara;
 
+#ifdef USE_RL
+/**
+ * @brief The SharedBatchAgents struct holds MCTSAgents for concurrent games together with their networks.
+ * Each agent has its own search settings, while the search threads with the same index of all agents share one network
+ * which evaluates their batches together.
+ */
+struct SharedBatchAgents
+{
+    vector<unique_ptr<NeuralNetAPI>> sharedNets;
+    vector<unique_ptr<SharedBatchServer>> servers;
+    // every agent needs its own search settings because a quick search modifies them
+    vector<SearchSettings> searchSettings;
+    vector<unique_ptr<NeuralNetAPI>> netSingles;
+    vector<vector<unique_ptr<NeuralNetAPI>>> netBatches;
+    vector<unique_ptr<MCTSAgent>> agents;
+
+    vector<MCTSAgent*> get_agents() const;
+
+    /**
+     * @brief print_average_batch_size Prints the average batch size of each shared network
+     */
+    void print_average_batch_size() const;
+};
+#endif
+
 class CrazyAra
 {
 private:
@@ -82,6 +109,9 @@ private:
     SearchLimits searchLimits;
     PlaySettings playSettings;
     thread mainSearchThread;
+    // loads a new model in the background and swaps it with the current one
+    thread modelLoader;
+    atomic<bool> isLoadingModel;
 
     Variant variant;
 
@@ -152,6 +182,14 @@ public:
      */
     void benchmark(istringstream& is);
 
+    /**
+     * @brief benchmark_thread_budget Runs the benchmark positions for different splits of the cores between search and
+     * inference threads (see option "Centi_Inference_Cores") and prints the NPS as a heatmap.
+     * Only back-ends which apply a changed thread budget are supported (see is_inference_budget_adjustable()).
+     * @param is Movetime in ms for each position
+     */
+    void benchmark_thread_budget(istringstream& is);
+
     /**
      * @brief export_search_tree Exports the current search tree as a graph in a .gv/.dot-file
      * @param is Input stream. If no argument is given:
@@ -159,6 +197,14 @@ public:
      */
     void export_search_tree(istringstream& is);
 
+    /**
+     * @brief load_model Loads the model of the given directory in the background while the search continues with the current model.
+     * All search threads switch to the new model at their next mini-batch and the agents before their next action.
+     * The old model is freed afterwards. Commands which use the networks wait until the swap has finished.
+     * @param is Model directory
+     */
+    void load_model(istringstream& is);
+
 #ifdef USE_RL
     /**
      * @brief selfplay Starts self play for a given number of games
@@ -166,16 +212,43 @@ public:
      */
     void selfplay(istringstream &is);
 
+    /**
+     * @brief selfplay_parallel Generates the selfplay games concurrently (see RLSettings::numberParallelGames).
+     * Each game uses its own MCTSAgent, while the search threads with the same index of all games share one network
+     * which evaluates their batches together. The shared networks use the batch size Batch_Size * Selfplay_Parallel_Games.
+     * @param selfPlay SelfPlay object which generates and exports the games
+     * @param numberOfGames Number of games to generate
+     */
+    void selfplay_parallel(SelfPlay& selfPlay, size_t numberOfGames);
+
+    /**
+     * @brief create_shared_batch_agents Creates MCTSAgents for concurrent games which share their networks (see SharedBatchAgents).
+     * The shared networks use the batch size Batch_Size * numberAgents.
+     * @param modelDirectory Model directory of the networks
+     * @param numberAgents Number of agents
+     * @param numberClients Number of agents which usually search at the same time
+     */
+    unique_ptr<SharedBatchAgents> create_shared_batch_agents(const string& modelDirectory, size_t numberAgents, size_t numberClients);
+
     /**
      * @brief arena Starts the arena comparision between two different NN weights.
      * The score can be used for logging and to decide if the current weights shall be replaced.
      * The arena ends with either the keywords "keep" or "replace".
      * "keep": Signals that the current generator should be kept
      * "replace": Signals that the current generator should be replaced by the contender
+     * Several game pairs are played concurrently if Arena_Parallel_Pairs > 1. The match stops early when the SPRT
+     * (SPRT_Elo0, SPRT_Elo1, Centi_SPRT_Alpha, Centi_SPRT_Beta) is decided, which also determines the keyword.
      * @param is Number of games to generate
      */
     void arena(istringstream &is);
 
+    /**
+     * @brief benchmark_exporter Measures the cost per sample for saving and exporting training samples of random games.
+     * The samples are exported to "bench_export.zarr".
+     * @param is Number of games (default 20)
+     */
+    void benchmark_exporter(istringstream& is);
+
     /**
      * @brief init_rl_settings Initializes the rl settings used for the mcts agent with the current UCI parameters
      */
@@ -214,16 +287,36 @@ private:
     /**
      * @brief create_new_net_single Factory to create and load a new model from a given directory
      * @param modelDirectory Model directory where the .params and .json files are stored
+     * @param batchSize Batch size of the network (1 for the evaluation of single positions)
      * @return Pointer to the newly created object
      */
-    unique_ptr<NeuralNetAPI> create_new_net_single(const string& modelDirectory);
+    unique_ptr<NeuralNetAPI> create_new_net_single(const string& modelDirectory, unsigned int batchSize=1);
 
     /**
      * @brief create_new_net_batches Factory to create and load a new model for batch-size access
      * @param modelDirectory Model directory where the .params and .json files are stored
+     * @param batchSize Batch size of the networks, 0 uses the batch size of the search settings
      * @return Vector of pointers to the newly createded objects. For every thread a sepreate net.
      */
-    vector<unique_ptr<NeuralNetAPI>> create_new_net_batches(const string& modelDirectory);
+    vector<unique_ptr<NeuralNetAPI>> create_new_net_batches(const string& modelDirectory, unsigned int batchSize=0);
+
+    /**
+     * @brief swap_model Creates the networks for the given model directory, requests the agents to switch to them
+     * and frees the old networks as soon as all switches have been applied
+     * @param modelDirectory Model directory of the new model
+     */
+    void swap_model(const string& modelDirectory);
+
+    /**
+     * @brief wait_for_model_loader Blocks until a model swap which was started by load_model() has finished.
+     * Commands which recreate the networks or agents must call this first.
+     */
+    void wait_for_model_loader();
+
+    /**
+     * @brief reload_networks Recreates the networks and agents with the current options
+     */
+    void reload_networks();
 };
 
 /**
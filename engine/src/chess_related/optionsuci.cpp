@@ -55,6 +55,11 @@ void OptionsUCI::init(OptionsMap &o)
     o["Batch_Size"]                    << Option(16, 1, 8192);
 #endif
     o["Threads"]                       << Option(2, 1, 512);
+#ifdef NATIVE_CPU
+    o["Inference_Threads"]             << Option(1, 1, 512);
+#endif
+    o["Centi_Inference_Cores"]         << Option(0, 0, 100);
+    o["Pin_Threads"]                   << Option(false);
     o["Centi_CPuct_Init"]              << Option(250, 1, 99999);
     o["CPuct_Base"]                    << Option(19652, 1, 99999);
 #ifdef USE_RL
@@ -99,6 +104,9 @@ void OptionsUCI::init(OptionsMap &o)
 #ifdef TENSORRT
     o["Use_TensorRT"]                  << Option(true);
     o["Precision"]                     << Option("float16", {"float32", "float16", "int8"});
+#elif defined NATIVE_CPU
+    o["Precision"]                     << Option("float32", {"float32", "int8"});
+    o["Calibration_PGN"]               << Option("<empty>");
 #endif
 #ifdef MODE_CRAZYHOUSE
     o["Model_Directory"]               << Option("model");
@@ -121,6 +129,21 @@ void OptionsUCI::init(OptionsMap &o)
     o["Centi_Resign_Probability"]      << Option(90, 0, 100);
     o["Centi_Resign_Threshold"]        << Option(-90, -100, 100);
     o["Reuse_Tree"]                    << Option(false);
+    o["Selfplay_Parallel_Games"]       << Option(1, 1, 1024);
+    o["Selfplay_Pack_Planes"]          << Option(false);
+    o["Selfplay_Compressor"]           << Option("raw", {"raw", "blosclz", "lz4", "lz4hc", "zlib", "zstd"});
+    o["Selfplay_Compression_Level"]    << Option(5, 0, 9);
+    o["Selfplay_Sparse_Policy"]        << Option(false);
+    o["Selfplay_Replay_Buffer"]        << Option("<empty>");
+    o["Selfplay_Replay_Buffer_Size"]   << Option(16384, 1, 99999999);
+    o["Selfplay_Opening_Pool_Size"]    << Option(0, 0, 99999);
+    o["Selfplay_Opening_Batch_Size"]   << Option(32, 1, 8192);
+    o["Selfplay_Checkpoint_Games"]     << Option(32, 0, 99999);
+    o["Arena_Parallel_Pairs"]          << Option(1, 1, 512);
+    o["SPRT_Elo0"]                     << Option(0, -1000, 1000);
+    o["SPRT_Elo1"]                     << Option(0, -1000, 1000);
+    o["Centi_SPRT_Alpha"]              << Option(5, 1, 50);
+    o["Centi_SPRT_Beta"]               << Option(5, 1, 50);
 #endif
     o["Move_Overhead"]                 << Option(50, 0, 5000);
     o["Centi_Random_Move_Factor"]      << Option(0, 0, 99);
@@ -132,6 +155,11 @@ void OptionsUCI::init(OptionsMap &o)
     o["UCI_Chess960"]                  << Option(true);
 #endif
     o["Random_Playout"]                << Option(true);
+    o["Subtree_Affinity"]              << Option(false);
+    o["Multi_Visit"]                   << Option(false);
+    o["Adaptive_Batch_Size"]           << Option(false);
+    o["Sparse_Policy"]                 << Option(false);
+    o["Search_Statistics"]             << Option(false);
 }
 
 void OptionsUCI::setoption(istringstream &is)
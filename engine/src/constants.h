@@ -66,6 +66,11 @@ const string engineAuthors = "Johannes Czech, Moritz Willig, Alena Beyer et al."
 #define RANDOM_MOVE_COUNTER 20
 #define RANDOM_MOVE_THRESH 10000
 #define Q_INIT -1.0f
+// upper bound for the number of visits of a single multi-visit descent
+// (the total number of pending visits per edge is additionally capped at 255 because virtualLossCounter is stored as uint8_t)
+#define MAX_MULTI_VISITS 32
+// initial capacity for the trajectory and action buffers of a rollout
+#define RESERVED_TRAJECTORY_LENGTH 128
 
 #ifndef MODE_POMMERMAN
 #define TERMINAL_NODE_CACHE 8192
@@ -0,0 +1,102 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: batchsizecontroller.cpp
+ * Created on 19.10.2026
+ * @author: agent
+ */
+
+#include "batchsizecontroller.h"
+#include <algorithm>
+
+using namespace std;
+
+
+BatchSizeController::BatchSizeController(size_t maxBatchSize):
+    minBatchSize(max(maxBatchSize / 8, size_t(1))),
+    maxBatchSize(maxBatchSize),
+    curBatchSize(maxBatchSize),
+    iterations(0),
+    samples(0),
+    descents(0),
+    collisions(0),
+    iterationTimeMS(0),
+    latencyMS(0),
+    lastThroughput(0),
+    lastLatencyMS(0),
+    direction(1)
+{
+}
+
+void BatchSizeController::update(size_t newNodes, size_t descents, size_t collisions, float iterationTimeMS, float latencyMS)
+{
+    ++iterations;
+    samples += newNodes;
+    this->descents += descents;
+    this->collisions += collisions;
+    this->iterationTimeMS += iterationTimeMS;
+    this->latencyMS += latencyMS;
+
+    if (iterations == BATCH_SIZE_UPDATE_INTERVAL) {
+        adjust_batch_size();
+        iterations = 0;
+        samples = 0;
+        this->descents = 0;
+        this->collisions = 0;
+        this->iterationTimeMS = 0;
+        this->latencyMS = 0;
+    }
+}
+
+void BatchSizeController::adjust_batch_size()
+{
+    const float collisionRate = descents == 0 ? 0 : float(collisions) / descents;
+    const float throughput = samples / max(iterationTimeMS, 0.001f);
+    lastLatencyMS = latencyMS / iterations;
+    const size_t batchSize = curBatchSize;
+    const size_t step = max(batchSize / 8, size_t(1));
+
+    if (collisionRate > MAX_COLLISION_RATE) {
+        // too many rollouts are wasted, gather less leaves per request
+        direction = -1;
+    }
+    else if (throughput < lastThroughput) {
+        // the last change made it worse
+        direction = -direction;
+    }
+    lastThroughput = throughput;
+
+    if (direction > 0) {
+        curBatchSize = min(batchSize + step, maxBatchSize);
+    }
+    else {
+        curBatchSize = max(batchSize - step, minBatchSize);
+    }
+}
+
+size_t BatchSizeController::get_batch_size() const
+{
+    return curBatchSize;
+}
+
+float BatchSizeController::get_latency() const
+{
+    return lastLatencyMS;
+}
@@ -0,0 +1,94 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: batchsizecontroller.h
+ * Created on 19.10.2026
+ * @author: agent
+ *
+ * Controller which adjusts the number of leaf nodes that a search thread gathers for each neural network request.
+ * The batch size is reduced if too many collisions occur and otherwise hill-climbs on the measured sample throughput.
+ * The compiled batch size of the network is used as the upper bound.
+ */
+
+#ifndef BATCHSIZECONTROLLER_H
+#define BATCHSIZECONTROLLER_H
+
+#include <cstddef>
+#include <atomic>
+
+// number of iterations after which the batch size is updated
+const size_t BATCH_SIZE_UPDATE_INTERVAL = 16;
+// collision fraction above which the batch size is reduced
+const float MAX_COLLISION_RATE = 0.2f;
+
+class BatchSizeController
+{
+private:
+    size_t minBatchSize;
+    size_t maxBatchSize;
+    // read by other threads for the search info
+    std::atomic<size_t> curBatchSize;
+
+    // statistics of the current measurement interval
+    size_t iterations;
+    size_t samples;
+    size_t descents;
+    size_t collisions;
+    float iterationTimeMS;
+    float latencyMS;
+
+    // throughput (samples per ms) and average request latency of the last measurement interval
+    float lastThroughput;
+    std::atomic<float> lastLatencyMS;
+    // direction of the last batch size change (+1 or -1)
+    int direction;
+
+    /**
+     * @brief adjust_batch_size Applies a new batch size based on the statistics of the last measurement interval
+     */
+    void adjust_batch_size();
+
+public:
+    /**
+     * @brief BatchSizeController
+     * @param maxBatchSize Batch size with which the neural network was compiled
+     */
+    BatchSizeController(size_t maxBatchSize);
+
+    /**
+     * @brief update Adds the statistics of a single search iteration
+     * @param newNodes Number of samples which were sent to the neural network
+     * @param descents Number of descents from the root node
+     * @param collisions Number of descents which ended in a collision
+     * @param iterationTimeMS Duration of the full iteration in ms
+     * @param latencyMS Duration of the neural network request in ms
+     */
+    void update(size_t newNodes, size_t descents, size_t collisions, float iterationTimeMS, float latencyMS);
+
+    size_t get_batch_size() const;
+
+    /**
+     * @brief get_latency Returns the average latency of a neural network request of the last measurement interval in ms
+     * @return float
+     */
+    float get_latency() const;
+};
+
+#endif // BATCHSIZECONTROLLER_H
@@ -0,0 +1,195 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: subtreescheduler.cpp
+ * Created on 19.10.2026
+ * @author: agent
+ */
+
+#include "subtreescheduler.h"
+#include <algorithm>
+
+/**
+ * @brief is_open_subtree Returns true if the root child can still receive scheduled rollouts
+ */
+inline bool is_open_subtree(const Node* childNode)
+{
+    return childNode != nullptr && !childNode->is_terminal() && childNode->get_node_type() == UNSOLVED;
+}
+
+SubtreeScheduler::SubtreeScheduler(size_t numberThreads, size_t batchSize):
+    rootNode(nullptr),
+    numberThreads(numberThreads),
+    maxSubtrees(max(numberThreads * 2, size_t(2))),
+    windowSize(numberThreads * batchSize * 4),
+    subtrees(new atomic<uint16_t>[maxSubtrees]),
+    budgets(new atomic<int>[maxSubtrees]),
+    affinity(new atomic<size_t>[numberThreads]),
+    numberSubtrees(0),
+    nextRebalanceVisits(0),
+    rebalanceRequested(false),
+    ownRollouts(0),
+    stolenRollouts(0),
+    defaultRollouts(0)
+{
+    for (size_t idx = 0; idx < maxSubtrees; ++idx) {
+        subtrees[idx] = 0;
+        budgets[idx] = 0;
+    }
+    for (size_t idx = 0; idx < numberThreads; ++idx) {
+        affinity[idx] = 0;
+    }
+    assignedThreads.reserve(maxSubtrees);
+}
+
+void SubtreeScheduler::reset(Node* rootNode)
+{
+    this->rootNode = rootNode;
+    candidates.reserve(rootNode->get_number_child_nodes());
+    numberSubtrees = 0;
+    // the first window after the root was set uses the default selection to gather initial statistics
+    nextRebalanceVisits = rootNode->get_visits() + windowSize;
+    rebalanceRequested = false;
+    ownRollouts = 0;
+    stolenRollouts = 0;
+    defaultRollouts = 0;
+}
+
+bool SubtreeScheduler::pick_root_child(size_t threadIdx, size_t& childIdx)
+{
+    const size_t curNumberSubtrees = numberSubtrees;
+    if (curNumberSubtrees != 0) {
+        const size_t ownIdx = affinity[threadIdx];
+        if (take_rollout(ownIdx, childIdx)) {
+            ++ownRollouts;
+            return true;
+        }
+        // steal from the subtree with the most remaining rollouts
+        size_t victimIdx = ownIdx;
+        int maxBudget = 0;
+        for (size_t idx = 0; idx < curNumberSubtrees; ++idx) {
+            const int budget = budgets[idx].load(memory_order_relaxed);
+            if (budget > maxBudget) {
+                maxBudget = budget;
+                victimIdx = idx;
+            }
+        }
+        if (maxBudget > 0 && take_rollout(victimIdx, childIdx)) {
+            ++stolenRollouts;
+            return true;
+        }
+    }
+    if ((rebalanceRequested || rootNode->get_visits() >= nextRebalanceVisits) && mtx.try_lock()) {
+        rebalance();
+        mtx.unlock();
+    }
+    ++defaultRollouts;
+    return false;
+}
+
+bool SubtreeScheduler::take_rollout(size_t subtreeIdx, size_t& childIdx)
+{
+    if (budgets[subtreeIdx].fetch_sub(1) <= 0) {
+        return false;
+    }
+    const size_t scheduledIdx = subtrees[subtreeIdx];
+    if (!is_open_subtree(rootNode->get_child_node(scheduledIdx))) {
+        budgets[subtreeIdx] = 0;
+        rebalanceRequested = true;
+        return false;
+    }
+    childIdx = scheduledIdx;
+    return true;
+}
+
+void SubtreeScheduler::rebalance()
+{
+    numberSubtrees = 0;
+    rebalanceRequested = false;
+    candidates.clear();
+
+    rootNode->lock();
+    nextRebalanceVisits = rootNode->get_visits() + windowSize;
+    if (rootNode->has_forced_win()) {
+        rootNode->unlock();
+        return;
+    }
+    for (size_t childIdx = 0; childIdx < rootNode->get_no_visit_idx(); ++childIdx) {
+        const Node* childNode = rootNode->get_child_node(childIdx);
+        if (is_open_subtree(childNode) && childNode->has_nn_results()) {
+            candidates.emplace_back(rootNode->get_real_visits(childIdx), childIdx);
+        }
+    }
+    rootNode->unlock();
+
+    const size_t curNumberSubtrees = min(candidates.size(), maxSubtrees);
+    if (curNumberSubtrees == 0) {
+        return;
+    }
+    partial_sort(candidates.begin(), candidates.begin() + curNumberSubtrees, candidates.end(),
+                 [](const pair<uint32_t, uint16_t>& a, const pair<uint32_t, uint16_t>& b) { return a.first > b.first; });
+
+    double visitSum = 0;
+    for (size_t idx = 0; idx < curNumberSubtrees; ++idx) {
+        visitSum += candidates[idx].first;
+    }
+    if (visitSum == 0) {
+        return;
+    }
+
+    // distribute the rollouts of the next window proportional to the visit share
+    const double scheduledRollouts = windowSize * AFFINITY_SHARE;
+    for (size_t idx = 0; idx < curNumberSubtrees; ++idx) {
+        subtrees[idx] = candidates[idx].second;
+        budgets[idx] = max(1, int(scheduledRollouts * candidates[idx].first / visitSum + 0.5));
+    }
+
+    // assign each thread to the subtree which has the most rollouts per already assigned thread
+    assignedThreads.assign(curNumberSubtrees, 0);
+    for (size_t threadIdx = 0; threadIdx < numberThreads; ++threadIdx) {
+        size_t bestIdx = 0;
+        float bestShare = -1;
+        for (size_t idx = 0; idx < curNumberSubtrees; ++idx) {
+            const float share = float(budgets[idx]) / (assignedThreads[idx] + 1);
+            if (share > bestShare) {
+                bestShare = share;
+                bestIdx = idx;
+            }
+        }
+        affinity[threadIdx] = bestIdx;
+        ++assignedThreads[bestIdx];
+    }
+    numberSubtrees = curNumberSubtrees;
+}
+
+size_t SubtreeScheduler::get_own_rollouts() const
+{
+    return ownRollouts;
+}
+
+size_t SubtreeScheduler::get_stolen_rollouts() const
+{
+    return stolenRollouts;
+}
+
+size_t SubtreeScheduler::get_default_rollouts() const
+{
+    return defaultRollouts;
+}
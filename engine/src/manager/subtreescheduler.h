@@ -0,0 +1,120 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: subtreescheduler.h
+ * Created on 19.10.2026
+ * @author: agent
+ *
+ * Work-stealing rollout scheduler which gives every search thread a preferred subtree of the root node.
+ * Each rebalancing window distributes a fixed number of rollouts over the most visited root children proportional
+ * to their visit share. A thread first consumes the rollouts of its own subtree and steals from the subtree
+ * with the largest remaining budget afterwards. If all budgets are exhausted, the default PUCT selection is used at the root.
+ * This reduces the number of threads which descend into the same subtree at the same time
+ * and thus the lock contention on the inner nodes.
+ */
+
+#ifndef SUBTREESCHEDULER_H
+#define SUBTREESCHEDULER_H
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include "../node.h"
+
+using namespace std;
+
+// fraction of rollouts of a rebalancing window which are assigned to subtrees, the rest uses the default PUCT selection at the root
+const float AFFINITY_SHARE = 0.75f;
+
+class SubtreeScheduler
+{
+private:
+    Node* rootNode;
+    size_t numberThreads;
+    // maximum number of root child nodes which are scheduled at the same time
+    size_t maxSubtrees;
+    // number of root visits after which the budgets are redistributed
+    size_t windowSize;
+
+    // root child indices of the scheduled subtrees
+    unique_ptr<atomic<uint16_t>[]> subtrees;
+    // remaining rollouts for each scheduled subtree in the current window
+    unique_ptr<atomic<int>[]> budgets;
+    // index of the preferred subtree for each search thread
+    unique_ptr<atomic<size_t>[]> affinity;
+    atomic<size_t> numberSubtrees;
+    atomic<uint32_t> nextRebalanceVisits;
+    // set if a scheduled subtree has been solved, so that the budgets are redistributed before the window ends
+    atomic<bool> rebalanceRequested;
+    mutex mtx;
+    // buffers for rebalance() which are protected by mtx
+    vector<pair<uint32_t, uint16_t>> candidates;
+    vector<size_t> assignedThreads;
+
+    // statistics
+    atomic<size_t> ownRollouts;
+    atomic<size_t> stolenRollouts;
+    atomic<size_t> defaultRollouts;
+
+    /**
+     * @brief rebalance Recomputes the scheduled subtrees, their rollout budgets and the thread affinities based on the current root statistics
+     */
+    void rebalance();
+
+    /**
+     * @brief take_rollout Takes a rollout from the budget of the given scheduled subtree.
+     * A subtree which has been solved or became terminal since the last rebalancing gets no more rollouts and a rebalancing is requested.
+     * @param subtreeIdx Index of the scheduled subtree
+     * @param childIdx Root child index of the subtree (only set if true is returned)
+     * @return True, if a rollout was taken
+     */
+    bool take_rollout(size_t subtreeIdx, size_t& childIdx);
+
+public:
+    /**
+     * @brief SubtreeScheduler
+     * @param numberThreads Number of search threads which request rollouts
+     * @param batchSize Batch size of each search thread which is used to define the rebalancing window
+     */
+    SubtreeScheduler(size_t numberThreads, size_t batchSize);
+
+    /**
+     * @brief reset Sets a new root node and clears all budgets and statistics. Must be called before the search threads are started.
+     * @param rootNode Root node of the upcoming search
+     */
+    void reset(Node* rootNode);
+
+    /**
+     * @brief pick_root_child Returns the root child index for the next rollout of the given thread.
+     * The thread's own subtree is preferred, otherwise a rollout is stolen from the subtree with the largest remaining budget.
+     * The node type of the scheduled child is checked on every pick, so solved subtrees are skipped and trigger an immediate rebalancing.
+     * @param threadIdx Index of the requesting search thread
+     * @param childIdx Selected child index (only set if true is returned)
+     * @return True, if a subtree was assigned, false if the default PUCT selection shall be used
+     */
+    bool pick_root_child(size_t threadIdx, size_t& childIdx);
+
+    size_t get_own_rollouts() const;
+    size_t get_stolen_rollouts() const;
+    size_t get_default_rollouts() const;
+};
+
+#endif // SUBTREESCHEDULER_H
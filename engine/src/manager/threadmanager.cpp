@@ -49,6 +49,9 @@ void ThreadManager::print_info()
     evalInfo->end = chrono::steady_clock::now();
     update_eval_info(*evalInfo, rootNode, get_tb_hits(searchThreads), get_max_depth(searchThreads), multiPV);
     info_msg(*evalInfo);
+    if (searchThreads.front()->get_search_settings()->useAdaptiveBatchSize) {
+        info_string("batchsize", to_string(get_avg_batch_size(searchThreads)) + " latency " + to_string(get_avg_batch_latency(searchThreads)) + " ms");
+    }
 }
 
 void ThreadManager::await_kill_signal()
@@ -205,3 +208,72 @@ size_t get_tb_hits(const vector<SearchThread*>& searchThreads)
     }
     return tbHits;
 }
+
+float get_collision_rate(const vector<SearchThread*>& searchThreads)
+{
+    size_t descents = 0;
+    size_t collisions = 0;
+    for (SearchThread* searchThread : searchThreads) {
+        descents += searchThread->get_descents();
+        collisions += searchThread->get_collisions();
+    }
+    if (descents == 0) {
+        return 0;
+    }
+    return float(collisions) / descents;
+}
+
+size_t get_effective_rollouts(const vector<SearchThread*>& searchThreads)
+{
+    size_t effectiveRollouts = 0;
+    for (SearchThread* searchThread : searchThreads) {
+        effectiveRollouts += searchThread->get_effective_rollouts();
+    }
+    return effectiveRollouts;
+}
+
+float get_hash_table_locks_per_descent(const vector<SearchThread*>& searchThreads)
+{
+    size_t descents = 0;
+    size_t hashTableLocks = 0;
+    for (SearchThread* searchThread : searchThreads) {
+        descents += searchThread->get_descents();
+        hashTableLocks += searchThread->get_hash_table_locks();
+    }
+    if (descents == 0) {
+        return 0;
+    }
+    return float(hashTableLocks) / descents;
+}
+
+size_t get_avg_batch_size(const vector<SearchThread*>& searchThreads)
+{
+    size_t batchSize = 0;
+    for (SearchThread* searchThread : searchThreads) {
+        batchSize += searchThread->get_batch_size();
+    }
+    return size_t(double(batchSize) / searchThreads.size() + 0.5);
+}
+
+float get_avg_batch_latency(const vector<SearchThread*>& searchThreads)
+{
+    float latency = 0;
+    for (SearchThread* searchThread : searchThreads) {
+        latency += searchThread->get_batch_latency();
+    }
+    return latency / searchThreads.size();
+}
+
+float get_batch_utilization(const vector<SearchThread*>& searchThreads)
+{
+    size_t filledSamples = 0;
+    size_t computedSamples = 0;
+    for (SearchThread* searchThread : searchThreads) {
+        filledSamples += searchThread->get_filled_samples();
+        computedSamples += searchThread->get_computed_samples();
+    }
+    if (computedSamples == 0) {
+        return 0;
+    }
+    return float(filledSamples) / computedSamples;
+}
@@ -145,5 +145,48 @@ size_t get_avg_depth(const vector<SearchThread*>& searchThreads);
  */
 size_t get_max_depth(const vector<SearchThread*>& searchThreads);
 
+/**
+ * @brief get_collision_rate Returns the fraction of descents which ended in a collision for all threads
+ * @param searchThreads MCTS search threads
+ * @return collision rate in [0, 1]
+ */
+float get_collision_rate(const vector<SearchThread*>& searchThreads);
+
+/**
+ * @brief get_effective_rollouts Returns the number of backed up visits for all threads.
+ * In multi-visit mode a single descent can account for several visits.
+ * @param searchThreads MCTS search threads
+ * @return number of effective rollouts
+ */
+size_t get_effective_rollouts(const vector<SearchThread*>& searchThreads);
+
+/**
+ * @brief get_hash_table_locks_per_descent Returns the average number of hash table lock acquisitions per descent for all threads
+ * @param searchThreads MCTS search threads
+ * @return lock acquisitions per descent
+ */
+float get_hash_table_locks_per_descent(const vector<SearchThread*>& searchThreads);
+
+/**
+ * @brief get_avg_batch_size Returns the average number of leaves per neural network request for all threads
+ * @param searchThreads MCTS search threads
+ * @return average batch size
+ */
+size_t get_avg_batch_size(const vector<SearchThread*>& searchThreads);
+
+/**
+ * @brief get_avg_batch_latency Returns the average neural network latency in ms for all threads
+ * @param searchThreads MCTS search threads
+ * @return average latency in ms
+ */
+float get_avg_batch_latency(const vector<SearchThread*>& searchThreads);
+
+/**
+ * @brief get_batch_utilization Returns the fraction of the computed neural network samples which belonged to filled batch slots
+ * @param searchThreads MCTS search threads
+ * @return utilization in [0, 1]
+ */
+float get_batch_utilization(const vector<SearchThread*>& searchThreads);
+
 
 #endif // THREADMANAGER_H
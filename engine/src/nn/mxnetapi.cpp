@@ -49,10 +49,18 @@ MXNetAPI::MXNetAPI(const string& ctx, int deviceID, unsigned int miniBatchSize,
         throw "unsupported context " + ctx + " given";
     }
 
-    load_model();
-    load_parameters();
+    // the parameters are only loaded once, each object only binds its own executor
+    model = get_shared_model<MXNetModel>(parameterFilePath + ":" + deviceName + (tensorRT ? ":tensorrt" : ""), [&]() {
+        model = make_shared<MXNetModel>();
+        load_model();
+        load_parameters();
+        return model;
+    });
     bind_executor();
     check_if_policy_map();
+    if (globalCtx.GetDeviceType() == kCPU) {
+        info_string("output copy avoided per batch (KiB):", (batchSize + policyOutputLength) * sizeof(float) / 1024.0f);
+    }
 }
 
 MXNetAPI::~MXNetAPI()
@@ -67,10 +75,10 @@ void MXNetAPI::load_model()
         throw runtime_error("Model file does not exist");
     }
     info_string("Loading the model from", modelFilePath);
-    net = Symbol::Load(modelFilePath);
+    model->net = Symbol::Load(modelFilePath);
     if (enableTensorrt) {
       #ifdef TENSORRT
-      net = net.GetBackendSymbol("TensorRT");
+      model->net = model->net.GetBackendSymbol("TensorRT");
       #endif
     }
 }
@@ -112,12 +120,12 @@ void MXNetAPI::load_parameters() {
       std::map<std::string, NDArray> intermediate_args_map;
       std::map<std::string, NDArray> intermediate_aux_map;
       SplitParamMap(parameters, &intermediate_args_map, &intermediate_aux_map, Context::cpu());
-      contrib::InitTensorRTParams(net, &intermediate_args_map, &intermediate_aux_map);
-      ConvertParamMapToTargetContext(intermediate_args_map, &argsMap, globalCtx);
-      ConvertParamMapToTargetContext(intermediate_aux_map, &auxMap, globalCtx);
+      contrib::InitTensorRTParams(model->net, &intermediate_args_map, &intermediate_aux_map);
+      ConvertParamMapToTargetContext(intermediate_args_map, &model->argsMap, globalCtx);
+      ConvertParamMapToTargetContext(intermediate_aux_map, &model->auxMap, globalCtx);
       #endif
     } else {
-      SplitParamMap(parameters, &argsMap, &auxMap, globalCtx);
+      SplitParamMap(parameters, &model->argsMap, &model->auxMap, globalCtx);
     }
 
     // WaitAll is needed when data is copied between GPU and the main memory
@@ -127,6 +135,8 @@ void MXNetAPI::load_parameters() {
 void MXNetAPI::bind_executor()
 {
     // Create an executor after binding the model to input parameters.
+    // The NDArrays of the parameters are handles, so that the copied map still refers to the shared parameters.
+    argsMap = model->argsMap;
     argsMap["data"] = NDArray(inputShape, globalCtx, false);
     /* new */
     vector<NDArray> argArrays;
@@ -139,14 +149,14 @@ void MXNetAPI::bind_executor()
     argsMap["value_label"] = NDArray(value_label_shape, globalCtx, false);
     argsMap["policy_label"] = NDArray(policy_label_shape, globalCtx, false);
 
-    net.InferExecutorArrays(globalCtx, &argArrays, &gradArrays, &gradReqs,
-                            &auxArrays, argsMap, map<string, NDArray>(),
-                            map<string, OpReqType>(), auxMap);
+    model->net.InferExecutorArrays(globalCtx, &argArrays, &gradArrays, &gradReqs,
+                                   &auxArrays, argsMap, map<string, NDArray>(),
+                                   map<string, OpReqType>(), model->auxMap);
     for (size_t i = 0; i < gradReqs.size(); ++i) {
         gradReqs[i] = kNullOp;
     }
 
-    executor = new Executor(net, globalCtx, argArrays, gradArrays, gradReqs, auxArrays);
+    executor = new Executor(model->net, globalCtx, argArrays, gradArrays, gradReqs, auxArrays);
     info_string("Bind successfull!");
 }
 
@@ -194,8 +204,30 @@ void MXNetAPI::predict(float *inputPlanes, float* valueOutput, float* probOutput
     // Run the forward pass.
     executor->Forward(false);
 
-    executor->outputs[0].SyncCopyToCPU(valueOutput, batchSize);
-    executor->outputs[1].SyncCopyToCPU(probOutputs, policyOutputLength);
+    // the outputs are only copied if they aren't read directly from the output arrays of the executor
+    if (valueOutput == executor->outputs[0].GetData()) {
+        executor->outputs[0].WaitToRead();
+    }
+    else {
+        executor->outputs[0].SyncCopyToCPU(valueOutput, batchSize);
+    }
+    if (probOutputs == executor->outputs[1].GetData()) {
+        executor->outputs[1].WaitToRead();
+    }
+    else {
+        executor->outputs[1].SyncCopyToCPU(probOutputs, policyOutputLength);
+    }
+}
+
+bool MXNetAPI::get_output_buffers(float*& valueOutput, float*& probOutputs)
+{
+    // the output arrays of the executor are allocated once during binding and can be read directly on the CPU
+    if (globalCtx.GetDeviceType() != kCPU) {
+        return false;
+    }
+    valueOutput = const_cast<float*>(executor->outputs[0].GetData());
+    probOutputs = const_cast<float*>(executor->outputs[1].GetData());
+    return true;
 }
 
 #endif
@@ -36,6 +36,15 @@
 
 using namespace mxnet::cpp;
 
+/**
+ * @brief The MXNetModel struct holds the network symbol and its parameters.
+ * It is shared between all MXNetAPI objects which use the same parameter file and device.
+ */
+struct MXNetModel {
+    Symbol net;
+    std::map<std::string, NDArray> argsMap;
+    std::map<std::string, NDArray> auxMap;
+};
 
 /**
  * @brief The MXNetAPI class implements access to the MXNET-C++ back-end for running inference on CPU and GPU.
@@ -43,10 +52,9 @@ using namespace mxnet::cpp;
 class MXNetAPI : public NeuralNetAPI
 {
 private:
-    std::mutex mtx;
+    std::shared_ptr<MXNetModel> model;
+    // shared parameters and the input buffers of this executor
     std::map<std::string, NDArray> argsMap;
-    std::map<std::string, NDArray> auxMap;
-    Symbol net;
     Executor *executor;
     Shape inputShape;
     Context globalCtx = Context::cpu();
@@ -56,6 +64,7 @@ public:
     ~MXNetAPI();
 
     void predict(float* inputPlanes, float* valueOutput, float* probOutputs);
+    bool get_output_buffers(float*& valueOutput, float*& probOutputs) override;
 
 protected:
     void load_model();
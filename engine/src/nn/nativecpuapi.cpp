@@ -0,0 +1,908 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: nativecpuapi.cpp
+ * Created on 19.10.2026
+ * @author: agent
+ */
+
+#ifdef NATIVE_CPU
+#include "nativecpuapi.h"
+
+#include <algorithm>
+#include <cmath>
+#include <climits>
+#include <thread>
+#include <unordered_set>
+#include "util/cpukernels.h"
+#include "../stateobj.h"
+#include "../util/communication.h"
+#include "../util/threadbudget.h"
+#ifndef MODE_POMMERMAN
+#include "chess_related/chessbatchstream.h"
+#endif
+
+atomic<size_t> NativeCPUAPI::nextPinnedThread(0);
+
+/**
+ * @brief use_int8 Returns true if the given precision requests int8 inference
+ */
+bool use_int8(const string& strPrecision)
+{
+    if (strPrecision == "float32" || strPrecision == "fp32") {
+        return false;
+    }
+    if (strPrecision == "int8") {
+        return true;
+    }
+    throw invalid_argument("The native CPU back-end doesn't support the precision " + strPrecision);
+}
+
+NativeCPUAPI::NativeCPUAPI(int deviceID, unsigned int batchSize, const string& modelDirectory, size_t numberThreads,
+                           const string& strPrecision, const string& calibrationFile):
+    NeuralNetAPI("cpu", deviceID, batchSize, modelDirectory, false),
+    numberThreads(max(size_t(1), min(numberThreads, size_t(batchSize)))),
+    chunkSize((batchSize + this->numberThreads - 1) / this->numberThreads),
+    useInt8(use_int8(strPrecision)),
+    firstPinnedThread(nextPinnedThread.fetch_add(this->numberThreads - 1)),
+    workerTask(nullptr),
+    workerSamples(0),
+    workerChunkSize(0),
+    workerBatchIdx(0),
+    runningWorkers(0),
+    stopWorkers(false)
+{
+    // in ONNX, the model architecture and parameters are in the same file
+    modelFilePath = modelDir + get_file_ending_with(modelDir, "-bsize-" + to_string(batchSize) + ".onnx");
+    info_string("onnx file:", modelFilePath);
+    modelName = modelFilePath.substr(0, modelFilePath.length()-string(".onnx").length());
+
+    // the layers don't depend on the batch size, so that all objects using the same directory and precision share them
+    model = get_shared_model<NativeCPUModel>(modelDir + ":" + strPrecision + ":" + calibrationFile, [&]() {
+        model = make_shared<NativeCPUModel>();
+        load_model();
+        load_parameters();
+        if (useInt8) {
+            calibrate_int8(calibrationFile);
+        }
+        return model;
+    });
+    check_if_policy_map();
+    bind_executor();
+}
+
+NativeCPUAPI::~NativeCPUAPI()
+{
+    {
+        lock_guard<mutex> lock(workerMutex);
+        stopWorkers = true;
+    }
+    workerStart.notify_all();
+    for (thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void NativeCPUAPI::load_model()
+{
+    graph = read_onnx_graph(modelFilePath);
+    if (graph.inputs.size() != 1) {
+        throw invalid_argument("The native CPU back-end expects a single input but the model has " + to_string(graph.inputs.size()));
+    }
+    if (graph.outputs.size() != 2) {
+        throw invalid_argument("The native CPU back-end expects a value and policy output but the model has " + to_string(graph.outputs.size()) + " outputs");
+    }
+}
+
+/**
+ * @brief fold_batch_norm Folds the parameters of a batch normalization node into the weights and bias of the preceding layer
+ * whose last weight dimension is the channel dimension
+ */
+void fold_batch_norm(const OnnxNode& node, const unordered_map<string, OnnxTensor>& initializers, vector<float>& weights, vector<float>& bias)
+{
+    const vector<float>& gamma = initializers.at(node.inputs[1]).floatData;
+    const vector<float>& beta = initializers.at(node.inputs[2]).floatData;
+    const vector<float>& mean = initializers.at(node.inputs[3]).floatData;
+    const vector<float>& var = initializers.at(node.inputs[4]).floatData;
+    const float epsilon = node.get_float("epsilon", 1e-5f);
+    const size_t channels = bias.size();
+    for (size_t c = 0; c < channels; ++c) {
+        const float factor = gamma[c] / sqrt(var[c] + epsilon);
+        for (size_t idx = c; idx < weights.size(); idx += channels) {
+            weights[idx] *= factor;
+        }
+        bias[c] = (bias[c] - mean[c]) * factor + beta[c];
+    }
+}
+
+void NativeCPUAPI::load_parameters()
+{
+    const unordered_map<string, OnnxTensor>& params = graph.initializers;
+    unordered_map<string, size_t> tensorIds;
+    unordered_map<string, vector<size_t>> consumers;
+    const unordered_set<string> graphOutputs(graph.outputs.begin(), graph.outputs.end());
+    for (size_t nodeIdx = 0; nodeIdx < graph.nodes.size(); ++nodeIdx) {
+        for (const string& input : graph.nodes[nodeIdx].inputs) {
+            consumers[input].push_back(nodeIdx);
+        }
+    }
+    vector<bool> fused(graph.nodes.size(), false);
+
+    auto add_tensor = [&](const string& name, const CPUTensorShape& shape) {
+        tensorIds[name] = model->tensorShapes.size();
+        model->tensorShapes.push_back(shape);
+        return tensorIds[name];
+    };
+    auto get_tensor = [&](const string& name) {
+        auto it = tensorIds.find(name);
+        if (it == tensorIds.end()) {
+            throw invalid_argument("The tensor " + name + " isn't computed by any supported layer.");
+        }
+        return it->second;
+    };
+    // returns the index of the only node which uses the given tensor or INT_MAX if the tensor can't be fused
+    auto single_consumer = [&](const string& name) {
+        auto it = consumers.find(name);
+        if (it == consumers.end() || it->second.size() != 1 || graphOutputs.find(name) != graphOutputs.end()) {
+            return size_t(INT_MAX);
+        }
+        return it->second[0];
+    };
+    auto fuse_relu = [&](CPULayer& layer, string& outputName) {
+        const size_t consumerIdx = single_consumer(outputName);
+        if (consumerIdx != size_t(INT_MAX) && graph.nodes[consumerIdx].opType == "Relu") {
+            layer.relu = true;
+            fused[consumerIdx] = true;
+            outputName = graph.nodes[consumerIdx].outputs[0];
+        }
+    };
+
+    // the input planes are converted from NCHW into NHWC
+    CPUTensorShape inputShape;
+    const vector<int64_t>& inputDims = graph.inputDims[0];
+    inputShape.spatial = true;
+    if (inputDims.size() == 4 && inputDims[1] > 0 && inputDims[2] > 0 && inputDims[3] > 0) {
+        inputShape.channels = size_t(inputDims[1]);
+        inputShape.height = size_t(inputDims[2]);
+        inputShape.width = size_t(inputDims[3]);
+    }
+    else {
+        inputShape.channels = StateConstants::NB_CHANNELS_TOTAL();
+        inputShape.height = StateConstants::BOARD_HEIGHT();
+        inputShape.width = StateConstants::BOARD_WIDTH();
+    }
+    model->inputTensor = add_tensor(graph.inputs[0], inputShape);
+
+    for (size_t nodeIdx = 0; nodeIdx < graph.nodes.size(); ++nodeIdx) {
+        if (fused[nodeIdx]) {
+            continue;
+        }
+        const OnnxNode& node = graph.nodes[nodeIdx];
+        const string& op = node.opType;
+        CPULayer layer;
+        string outputName = node.outputs[0];
+        CPUTensorShape outShape;
+
+        if (op == "Identity" || op == "Dropout") {
+            tensorIds[outputName] = get_tensor(node.inputs[0]);
+            continue;
+        }
+        layer.inputs.push_back(get_tensor(node.inputs[0]));
+        const CPUTensorShape inShape = model->tensorShapes[layer.inputs[0]];
+
+        if (op == "Conv") {
+            const OnnxTensor& weights = params.at(node.inputs[1]);
+            const size_t outChannels = weights.dims[0];
+            const size_t groupChannels = weights.dims[1];
+            layer.kernelH = weights.dims[2];
+            layer.kernelW = weights.dims[3];
+            for (int64_t value : node.get_ints("strides")) {
+                if (value != 1) {
+                    throw invalid_argument("The native CPU back-end only supports convolutions with stride 1 (" + node.name + ")");
+                }
+            }
+            for (int64_t value : node.get_ints("dilations")) {
+                if (value != 1) {
+                    throw invalid_argument("The native CPU back-end doesn't support dilated convolutions (" + node.name + ")");
+                }
+            }
+            const vector<int64_t> pads = node.get_ints("pads");
+            for (size_t idx = 0; idx < pads.size() && idx < 4; ++idx) {
+                layer.pads[idx] = size_t(pads[idx]);
+            }
+            layer.bias = node.inputs.size() > 2 ? params.at(node.inputs[2]).floatData : vector<float>(outChannels, 0.0f);
+
+            const size_t kernelSize = layer.kernelH * layer.kernelW;
+            layer.weights.resize(weights.size());
+            const size_t group = size_t(node.get_int("group", 1));
+            if (group == 1) {
+                // [outChannels, inChannels, kernelH, kernelW] -> [kernelH, kernelW, inChannels, outChannels]
+                layer.type = LAYER_CONV;
+                for (size_t co = 0; co < outChannels; ++co) {
+                    for (size_t ci = 0; ci < groupChannels; ++ci) {
+                        for (size_t k = 0; k < kernelSize; ++k) {
+                            layer.weights[(k * groupChannels + ci) * outChannels + co] = weights.floatData[(co * groupChannels + ci) * kernelSize + k];
+                        }
+                    }
+                }
+            }
+            else if (group == inShape.channels && group == outChannels && groupChannels == 1) {
+                // [channels, 1, kernelH, kernelW] -> [kernelH, kernelW, channels]
+                layer.type = LAYER_DEPTHWISE_CONV;
+                for (size_t c = 0; c < outChannels; ++c) {
+                    for (size_t k = 0; k < kernelSize; ++k) {
+                        layer.weights[k * outChannels + c] = weights.floatData[c * kernelSize + k];
+                    }
+                }
+            }
+            else {
+                throw invalid_argument("The native CPU back-end only supports regular and depthwise convolutions (" + node.name + ")");
+            }
+            outShape.channels = outChannels;
+            outShape.height = inShape.height + layer.pads[0] + layer.pads[2] - layer.kernelH + 1;
+            outShape.width = inShape.width + layer.pads[1] + layer.pads[3] - layer.kernelW + 1;
+            outShape.spatial = true;
+
+            // fuse a following batch normalization, residual connection and ReLU activation
+            size_t consumerIdx = single_consumer(outputName);
+            if (consumerIdx != size_t(INT_MAX) && graph.nodes[consumerIdx].opType == "BatchNormalization") {
+                fold_batch_norm(graph.nodes[consumerIdx], params, layer.weights, layer.bias);
+                fused[consumerIdx] = true;
+                outputName = graph.nodes[consumerIdx].outputs[0];
+            }
+            consumerIdx = single_consumer(outputName);
+            if (consumerIdx != size_t(INT_MAX) && graph.nodes[consumerIdx].opType == "Add") {
+                const OnnxNode& addNode = graph.nodes[consumerIdx];
+                const string& residualName = addNode.inputs[0] == outputName ? addNode.inputs[1] : addNode.inputs[0];
+                // the residual tensor must already be available when the convolution is computed
+                auto it = tensorIds.find(residualName);
+                if (it != tensorIds.end() && model->tensorShapes[it->second].size() == outShape.size()) {
+                    layer.inputs.push_back(it->second);
+                    layer.hasResidual = true;
+                    fused[consumerIdx] = true;
+                    outputName = addNode.outputs[0];
+                }
+            }
+            fuse_relu(layer, outputName);
+        }
+        else if (op == "Gemm" || op == "MatMul") {
+            const OnnxTensor& weights = params.at(node.inputs[1]);
+            const bool transB = op == "Gemm" && node.get_int("transB", 0) != 0;
+            const float alpha = op == "Gemm" ? node.get_float("alpha", 1.0f) : 1.0f;
+            const float beta = op == "Gemm" ? node.get_float("beta", 1.0f) : 1.0f;
+            const size_t inFeatures = transB ? weights.dims[1] : weights.dims[0];
+            const size_t outFeatures = transB ? weights.dims[0] : weights.dims[1];
+            if (inFeatures != inShape.size() || (inShape.spatial && inShape.spatial_size() != 1)) {
+                throw invalid_argument("The input of the dense layer " + node.name + " must be flattened.");
+            }
+            layer.type = LAYER_FULLY_CONNECTED;
+            layer.weights.resize(weights.size());
+            for (size_t in = 0; in < inFeatures; ++in) {
+                for (size_t out = 0; out < outFeatures; ++out) {
+                    layer.weights[in * outFeatures + out] = alpha * (transB ? weights.floatData[out * inFeatures + in] : weights.floatData[in * outFeatures + out]);
+                }
+            }
+            layer.bias.assign(outFeatures, 0.0f);
+            if (node.inputs.size() > 2) {
+                const vector<float>& bias = params.at(node.inputs[2]).floatData;
+                for (size_t out = 0; out < outFeatures; ++out) {
+                    layer.bias[out] = beta * bias[bias.size() == 1 ? 0 : out];
+                }
+            }
+            outShape.channels = outFeatures;
+            fuse_relu(layer, outputName);
+        }
+        else if (op == "BatchNormalization") {
+            layer.type = LAYER_AFFINE;
+            layer.weights.assign(inShape.channels, 1.0f);
+            layer.bias.assign(inShape.channels, 0.0f);
+            fold_batch_norm(node, params, layer.weights, layer.bias);
+            outShape = inShape;
+            fuse_relu(layer, outputName);
+        }
+        else if (op == "Add" || op == "Mul") {
+            auto it = tensorIds.find(node.inputs[1]);
+            if (it == tensorIds.end()) {
+                // the second operand is a constant which is broadcast over the channels
+                const vector<float>& constant = params.at(node.inputs[1]).floatData;
+                if (constant.size() != 1 && constant.size() != inShape.channels) {
+                    throw invalid_argument("The native CPU back-end only supports per channel constants (" + node.name + ")");
+                }
+                layer.type = LAYER_AFFINE;
+                layer.weights.assign(inShape.channels, 1.0f);
+                layer.bias.assign(inShape.channels, 0.0f);
+                vector<float>& target = op == "Add" ? layer.bias : layer.weights;
+                for (size_t c = 0; c < inShape.channels; ++c) {
+                    target[c] = constant[constant.size() == 1 ? 0 : c];
+                }
+                outShape = inShape;
+            }
+            else {
+                const CPUTensorShape& otherShape = model->tensorShapes[it->second];
+                layer.inputs.push_back(it->second);
+                if (otherShape.size() == inShape.size()) {
+                    layer.type = op == "Add" ? LAYER_ADD : LAYER_MUL;
+                    outShape = inShape;
+                }
+                else if (op == "Mul" && (otherShape.size() == inShape.channels || inShape.size() == otherShape.channels)) {
+                    // e.g. squeeze excitation: the spatial tensor is stored as the first input
+                    layer.type = LAYER_SCALE_CHANNELS;
+                    if (otherShape.size() > inShape.size()) {
+                        swap(layer.inputs[0], layer.inputs[1]);
+                    }
+                    outShape = model->tensorShapes[layer.inputs[0]];
+                }
+                else {
+                    throw invalid_argument("The native CPU back-end doesn't support the broadcast in " + node.name);
+                }
+            }
+            if (layer.type != LAYER_SCALE_CHANNELS && layer.type != LAYER_MUL) {
+                fuse_relu(layer, outputName);
+            }
+        }
+        else if (op == "Relu" || op == "Sigmoid" || op == "Tanh") {
+            layer.type = op == "Relu" ? LAYER_RELU : op == "Sigmoid" ? LAYER_SIGMOID : LAYER_TANH;
+            outShape = inShape;
+        }
+        else if (op == "GlobalAveragePool") {
+            layer.type = LAYER_GLOBAL_AVG_POOL;
+            outShape.channels = inShape.channels;
+            outShape.spatial = true;
+        }
+        else if (op == "Flatten" || op == "Reshape") {
+            vector<int64_t> shape;
+            if (op == "Reshape") {
+                shape = params.at(node.inputs[1]).intData;
+            }
+            if (shape.size() == 4) {
+                // resolve 0 (keep the input dimension) and -1 (infer the dimension)
+                const size_t inDims[3] = {inShape.channels, inShape.height, inShape.width};
+                size_t dims[3];
+                size_t inferIdx = 3;
+                size_t knownSize = 1;
+                for (size_t idx = 0; idx < 3; ++idx) {
+                    dims[idx] = shape[idx+1] == 0 ? inDims[idx] : size_t(shape[idx+1]);
+                    if (shape[idx+1] == -1) {
+                        inferIdx = idx;
+                    }
+                    else {
+                        knownSize *= dims[idx];
+                    }
+                }
+                if (inferIdx != 3) {
+                    dims[inferIdx] = inShape.size() / knownSize;
+                }
+                outShape.channels = dims[0];
+                outShape.height = dims[1];
+                outShape.width = dims[2];
+                outShape.spatial = true;
+                layer.type = outShape.spatial_size() == 1 && inShape.spatial_size() == 1 ? LAYER_COPY : LAYER_TO_NHWC;
+                if (layer.type == LAYER_TO_NHWC && inShape.spatial && inShape.spatial_size() != 1) {
+                    throw invalid_argument("The native CPU back-end doesn't support the reshape " + node.name);
+                }
+            }
+            else {
+                outShape.channels = inShape.size();
+                layer.type = inShape.spatial_size() == 1 ? LAYER_COPY : LAYER_TO_NCHW;
+            }
+        }
+        else if (op == "Softmax") {
+            if (inShape.spatial_size() != 1) {
+                // the softmax is applied on the flattened tensor in NCHW order
+                CPULayer flattenLayer;
+                flattenLayer.type = LAYER_TO_NCHW;
+                flattenLayer.inputs = layer.inputs;
+                CPUTensorShape flatShape;
+                flatShape.channels = inShape.size();
+                flattenLayer.output = add_tensor(outputName + "_flatten", flatShape);
+                model->layers.push_back(flattenLayer);
+                layer.inputs[0] = flattenLayer.output;
+            }
+            layer.type = LAYER_SOFTMAX;
+            outShape.channels = inShape.size();
+        }
+        else if (op == "Concat") {
+            if (node.get_int("axis", 1) != 1) {
+                throw invalid_argument("The native CPU back-end only supports concatenation along the channel axis (" + node.name + ")");
+            }
+            // concatenations with more than two inputs are split into consecutive layers
+            size_t curInput = layer.inputs[0];
+            for (size_t inputIdx = 1; inputIdx < node.inputs.size(); ++inputIdx) {
+                const size_t otherInput = get_tensor(node.inputs[inputIdx]);
+                CPULayer concatLayer;
+                concatLayer.type = LAYER_CONCAT;
+                concatLayer.inputs = {curInput, otherInput};
+                CPUTensorShape concatShape = model->tensorShapes[curInput];
+                concatShape.channels += model->tensorShapes[otherInput].channels;
+                if (inputIdx + 1 == node.inputs.size()) {
+                    layer = concatLayer;
+                    outShape = concatShape;
+                }
+                else {
+                    concatLayer.output = add_tensor(outputName + "_concat" + to_string(inputIdx), concatShape);
+                    model->layers.push_back(concatLayer);
+                    curInput = concatLayer.output;
+                }
+            }
+        }
+        else {
+            throw invalid_argument("The operator " + op + " of node " + node.name + " isn't supported by the native CPU back-end.");
+        }
+        layer.output = add_tensor(outputName, outShape);
+        model->layers.push_back(layer);
+    }
+
+    // the value output has a single entry per sample, the other output is the policy
+    const size_t firstOutput = get_tensor(graph.outputs[0]);
+    const size_t secondOutput = get_tensor(graph.outputs[1]);
+    if (model->tensorShapes[firstOutput].size() == 1) {
+        model->valueTensor = firstOutput;
+        model->policyTensor = secondOutput;
+    }
+    else {
+        model->valueTensor = secondOutput;
+        model->policyTensor = firstOutput;
+    }
+    prepare_sparse_policy();
+    assign_memory_slots();
+    info_string("native cpu layers:", model->layers.size());
+
+    // the parameters are now stored in the layers
+    graph = OnnxGraph();
+}
+
+void NativeCPUAPI::prepare_sparse_policy()
+{
+    vector<size_t> numberUses(model->tensorShapes.size(), 0);
+    vector<size_t> producer(model->tensorShapes.size(), size_t(INT_MAX));
+    for (size_t layerIdx = 0; layerIdx < model->layers.size(); ++layerIdx) {
+        for (size_t input : model->layers[layerIdx].inputs) {
+            ++numberUses[input];
+        }
+        producer[model->layers[layerIdx].output] = layerIdx;
+    }
+
+    // walk backwards from the policy output over copies, a softmax and a conversion into NCHW order
+    model->skipForSparsePolicy.assign(model->layers.size(), false);
+    size_t tensor = model->policyTensor;
+    while (producer[tensor] != size_t(INT_MAX) && numberUses[tensor] == 0) {
+        const CPULayer& layer = model->layers[producer[tensor]];
+        if (numberUses[layer.inputs[0]] != 1) {
+            break;
+        }
+        if (layer.type == LAYER_SOFTMAX && !model->isSparsePolicyLogits && !model->isSparsePolicyNHWC) {
+            model->isSparsePolicyLogits = true;
+        }
+        else if (layer.type == LAYER_TO_NCHW && !model->isSparsePolicyNHWC) {
+            model->isSparsePolicyNHWC = true;
+        }
+        else if (layer.type != LAYER_COPY) {
+            break;
+        }
+        model->skipForSparsePolicy[producer[tensor]] = true;
+        // the skipped layer is the only user of its input
+        numberUses[layer.inputs[0]] = 0;
+        tensor = layer.inputs[0];
+    }
+    model->sparsePolicyTensor = tensor;
+    if (tensor == model->policyTensor && model->tensorShapes[tensor].spatial_size() != 1) {
+        // the policy output itself is stored in NHWC
+        model->isSparsePolicyNHWC = true;
+    }
+}
+
+void NativeCPUAPI::assign_memory_slots()
+{
+    const size_t noSlot = size_t(INT_MAX);
+    // index of the last layer which reads each tensor, the outputs are kept until the end
+    vector<size_t> lastUse(model->tensorShapes.size(), 0);
+    for (size_t layerIdx = 0; layerIdx < model->layers.size(); ++layerIdx) {
+        lastUse[model->layers[layerIdx].output] = max(lastUse[model->layers[layerIdx].output], layerIdx);
+        for (size_t input : model->layers[layerIdx].inputs) {
+            lastUse[input] = layerIdx;
+        }
+    }
+    lastUse[model->valueTensor] = model->layers.size();
+    lastUse[model->policyTensor] = model->layers.size();
+    lastUse[model->sparsePolicyTensor] = model->layers.size();
+
+    model->tensorSlots.assign(model->tensorShapes.size(), noSlot);
+    vector<size_t> freeSlots;
+    auto acquire_slot = [&]() {
+        if (freeSlots.empty()) {
+            return model->numberSlots++;
+        }
+        const size_t slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    };
+    vector<bool> released(model->tensorShapes.size(), false);
+    auto release_tensor = [&](size_t tensor, size_t layerIdx) {
+        if (lastUse[tensor] == layerIdx && !released[tensor]) {
+            released[tensor] = true;
+            freeSlots.push_back(model->tensorSlots[tensor]);
+        }
+    };
+
+    model->tensorSlots[model->inputTensor] = acquire_slot();
+    for (size_t layerIdx = 0; layerIdx < model->layers.size(); ++layerIdx) {
+        const CPULayer& layer = model->layers[layerIdx];
+        // the output slot is acquired before the inputs are released, so that no layer operates in-place
+        model->tensorSlots[layer.output] = acquire_slot();
+        for (size_t input : layer.inputs) {
+            release_tensor(input, layerIdx);
+        }
+        release_tensor(layer.output, layerIdx);
+    }
+}
+
+CPUWorkspace NativeCPUAPI::create_workspace() const
+{
+    vector<size_t> slotSizes(model->numberSlots, 0);
+    for (size_t tensor = 0; tensor < model->tensorShapes.size(); ++tensor) {
+        if (model->tensorSlots[tensor] < model->numberSlots) {
+            slotSizes[model->tensorSlots[tensor]] = max(slotSizes[model->tensorSlots[tensor]], model->tensorShapes[tensor].size() * chunkSize);
+        }
+    }
+    size_t paddedSize = 0;
+    for (const CPULayer& layer : model->layers) {
+        if (layer.type == LAYER_CONV || layer.type == LAYER_DEPTHWISE_CONV) {
+            const CPUTensorShape& inShape = model->tensorShapes[layer.inputs[0]];
+            paddedSize = max(paddedSize, chunkSize * inShape.channels * (inShape.height + layer.pads[0] + layer.pads[2]) *
+                             (inShape.width + layer.pads[1] + layer.pads[3]));
+        }
+    }
+
+    CPUWorkspace workspace;
+    workspace.slots.resize(model->numberSlots);
+    for (size_t slot = 0; slot < model->numberSlots; ++slot) {
+        workspace.slots[slot].resize(slotSizes[slot]);
+    }
+    workspace.paddedInput.resize(paddedSize);
+    return workspace;
+}
+
+void NativeCPUAPI::bind_executor()
+{
+    workspaces.clear();
+    for (size_t threadIdx = 0; threadIdx < numberThreads; ++threadIdx) {
+        workspaces.push_back(create_workspace());
+    }
+    info_string("native cpu kernels:", useInt8 ? string(simd_instruction_set()) + " (int8: " + int8_instruction_set() + ")" : simd_instruction_set());
+    // the first chunk is evaluated by the calling search thread, all other chunks by the inference threads
+    for (size_t chunkIdx = 1; chunkIdx < numberThreads; ++chunkIdx) {
+        workers.emplace_back(&NativeCPUAPI::run_worker, this, chunkIdx);
+    }
+    info_string("native cpu threads:", numberThreads);
+    const CPUTensorShape& policyShape = model->tensorShapes[model->policyTensor];
+    const size_t directOutputs = model->tensorShapes[model->valueTensor].size() + (policyShape.spatial_size() == 1 ? policyShape.size() : 0);
+    info_string("output copy avoided per batch (KiB):", batchSize * directOutputs * sizeof(float) / 1024.0f);
+}
+
+void NativeCPUAPI::check_if_policy_map()
+{
+    isPolicyMap = false;
+    if (model->tensorShapes[model->policyTensor].size() != size_t(StateConstants::NB_LABELS())) {
+        isPolicyMap = true;
+        policyOutputLength = StateConstants::NB_LABELS_POLICY_MAP() * batchSize;
+    }
+}
+
+void NativeCPUAPI::run_layers(CPUWorkspace& workspace, size_t curBatchSize, float* valueOutput, float* policyOutput, vector<float>* inputRanges,
+                              bool sparsePolicy) const
+{
+    auto tensor_data = [&](size_t tensor) {
+        if (tensor == model->valueTensor && valueOutput != nullptr) {
+            return valueOutput;
+        }
+        if (tensor == model->policyTensor && policyOutput != nullptr) {
+            return policyOutput;
+        }
+        return workspace.slots[model->tensorSlots[tensor]].data();
+    };
+    for (size_t layerIdx = 0; layerIdx < model->layers.size(); ++layerIdx) {
+        const CPULayer& layer = model->layers[layerIdx];
+        if (sparsePolicy && model->skipForSparsePolicy[layerIdx]) {
+            continue;
+        }
+        const CPUTensorShape& inShape = model->tensorShapes[layer.inputs[0]];
+        const CPUTensorShape& outShape = model->tensorShapes[layer.output];
+        const float* input = tensor_data(layer.inputs[0]);
+        const float* secondInput = layer.inputs.size() > 1 ? tensor_data(layer.inputs[1]) : nullptr;
+        const float* residual = layer.hasResidual ? secondInput : nullptr;
+        float* output = tensor_data(layer.output);
+        if (inputRanges != nullptr) {
+            (*inputRanges)[layerIdx] = max((*inputRanges)[layerIdx], max_abs(input, curBatchSize * inShape.size()));
+        }
+
+        switch (layer.type) {
+        case LAYER_CONV:
+            if (layer.quantized) {
+                conv2d_nhwc_int8(input, layer.inputScale, layer.weightsInt8.data(), layer.outputScales.data(), layer.compensation.data(),
+                                 layer.bias.data(), residual, output, workspace.quantizedInput, curBatchSize, inShape.height, inShape.width,
+                                 inShape.channels, outShape.channels, layer.kernelH, layer.kernelW, layer.pads, layer.relu);
+                break;
+            }
+            conv2d_nhwc(input, layer.weights.data(), layer.bias.data(), residual, output, workspace.paddedInput, curBatchSize,
+                        inShape.height, inShape.width, inShape.channels, outShape.channels, layer.kernelH, layer.kernelW, layer.pads, layer.relu);
+            break;
+        case LAYER_DEPTHWISE_CONV:
+            depthwise_conv2d_nhwc(input, layer.weights.data(), layer.bias.data(), residual, output, workspace.paddedInput, curBatchSize,
+                                  inShape.height, inShape.width, inShape.channels, layer.kernelH, layer.kernelW, layer.pads, layer.relu);
+            break;
+        case LAYER_FULLY_CONNECTED:
+            fully_connected(input, layer.weights.data(), layer.bias.data(), output, curBatchSize, inShape.size(), outShape.size(), layer.relu);
+            break;
+        case LAYER_AFFINE:
+            channel_affine(input, layer.weights.data(), layer.bias.data(), output, curBatchSize * inShape.spatial_size(), inShape.channels, layer.relu);
+            break;
+        case LAYER_ADD:
+            add_tensors(input, secondInput, output, curBatchSize * outShape.size(), layer.relu);
+            break;
+        case LAYER_MUL:
+            multiply_tensors(input, secondInput, output, curBatchSize * outShape.size());
+            break;
+        case LAYER_SCALE_CHANNELS:
+            scale_channels(input, secondInput, output, curBatchSize, inShape.spatial_size(), inShape.channels);
+            break;
+        case LAYER_RELU:
+            relu_activation(input, output, curBatchSize * outShape.size());
+            break;
+        case LAYER_SIGMOID:
+            sigmoid_activation(input, output, curBatchSize * outShape.size());
+            break;
+        case LAYER_TANH:
+            tanh_activation(input, output, curBatchSize * outShape.size());
+            break;
+        case LAYER_SOFTMAX:
+            softmax(input, output, curBatchSize, outShape.size());
+            break;
+        case LAYER_GLOBAL_AVG_POOL:
+            global_avg_pool_nhwc(input, output, curBatchSize, inShape.spatial_size(), inShape.channels);
+            break;
+        case LAYER_CONCAT:
+            concat_channels(input, secondInput, output, curBatchSize * inShape.spatial_size(), inShape.channels,
+                            model->tensorShapes[layer.inputs[1]].channels);
+            break;
+        case LAYER_TO_NCHW:
+            nhwc_to_nchw(input, output, curBatchSize, inShape.channels, inShape.spatial_size());
+            break;
+        case LAYER_TO_NHWC:
+            nchw_to_nhwc(input, output, curBatchSize, outShape.channels, outShape.spatial_size());
+            break;
+        case LAYER_COPY:
+            copy(input, input + curBatchSize * outShape.size(), output);
+            break;
+        }
+    }
+}
+
+void NativeCPUAPI::evaluate(CPUWorkspace& workspace, const float* inputPlanes, size_t curBatchSize, float* valueOutput, float* probOutputs,
+                            vector<float>* inputRanges) const
+{
+    const CPUTensorShape& inputShape = model->tensorShapes[model->inputTensor];
+    nchw_to_nhwc(inputPlanes, workspace.slots[model->tensorSlots[model->inputTensor]].data(), curBatchSize, inputShape.channels, inputShape.spatial_size());
+    // the outputs are written directly into the output buffers, only spatial policy outputs must be converted into NCHW order
+    const CPUTensorShape& policyShape = model->tensorShapes[model->policyTensor];
+    const bool isSpatialPolicy = policyShape.spatial_size() != 1;
+    run_layers(workspace, curBatchSize, valueOutput, isSpatialPolicy ? nullptr : probOutputs, inputRanges);
+    if (isSpatialPolicy) {
+        nhwc_to_nchw(workspace.slots[model->tensorSlots[model->policyTensor]].data(), probOutputs, curBatchSize,
+                     policyShape.channels, policyShape.spatial_size());
+    }
+}
+
+void NativeCPUAPI::predict_chunk(size_t chunkIdx, size_t startIdx, size_t curBatchSize, float* inputPlanes, float* valueOutput, float* probOutputs)
+{
+    evaluate(workspaces[chunkIdx], inputPlanes + startIdx * model->tensorShapes[model->inputTensor].size(), curBatchSize,
+             valueOutput + startIdx, probOutputs + startIdx * model->tensorShapes[model->policyTensor].size(), nullptr);
+}
+
+void NativeCPUAPI::evaluate_samples(CPUWorkspace& workspace, const vector<float>& planes, vector<float>& valueOutputs, vector<float>& policyOutputs, vector<float>* inputRanges)
+{
+    const size_t inputSize = model->tensorShapes[model->inputTensor].size();
+    const size_t policySize = model->tensorShapes[model->policyTensor].size();
+    const size_t numberSamples = planes.size() / inputSize;
+    valueOutputs.resize(numberSamples);
+    policyOutputs.resize(numberSamples * policySize);
+    for (size_t startIdx = 0; startIdx < numberSamples; startIdx += chunkSize) {
+        evaluate(workspace, planes.data() + startIdx * inputSize, min(chunkSize, numberSamples - startIdx),
+                 valueOutputs.data() + startIdx, policyOutputs.data() + startIdx * policySize, inputRanges);
+    }
+}
+
+void NativeCPUAPI::calibrate_int8(const string& calibrationFile)
+{
+#ifdef MODE_POMMERMAN
+    throw invalid_argument("The int8 calibration of the native CPU back-end isn't available for Pommerman.");
+#else
+    info_string("run INT8 quantization calibration");
+    // the accuracy is always measured on the same built-in positions
+    const vector<float> samplePlanes = generate_sample_planes(MAX_CALIBRATION_SAMPLES);
+    const vector<float> calibrationPlanes = calibrationFile.empty() ? samplePlanes : read_pgn_planes(calibrationFile, MAX_CALIBRATION_SAMPLES);
+    if (calibrationPlanes.empty()) {
+        throw invalid_argument("No calibration positions could be read from " + calibrationFile);
+    }
+    info_string("calibration positions:", calibrationPlanes.size() / model->tensorShapes[model->inputTensor].size());
+
+    CPUWorkspace workspace = create_workspace();
+    vector<float> inputRanges(model->layers.size(), 0.0f);
+    vector<float> valueFloat;
+    vector<float> policyFloat;
+    evaluate_samples(workspace, calibrationPlanes, valueFloat, policyFloat, &inputRanges);
+    evaluate_samples(workspace, samplePlanes, valueFloat, policyFloat, nullptr);
+
+    size_t numberQuantized = 0;
+    vector<float> weightScales;
+    for (size_t layerIdx = 0; layerIdx < model->layers.size(); ++layerIdx) {
+        CPULayer& layer = model->layers[layerIdx];
+        if (layer.type != LAYER_CONV || inputRanges[layerIdx] <= 0) {
+            continue;
+        }
+        const size_t inChannels = model->tensorShapes[layer.inputs[0]].channels;
+        const size_t outChannels = model->tensorShapes[layer.output].channels;
+        quantize_weights_int8(layer.weights.data(), layer.kernelH * layer.kernelW, inChannels, outChannels,
+                              layer.weightsInt8, weightScales, layer.compensation);
+        layer.inputScale = inputRanges[layerIdx] / 127.0f;
+        layer.outputScales.resize(outChannels);
+        for (size_t co = 0; co < outChannels; ++co) {
+            layer.outputScales[co] = layer.inputScale * weightScales[co];
+        }
+        layer.quantized = true;
+        layer.weights = vector<float>();
+        ++numberQuantized;
+    }
+    info_string("quantized convolutions:", numberQuantized);
+
+    // compare the int8 network against the float32 network
+    vector<float> valueInt8;
+    vector<float> policyInt8;
+    evaluate_samples(workspace, samplePlanes, valueInt8, policyInt8, nullptr);
+    const size_t numberSamples = valueFloat.size();
+    const size_t policySize = model->tensorShapes[model->policyTensor].size();
+    float valueError = 0;
+    float maxValueError = 0;
+    float policyError = 0;
+    size_t sameBestMove = 0;
+    for (size_t idx = 0; idx < numberSamples; ++idx) {
+        const float error = abs(valueFloat[idx] - valueInt8[idx]);
+        valueError += error;
+        maxValueError = max(maxValueError, error);
+        const float* policyA = policyFloat.data() + idx * policySize;
+        const float* policyB = policyInt8.data() + idx * policySize;
+        for (size_t moveIdx = 0; moveIdx < policySize; ++moveIdx) {
+            policyError += abs(policyA[moveIdx] - policyB[moveIdx]);
+        }
+        sameBestMove += max_element(policyA, policyA + policySize) - policyA == max_element(policyB, policyB + policySize) - policyB;
+    }
+    info_string("int8 value mean abs error:", valueError / numberSamples);
+    info_string("int8 value max abs error:", maxValueError);
+    info_string("int8 policy mean L1 error:", policyError / numberSamples);
+    info_string("int8 policy top-1 agreement:", to_string(100.0f * sameBestMove / numberSamples) + "%");
+#endif
+}
+
+void NativeCPUAPI::predict_sparse_chunk(size_t chunkIdx, size_t startIdx, size_t curBatchSize, float* inputPlanes, float* valueOutput,
+                                        SparsePolicy* sparsePolicy)
+{
+    CPUWorkspace& workspace = workspaces[chunkIdx];
+    const CPUTensorShape& inputShape = model->tensorShapes[model->inputTensor];
+    nchw_to_nhwc(inputPlanes + startIdx * inputShape.size(), workspace.slots[model->tensorSlots[model->inputTensor]].data(), curBatchSize,
+                 inputShape.channels, inputShape.spatial_size());
+    run_layers(workspace, curBatchSize, valueOutput + startIdx, nullptr, nullptr, true);
+
+    // the indices refer to the policy in NCHW order
+    const CPUTensorShape& policyShape = model->tensorShapes[model->sparsePolicyTensor];
+    const size_t spatialSize = policyShape.spatial_size();
+    const float* policy = workspace.slots[model->tensorSlots[model->sparsePolicyTensor]].data();
+    const bool isLogits = model->isSparsePolicyLogits || !isPolicyMap;
+    for (size_t sampleIdx = startIdx; sampleIdx < startIdx + curBatchSize; ++sampleIdx) {
+        const float* samplePolicy = policy + (sampleIdx - startIdx) * policyShape.size();
+        const uint16_t* indices = sparsePolicy->indices.data() + sparsePolicy->offsets[sampleIdx];
+        float* gathered = sparsePolicy->probabilities.data() + sparsePolicy->offsets[sampleIdx];
+        const size_t length = sparsePolicy->offsets[sampleIdx+1] - sparsePolicy->offsets[sampleIdx];
+        if (model->isSparsePolicyNHWC) {
+            for (size_t idx = 0; idx < length; ++idx) {
+                gathered[idx] = samplePolicy[(indices[idx] % spatialSize) * policyShape.channels + indices[idx] / spatialSize];
+            }
+        }
+        else {
+            for (size_t idx = 0; idx < length; ++idx) {
+                gathered[idx] = samplePolicy[indices[idx]];
+            }
+        }
+        normalize_policy(gathered, length, isLogits);
+    }
+}
+
+void NativeCPUAPI::run_worker(size_t chunkIdx)
+{
+    pin_inference_thread(firstPinnedThread + chunkIdx - 1);
+    size_t batchIdx = 0;
+    unique_lock<mutex> lock(workerMutex);
+    while (true) {
+        workerStart.wait(lock, [&]{ return stopWorkers || workerBatchIdx != batchIdx; });
+        if (stopWorkers) {
+            return;
+        }
+        batchIdx = workerBatchIdx;
+        const size_t startIdx = chunkIdx * workerChunkSize;
+        if (startIdx < workerSamples) {
+            const function<void(size_t, size_t, size_t)>& evaluate_chunk = *workerTask;
+            const size_t curBatchSize = min(workerChunkSize, workerSamples - startIdx);
+            lock.unlock();
+            evaluate_chunk(chunkIdx, startIdx, curBatchSize);
+            lock.lock();
+        }
+        if (--runningWorkers == 0) {
+            workerDone.notify_one();
+        }
+    }
+}
+
+void NativeCPUAPI::run_chunks(size_t numberSamples, const function<void(size_t, size_t, size_t)>& evaluate_chunk)
+{
+    const size_t curChunkSize = (numberSamples + numberThreads - 1) / numberThreads;
+    const bool useWorkers = numberSamples > curChunkSize;
+    if (useWorkers) {
+        {
+            lock_guard<mutex> lock(workerMutex);
+            workerTask = &evaluate_chunk;
+            workerSamples = numberSamples;
+            workerChunkSize = curChunkSize;
+            runningWorkers = workers.size();
+            ++workerBatchIdx;
+        }
+        workerStart.notify_all();
+    }
+    if (numberSamples != 0) {
+        evaluate_chunk(0, 0, min(curChunkSize, numberSamples));
+    }
+    if (useWorkers) {
+        unique_lock<mutex> lock(workerMutex);
+        workerDone.wait(lock, [&]{ return runningWorkers == 0; });
+    }
+}
+
+void NativeCPUAPI::predict(float* inputPlanes, float* valueOutput, float* probOutputs)
+{
+    predict_samples(inputPlanes, valueOutput, probOutputs, batchSize);
+}
+
+size_t NativeCPUAPI::predict_samples(float* inputPlanes, float* valueOutput, float* probOutputs, size_t numberSamples)
+{
+    numberSamples = min(numberSamples, size_t(batchSize));
+    run_chunks(numberSamples, [&](size_t chunkIdx, size_t startIdx, size_t curBatchSize) {
+        predict_chunk(chunkIdx, startIdx, curBatchSize, inputPlanes, valueOutput, probOutputs);
+    });
+    return numberSamples;
+}
+
+size_t NativeCPUAPI::predict_sparse(float* inputPlanes, float* valueOutput, float* probOutputs, size_t numberSamples, SparsePolicy& sparsePolicy)
+{
+    numberSamples = min(numberSamples, size_t(batchSize));
+    sparsePolicy.probabilities.resize(sparsePolicy.indices.size());
+    run_chunks(numberSamples, [&](size_t chunkIdx, size_t startIdx, size_t curBatchSize) {
+        predict_sparse_chunk(chunkIdx, startIdx, curBatchSize, inputPlanes, valueOutput, &sparsePolicy);
+    });
+    return numberSamples;
+}
+
+#endif
@@ -0,0 +1,274 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: nativecpuapi.h
+ * Created on 19.10.2026
+ * @author: agent
+ *
+ * Self-contained CPU back-end which runs the ONNX export of the network (the same file which is used by TensorrtAPI)
+ * without any deep learning framework.
+ * Batch normalization layers are folded into the preceding convolutions at load time and residual additions
+ * as well as ReLU activations are fused into the convolution kernels. The activations are stored in NHWC layout.
+ * The batch is split into chunks which are evaluated in parallel by persistent inference threads.
+ * The outputs are written directly into the buffers of the caller. For a sparse policy, the legal moves are gathered
+ * from the policy logits and the remaining layers of the policy head (e.g. the softmax over all moves) are skipped.
+ * Partially filled batches are evaluated without padding because all layers support a variable batch size.
+ * In int8 mode, the regular convolutions are quantized after loading. The weights use a symmetric scale per output channel
+ * and the input scales are calibrated on sample positions (or positions of a PGN file) by the maximum absolute activation.
+ */
+
+#ifndef NATIVECPUAPI_H
+#define NATIVECPUAPI_H
+
+#ifdef NATIVE_CPU
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "neuralnetapi.h"
+#include "util/onnxreader.h"
+
+using namespace std;
+
+// maximum number of positions which are used for the int8 calibration and the accuracy report
+const size_t MAX_CALIBRATION_SAMPLES = 1024;
+
+enum CPULayerType {
+    LAYER_CONV,
+    LAYER_DEPTHWISE_CONV,
+    LAYER_FULLY_CONNECTED,
+    LAYER_AFFINE,
+    LAYER_ADD,
+    LAYER_MUL,
+    LAYER_SCALE_CHANNELS,
+    LAYER_RELU,
+    LAYER_SIGMOID,
+    LAYER_TANH,
+    LAYER_SOFTMAX,
+    LAYER_GLOBAL_AVG_POOL,
+    LAYER_CONCAT,
+    LAYER_TO_NCHW,
+    LAYER_TO_NHWC,
+    LAYER_COPY
+};
+
+/**
+ * @brief The CPUTensorShape struct describes the shape of a single sample. Spatial tensors are stored in NHWC layout,
+ * non spatial tensors (e.g. the output of a dense layer) only use the channel dimension.
+ */
+struct CPUTensorShape {
+    size_t channels = 0;
+    size_t height = 1;
+    size_t width = 1;
+    bool spatial = false;
+
+    size_t spatial_size() const {
+        return height * width;
+    }
+    size_t size() const {
+        return channels * height * width;
+    }
+};
+
+struct CPULayer {
+    CPULayerType type = LAYER_COPY;
+    // indices of the input tensors, the optional residual tensor is stored as the last input
+    vector<size_t> inputs;
+    size_t output;
+    bool relu = false;
+    bool hasResidual = false;
+
+    // parameters for convolutions
+    size_t kernelH = 1;
+    size_t kernelW = 1;
+    size_t pads[4] = {0, 0, 0, 0};
+    // weights in layout [kernelH, kernelW, inChannels, outChannels] and [inFeatures, outFeatures] respectively,
+    // or the scale in case of an affine layer
+    vector<float> weights;
+    // bias or the shift in case of an affine layer
+    vector<float> bias;
+
+    // int8 parameters, only used for regular convolutions in int8 mode
+    bool quantized = false;
+    float inputScale = 1;
+    vector<int8_t> weightsInt8;
+    vector<float> outputScales;
+    vector<int32_t> compensation;
+};
+
+/**
+ * @brief The CPUWorkspace struct holds the activation buffers for a single chunk of the batch
+ */
+struct CPUWorkspace {
+    vector<vector<float>> slots;
+    vector<float> paddedInput;
+    vector<uint8_t> quantizedInput;
+};
+
+/**
+ * @brief The NativeCPUModel struct holds the layers of the network. It is immutable after loading and shared between
+ * all NativeCPUAPI objects which use the same model directory and precision, independent of their batch size.
+ */
+struct NativeCPUModel {
+    vector<CPULayer> layers;
+    vector<CPUTensorShape> tensorShapes;
+    // memory slot of the workspace which is used for each tensor
+    vector<size_t> tensorSlots;
+    size_t numberSlots = 0;
+    size_t inputTensor = 0;
+    size_t valueTensor = 0;
+    size_t policyTensor = 0;
+
+    // tensor from which the legal moves are gathered for a sparse policy, the layers after it are skipped in this case
+    size_t sparsePolicyTensor = 0;
+    bool isSparsePolicyNHWC = false;
+    bool isSparsePolicyLogits = false;
+    vector<bool> skipForSparsePolicy;
+};
+
+/**
+ * @brief The NativeCPUAPI class implements a neural network back-end for CPUs which doesn't rely on external libraries
+ */
+class NativeCPUAPI : public NeuralNetAPI
+{
+private:
+    // the graph is only kept while the model is loaded
+    OnnxGraph graph;
+    shared_ptr<NativeCPUModel> model;
+
+    // number of threads which evaluate separate chunks of the batch in parallel
+    size_t numberThreads;
+    size_t chunkSize;
+    vector<CPUWorkspace> workspaces;
+    bool useInt8;
+    // index of the first inference thread of this object for thread pinning (see pin_inference_thread())
+    size_t firstPinnedThread;
+    static atomic<size_t> nextPinnedThread;
+
+    // inference threads which evaluate the chunks after the first one, they are kept alive between batches
+    vector<thread> workers;
+    mutex workerMutex;
+    condition_variable workerStart;
+    condition_variable workerDone;
+    // current batch of the inference threads (protected by workerMutex)
+    const function<void(size_t, size_t, size_t)>* workerTask;
+    size_t workerSamples;
+    size_t workerChunkSize;
+    size_t workerBatchIdx;
+    size_t runningWorkers;
+    bool stopWorkers;
+
+    /**
+     * @brief run_worker Main loop of the inference thread which evaluates the chunk with the given index of every batch
+     */
+    void run_worker(size_t chunkIdx);
+
+    /**
+     * @brief run_layers Evaluates the network for a single chunk of the batch which must already be stored in the input slot
+     * @param valueOutput If not nullptr, the value output is written directly into this buffer instead of the workspace
+     * @param policyOutput If not nullptr, the policy output is written directly into this buffer instead of the workspace
+     * @param inputRanges If not nullptr, the maximum absolute input value of each layer is tracked for the int8 calibration
+     * @param sparsePolicy If true, the layers after the sparse policy tensor are skipped
+     */
+    void run_layers(CPUWorkspace& workspace, size_t curBatchSize, float* valueOutput, float* policyOutput, vector<float>* inputRanges,
+                    bool sparsePolicy=false) const;
+
+    /**
+     * @brief evaluate Copies the input planes into the workspace, runs the network and writes the outputs
+     */
+    void evaluate(CPUWorkspace& workspace, const float* inputPlanes, size_t curBatchSize, float* valueOutput, float* probOutputs,
+                  vector<float>* inputRanges) const;
+
+    /**
+     * @brief predict_chunk Evaluates curBatchSize samples starting at startIdx using the workspace of the given chunk
+     */
+    void predict_chunk(size_t chunkIdx, size_t startIdx, size_t curBatchSize, float* inputPlanes, float* valueOutput, float* probOutputs);
+
+    /**
+     * @brief predict_sparse_chunk Version of predict_chunk() which gathers the legal moves of the policy
+     */
+    void predict_sparse_chunk(size_t chunkIdx, size_t startIdx, size_t curBatchSize, float* inputPlanes, float* valueOutput,
+                              SparsePolicy* sparsePolicy);
+
+    /**
+     * @brief run_chunks Distributes the samples evenly over the threads and runs the given function for each chunk.
+     * The first chunk is evaluated by the calling thread, the other chunks by the inference threads.
+     * @param evaluate_chunk Function which receives the chunk index, the start index and the number of samples of the chunk
+     */
+    void run_chunks(size_t numberSamples, const function<void(size_t, size_t, size_t)>& evaluate_chunk);
+
+    /**
+     * @brief prepare_sparse_policy Finds the last tensor of the policy head from which the legal moves can be gathered
+     * (e.g. the logits before a softmax) and marks the following layers which aren't needed for a sparse policy
+     */
+    void prepare_sparse_policy();
+
+    /**
+     * @brief create_workspace Allocates the activation buffers for a single chunk of the batch
+     */
+    CPUWorkspace create_workspace() const;
+
+    /**
+     * @brief evaluate_samples Evaluates an arbitrary number of samples in chunks using the given workspace
+     */
+    void evaluate_samples(CPUWorkspace& workspace, const vector<float>& planes, vector<float>& valueOutputs, vector<float>& policyOutputs, vector<float>* inputRanges);
+
+    /**
+     * @brief calibrate_int8 Quantizes the convolutions using the activation ranges of the calibration positions
+     * and prints the accuracy of the int8 network compared to the float32 network on the built-in sample positions
+     * @param calibrationFile PGN file which is used for calibration or "" to use the built-in sample positions
+     */
+    void calibrate_int8(const string& calibrationFile);
+
+    /**
+     * @brief assign_memory_slots Assigns the tensors to a minimal number of memory slots based on their lifetime
+     */
+    void assign_memory_slots();
+
+public:
+    /**
+     * @brief NativeCPUAPI
+     * @param deviceID Only used to generate the device name
+     * @param batchSize Constant batch size which is used for inference
+     * @param modelDirectory Directory which contains the .onnx file for the given batch size
+     * @param numberThreads Number of threads which are used to evaluate a batch
+     * @param strPrecision Inference precision ("float32" or "int8")
+     * @param calibrationFile PGN file which is used for the int8 calibration or "" to use the built-in sample positions
+     */
+    NativeCPUAPI(int deviceID, unsigned int batchSize, const string& modelDirectory, size_t numberThreads,
+                 const string& strPrecision="float32", const string& calibrationFile="");
+    ~NativeCPUAPI();
+    NativeCPUAPI(const NativeCPUAPI&) = delete;
+    NativeCPUAPI& operator=(const NativeCPUAPI&) = delete;
+
+    void predict(float* inputPlanes, float* valueOutput, float* probOutputs) override;
+    size_t predict_samples(float* inputPlanes, float* valueOutput, float* probOutputs, size_t numberSamples) override;
+    size_t predict_sparse(float* inputPlanes, float* valueOutput, float* probOutputs, size_t numberSamples, SparsePolicy& sparsePolicy) override;
+
+protected:
+    void load_model() override;
+    void load_parameters() override;
+    void bind_executor() override;
+    void check_if_policy_map() override;
+};
+
+#endif
+
+#endif // NATIVECPUAPI_H
@@ -25,6 +25,10 @@
 
 #include "neuralnetapi.h"
 #include <string>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <unistd.h>
 #include "../stateobj.h"
 
 
@@ -39,6 +43,63 @@ string get_file_ending_with(const string& dir, const string& suffix) {
     return "";
 }
 
+SparsePolicy::SparsePolicy():
+    offsets(1, 0)
+{
+}
+
+void SparsePolicy::clear()
+{
+    indices.clear();
+    offsets.resize(1);
+}
+
+void SparsePolicy::finish_sample()
+{
+    offsets.push_back(indices.size());
+}
+
+size_t SparsePolicy::number_samples() const
+{
+    return offsets.size() - 1;
+}
+
+void normalize_policy(float* policy, size_t length, bool isLogits)
+{
+    if (length == 0) {
+        return;
+    }
+    float sum = 0;
+    if (isLogits) {
+        const float maxLogit = *max_element(policy, policy + length);
+        for (size_t idx = 0; idx < length; ++idx) {
+            policy[idx] = exp(policy[idx] - maxLogit);
+            sum += policy[idx];
+        }
+    }
+    else {
+        for (size_t idx = 0; idx < length; ++idx) {
+            sum += policy[idx];
+        }
+    }
+    const float factor = 1.0f / sum;
+    for (size_t idx = 0; idx < length; ++idx) {
+        policy[idx] *= factor;
+    }
+}
+
+size_t get_resident_memory_mb()
+{
+    // the second entry of statm is the number of resident pages
+    ifstream statm("/proc/self/statm");
+    size_t totalPages = 0;
+    size_t residentPages = 0;
+    if (!(statm >> totalPages >> residentPages)) {
+        return 0;
+    }
+    return residentPages * size_t(sysconf(_SC_PAGESIZE)) / (1024 * 1024);
+}
+
 
 unsigned int NeuralNetAPI::get_batch_size() const
 {
@@ -55,6 +116,36 @@ NeuralNetAPI::NeuralNetAPI(const string& ctx, int deviceID, unsigned int batchSi
     deviceName = ctx + string("_") + to_string(deviceID);
 }
 
+size_t NeuralNetAPI::predict_samples(float* inputPlanes, float* valueOutput, float* probOutputs, size_t numberSamples)
+{
+    // the default implementation always evaluates the full batch
+    predict(inputPlanes, valueOutput, probOutputs);
+    return batchSize;
+}
+
+size_t NeuralNetAPI::predict_sparse(float* inputPlanes, float* valueOutput, float* probOutputs, size_t numberSamples, SparsePolicy& sparsePolicy)
+{
+    const size_t computedSamples = predict_samples(inputPlanes, valueOutput, probOutputs, numberSamples);
+    // policy map outputs already contain probabilities, the plain policy output is given as logits
+    const size_t policySize = policyOutputLength / batchSize;
+    sparsePolicy.probabilities.resize(sparsePolicy.indices.size());
+    for (size_t sampleIdx = 0; sampleIdx < numberSamples; ++sampleIdx) {
+        const float* policy = probOutputs + sampleIdx * policySize;
+        float* gathered = sparsePolicy.probabilities.data() + sparsePolicy.offsets[sampleIdx];
+        const size_t length = sparsePolicy.offsets[sampleIdx+1] - sparsePolicy.offsets[sampleIdx];
+        for (size_t idx = 0; idx < length; ++idx) {
+            gathered[idx] = policy[sparsePolicy.indices[sparsePolicy.offsets[sampleIdx] + idx]];
+        }
+        normalize_policy(gathered, length, !isPolicyMap);
+    }
+    return computedSamples;
+}
+
+bool NeuralNetAPI::get_output_buffers(float*& valueOutput, float*& probOutputs)
+{
+    return false;
+}
+
 bool NeuralNetAPI::is_policy_map() const
 {
     return isPolicyMap;
@@ -29,10 +29,14 @@
 #define NEURALNETAPI_H
 
 #include <iostream>
+#include <cstdint>
 #include <sys/stat.h>
 #include <mutex>
+#include <chrono>
 #include <vector>
 #include <memory>
+#include <functional>
+#include <unordered_map>
 #include <dirent.h>
 #include <cstring>
 #include "../util/communication.h"
@@ -72,6 +76,78 @@ bool has_suffix(const std::string &str, const std::string &suffix)
  */
 string get_file_ending_with(const string& dir, const string& suffix);
 
+/**
+ * @brief get_shared_model Returns the model which is stored under the given key and loads it if it isn't available yet.
+ * This allows all NeuralNetAPI objects of the same network to share the immutable weights while each object only holds
+ * its own execution context and buffers. The model is released as soon as the last object using it is destroyed.
+ * Objects which are constructed concurrently wait for the first one to load the model, while different models
+ * (e.g. for different devices) are loaded in parallel.
+ * @param key Unique identifier of the model (e.g. file path, device and precision)
+ * @param load_model Function which loads the model. It is called while holding the lock of the given key.
+ * @return Shared model
+ */
+template <typename T>
+shared_ptr<T> get_shared_model(const string& key, const function<shared_ptr<T>()>& load_model)
+{
+    struct ModelEntry {
+        mutex mtx;
+        weak_ptr<T> model;
+    };
+    static mutex mtx;
+    // the entries are never removed, so that the pointers stay valid
+    static unordered_map<string, unique_ptr<ModelEntry>> entries;
+    ModelEntry* entry;
+    {
+        lock_guard<mutex> lock(mtx);
+        unique_ptr<ModelEntry>& slot = entries[key];
+        if (slot == nullptr) {
+            slot = make_unique<ModelEntry>();
+        }
+        entry = slot.get();
+    }
+    lock_guard<mutex> lock(entry->mtx);
+    shared_ptr<T> model = entry->model.lock();
+    if (model == nullptr) {
+        const chrono::steady_clock::time_point loadStart = chrono::steady_clock::now();
+        model = load_model();
+        entry->model = model;
+        info_string("model loading time (ms):", chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - loadStart).count());
+    }
+    return model;
+}
+
+/**
+ * @brief The SparsePolicy struct holds the policy indices of the legal moves for all samples of a batch and receives
+ * the prior probabilities of these moves. The entries of sample i are stored in the range [offsets[i], offsets[i+1]).
+ */
+struct SparsePolicy {
+    // indices into the dense policy output of a single sample (see MoveIdx)
+    vector<uint16_t> indices;
+    vector<uint32_t> offsets;
+    vector<float> probabilities;
+
+    SparsePolicy();
+    void clear();
+    /**
+     * @brief finish_sample Marks all indices which have been added since the last call as the indices of the next sample
+     */
+    void finish_sample();
+    size_t number_samples() const;
+};
+
+/**
+ * @brief normalize_policy Converts the gathered policy entries of a single sample into a distribution over the legal moves
+ * @param policy Gathered entries which are replaced by the distribution
+ * @param length Number of entries
+ * @param isLogits True, if the entries are logits (softmax is applied), false if they are probabilities (renormalization)
+ */
+void normalize_policy(float* policy, size_t length, bool isLogits);
+
+/**
+ * @brief get_resident_memory_mb Returns the resident memory of the current process in MiB (only available on Linux, 0 otherwise)
+ */
+size_t get_resident_memory_mb();
+
 
 /**
  * @brief The NeuralNetAPI class is an abstract class for accessing a neural network back-end and to run inference
@@ -133,6 +209,33 @@ public:
      */
     virtual void predict(float* inputPlanes, float* valueOutput, float* probOutputs) = 0;
 
+    /**
+     * @brief predict_samples Runs a prediction for the first numberSamples samples of the batch.
+     * Back-ends which support dynamic shapes only compute the filled samples, other back-ends may use the nearest smaller
+     * pre-built batch size or compute the full batch. The outputs of the samples after numberSamples are undefined.
+     * @param numberSamples Number of filled samples in inputPlanes
+     * @return Number of samples which have been computed
+     */
+    virtual size_t predict_samples(float* inputPlanes, float* valueOutput, float* probOutputs, size_t numberSamples);
+
+    /**
+     * @brief predict_sparse Runs a prediction for the first numberSamples samples and only returns the policy of the legal moves.
+     * The given sparse policy receives the softmax over the legal moves of each sample. The default implementation gathers
+     * the entries from the dense output in probOutputs, back-ends which gather internally don't touch probOutputs.
+     * @return Number of samples which have been computed
+     */
+    virtual size_t predict_sparse(float* inputPlanes, float* valueOutput, float* probOutputs, size_t numberSamples, SparsePolicy& sparsePolicy);
+
+    /**
+     * @brief get_output_buffers Returns host buffers owned by the back-end which always hold the outputs of the last prediction.
+     * If the back-end provides these buffers, they should be passed to predict() as output pointers,
+     * so that the back-end doesn't need to copy its outputs after each batch.
+     * @param valueOutput Returns the value buffer
+     * @param probOutputs Returns the policy buffer
+     * @return True, if the back-end provides output buffers, false otherwise (default)
+     */
+    virtual bool get_output_buffers(float*& valueOutput, float*& probOutputs);
+
     unsigned int get_policy_output_length() const;
 
     unsigned int get_batch_size() const;
@@ -24,6 +24,7 @@
  */
 
 #include "neuralnetapiuser.h"
+#include <stdexcept>
 #include "stateobj.h"
 #ifdef TENSORRT
 #include "NvInfer.h"
@@ -32,29 +33,82 @@
 #endif
 
 NeuralNetAPIUser::NeuralNetAPIUser(NeuralNetAPI *net):
-    net(net)
+    net(net),
+    valueOutputs(nullptr),
+    probOutputs(nullptr),
+    ownsOutputs(false),
+    pendingNet(nullptr)
 {
     // allocate memory for all predictions and results
 #ifdef TENSORRT
     CHECK(cudaMallocHost((void**) &inputPlanes, net->get_batch_size() * StateConstants::NB_VALUES_TOTAL() * sizeof(float)));
+#else
+    inputPlanes = new float[net->get_batch_size() * StateConstants::NB_VALUES_TOTAL()];
+#endif
+    allocate_output_buffers();
+}
+
+NeuralNetAPIUser::~NeuralNetAPIUser()
+{
+#ifdef TENSORRT
+    CHECK(cudaFreeHost(inputPlanes));
+#else
+    delete [] inputPlanes;
+#endif
+    free_output_buffers();
+}
+
+void NeuralNetAPIUser::allocate_output_buffers()
+{
+    ownsOutputs = !net->get_output_buffers(valueOutputs, probOutputs);
+    if (!ownsOutputs) {
+        return;
+    }
+#ifdef TENSORRT
     CHECK(cudaMallocHost((void**) &valueOutputs, net->get_batch_size() * sizeof(float)));
     CHECK(cudaMallocHost((void**) &probOutputs, net->get_policy_output_length() * sizeof(float)));
 #else
-    inputPlanes = new float[net->get_batch_size() * StateConstants::NB_VALUES_TOTAL()];
     valueOutputs = new float[net->get_batch_size()];
     probOutputs = new float[net->get_policy_output_length()];
 #endif
 }
 
-NeuralNetAPIUser::~NeuralNetAPIUser()
+void NeuralNetAPIUser::free_output_buffers()
 {
+    if (!ownsOutputs) {
+        return;
+    }
 #ifdef TENSORRT
-    CHECK(cudaFreeHost(inputPlanes));
     CHECK(cudaFreeHost(valueOutputs));
     CHECK(cudaFreeHost(probOutputs));
 #else
-    delete [] inputPlanes;
     delete [] valueOutputs;
     delete [] probOutputs;
 #endif
+    ownsOutputs = false;
+}
+
+void NeuralNetAPIUser::request_net_swap(NeuralNetAPI* newNet)
+{
+    if (newNet->get_batch_size() != net->get_batch_size()) {
+        throw invalid_argument("The new network must use the batch size " + to_string(net->get_batch_size()) +
+                               " but uses " + to_string(newNet->get_batch_size()));
+    }
+    pendingNet = newNet;
+}
+
+void NeuralNetAPIUser::apply_net_swap()
+{
+    if (pendingNet.load(memory_order_relaxed) == nullptr) {
+        return;
+    }
+    NeuralNetAPI* newNet = pendingNet.exchange(nullptr);
+    free_output_buffers();
+    net = newNet;
+    allocate_output_buffers();
+}
+
+bool NeuralNetAPIUser::has_pending_net_swap() const
+{
+    return pendingNet != nullptr;
 }
@@ -28,6 +28,7 @@
 #ifndef NEURALNETAPIUSER_H
 #define NEURALNETAPIUSER_H
 
+#include <atomic>
 #include "neuralnetapi.h"
 
 /**
@@ -43,13 +44,37 @@ protected:
     float* inputPlanes;
     // stores the corresponding value-Outputs and probability-Outputs of the nodes stored in the vector "newNodes"
     // sufficient memory according to the batch-size will be allocated in the constructor
+    // unless the back-end provides its own output buffers
     float* valueOutputs;
     float* probOutputs;
+    bool ownsOutputs;
+    // network which replaces the current one at the next batch boundary (nullptr if no swap has been requested)
+    atomic<NeuralNetAPI*> pendingNet;
+
+    /**
+     * @brief allocate_output_buffers Uses the output buffers of the network or allocates them if the network provides none
+     */
+    void allocate_output_buffers();
+    void free_output_buffers();
 
 public:
     NeuralNetAPIUser(NeuralNetAPI* net);
     ~NeuralNetAPIUser();
     NeuralNetAPIUser(NeuralNetAPIUser&) = delete;
+
+    /**
+     * @brief request_net_swap Requests to replace the neural network by the given one.
+     * The new network must use the same batch size. The swap is performed by apply_net_swap().
+     */
+    void request_net_swap(NeuralNetAPI* newNet);
+
+    /**
+     * @brief apply_net_swap Replaces the neural network if a swap has been requested.
+     * It must only be called when no inference is running, e.g. between two mini-batches.
+     */
+    void apply_net_swap();
+
+    bool has_pending_net_swap() const;
 };
 
 #endif // NEURALNETAPIUSER_H
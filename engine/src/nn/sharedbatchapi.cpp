@@ -0,0 +1,181 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: sharedbatchapi.cpp
+ * Created on 19.10.2026
+ * @author: agent
+ */
+
+#include "sharedbatchapi.h"
+#include <stdexcept>
+#include "stateobj.h"
+#ifdef TENSORRT
+#include "NvInfer.h"
+#include <cuda_runtime_api.h>
+#include "common.h"
+#endif
+
+
+SharedBatchServer::SharedBatchServer(NeuralNetAPI* net, size_t numberClients, size_t maxWaitMicros):
+    net(net),
+    numberClients(numberClients),
+    maxWaitTime(maxWaitMicros),
+    policySize(net->get_policy_output_length() / net->get_batch_size()),
+    filledSamples(0),
+    isEvaluating(false),
+    batchIdx(0),
+    numberBatches(0),
+    numberEvaluatedSamples(0)
+{
+#ifdef TENSORRT
+    CHECK(cudaMallocHost((void**) &inputPlanes, net->get_batch_size() * StateConstants::NB_VALUES_TOTAL() * sizeof(float)));
+#else
+    inputPlanes = new float[net->get_batch_size() * StateConstants::NB_VALUES_TOTAL()];
+#endif
+    ownsOutputs = !net->get_output_buffers(valueOutputs, probOutputs);
+    if (ownsOutputs) {
+        valueOutputs = new float[net->get_batch_size()];
+        probOutputs = new float[net->get_policy_output_length()];
+    }
+    requests.reserve(numberClients);
+}
+
+SharedBatchServer::~SharedBatchServer()
+{
+#ifdef TENSORRT
+    CHECK(cudaFreeHost(inputPlanes));
+#else
+    delete [] inputPlanes;
+#endif
+    if (ownsOutputs) {
+        delete [] valueOutputs;
+        delete [] probOutputs;
+    }
+}
+
+bool SharedBatchServer::is_batch_complete() const
+{
+    return requests.size() >= numberClients || filledSamples == net->get_batch_size();
+}
+
+void SharedBatchServer::predict(const float* clientInputPlanes, float* valueOutput, float* clientProbOutputs, size_t numberSamples)
+{
+    const size_t inputSize = StateConstants::NB_VALUES_TOTAL();
+    unique_lock<mutex> lock(mtx);
+    // wait until the previous batch has been evaluated and there is enough space left in the current batch
+    cv.wait(lock, [&]{ return !isEvaluating && filledSamples + numberSamples <= net->get_batch_size(); });
+    const size_t offset = filledSamples;
+    const size_t curBatchIdx = batchIdx;
+    filledSamples += numberSamples;
+    requests.push_back({valueOutput, clientProbOutputs, offset, numberSamples});
+    copy(clientInputPlanes, clientInputPlanes + numberSamples * inputSize, inputPlanes + offset * inputSize);
+
+    if (requests.size() > 1) {
+        if (is_batch_complete()) {
+            cv.notify_all();
+        }
+        cv.wait(lock, [&]{ return batchIdx != curBatchIdx; });
+        return;
+    }
+
+    // the first client of a batch waits for the remaining clients and evaluates the batch
+    cv.wait_for(lock, maxWaitTime, [&]{ return is_batch_complete(); });
+    isEvaluating = true;
+    lock.unlock();
+
+    // the requests can't be modified while isEvaluating is set
+    net->predict_samples(inputPlanes, valueOutputs, probOutputs, filledSamples);
+    for (const Request& request : requests) {
+        copy(valueOutputs + request.offset, valueOutputs + request.offset + request.numberSamples, request.valueOutput);
+        copy(probOutputs + request.offset * policySize, probOutputs + (request.offset + request.numberSamples) * policySize,
+             request.probOutputs);
+    }
+
+    lock.lock();
+    ++numberBatches;
+    numberEvaluatedSamples += filledSamples;
+    requests.clear();
+    filledSamples = 0;
+    isEvaluating = false;
+    ++batchIdx;
+    lock.unlock();
+    cv.notify_all();
+}
+
+NeuralNetAPI* SharedBatchServer::get_net() const
+{
+    return net;
+}
+
+float SharedBatchServer::get_average_batch_size()
+{
+    lock_guard<mutex> lock(mtx);
+    if (numberBatches == 0) {
+        return 0;
+    }
+    return float(numberEvaluatedSamples) / numberBatches;
+}
+
+SharedBatchAPI::SharedBatchAPI(SharedBatchServer* server, unsigned int batchSize):
+    NeuralNetAPI("shared", 0, batchSize, "./", false),
+    server(server)
+{
+    if (batchSize > server->get_net()->get_batch_size()) {
+        throw invalid_argument("The batch size " + to_string(batchSize) + " of the client exceeds the batch size " +
+                               to_string(server->get_net()->get_batch_size()) + " of the shared network");
+    }
+    modelName = server->get_net()->get_model_name();
+    deviceName = server->get_net()->get_device_name();
+    check_if_policy_map();
+}
+
+void SharedBatchAPI::predict(float* inputPlanes, float* valueOutput, float* probOutputs)
+{
+    server->predict(inputPlanes, valueOutput, probOutputs, batchSize);
+}
+
+size_t SharedBatchAPI::predict_samples(float* inputPlanes, float* valueOutput, float* probOutputs, size_t numberSamples)
+{
+    server->predict(inputPlanes, valueOutput, probOutputs, numberSamples);
+    return numberSamples;
+}
+
+void SharedBatchAPI::load_model()
+{
+    // the model is owned by the network of the server
+}
+
+void SharedBatchAPI::load_parameters()
+{
+    // the parameters are owned by the network of the server
+}
+
+void SharedBatchAPI::bind_executor()
+{
+    // the executor is owned by the network of the server
+}
+
+void SharedBatchAPI::check_if_policy_map()
+{
+    const NeuralNetAPI* net = server->get_net();
+    isPolicyMap = net->is_policy_map();
+    // a policy map network has a larger policy output per sample
+    policyOutputLength = net->get_policy_output_length() / net->get_batch_size() * batchSize;
+}
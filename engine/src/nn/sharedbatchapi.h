@@ -0,0 +1,137 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: sharedbatchapi.h
+ * Created on 19.10.2026
+ * @author: agent
+ *
+ * Batches the predictions of several independent clients (e.g. the search threads of concurrent selfplay games)
+ * into a single prediction of one large network.
+ * Each client is a NeuralNetAPI with a small batch size which forwards its samples to a SharedBatchServer.
+ * The first client of a batch waits until all clients have submitted their samples (or a short timeout has passed),
+ * evaluates the combined batch and copies the outputs back to the clients.
+ */
+
+#ifndef SHAREDBATCHAPI_H
+#define SHAREDBATCHAPI_H
+
+#include <mutex>
+#include <condition_variable>
+#include "neuralnetapi.h"
+
+using namespace std;
+
+/**
+ * @brief The SharedBatchServer class collects the samples of its clients and evaluates them together with the given network
+ */
+class SharedBatchServer
+{
+private:
+    struct Request {
+        float* valueOutput;
+        float* probOutputs;
+        size_t offset;
+        size_t numberSamples;
+    };
+
+    NeuralNetAPI* net;
+    // number of clients which usually submit their samples for each batch
+    size_t numberClients;
+    // maximum time the first client of a batch waits for the remaining clients
+    chrono::microseconds maxWaitTime;
+    size_t policySize;
+
+    float* inputPlanes;
+    float* valueOutputs;
+    float* probOutputs;
+    bool ownsOutputs;
+
+    vector<Request> requests;
+    size_t filledSamples;
+    bool isEvaluating;
+    size_t batchIdx;
+    mutex mtx;
+    condition_variable cv;
+
+    // statistics
+    size_t numberBatches;
+    size_t numberEvaluatedSamples;
+
+    /**
+     * @brief is_batch_complete Returns true if all clients have submitted their samples or the batch is full
+     */
+    bool is_batch_complete() const;
+
+public:
+    /**
+     * @brief SharedBatchServer
+     * @param net Network which evaluates the combined batch. Its batch size must be at least the sum of the batch sizes of the clients
+     * @param numberClients Number of clients which submit their samples for each batch
+     * @param maxWaitMicros Maximum time in microseconds the first client of a batch waits for the remaining clients
+     */
+    SharedBatchServer(NeuralNetAPI* net, size_t numberClients, size_t maxWaitMicros=1000);
+    ~SharedBatchServer();
+    SharedBatchServer(const SharedBatchServer&) = delete;
+    SharedBatchServer& operator=(const SharedBatchServer&) = delete;
+
+    /**
+     * @brief predict Adds the samples to the current batch and returns after the batch has been evaluated
+     * @param inputPlanes Input planes of the samples
+     * @param valueOutput Receives the value outputs of the samples
+     * @param probOutputs Receives the policy outputs of the samples
+     * @param numberSamples Number of samples
+     */
+    void predict(const float* inputPlanes, float* valueOutput, float* probOutputs, size_t numberSamples);
+
+    NeuralNetAPI* get_net() const;
+
+    /**
+     * @brief get_average_batch_size Returns the average number of samples which were evaluated in a single batch
+     */
+    float get_average_batch_size();
+};
+
+/**
+ * @brief The SharedBatchAPI class is a NeuralNetAPI client which forwards all predictions to a SharedBatchServer
+ */
+class SharedBatchAPI : public NeuralNetAPI
+{
+private:
+    SharedBatchServer* server;
+
+public:
+    /**
+     * @brief SharedBatchAPI
+     * @param server Server which evaluates the samples
+     * @param batchSize Batch size of the client
+     */
+    SharedBatchAPI(SharedBatchServer* server, unsigned int batchSize);
+
+    void predict(float* inputPlanes, float* valueOutput, float* probOutputs) override;
+    size_t predict_samples(float* inputPlanes, float* valueOutput, float* probOutputs, size_t numberSamples) override;
+
+protected:
+    void load_model() override;
+    void load_parameters() override;
+    void bind_executor() override;
+    void check_if_policy_map() override;
+};
+
+#endif // SHAREDBATCHAPI_H
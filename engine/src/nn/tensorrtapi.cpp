@@ -65,7 +65,10 @@ TensorrtAPI::~TensorrtAPI()
 void TensorrtAPI::load_model()
 {
     // load an engine from file or build an engine from the ONNX network
-    engine = shared_ptr<nvinfer1::ICudaEngine>(get_cuda_engine(), samplesCommon::InferDeleter());
+    // the engine is shared between all objects with the same batch size, precision and device; each object creates its own context
+    engine = get_shared_model<nvinfer1::ICudaEngine>(trtFilePath, [&]() {
+        return shared_ptr<nvinfer1::ICudaEngine>(get_cuda_engine(), samplesCommon::InferDeleter());
+    });
     idxInput = engine->getBindingIndex("data");
 #ifdef MODE_CRAZYHOUSE
     idxValueOutput = engine->getBindingIndex("value_tanh0");
@@ -46,27 +46,49 @@ TorchAPI::TorchAPI(const string& ctx, int deviceID, unsigned int miniBatchSize,
 
 void TorchAPI::predict(float *inputPlanes, float *valueOutput, float *probOutputs)
 {
+    predict_samples(inputPlanes, valueOutput, probOutputs, batchSize);
+}
+
+size_t TorchAPI::predict_samples(float* inputPlanes, float* valueOutput, float* probOutputs, size_t numberSamples)
+{
+    // use the smallest pre-built batch size which holds all filled samples
+    const auto it = modules.lower_bound(numberSamples);
+    const size_t curBatchSize = it != modules.end() ? it->first : batchSize;
+    torch::jit::script::Module* curModule = it != modules.end() ? it->second.get() : module.get();
+
     // Create a vector of inputs.
-    std::vector<torch::jit::IValue> inputs = {torch::from_blob(inputPlanes, {batchSize, StateConstants::NB_CHANNELS_TOTAL(), StateConstants::BOARD_HEIGHT(), StateConstants::BOARD_WIDTH()}, device)};
+    std::vector<torch::jit::IValue> inputs = {torch::from_blob(inputPlanes, {int64_t(curBatchSize), StateConstants::NB_CHANNELS_TOTAL(), StateConstants::BOARD_HEIGHT(), StateConstants::BOARD_WIDTH()}, device)};
 
     // Execute the model and turn its output into a tensor.
-    auto output = module.forward(inputs).toList();
+    auto output = curModule->forward(inputs).toList();
 
     const float* torchValuePt = output.get(0).toTensor().data_ptr<float>();
-    std::copy(torchValuePt, torchValuePt+batchSize, valueOutput);
+    std::copy(torchValuePt, torchValuePt+curBatchSize, valueOutput);
     const float* torchPolicyPt = output.get(1).toTensor().data_ptr<float>();
-    std::copy(torchPolicyPt, torchPolicyPt+policyOutputLength, probOutputs);
+    std::copy(torchPolicyPt, torchPolicyPt+policyOutputLength/batchSize*curBatchSize, probOutputs);
+    return curBatchSize;
+}
+
+shared_ptr<torch::jit::script::Module> TorchAPI::load_module(const string& filePath)
+{
+    return get_shared_model<torch::jit::script::Module>(filePath + ":" + deviceName, [&]() {
+        // deserialize the ScriptModule from a file, a c10::Error is propagated so that no empty module is cached
+        return make_shared<torch::jit::script::Module>(torch::jit::load(filePath, device));
+    });
 }
 
 void TorchAPI::load_model()
 {
-    try {
-      // Deserialize the ScriptModule from a file using torch::jit::load().
-      module = torch::jit::load(modelFilePath, device);
-    }
-    catch (const c10::Error& e) {
-      std::cerr << "error loading the model: " <<  modelFilePath << std::endl;
+    module = load_module(modelFilePath);
+    modules[batchSize] = module;
+    // smaller pre-built batch sizes are optional
+    for (size_t curBatchSize = 1; curBatchSize < batchSize; ++curBatchSize) {
+        const string filePath = modelDir + "model-bsize-" + to_string(curBatchSize) + ".pt";
+        if (file_exists(filePath)) {
+            modules[curBatchSize] = load_module(filePath);
+        }
     }
+    info_string("pre-built batch sizes:", modules.size());
 }
 
 void TorchAPI::load_parameters()
@@ -86,7 +108,7 @@ void TorchAPI::check_if_policy_map()
     // Create a vector of inputs.
     std::vector<torch::jit::IValue> inputs = {torch::from_blob(inputPlanes, {batchSize, StateConstants::NB_CHANNELS_TOTAL(), StateConstants::BOARD_HEIGHT(), StateConstants::BOARD_WIDTH()}, device)};
 
-    auto output = module.forward(inputs).toList();
+    auto output = module->forward(inputs).toList();
     auto probOutputs = output.get(1).toTensor();
 
     isPolicyMap = probOutputs.size(1) != StateConstants::NB_LABELS();
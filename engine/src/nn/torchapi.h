@@ -32,6 +32,7 @@
 #define TORCHAPI_H
 
 #include "neuralnetapi.h"
+#include <map>
 #include <torch/script.h>
 
 /**
@@ -40,13 +41,22 @@
 class TorchAPI : public NeuralNetAPI
 {
 private:
-    torch::jit::script::Module module;
+    // the module is shared between all objects which use the same model file and device
+    std::shared_ptr<torch::jit::script::Module> module;
+    // modules of all pre-built batch sizes up to the batch size, which are used for partially filled batches
+    std::map<size_t, std::shared_ptr<torch::jit::script::Module>> modules;
     torch::Device device;
+
+    /**
+     * @brief load_module Loads the torchscript module of the given file or returns the already loaded module
+     */
+    std::shared_ptr<torch::jit::script::Module> load_module(const string& filePath);
 public:
     TorchAPI(const string& ctx, int deviceID, unsigned int miniBatchSize, const string& modelDirectory);
 
     // NeuralNetAPI interface
     void predict(float *inputPlanes, float *valueOutput, float *probOutputs) override;
+    size_t predict_samples(float* inputPlanes, float* valueOutput, float* probOutputs, size_t numberSamples) override;
 
 protected:
     void load_model() override;
@@ -0,0 +1,628 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: cpukernels.cpp
+ * Created on 19.10.2026
+ * @author: agent
+ */
+
+#include "cpukernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// wrappers for the vector registers of the active instruction set
+#if defined(__AVX512F__)
+typedef __m512 VecFloat;
+const size_t SIMD_WIDTH = 16;
+inline VecFloat vec_zero() { return _mm512_setzero_ps(); }
+inline VecFloat vec_set1(float value) { return _mm512_set1_ps(value); }
+inline VecFloat vec_load(const float* data) { return _mm512_loadu_ps(data); }
+inline void vec_store(float* data, VecFloat value) { _mm512_storeu_ps(data, value); }
+inline VecFloat vec_add(VecFloat a, VecFloat b) { return _mm512_add_ps(a, b); }
+// _mm512_max_ps() passes an undefined source to the masked builtin, which GCC reports as maybe uninitialized
+inline VecFloat vec_max(VecFloat a, VecFloat b) { return _mm512_mask_max_ps(a, __mmask16(0xFFFF), a, b); }
+inline VecFloat vec_fmadd(VecFloat a, VecFloat b, VecFloat c) { return _mm512_fmadd_ps(a, b, c); }
+#elif defined(__AVX2__) && defined(__FMA__)
+typedef __m256 VecFloat;
+const size_t SIMD_WIDTH = 8;
+inline VecFloat vec_zero() { return _mm256_setzero_ps(); }
+inline VecFloat vec_set1(float value) { return _mm256_set1_ps(value); }
+inline VecFloat vec_load(const float* data) { return _mm256_loadu_ps(data); }
+inline void vec_store(float* data, VecFloat value) { _mm256_storeu_ps(data, value); }
+inline VecFloat vec_add(VecFloat a, VecFloat b) { return _mm256_add_ps(a, b); }
+inline VecFloat vec_max(VecFloat a, VecFloat b) { return _mm256_max_ps(a, b); }
+inline VecFloat vec_fmadd(VecFloat a, VecFloat b, VecFloat c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+typedef float VecFloat;
+const size_t SIMD_WIDTH = 1;
+inline VecFloat vec_zero() { return 0.0f; }
+inline VecFloat vec_set1(float value) { return value; }
+inline VecFloat vec_load(const float* data) { return *data; }
+inline void vec_store(float* data, VecFloat value) { *data = value; }
+inline VecFloat vec_add(VecFloat a, VecFloat b) { return a + b; }
+inline VecFloat vec_max(VecFloat a, VecFloat b) { return max(a, b); }
+inline VecFloat vec_fmadd(VecFloat a, VecFloat b, VecFloat c) { return a * b + c; }
+#endif
+
+// number of output pixels and output channel vectors which are computed at once by the convolution micro kernel
+const size_t PIXEL_BLOCK = 4;
+const size_t VECTOR_BLOCK = 2;
+
+// number of consecutive input channels which are multiplied at once and number of output channels per int8 vector
+#if defined(__AVX512F__) && defined(__AVX512VNNI__)
+const size_t INT8_GROUP = 4;
+const size_t INT8_LANES = 16;
+#else
+const size_t INT8_GROUP = 2;
+const size_t INT8_LANES = 8;
+#endif
+// offset which turns the signed quantized activations into unsigned values
+const int32_t INT8_OFFSET = 128;
+
+const char* simd_instruction_set()
+{
+#if defined(__AVX512F__)
+    return "avx512";
+#elif defined(__AVX2__) && defined(__FMA__)
+    return "avx2";
+#else
+    return "generic";
+#endif
+}
+
+const char* int8_instruction_set()
+{
+#if defined(__AVX512F__) && defined(__AVX512VNNI__)
+    return "avx512vnni";
+#elif defined(__AVX2__)
+    return "avx2";
+#else
+    return "generic";
+#endif
+}
+
+inline size_t round_up(size_t value, size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+inline void store_output(float* output, VecFloat value, const float* residual, bool relu)
+{
+    if (residual != nullptr) {
+        value = vec_add(value, vec_load(residual));
+    }
+    if (relu) {
+        value = vec_max(value, vec_zero());
+    }
+    vec_store(output, value);
+}
+
+inline float apply_epilogue(float value, const float* residual, bool relu)
+{
+    if (residual != nullptr) {
+        value += *residual;
+    }
+    return relu ? max(value, 0.0f) : value;
+}
+
+/**
+ * @brief conv_block Computes P consecutive output pixels of a row for V vectors of output channels.
+ * All pointers are already offset to the first pixel and first output channel of the block.
+ */
+template<size_t P, size_t V>
+inline void conv_block(const float* input, const float* weights, const float* bias, const float* residual, float* output,
+                       size_t paddedWidth, size_t inChannels, size_t outChannels, size_t kernelH, size_t kernelW, bool relu)
+{
+    VecFloat acc[P][V];
+    for (size_t p = 0; p < P; ++p) {
+        for (size_t v = 0; v < V; ++v) {
+            acc[p][v] = vec_load(bias + v * SIMD_WIDTH);
+        }
+    }
+    for (size_t ky = 0; ky < kernelH; ++ky) {
+        for (size_t kx = 0; kx < kernelW; ++kx) {
+            const float* in = input + (ky * paddedWidth + kx) * inChannels;
+            const float* w = weights + (ky * kernelW + kx) * inChannels * outChannels;
+            for (size_t ci = 0; ci < inChannels; ++ci) {
+                VecFloat weightVec[V];
+                for (size_t v = 0; v < V; ++v) {
+                    weightVec[v] = vec_load(w + ci * outChannels + v * SIMD_WIDTH);
+                }
+                for (size_t p = 0; p < P; ++p) {
+                    const VecFloat inputVec = vec_set1(in[p * inChannels + ci]);
+                    for (size_t v = 0; v < V; ++v) {
+                        acc[p][v] = vec_fmadd(inputVec, weightVec[v], acc[p][v]);
+                    }
+                }
+            }
+        }
+    }
+    for (size_t p = 0; p < P; ++p) {
+        for (size_t v = 0; v < V; ++v) {
+            store_output(output + p * outChannels + v * SIMD_WIDTH, acc[p][v],
+                         residual != nullptr ? residual + p * outChannels + v * SIMD_WIDTH : nullptr, relu);
+        }
+    }
+}
+
+/**
+ * @brief conv_pixels Computes P consecutive output pixels for all output channels
+ */
+template<size_t P>
+inline void conv_pixels(const float* input, const float* weights, const float* bias, const float* residual, float* output,
+                        size_t paddedWidth, size_t inChannels, size_t outChannels, size_t kernelH, size_t kernelW, bool relu)
+{
+    size_t co = 0;
+    for (; co + VECTOR_BLOCK * SIMD_WIDTH <= outChannels; co += VECTOR_BLOCK * SIMD_WIDTH) {
+        conv_block<P, VECTOR_BLOCK>(input, weights + co, bias + co, residual != nullptr ? residual + co : nullptr, output + co,
+                                    paddedWidth, inChannels, outChannels, kernelH, kernelW, relu);
+    }
+    for (; co + SIMD_WIDTH <= outChannels; co += SIMD_WIDTH) {
+        conv_block<P, 1>(input, weights + co, bias + co, residual != nullptr ? residual + co : nullptr, output + co,
+                         paddedWidth, inChannels, outChannels, kernelH, kernelW, relu);
+    }
+    // remaining output channels which don't fill a full vector
+    for (; co < outChannels; ++co) {
+        for (size_t p = 0; p < P; ++p) {
+            float sum = bias[co];
+            for (size_t ky = 0; ky < kernelH; ++ky) {
+                for (size_t kx = 0; kx < kernelW; ++kx) {
+                    const float* in = input + (ky * paddedWidth + kx + p) * inChannels;
+                    const float* w = weights + (ky * kernelW + kx) * inChannels * outChannels + co;
+                    for (size_t ci = 0; ci < inChannels; ++ci) {
+                        sum += in[ci] * w[ci * outChannels];
+                    }
+                }
+            }
+            output[p * outChannels + co] = apply_epilogue(sum, residual != nullptr ? residual + p * outChannels + co : nullptr, relu);
+        }
+    }
+}
+
+/**
+ * @brief pad_input Copies the input into the workspace with zero padding around each sample.
+ * Returns the input itself if no padding is required.
+ */
+const float* pad_input(const float* input, vector<float>& workspace, size_t batchSize, size_t height, size_t width,
+                       size_t channels, const size_t pads[4])
+{
+    if (pads[0] == 0 && pads[1] == 0 && pads[2] == 0 && pads[3] == 0) {
+        return input;
+    }
+    const size_t paddedHeight = height + pads[0] + pads[2];
+    const size_t paddedWidth = width + pads[1] + pads[3];
+    const size_t paddedSize = batchSize * paddedHeight * paddedWidth * channels;
+    if (workspace.size() < paddedSize) {
+        workspace.resize(paddedSize);
+    }
+    fill(workspace.begin(), workspace.begin() + paddedSize, 0.0f);
+    for (size_t n = 0; n < batchSize; ++n) {
+        for (size_t y = 0; y < height; ++y) {
+            memcpy(workspace.data() + ((n * paddedHeight + y + pads[0]) * paddedWidth + pads[1]) * channels,
+                   input + (n * height + y) * width * channels, width * channels * sizeof(float));
+        }
+    }
+    return workspace.data();
+}
+
+void conv2d_nhwc(const float* input, const float* weights, const float* bias, const float* residual, float* output,
+                 vector<float>& workspace, size_t batchSize, size_t height, size_t width, size_t inChannels, size_t outChannels,
+                 size_t kernelH, size_t kernelW, const size_t pads[4], bool relu)
+{
+    const size_t paddedHeight = height + pads[0] + pads[2];
+    const size_t paddedWidth = width + pads[1] + pads[3];
+    const size_t outHeight = paddedHeight - kernelH + 1;
+    const size_t outWidth = paddedWidth - kernelW + 1;
+    const float* paddedInput = pad_input(input, workspace, batchSize, height, width, inChannels, pads);
+
+    for (size_t n = 0; n < batchSize; ++n) {
+        for (size_t oy = 0; oy < outHeight; ++oy) {
+            const float* inRow = paddedInput + (n * paddedHeight + oy) * paddedWidth * inChannels;
+            const size_t outOffset = (n * outHeight + oy) * outWidth * outChannels;
+            const float* resRow = residual != nullptr ? residual + outOffset : nullptr;
+            float* outRow = output + outOffset;
+            size_t ox = 0;
+            for (; ox + PIXEL_BLOCK <= outWidth; ox += PIXEL_BLOCK) {
+                conv_pixels<PIXEL_BLOCK>(inRow + ox * inChannels, weights, bias, resRow != nullptr ? resRow + ox * outChannels : nullptr,
+                                         outRow + ox * outChannels, paddedWidth, inChannels, outChannels, kernelH, kernelW, relu);
+            }
+            for (; ox < outWidth; ++ox) {
+                conv_pixels<1>(inRow + ox * inChannels, weights, bias, resRow != nullptr ? resRow + ox * outChannels : nullptr,
+                               outRow + ox * outChannels, paddedWidth, inChannels, outChannels, kernelH, kernelW, relu);
+            }
+        }
+    }
+}
+
+void quantize_weights_int8(const float* weights, size_t kernelSize, size_t inChannels, size_t outChannels,
+                           vector<int8_t>& weightsInt8, vector<float>& weightScales, vector<int32_t>& compensation)
+{
+    const size_t groups = round_up(inChannels, INT8_GROUP) / INT8_GROUP;
+    const size_t outChannelsPadded = round_up(outChannels, INT8_LANES);
+    weightsInt8.assign(kernelSize * groups * outChannelsPadded * INT8_GROUP, 0);
+    weightScales.assign(outChannels, 1.0f);
+    compensation.assign(outChannels, 0);
+
+    for (size_t co = 0; co < outChannels; ++co) {
+        float maxValue = 0;
+        for (size_t idx = co; idx < kernelSize * inChannels * outChannels; idx += outChannels) {
+            maxValue = max(maxValue, abs(weights[idx]));
+        }
+        if (maxValue > 0) {
+            weightScales[co] = maxValue / 127;
+        }
+        for (size_t k = 0; k < kernelSize; ++k) {
+            for (size_t ci = 0; ci < inChannels; ++ci) {
+                const float value = weights[(k * inChannels + ci) * outChannels + co] / weightScales[co];
+                const int8_t quantized = int8_t(max(-127.0f, min(127.0f, round(value))));
+                weightsInt8[((k * groups + ci / INT8_GROUP) * outChannelsPadded + co) * INT8_GROUP + ci % INT8_GROUP] = quantized;
+                compensation[co] += INT8_OFFSET * quantized;
+            }
+        }
+    }
+}
+
+/**
+ * @brief conv_block_int8 Computes the int32 accumulators for P consecutive output pixels and INT8_LANES output channels
+ * @param input Quantized input at the first pixel of the block
+ * @param weights Quantized weights at the first output channel of the block
+ * @param acc Accumulators of shape [P, INT8_LANES]
+ */
+template<size_t P>
+inline void conv_block_int8(const uint8_t* input, const int8_t* weights, int32_t* acc, size_t paddedWidth, size_t groups,
+                            size_t outChannelsPadded, size_t kernelH, size_t kernelW)
+{
+    const size_t inChannels = groups * INT8_GROUP;
+    const size_t groupStride = outChannelsPadded * INT8_GROUP;
+#if defined(__AVX512F__) && defined(__AVX512VNNI__)
+    __m512i sum[P];
+    for (size_t p = 0; p < P; ++p) {
+        sum[p] = _mm512_setzero_si512();
+    }
+    for (size_t ky = 0; ky < kernelH; ++ky) {
+        for (size_t kx = 0; kx < kernelW; ++kx) {
+            const uint8_t* in = input + (ky * paddedWidth + kx) * inChannels;
+            const int8_t* w = weights + (ky * kernelW + kx) * groups * groupStride;
+            for (size_t g = 0; g < groups; ++g) {
+                const __m512i weightVec = _mm512_loadu_si512(w + g * groupStride);
+                for (size_t p = 0; p < P; ++p) {
+                    int32_t inputGroup;
+                    memcpy(&inputGroup, in + p * inChannels + g * INT8_GROUP, sizeof(int32_t));
+                    sum[p] = _mm512_dpbusd_epi32(sum[p], _mm512_set1_epi32(inputGroup), weightVec);
+                }
+            }
+        }
+    }
+    for (size_t p = 0; p < P; ++p) {
+        _mm512_storeu_si512(acc + p * INT8_LANES, sum[p]);
+    }
+#elif defined(__AVX2__)
+    __m256i sum[P];
+    for (size_t p = 0; p < P; ++p) {
+        sum[p] = _mm256_setzero_si256();
+    }
+    for (size_t ky = 0; ky < kernelH; ++ky) {
+        for (size_t kx = 0; kx < kernelW; ++kx) {
+            const uint8_t* in = input + (ky * paddedWidth + kx) * inChannels;
+            const int8_t* w = weights + (ky * kernelW + kx) * groups * groupStride;
+            for (size_t g = 0; g < groups; ++g) {
+                // the 16 bit products of an unsigned and a signed 8 bit value can't saturate
+                const __m256i weightVec = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(w + g * groupStride)));
+                for (size_t p = 0; p < P; ++p) {
+                    const uint8_t* inputGroup = in + p * inChannels + g * INT8_GROUP;
+                    const __m256i inputVec = _mm256_set1_epi32(int32_t(inputGroup[0]) | (int32_t(inputGroup[1]) << 16));
+                    sum[p] = _mm256_add_epi32(sum[p], _mm256_madd_epi16(inputVec, weightVec));
+                }
+            }
+        }
+    }
+    for (size_t p = 0; p < P; ++p) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + p * INT8_LANES), sum[p]);
+    }
+#else
+    fill(acc, acc + P * INT8_LANES, 0);
+    for (size_t ky = 0; ky < kernelH; ++ky) {
+        for (size_t kx = 0; kx < kernelW; ++kx) {
+            const uint8_t* in = input + (ky * paddedWidth + kx) * inChannels;
+            const int8_t* w = weights + (ky * kernelW + kx) * groups * groupStride;
+            for (size_t g = 0; g < groups; ++g) {
+                for (size_t p = 0; p < P; ++p) {
+                    for (size_t lane = 0; lane < INT8_LANES; ++lane) {
+                        for (size_t j = 0; j < INT8_GROUP; ++j) {
+                            acc[p * INT8_LANES + lane] += int32_t(in[p * inChannels + g * INT8_GROUP + j]) *
+                                    w[g * groupStride + lane * INT8_GROUP + j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+#endif
+}
+
+template<size_t P>
+inline void conv_pixels_int8(const uint8_t* input, const int8_t* weights, const float* outputScales, const int32_t* compensation,
+                             const float* bias, const float* residual, float* output, size_t paddedWidth, size_t groups,
+                             size_t outChannels, size_t kernelH, size_t kernelW, bool relu)
+{
+    const size_t outChannelsPadded = round_up(outChannels, INT8_LANES);
+    int32_t acc[P * INT8_LANES];
+    for (size_t co = 0; co < outChannelsPadded; co += INT8_LANES) {
+        conv_block_int8<P>(input, weights + co * INT8_GROUP, acc, paddedWidth, groups, outChannelsPadded, kernelH, kernelW);
+        const size_t lanes = min(INT8_LANES, outChannels - co);
+        for (size_t p = 0; p < P; ++p) {
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                const size_t c = co + lane;
+                const float value = float(acc[p * INT8_LANES + lane] - compensation[c]) * outputScales[c] + bias[c];
+                output[p * outChannels + c] = apply_epilogue(value, residual != nullptr ? residual + p * outChannels + c : nullptr, relu);
+            }
+        }
+    }
+}
+
+void conv2d_nhwc_int8(const float* input, float inputScale, const int8_t* weights, const float* outputScales, const int32_t* compensation,
+                      const float* bias, const float* residual, float* output, vector<uint8_t>& workspace,
+                      size_t batchSize, size_t height, size_t width, size_t inChannels, size_t outChannels,
+                      size_t kernelH, size_t kernelW, const size_t pads[4], bool relu)
+{
+    const size_t paddedHeight = height + pads[0] + pads[2];
+    const size_t paddedWidth = width + pads[1] + pads[3];
+    const size_t outHeight = paddedHeight - kernelH + 1;
+    const size_t outWidth = paddedWidth - kernelW + 1;
+    const size_t inChannelsPadded = round_up(inChannels, INT8_GROUP);
+    const size_t groups = inChannelsPadded / INT8_GROUP;
+
+    // quantize the input into unsigned values, zero padding corresponds to the offset
+    const size_t paddedSize = batchSize * paddedHeight * paddedWidth * inChannelsPadded;
+    if (workspace.size() < paddedSize) {
+        workspace.resize(paddedSize);
+    }
+    fill(workspace.begin(), workspace.begin() + paddedSize, uint8_t(INT8_OFFSET));
+    const float invScale = 1.0f / inputScale;
+    for (size_t n = 0; n < batchSize; ++n) {
+        for (size_t y = 0; y < height; ++y) {
+            for (size_t x = 0; x < width; ++x) {
+                const float* in = input + ((n * height + y) * width + x) * inChannels;
+                uint8_t* out = workspace.data() + ((n * paddedHeight + y + pads[0]) * paddedWidth + x + pads[1]) * inChannelsPadded;
+                for (size_t c = 0; c < inChannels; ++c) {
+                    out[c] = uint8_t(int32_t(max(-127.0f, min(127.0f, round(in[c] * invScale)))) + INT8_OFFSET);
+                }
+            }
+        }
+    }
+
+    for (size_t n = 0; n < batchSize; ++n) {
+        for (size_t oy = 0; oy < outHeight; ++oy) {
+            const uint8_t* inRow = workspace.data() + (n * paddedHeight + oy) * paddedWidth * inChannelsPadded;
+            const size_t outOffset = (n * outHeight + oy) * outWidth * outChannels;
+            const float* resRow = residual != nullptr ? residual + outOffset : nullptr;
+            float* outRow = output + outOffset;
+            size_t ox = 0;
+            for (; ox + PIXEL_BLOCK <= outWidth; ox += PIXEL_BLOCK) {
+                conv_pixels_int8<PIXEL_BLOCK>(inRow + ox * inChannelsPadded, weights, outputScales, compensation, bias,
+                                              resRow != nullptr ? resRow + ox * outChannels : nullptr, outRow + ox * outChannels,
+                                              paddedWidth, groups, outChannels, kernelH, kernelW, relu);
+            }
+            for (; ox < outWidth; ++ox) {
+                conv_pixels_int8<1>(inRow + ox * inChannelsPadded, weights, outputScales, compensation, bias,
+                                    resRow != nullptr ? resRow + ox * outChannels : nullptr, outRow + ox * outChannels,
+                                    paddedWidth, groups, outChannels, kernelH, kernelW, relu);
+            }
+        }
+    }
+}
+
+float max_abs(const float* data, size_t length)
+{
+    float maxValue = 0;
+    for (size_t idx = 0; idx < length; ++idx) {
+        maxValue = max(maxValue, abs(data[idx]));
+    }
+    return maxValue;
+}
+
+void depthwise_conv2d_nhwc(const float* input, const float* weights, const float* bias, const float* residual, float* output,
+                           vector<float>& workspace, size_t batchSize, size_t height, size_t width, size_t channels,
+                           size_t kernelH, size_t kernelW, const size_t pads[4], bool relu)
+{
+    const size_t paddedHeight = height + pads[0] + pads[2];
+    const size_t paddedWidth = width + pads[1] + pads[3];
+    const size_t outHeight = paddedHeight - kernelH + 1;
+    const size_t outWidth = paddedWidth - kernelW + 1;
+    const float* paddedInput = pad_input(input, workspace, batchSize, height, width, channels, pads);
+
+    for (size_t n = 0; n < batchSize; ++n) {
+        for (size_t oy = 0; oy < outHeight; ++oy) {
+            for (size_t ox = 0; ox < outWidth; ++ox) {
+                const float* in = paddedInput + ((n * paddedHeight + oy) * paddedWidth + ox) * channels;
+                const size_t outOffset = ((n * outHeight + oy) * outWidth + ox) * channels;
+                const float* res = residual != nullptr ? residual + outOffset : nullptr;
+                float* out = output + outOffset;
+                size_t c = 0;
+                for (; c + SIMD_WIDTH <= channels; c += SIMD_WIDTH) {
+                    VecFloat acc = vec_load(bias + c);
+                    for (size_t ky = 0; ky < kernelH; ++ky) {
+                        for (size_t kx = 0; kx < kernelW; ++kx) {
+                            acc = vec_fmadd(vec_load(in + (ky * paddedWidth + kx) * channels + c),
+                                            vec_load(weights + (ky * kernelW + kx) * channels + c), acc);
+                        }
+                    }
+                    store_output(out + c, acc, res != nullptr ? res + c : nullptr, relu);
+                }
+                for (; c < channels; ++c) {
+                    float sum = bias[c];
+                    for (size_t ky = 0; ky < kernelH; ++ky) {
+                        for (size_t kx = 0; kx < kernelW; ++kx) {
+                            sum += in[(ky * paddedWidth + kx) * channels + c] * weights[(ky * kernelW + kx) * channels + c];
+                        }
+                    }
+                    out[c] = apply_epilogue(sum, res != nullptr ? res + c : nullptr, relu);
+                }
+            }
+        }
+    }
+}
+
+void fully_connected(const float* input, const float* weights, const float* bias, float* output,
+                     size_t batchSize, size_t inFeatures, size_t outFeatures, bool relu)
+{
+    // a dense layer is a 1x1 convolution in which the samples of the batch are treated as the pixels of a single row
+    const size_t pads[4] = {0, 0, 0, 0};
+    vector<float> unusedWorkspace;
+    conv2d_nhwc(input, weights, bias, nullptr, output, unusedWorkspace, 1, 1, batchSize, inFeatures, outFeatures, 1, 1, pads, relu);
+}
+
+void channel_affine(const float* input, const float* scale, const float* shift, float* output,
+                    size_t numberPixels, size_t channels, bool relu)
+{
+    for (size_t pixel = 0; pixel < numberPixels; ++pixel) {
+        const float* in = input + pixel * channels;
+        float* out = output + pixel * channels;
+        for (size_t c = 0; c < channels; ++c) {
+            const float value = in[c] * scale[c] + shift[c];
+            out[c] = relu ? max(value, 0.0f) : value;
+        }
+    }
+}
+
+void add_tensors(const float* inputA, const float* inputB, float* output, size_t length, bool relu)
+{
+    if (relu) {
+        for (size_t idx = 0; idx < length; ++idx) {
+            output[idx] = max(inputA[idx] + inputB[idx], 0.0f);
+        }
+        return;
+    }
+    for (size_t idx = 0; idx < length; ++idx) {
+        output[idx] = inputA[idx] + inputB[idx];
+    }
+}
+
+void multiply_tensors(const float* inputA, const float* inputB, float* output, size_t length)
+{
+    for (size_t idx = 0; idx < length; ++idx) {
+        output[idx] = inputA[idx] * inputB[idx];
+    }
+}
+
+void scale_channels(const float* input, const float* scale, float* output, size_t batchSize, size_t spatialSize, size_t channels)
+{
+    for (size_t n = 0; n < batchSize; ++n) {
+        const float* sampleScale = scale + n * channels;
+        for (size_t pixel = 0; pixel < spatialSize; ++pixel) {
+            const size_t offset = (n * spatialSize + pixel) * channels;
+            multiply_tensors(input + offset, sampleScale, output + offset, channels);
+        }
+    }
+}
+
+void global_avg_pool_nhwc(const float* input, float* output, size_t batchSize, size_t spatialSize, size_t channels)
+{
+    for (size_t n = 0; n < batchSize; ++n) {
+        float* out = output + n * channels;
+        fill(out, out + channels, 0.0f);
+        for (size_t pixel = 0; pixel < spatialSize; ++pixel) {
+            const float* in = input + (n * spatialSize + pixel) * channels;
+            for (size_t c = 0; c < channels; ++c) {
+                out[c] += in[c];
+            }
+        }
+        for (size_t c = 0; c < channels; ++c) {
+            out[c] /= spatialSize;
+        }
+    }
+}
+
+void relu_activation(const float* input, float* output, size_t length)
+{
+    for (size_t idx = 0; idx < length; ++idx) {
+        output[idx] = max(input[idx], 0.0f);
+    }
+}
+
+void sigmoid_activation(const float* input, float* output, size_t length)
+{
+    for (size_t idx = 0; idx < length; ++idx) {
+        output[idx] = 1.0f / (1.0f + exp(-input[idx]));
+    }
+}
+
+void tanh_activation(const float* input, float* output, size_t length)
+{
+    for (size_t idx = 0; idx < length; ++idx) {
+        output[idx] = std::tanh(input[idx]);
+    }
+}
+
+void softmax(const float* input, float* output, size_t batchSize, size_t length)
+{
+    for (size_t n = 0; n < batchSize; ++n) {
+        const float* in = input + n * length;
+        float* out = output + n * length;
+        const float maxValue = *max_element(in, in + length);
+        float sum = 0;
+        for (size_t idx = 0; idx < length; ++idx) {
+            out[idx] = exp(in[idx] - maxValue);
+            sum += out[idx];
+        }
+        for (size_t idx = 0; idx < length; ++idx) {
+            out[idx] /= sum;
+        }
+    }
+}
+
+void nchw_to_nhwc(const float* input, float* output, size_t batchSize, size_t channels, size_t spatialSize)
+{
+    for (size_t n = 0; n < batchSize; ++n) {
+        const float* in = input + n * channels * spatialSize;
+        float* out = output + n * channels * spatialSize;
+        for (size_t c = 0; c < channels; ++c) {
+            for (size_t pixel = 0; pixel < spatialSize; ++pixel) {
+                out[pixel * channels + c] = in[c * spatialSize + pixel];
+            }
+        }
+    }
+}
+
+void nhwc_to_nchw(const float* input, float* output, size_t batchSize, size_t channels, size_t spatialSize)
+{
+    for (size_t n = 0; n < batchSize; ++n) {
+        const float* in = input + n * channels * spatialSize;
+        float* out = output + n * channels * spatialSize;
+        for (size_t pixel = 0; pixel < spatialSize; ++pixel) {
+            for (size_t c = 0; c < channels; ++c) {
+                out[c * spatialSize + pixel] = in[pixel * channels + c];
+            }
+        }
+    }
+}
+
+void concat_channels(const float* inputA, const float* inputB, float* output, size_t numberPixels, size_t channelsA, size_t channelsB)
+{
+    for (size_t pixel = 0; pixel < numberPixels; ++pixel) {
+        float* out = output + pixel * (channelsA + channelsB);
+        memcpy(out, inputA + pixel * channelsA, channelsA * sizeof(float));
+        memcpy(out + channelsA, inputB + pixel * channelsB, channelsB * sizeof(float));
+    }
+}
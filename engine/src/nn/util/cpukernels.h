@@ -0,0 +1,154 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: cpukernels.h
+ * Created on 19.10.2026
+ * @author: agent
+ *
+ * Single precision CPU kernels for the native CPU back-end.
+ * All spatial activations are stored in NHWC layout, so that the channel dimension is contiguous and can be vectorized.
+ * The kernels use AVX-512 or AVX2+FMA intrinsics if the corresponding instruction set is enabled at compile time
+ * (e.g. -march=native) and fall back to portable code otherwise.
+ * The int8 convolution uses VNNI instructions (AVX-512 VNNI) if available and 16 bit multiply-adds (AVX2) otherwise.
+ */
+
+#ifndef CPUKERNELS_H
+#define CPUKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief simd_instruction_set Returns the name of the instruction set which is used by the kernels
+ * @return "avx512", "avx2" or "generic"
+ */
+const char* simd_instruction_set();
+
+/**
+ * @brief int8_instruction_set Returns the name of the instruction set which is used by the int8 kernels
+ * @return "avx512vnni", "avx2" or "generic"
+ */
+const char* int8_instruction_set();
+
+/**
+ * @brief conv2d_nhwc Convolution with stride 1 and a fused bias, residual connection and ReLU activation.
+ * Batch normalization must be folded into the weights and bias beforehand.
+ * @param input Input tensor of shape [batchSize, height, width, inChannels]
+ * @param weights Weights of shape [kernelH, kernelW, inChannels, outChannels]
+ * @param bias Bias of shape [outChannels]
+ * @param residual Optional tensor in the output shape which is added before the activation (nullptr if not used)
+ * @param output Output tensor of shape [batchSize, outHeight, outWidth, outChannels]
+ * @param workspace Buffer for the zero padded input which is resized if necessary
+ * @param pads Padding in the order top, left, bottom, right
+ * @param relu True, if a ReLU activation is applied
+ */
+void conv2d_nhwc(const float* input, const float* weights, const float* bias, const float* residual, float* output,
+                 vector<float>& workspace, size_t batchSize, size_t height, size_t width, size_t inChannels, size_t outChannels,
+                 size_t kernelH, size_t kernelW, const size_t pads[4], bool relu);
+
+/**
+ * @brief quantize_weights_int8 Quantizes convolution weights symmetrically per output channel into the layout of conv2d_nhwc_int8()
+ * @param weights Weights of shape [kernelSize, inChannels, outChannels]
+ * @param weightsInt8 Returns the quantized weights
+ * @param weightScales Returns the scale for each output channel (real value = scale * quantized value)
+ * @param compensation Returns the correction term for the unsigned input offset for each output channel
+ */
+void quantize_weights_int8(const float* weights, size_t kernelSize, size_t inChannels, size_t outChannels,
+                           vector<int8_t>& weightsInt8, vector<float>& weightScales, vector<int32_t>& compensation);
+
+/**
+ * @brief conv2d_nhwc_int8 Int8 convolution with stride 1. The input is quantized on the fly with the given scale and
+ * the accumulators are dequantized with a fused bias, residual connection and ReLU activation.
+ * @param inputScale Scale of the quantized input (real value = scale * quantized value)
+ * @param weights Weights which were generated by quantize_weights_int8()
+ * @param outputScales Product of the input scale and the weight scale for each output channel
+ * @param compensation Compensation which was generated by quantize_weights_int8()
+ * @param workspace Buffer for the quantized and padded input which is resized if necessary
+ * For all other parameters see conv2d_nhwc()
+ */
+void conv2d_nhwc_int8(const float* input, float inputScale, const int8_t* weights, const float* outputScales, const int32_t* compensation,
+                      const float* bias, const float* residual, float* output, vector<uint8_t>& workspace,
+                      size_t batchSize, size_t height, size_t width, size_t inChannels, size_t outChannels,
+                      size_t kernelH, size_t kernelW, const size_t pads[4], bool relu);
+
+/**
+ * @brief max_abs Returns the maximum absolute value of the given data
+ */
+float max_abs(const float* data, size_t length);
+
+/**
+ * @brief depthwise_conv2d_nhwc Depthwise convolution (one filter per channel) with stride 1 and fused bias, residual and ReLU
+ * @param weights Weights of shape [kernelH, kernelW, channels]
+ * For all other parameters see conv2d_nhwc()
+ */
+void depthwise_conv2d_nhwc(const float* input, const float* weights, const float* bias, const float* residual, float* output,
+                           vector<float>& workspace, size_t batchSize, size_t height, size_t width, size_t channels,
+                           size_t kernelH, size_t kernelW, const size_t pads[4], bool relu);
+
+/**
+ * @brief fully_connected Dense layer with a fused bias and ReLU activation
+ * @param input Input of shape [batchSize, inFeatures]
+ * @param weights Weights of shape [inFeatures, outFeatures]
+ * @param bias Bias of shape [outFeatures]
+ * @param output Output of shape [batchSize, outFeatures]
+ */
+void fully_connected(const float* input, const float* weights, const float* bias, float* output,
+                     size_t batchSize, size_t inFeatures, size_t outFeatures, bool relu);
+
+/**
+ * @brief channel_affine Applies output = input * scale[c] + shift[c] (e.g. a batch normalization layer in inference mode)
+ */
+void channel_affine(const float* input, const float* scale, const float* shift, float* output,
+                    size_t numberPixels, size_t channels, bool relu);
+
+void add_tensors(const float* inputA, const float* inputB, float* output, size_t length, bool relu);
+void multiply_tensors(const float* inputA, const float* inputB, float* output, size_t length);
+
+/**
+ * @brief scale_channels Multiplies each channel of a sample with a sample specific factor (e.g. squeeze excitation)
+ * @param input Input of shape [batchSize, spatialSize, channels]
+ * @param scale Factors of shape [batchSize, channels]
+ * @param output Output in the input shape
+ */
+void scale_channels(const float* input, const float* scale, float* output, size_t batchSize, size_t spatialSize, size_t channels);
+
+void global_avg_pool_nhwc(const float* input, float* output, size_t batchSize, size_t spatialSize, size_t channels);
+
+void relu_activation(const float* input, float* output, size_t length);
+void sigmoid_activation(const float* input, float* output, size_t length);
+void tanh_activation(const float* input, float* output, size_t length);
+
+/**
+ * @brief softmax Applies a softmax activation on each row
+ */
+void softmax(const float* input, float* output, size_t batchSize, size_t length);
+
+void nchw_to_nhwc(const float* input, float* output, size_t batchSize, size_t channels, size_t spatialSize);
+void nhwc_to_nchw(const float* input, float* output, size_t batchSize, size_t channels, size_t spatialSize);
+
+/**
+ * @brief concat_channels Concatenates two NHWC tensors along the channel axis
+ */
+void concat_channels(const float* inputA, const float* inputB, float* output, size_t numberPixels, size_t channelsA, size_t channelsB);
+
+#endif // CPUKERNELS_H
@@ -0,0 +1,455 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: onnxreader.cpp
+ * Created on 19.10.2026
+ * @author: agent
+ */
+
+#include "onnxreader.h"
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <cstring>
+
+// protobuf wire types
+enum WireType {
+    WIRE_VARINT = 0,
+    WIRE_FIXED64 = 1,
+    WIRE_LENGTH_DELIMITED = 2,
+    WIRE_FIXED32 = 5
+};
+
+// ONNX tensor data types
+enum OnnxDataType {
+    ONNX_FLOAT = 1,
+    ONNX_INT32 = 6,
+    ONNX_INT64 = 7
+};
+
+/**
+ * @brief The ProtoReader class iterates over the fields of a serialized protobuf message
+ */
+class ProtoReader
+{
+private:
+    const uint8_t* pos;
+    const uint8_t* end;
+
+    void check_available(size_t numberBytes) const {
+        if (size_t(end - pos) < numberBytes) {
+            throw invalid_argument("The ONNX file is corrupted.");
+        }
+    }
+
+public:
+    ProtoReader(const uint8_t* data, size_t length):
+        pos(data), end(data + length) {}
+
+    bool has_next() const {
+        return pos < end;
+    }
+
+    uint64_t read_varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            check_available(1);
+            const uint8_t byte = *pos++;
+            value |= uint64_t(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        throw invalid_argument("The ONNX file is corrupted.");
+    }
+
+    /**
+     * @brief read_tag Reads the next field header and returns the field number
+     */
+    uint32_t read_tag(WireType& wireType) {
+        const uint64_t tag = read_varint();
+        wireType = WireType(tag & 0x7);
+        return uint32_t(tag >> 3);
+    }
+
+    float read_float() {
+        check_available(sizeof(float));
+        float value;
+        memcpy(&value, pos, sizeof(float));
+        pos += sizeof(float);
+        return value;
+    }
+
+    ProtoReader read_message() {
+        const size_t length = read_varint();
+        check_available(length);
+        ProtoReader message(pos, length);
+        pos += length;
+        return message;
+    }
+
+    string read_string() {
+        const size_t length = read_varint();
+        check_available(length);
+        string value(reinterpret_cast<const char*>(pos), length);
+        pos += length;
+        return value;
+    }
+
+    void skip(WireType wireType) {
+        switch (wireType) {
+        case WIRE_VARINT:
+            read_varint();
+            break;
+        case WIRE_FIXED64:
+            check_available(8);
+            pos += 8;
+            break;
+        case WIRE_LENGTH_DELIMITED: {
+            const size_t length = read_varint();
+            check_available(length);
+            pos += length;
+            break;
+        }
+        case WIRE_FIXED32:
+            check_available(4);
+            pos += 4;
+            break;
+        default:
+            throw invalid_argument("The ONNX file contains an unsupported protobuf wire type.");
+        }
+    }
+
+    /**
+     * @brief read_int64s Reads a repeated integer field which can be either packed or unpacked
+     */
+    void read_int64s(WireType wireType, vector<int64_t>& values) {
+        if (wireType == WIRE_LENGTH_DELIMITED) {
+            ProtoReader packed = read_message();
+            while (packed.has_next()) {
+                values.push_back(int64_t(packed.read_varint()));
+            }
+            return;
+        }
+        values.push_back(int64_t(read_varint()));
+    }
+
+    /**
+     * @brief read_floats Reads a repeated float field which can be either packed or unpacked
+     */
+    void read_floats(WireType wireType, vector<float>& values) {
+        if (wireType == WIRE_LENGTH_DELIMITED) {
+            ProtoReader packed = read_message();
+            while (packed.has_next()) {
+                values.push_back(packed.read_float());
+            }
+            return;
+        }
+        values.push_back(read_float());
+    }
+};
+
+size_t OnnxTensor::size() const
+{
+    size_t numberElements = 1;
+    for (int64_t dim : dims) {
+        numberElements *= size_t(dim);
+    }
+    return numberElements;
+}
+
+const OnnxAttribute* OnnxNode::get_attribute(const string& attributeName) const
+{
+    for (const OnnxAttribute& attribute : attributes) {
+        if (attribute.name == attributeName) {
+            return &attribute;
+        }
+    }
+    return nullptr;
+}
+
+int64_t OnnxNode::get_int(const string& attributeName, int64_t defaultValue) const
+{
+    const OnnxAttribute* attribute = get_attribute(attributeName);
+    return attribute == nullptr ? defaultValue : attribute->i;
+}
+
+float OnnxNode::get_float(const string& attributeName, float defaultValue) const
+{
+    const OnnxAttribute* attribute = get_attribute(attributeName);
+    return attribute == nullptr ? defaultValue : attribute->f;
+}
+
+vector<int64_t> OnnxNode::get_ints(const string& attributeName) const
+{
+    const OnnxAttribute* attribute = get_attribute(attributeName);
+    return attribute == nullptr ? vector<int64_t>() : attribute->ints;
+}
+
+OnnxTensor parse_tensor(ProtoReader reader)
+{
+    OnnxTensor tensor;
+    int dataType = ONNX_FLOAT;
+    string rawData;
+    WireType wireType;
+    while (reader.has_next()) {
+        switch (reader.read_tag(wireType)) {
+        case 1:
+            reader.read_int64s(wireType, tensor.dims);
+            break;
+        case 2:
+            dataType = int(reader.read_varint());
+            break;
+        case 4:
+            reader.read_floats(wireType, tensor.floatData);
+            break;
+        case 5:
+        case 7:
+            reader.read_int64s(wireType, tensor.intData);
+            break;
+        case 8:
+            tensor.name = reader.read_string();
+            break;
+        case 9:
+            rawData = reader.read_string();
+            break;
+        default:
+            reader.skip(wireType);
+        }
+    }
+
+    // raw data is stored in little endian byte order
+    if (!rawData.empty()) {
+        switch (dataType) {
+        case ONNX_FLOAT:
+            tensor.floatData.resize(rawData.size() / sizeof(float));
+            memcpy(tensor.floatData.data(), rawData.data(), tensor.floatData.size() * sizeof(float));
+            break;
+        case ONNX_INT32: {
+            tensor.intData.resize(rawData.size() / sizeof(int32_t));
+            const int32_t* values = reinterpret_cast<const int32_t*>(rawData.data());
+            for (size_t idx = 0; idx < tensor.intData.size(); ++idx) {
+                tensor.intData[idx] = values[idx];
+            }
+            break;
+        }
+        case ONNX_INT64:
+            tensor.intData.resize(rawData.size() / sizeof(int64_t));
+            memcpy(tensor.intData.data(), rawData.data(), tensor.intData.size() * sizeof(int64_t));
+            break;
+        default:
+            throw invalid_argument("The ONNX tensor " + tensor.name + " has the unsupported data type " + to_string(dataType));
+        }
+    }
+    return tensor;
+}
+
+OnnxAttribute parse_attribute(ProtoReader reader)
+{
+    OnnxAttribute attribute;
+    WireType wireType;
+    while (reader.has_next()) {
+        switch (reader.read_tag(wireType)) {
+        case 1:
+            attribute.name = reader.read_string();
+            break;
+        case 2:
+            attribute.f = reader.read_float();
+            break;
+        case 3:
+            attribute.i = int64_t(reader.read_varint());
+            break;
+        case 5:
+            attribute.t = parse_tensor(reader.read_message());
+            break;
+        case 7:
+            reader.read_floats(wireType, attribute.floats);
+            break;
+        case 8:
+            reader.read_int64s(wireType, attribute.ints);
+            break;
+        default:
+            reader.skip(wireType);
+        }
+    }
+    return attribute;
+}
+
+OnnxNode parse_node(ProtoReader reader)
+{
+    OnnxNode node;
+    WireType wireType;
+    while (reader.has_next()) {
+        switch (reader.read_tag(wireType)) {
+        case 1:
+            node.inputs.push_back(reader.read_string());
+            break;
+        case 2:
+            node.outputs.push_back(reader.read_string());
+            break;
+        case 3:
+            node.name = reader.read_string();
+            break;
+        case 4:
+            node.opType = reader.read_string();
+            break;
+        case 5:
+            node.attributes.push_back(parse_attribute(reader.read_message()));
+            break;
+        default:
+            reader.skip(wireType);
+        }
+    }
+    return node;
+}
+
+/**
+ * @brief parse_value_info Returns the name and the shape of a ValueInfoProto message. Symbolic dimensions are set to -1.
+ */
+string parse_value_info(ProtoReader reader, vector<int64_t>& dims)
+{
+    string name;
+    WireType wireType;
+    while (reader.has_next()) {
+        const uint32_t field = reader.read_tag(wireType);
+        if (field == 1) {
+            name = reader.read_string();
+        }
+        else if (field == 2) {
+            // TypeProto -> tensor_type -> shape -> dim
+            ProtoReader typeReader = reader.read_message();
+            while (typeReader.has_next()) {
+                if (typeReader.read_tag(wireType) != 1) {
+                    typeReader.skip(wireType);
+                    continue;
+                }
+                ProtoReader tensorReader = typeReader.read_message();
+                while (tensorReader.has_next()) {
+                    if (tensorReader.read_tag(wireType) != 2) {
+                        tensorReader.skip(wireType);
+                        continue;
+                    }
+                    ProtoReader shapeReader = tensorReader.read_message();
+                    while (shapeReader.has_next()) {
+                        if (shapeReader.read_tag(wireType) != 1) {
+                            shapeReader.skip(wireType);
+                            continue;
+                        }
+                        ProtoReader dimReader = shapeReader.read_message();
+                        int64_t dim = -1;
+                        while (dimReader.has_next()) {
+                            if (dimReader.read_tag(wireType) == 1) {
+                                dim = int64_t(dimReader.read_varint());
+                            }
+                            else {
+                                dimReader.skip(wireType);
+                            }
+                        }
+                        dims.push_back(dim);
+                    }
+                }
+            }
+        }
+        else {
+            reader.skip(wireType);
+        }
+    }
+    return name;
+}
+
+void parse_graph(ProtoReader reader, OnnxGraph& graph)
+{
+    vector<string> inputs;
+    vector<vector<int64_t>> inputDims;
+    WireType wireType;
+    while (reader.has_next()) {
+        switch (reader.read_tag(wireType)) {
+        case 1:
+            graph.nodes.push_back(parse_node(reader.read_message()));
+            break;
+        case 5: {
+            OnnxTensor tensor = parse_tensor(reader.read_message());
+            graph.initializers[tensor.name] = move(tensor);
+            break;
+        }
+        case 11: {
+            vector<int64_t> dims;
+            inputs.push_back(parse_value_info(reader.read_message(), dims));
+            inputDims.push_back(dims);
+            break;
+        }
+        case 12: {
+            vector<int64_t> dims;
+            graph.outputs.push_back(parse_value_info(reader.read_message(), dims));
+            break;
+        }
+        default:
+            reader.skip(wireType);
+        }
+    }
+
+    // older exporters also list all parameters as graph inputs
+    for (size_t idx = 0; idx < inputs.size(); ++idx) {
+        if (graph.initializers.find(inputs[idx]) == graph.initializers.end()) {
+            graph.inputs.push_back(inputs[idx]);
+            graph.inputDims.push_back(inputDims[idx]);
+        }
+    }
+
+    // constant nodes are treated as parameters
+    vector<OnnxNode> nodes;
+    nodes.reserve(graph.nodes.size());
+    for (OnnxNode& node : graph.nodes) {
+        if (node.opType == "Constant" && node.get_attribute("value") != nullptr) {
+            OnnxTensor tensor = node.get_attribute("value")->t;
+            tensor.name = node.outputs[0];
+            graph.initializers[tensor.name] = move(tensor);
+        }
+        else {
+            nodes.push_back(move(node));
+        }
+    }
+    graph.nodes = move(nodes);
+}
+
+OnnxGraph read_onnx_graph(const string& filePath)
+{
+    ifstream file(filePath, ios::binary);
+    if (!file) {
+        throw invalid_argument("The ONNX file " + filePath + " couldn't be opened.");
+    }
+    const vector<uint8_t> buffer((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+
+    OnnxGraph graph;
+    ProtoReader reader(buffer.data(), buffer.size());
+    WireType wireType;
+    while (reader.has_next()) {
+        if (reader.read_tag(wireType) == 7) {
+            parse_graph(reader.read_message(), graph);
+        }
+        else {
+            reader.skip(wireType);
+        }
+    }
+    if (graph.nodes.empty()) {
+        throw invalid_argument("The ONNX file " + filePath + " doesn't contain a graph.");
+    }
+    return graph;
+}
@@ -0,0 +1,105 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: onnxreader.h
+ * Created on 19.10.2026
+ * @author: agent
+ *
+ * Minimal reader for ONNX model files which only extracts the computation graph and the float parameters.
+ * The protobuf wire format is decoded directly so that no protobuf or ONNX library is required.
+ * References:
+ * https://developers.google.com/protocol-buffers/docs/encoding
+ * https://github.com/onnx/onnx/blob/master/onnx/onnx.proto
+ */
+
+#ifndef ONNXREADER_H
+#define ONNXREADER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * @brief The OnnxTensor struct stores a constant tensor of the graph (e.g. weights or reshape parameters)
+ */
+struct OnnxTensor {
+    string name;
+    vector<int64_t> dims;
+    // float parameters (only set for float tensors)
+    vector<float> floatData;
+    // integer parameters (only set for int32 and int64 tensors)
+    vector<int64_t> intData;
+
+    /**
+     * @brief size Returns the number of elements based on the dimensions
+     */
+    size_t size() const;
+};
+
+struct OnnxAttribute {
+    string name;
+    float f = 0;
+    int64_t i = 0;
+    vector<float> floats;
+    vector<int64_t> ints;
+    OnnxTensor t;
+};
+
+struct OnnxNode {
+    string name;
+    string opType;
+    vector<string> inputs;
+    vector<string> outputs;
+    vector<OnnxAttribute> attributes;
+
+    /**
+     * @brief get_int Returns the integer attribute of the given name or the default value if it doesn't exist
+     */
+    int64_t get_int(const string& attributeName, int64_t defaultValue) const;
+    float get_float(const string& attributeName, float defaultValue) const;
+    vector<int64_t> get_ints(const string& attributeName) const;
+    const OnnxAttribute* get_attribute(const string& attributeName) const;
+};
+
+/**
+ * @brief The OnnxGraph struct describes the nodes in topological order as they are stored in the ONNX file
+ */
+struct OnnxGraph {
+    vector<OnnxNode> nodes;
+    unordered_map<string, OnnxTensor> initializers;
+    // graph inputs which are not initializers
+    vector<string> inputs;
+    // shape of the graph inputs including the batch dimension
+    vector<vector<int64_t>> inputDims;
+    vector<string> outputs;
+};
+
+/**
+ * @brief read_onnx_graph Parses the given ONNX file. Constant nodes are moved into the initializers.
+ * Throws an invalid_argument exception if the file can't be opened or is corrupted.
+ * @param filePath Path to the .onnx file
+ * @return Parsed graph
+ */
+OnnxGraph read_onnx_graph(const string& filePath);
+
+#endif // ONNXREADER_H
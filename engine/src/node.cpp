@@ -25,6 +25,8 @@
 
 #include "node.h"
 #include <limits.h>
+#include <limits>
+#include <cmath>
 #include "util/blazeutil.h" // get_dirichlet_noise()
 #include "constants.h"
 #include "../util/communication.h"
@@ -376,12 +378,25 @@ Node::~Node()
 
 void Node::sort_moves_by_probabilities()
 {
-    auto p = sort_permutation(policyProbSmall, std::greater<float>());
-    apply_permutation_in_place(policyProbSmall, p);
-    apply_permutation_in_place(legalActions, p);
+    sort_legal_moves();
     sorted = true;
 }
 
+void Node::sort_legal_moves()
+{
+    for (size_t idx = 1; idx < legalActions.size(); ++idx) {
+        const float prob = policyProbSmall[idx];
+        const Action action = legalActions[idx];
+        size_t insertIdx = idx;
+        for (; insertIdx > 0 && policyProbSmall[insertIdx-1] < prob; --insertIdx) {
+            policyProbSmall[insertIdx] = policyProbSmall[insertIdx-1];
+            legalActions[insertIdx] = legalActions[insertIdx-1];
+        }
+        policyProbSmall[insertIdx] = prob;
+        legalActions[insertIdx] = action;
+    }
+}
+
 Action Node::get_action(size_t childIdx) const
 {
     return legalActions[childIdx];
@@ -440,6 +455,7 @@ template<bool increment>
 void Node::update_virtual_loss_counter(uint16_t childIdx)
 {
     if (increment) {
+        assert(d->virtualLossCounter[childIdx] != UINT8_MAX);
         ++d->virtualLossCounter[childIdx];
     }
     else {
@@ -561,7 +577,10 @@ uint8_t Node::get_number_parent_nodes() const
 
 void Node::prepare_node_for_visits()
 {
-    sort_moves_by_probabilities();
+    // the moves are already sorted if the prior policy was set by set_prior_policy() or set_sparse_prior_policy()
+    if (!sorted) {
+        sort_moves_by_probabilities();
+    }
     init_node_data();
 }
 
@@ -576,17 +595,42 @@ uint32_t Node::get_real_visits(uint16_t childIdx) const
 }
 
 void backup_value(float value, float virtualLoss, const Trajectory& trajectory) {
+    const uint16_t leafVisits = trajectory.back().numberVisits;
     for (auto it = trajectory.rbegin(); it != trajectory.rend(); ++it) {
 #ifndef MODE_POMMERMAN
         value = -value;
 #endif
-        it->node->revert_virtual_loss_and_update(it->childIdx, value, virtualLoss);
+        if (it->numberVisits == 1) {
+            it->node->revert_virtual_loss_and_update(it->childIdx, value, virtualLoss);
+        }
+        else {
+            it->node->revert_virtual_loss_and_update(it->childIdx, value, virtualLoss, leafVisits, it->numberVisits);
+        }
     }
 }
 
 void Node::revert_virtual_loss_and_update(size_t childIdx, float value, float virtualLoss)
 {
     lock();
+    update_child_stats(childIdx, value, virtualLoss);
+    unlock();
+}
+
+void Node::revert_virtual_loss_and_update(size_t childIdx, float value, float virtualLoss, uint16_t updateVisits, uint16_t appliedVisits)
+{
+    lock();
+    // revert the surplus visits first, so that the first real visit can still replace the Q_INIT initialization
+    for (uint16_t idx = updateVisits; idx < appliedVisits; ++idx) {
+        revert_child_stats(childIdx, virtualLoss);
+    }
+    for (uint16_t idx = 0; idx < updateVisits; ++idx) {
+        update_child_stats(childIdx, value, virtualLoss);
+    }
+    unlock();
+}
+
+void Node::update_child_stats(size_t childIdx, float value, float virtualLoss)
+{
     // decrement virtual loss counter
     update_virtual_loss_counter<false>(childIdx);
 
@@ -610,24 +654,30 @@ void Node::revert_virtual_loss_and_update(size_t childIdx, float value, float vi
         ++d->terminalVisits;
         solve_for_terminal(d->childNodes[childIdx]);
     }
-    unlock();
 }
 
 void backup_collision(float virtualLoss, const Trajectory& trajectory) {
     for (auto it = trajectory.rbegin(); it != trajectory.rend(); ++it) {
-        it->node->revert_virtual_loss(it->childIdx, virtualLoss);
+        it->node->revert_virtual_loss(it->childIdx, virtualLoss, it->numberVisits);
     }
 }
 
-void Node::revert_virtual_loss(size_t childIdx, float virtualLoss)
+void Node::revert_virtual_loss(size_t childIdx, float virtualLoss, uint16_t numberVisits)
 {
     lock();
+    for (uint16_t idx = 0; idx < numberVisits; ++idx) {
+        revert_child_stats(childIdx, virtualLoss);
+    }
+    unlock();
+}
+
+void Node::revert_child_stats(size_t childIdx, float virtualLoss)
+{
     d->qValues[childIdx] = (double(d->qValues[childIdx]) * d->childNumberVisits[childIdx] + virtualLoss) / (d->childNumberVisits[childIdx] - virtualLoss);
     d->childNumberVisits[childIdx] -= virtualLoss;
     d->visitSum -= virtualLoss;
     // decrement virtual loss counter
     update_virtual_loss_counter<false>(childIdx);
-    unlock();
 }
 
 bool Node::is_playout_node() const
@@ -880,6 +930,75 @@ void Node::set_probabilities_for_moves(const float *data, SideToMove sideToMove)
     }
 }
 
+void Node::append_policy_indices(SideToMove sideToMove, vector<MoveIdx>& indices) const
+{
+    for (Action action : legalActions) {
+        if (sideToMove == FIRST_PLAYER_IDX) {
+            indices.push_back(StateConstants::action_to_index<normal,notMirrored>(action));
+        }
+        else {
+            indices.push_back(StateConstants::action_to_index<normal,mirrored>(action));
+        }
+    }
+}
+
+void Node::set_prior_policy(const float* data, SideToMove sideToMove, bool isLogits, float temperature)
+{
+    assert(legalActions.size() == policyProbSmall.size());
+    const size_t numberMoves = legalActions.size();
+    float* prior = policyProbSmall.data();
+    if (sideToMove == FIRST_PLAYER_IDX) {
+        for (size_t mvIdx = 0; mvIdx < numberMoves; ++mvIdx) {
+            prior[mvIdx] = data[StateConstants::action_to_index<normal,notMirrored>(legalActions[mvIdx])];
+        }
+    }
+    else {
+        for (size_t mvIdx = 0; mvIdx < numberMoves; ++mvIdx) {
+            prior[mvIdx] = data[StateConstants::action_to_index<normal,mirrored>(legalActions[mvIdx])];
+        }
+    }
+    normalize_prior_policy(isLogits, temperature);
+    sort_moves_by_probabilities();
+}
+
+void Node::set_sparse_prior_policy(const float* probabilities, float temperature)
+{
+    assert(legalActions.size() == policyProbSmall.size());
+    copy(probabilities, probabilities + legalActions.size(), policyProbSmall.data());
+    normalize_prior_policy(false, temperature);
+    sort_moves_by_probabilities();
+}
+
+void Node::normalize_prior_policy(bool isLogits, float temperature)
+{
+    const size_t numberMoves = legalActions.size();
+    float* prior = policyProbSmall.data();
+    if (!isLogits) {
+        if (temperature == 1) {
+            return;
+        }
+        // p^(1/T) / sum(p^(1/T)) is the softmax of log(p) / T
+        for (size_t mvIdx = 0; mvIdx < numberMoves; ++mvIdx) {
+            prior[mvIdx] = log(prior[mvIdx]);
+        }
+    }
+    // the softmax of x / T is the same as applying the temperature to the softmax of x
+    const float invTemperature = 1.0f / temperature;
+    float maxValue = -numeric_limits<float>::infinity();
+    for (size_t mvIdx = 0; mvIdx < numberMoves; ++mvIdx) {
+        maxValue = max(maxValue, prior[mvIdx]);
+    }
+    float sum = 0;
+    for (size_t mvIdx = 0; mvIdx < numberMoves; ++mvIdx) {
+        prior[mvIdx] = exp((prior[mvIdx] - maxValue) * invTemperature);
+        sum += prior[mvIdx];
+    }
+    const float invSum = 1.0f / sum;
+    for (size_t mvIdx = 0; mvIdx < numberMoves; ++mvIdx) {
+        prior[mvIdx] *= invSum;
+    }
+}
+
 void Node::apply_softmax_to_policy()
 {
     policyProbSmall = softmax(policyProbSmall);
@@ -1022,7 +1141,7 @@ size_t get_best_action_index(const Node *curNode, bool fast)
 
 size_t Node::select_child_node(const SearchSettings* searchSettings)
 {
-    if (!sorted) {
+    if (!is_playout_node()) {
         prepare_node_for_visits();
     }
     if (d->noVisitIdx == 1) {
@@ -1036,7 +1155,65 @@ size_t Node::select_child_node(const SearchSettings* searchSettings)
     // find the move according to the q- and u-values for each move
     // calculate the current u values
     // it's not worth to save the u values as a node attribute because u is updated every time n_sum changes
-    return argmax(d->qValues + get_current_u_values(searchSettings));
+    // (the scores are computed in a single pass to avoid allocating a temporary vector for every selection)
+    const float cpuct = get_current_cput(d->visitSum, searchSettings);
+    const double sqrtVisitSum = sqrt(d->visitSum);
+    size_t bestIdx = 0;
+    float bestScore = -numeric_limits<float>::max();
+    for (size_t idx = 0; idx < d->noVisitIdx; ++idx) {
+        const float score = d->qValues[idx] + cpuct * policyProbSmall[idx] * (sqrtVisitSum / (d->childNumberVisits[idx] + 1.0));
+        if (score > bestScore) {
+            bestScore = score;
+            bestIdx = idx;
+        }
+    }
+    return bestIdx;
+}
+
+uint16_t Node::get_consecutive_visits(size_t childIdx, uint16_t maxVisits, const SearchSettings* searchSettings) const
+{
+    // the pending visits of an edge must fit into its uint8_t virtual loss counter
+    maxVisits = min(maxVisits, uint16_t(UINT8_MAX - d->virtualLossCounter[childIdx]));
+    if (maxVisits <= 1 || d->noVisitIdx == 1 || has_forced_win()) {
+        return 1;
+    }
+    const float cpuct = get_current_cput(d->visitSum, searchSettings);
+    const float sqrtVisitSum = sqrt(d->visitSum);
+
+    // find the currently second best child
+    size_t secondIdx = childIdx;
+    float secondScore = -numeric_limits<float>::max();
+    for (size_t idx = 0; idx < d->noVisitIdx; ++idx) {
+        if (idx == childIdx) {
+            continue;
+        }
+        const float score = d->qValues[idx] + cpuct * policyProbSmall[idx] * sqrtVisitSum / (d->childNumberVisits[idx] + 1.0f);
+        if (score > secondScore) {
+            secondScore = score;
+            secondIdx = idx;
+        }
+    }
+    if (secondIdx == childIdx) {
+        return 1;
+    }
+
+    // simulate further virtual losses on the best child until the second best child would be selected
+    double qSum = double(d->qValues[childIdx]) * d->childNumberVisits[childIdx];
+    double childVisits = d->childNumberVisits[childIdx];
+    double visitSum = d->visitSum;
+    const float secondFactor = cpuct * policyProbSmall[secondIdx] / (d->childNumberVisits[secondIdx] + 1.0f);
+    uint16_t numberVisits = 1;
+    while (numberVisits < maxVisits) {
+        qSum -= searchSettings->virtualLoss;
+        childVisits += searchSettings->virtualLoss;
+        visitSum += searchSettings->virtualLoss;
+        const float bestScore = qSum / childVisits + cpuct * policyProbSmall[childIdx] * sqrt(visitSum) / (childVisits + 1);
+        if (bestScore < d->qValues[secondIdx] + secondFactor * sqrt(visitSum)) {
+            break;
+        }
+        ++numberVisits;
+    }
+    return numberVisits;
 }
 
 const char* node_type_to_string(enum NodeType nodeType)
@@ -1089,7 +1266,7 @@ void delete_subtree_and_hash_entries(Node* node, unordered_map<Key, Node*>& hash
         return;
     }
     // if the current node hasn't been expanded or is a terminal node then childNodes is empty and the recursion ends
-    if (node->is_sorted()) {
+    if (node->is_playout_node()) {
         for (Node* childNode: node->get_child_nodes()) {
             if (childNode != nullptr && childNode->is_transposition()) {
                 childNode->kill_parent_node(node);
@@ -55,8 +55,10 @@ struct ParentNode {
 struct NodeAndIdx {
     Node* node;
     uint16_t childIdx;
-    NodeAndIdx(Node* node, uint16_t childIdx) :
-        node(node), childIdx(childIdx) {}
+    // number of visits (virtual losses) which have been applied on this edge during the descent
+    uint16_t numberVisits;
+    NodeAndIdx(Node* node, uint16_t childIdx, uint16_t numberVisits = 1) :
+        node(node), childIdx(childIdx), numberVisits(numberVisits) {}
 };
 using Trajectory = vector<NodeAndIdx>;
 
@@ -120,6 +122,17 @@ public:
 
     size_t select_child_node(const SearchSettings* searchSettings);
 
+    /**
+     * @brief get_consecutive_visits Returns how many consecutive visits the given child would receive by the PUCT selection
+     * before the currently second best child overtakes it. Each visit is assumed to apply a virtual loss on the child.
+     * The result is also capped so that the total number of pending visits on the edge never exceeds 255.
+     * @param childIdx Index of the selected child node
+     * @param maxVisits Upper bound for the number of visits
+     * @param searchSettings Search settings
+     * @return Number of visits in [1, maxVisits]
+     */
+    uint16_t get_consecutive_visits(size_t childIdx, uint16_t maxVisits, const SearchSettings* searchSettings) const;
+
     /**
      * @brief revert_virtual_loss_and_update Revert the virtual loss effect and apply the backpropagated value of its child node
      * @param childIdx Index to the child node to update
@@ -127,11 +140,22 @@ public:
      */
     void revert_virtual_loss_and_update(size_t childIdx, float value, float virtualLoss);
 
+    /**
+     * @brief revert_virtual_loss_and_update Multi-visit version which reverts appliedVisits virtual losses
+     * and applies the backpropagated value updateVisits times
+     * @param childIdx Index to the child node to update
+     * @param value Specifies the value evaluation to backpropagate
+     * @param updateVisits Weight of the value evaluation
+     * @param appliedVisits Number of virtual losses which have been applied on this edge (>= updateVisits)
+     */
+    void revert_virtual_loss_and_update(size_t childIdx, float value, float virtualLoss, uint16_t updateVisits, uint16_t appliedVisits);
+
     /**
      * @brief revert_virtual_loss Reverts the virtual loss for a target node
      * @param childIdx Index to the child node to update
+     * @param numberVisits Number of virtual losses to revert
      */
-    void revert_virtual_loss(size_t childIdx, float virtualLoss);
+    void revert_virtual_loss(size_t childIdx, float virtualLoss, uint16_t numberVisits = 1);
 
     bool is_playout_node() const;
 
@@ -260,6 +284,26 @@ public:
 
     void set_probabilities_for_moves(const float *data, SideToMove sideToMove);
 
+    /**
+     * @brief append_policy_indices Appends the index of each legal move in the policy output to the given vector
+     */
+    void append_policy_indices(SideToMove sideToMove, vector<MoveIdx>& indices) const;
+
+    /**
+     * @brief set_prior_policy Gathers the policy of the legal moves from the network output, applies a softmax with the given
+     * temperature and sorts the moves by their prior in place. This is equivalent to set_probabilities_for_moves(),
+     * apply_softmax_to_policy(), apply_temperature_to_prior_policy() and sort_moves_by_probabilities() but avoids all temporaries.
+     * @param data Policy output of the current sample
+     * @param isLogits True, if the policy output are logits, false if it is already a distribution (e.g. for policy map networks)
+     * @param temperature Temperature of the prior policy
+     */
+    void set_prior_policy(const float* data, SideToMove sideToMove, bool isLogits, float temperature);
+
+    /**
+     * @brief set_sparse_prior_policy Version of set_prior_policy() for a distribution which was already gathered over the legal moves
+     */
+    void set_sparse_prior_policy(const float* probabilities, float temperature);
+
     void apply_softmax_to_policy();
 
     /**
@@ -417,6 +461,28 @@ private:
 
     uint32_t get_real_visits_for_parent(const ParentNode& parent) const;
 
+    /**
+     * @brief normalize_prior_policy Converts the gathered policy into the prior distribution in place
+     * @param isLogits True, if the policy are logits, false if it is already a distribution
+     */
+    void normalize_prior_policy(bool isLogits, float temperature);
+
+    /**
+     * @brief sort_legal_moves Sorts the legal moves and their priors in descending order without a temporary permutation.
+     * Insertion sort is used because the number of legal moves is small and the moves are often already sorted.
+     */
+    void sort_legal_moves();
+
+    /**
+     * @brief update_child_stats Reverts a single virtual loss and updates the Q-value (the node must be locked)
+     */
+    inline void update_child_stats(size_t childIdx, float value, float virtualLoss);
+
+    /**
+     * @brief revert_child_stats Reverts a single virtual loss without an update (the node must be locked)
+     */
+    inline void revert_child_stats(size_t childIdx, float virtualLoss);
+
     double get_q_sum_for_parent(const ParentNode& parent, float virtualLoss) const;
 
     /**
@@ -622,7 +688,8 @@ bool is_terminal_value(float value);
 size_t get_node_count(const Node* node);
 
 /**
- * @brief backup_collision Iteratively removes the virtual loss of the collision event that occurred
+ * @brief backup_collision Iteratively removes the virtual loss of the collision event that occurred.
+ * All visits of a multi-visit descent are reverted.
  * @param rootNode Root node of the tree
  * @param virtualLoss Virtual loss value
  * @param trajectory Trajectory on how to get to the given collision
@@ -632,6 +699,8 @@ void backup_collision(float virtualLoss, const Trajectory& trajectory);
 /**
  * @brief backup_value Iteratively backpropagates a value prediction across all of the parents for this node.
  * The value is flipped at every ply.
+ * In case of a multi-visit descent the value is backed up with the number of visits of the last edge
+ * and the remaining virtual losses of the upper edges are reverted.
  * @param rootNode Root node of the tree
  * @param value Value evaluation to backup, this is the NN eval in the general case or can be from a terminal node
  * @param virtualLoss Virtual loss value
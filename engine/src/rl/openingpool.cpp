@@ -0,0 +1,175 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: openingpool.cpp
+ * Created on 19.10.2026
+ * @author: agent
+ */
+
+#ifdef USE_RL
+#include "openingpool.h"
+#include "selfplay.h"
+#include "util/blazeutil.h"
+#include "util/randomgen.h"
+
+OpeningPool::OpeningPool(NeuralNetAPI* net, PlaySettings* playSettings, Variant variant, float rawPolicyProbTemp, size_t capacity):
+    NeuralNetAPIUser(net),
+    playSettings(playSettings),
+    variant(variant),
+    rawPolicyProbTemp(rawPolicyProbTemp),
+    capacity(capacity),
+    running(true),
+    numberWaits(0)
+{
+    if (capacity == 0) {
+        throw invalid_argument("The capacity of the opening pool must be greater than 0");
+    }
+    generator = thread(&OpeningPool::generate_openings, this);
+}
+
+OpeningPool::~OpeningPool()
+{
+    {
+        lock_guard<mutex> lock(poolMutex);
+        running = false;
+    }
+    openingRequired.notify_one();
+    generator.join();
+}
+
+void OpeningPool::generate_openings()
+{
+    vector<OpeningSlot> slots(net->get_batch_size());
+    for (OpeningSlot& slot : slots) {
+        start_opening(slot);
+    }
+    vector<size_t> batchSlots;
+
+    while (true) {
+        {
+            unique_lock<mutex> lock(poolMutex);
+            openingRequired.wait(lock, [this]{ return !running || openings.size() < capacity; });
+            if (!running) {
+                return;
+            }
+        }
+        batchSlots.clear();
+        for (size_t slotIdx = 0; slotIdx < slots.size(); ++slotIdx) {
+            OpeningSlot& slot = slots[slotIdx];
+            if (prepare_slot(slot)) {
+                slot.opening.state->get_state_planes(true, inputPlanes + batchSlots.size() * StateConstants::NB_VALUES_TOTAL());
+                batchSlots.push_back(slotIdx);
+            }
+            else {
+                // the new opening of the slot joins the next batch
+                add_opening(slot);
+                start_opening(slot);
+            }
+        }
+        if (batchSlots.empty()) {
+            continue;
+        }
+        net->predict_samples(inputPlanes, valueOutputs, probOutputs, batchSlots.size());
+
+        for (size_t batchIdx = 0; batchIdx < batchSlots.size(); ++batchIdx) {
+            OpeningSlot& slot = slots[batchSlots[batchIdx]];
+            slot.eval.policyProbSmall.resize(slot.eval.legalMoves.size());
+            get_probs_of_move_list(batchIdx, probOutputs, slot.eval.legalMoves, slot.opening.state->side_to_move(),
+                                   !net->is_policy_map(), slot.eval.policyProbSmall, net->is_policy_map());
+            apply_raw_policy_temp(slot.eval, rawPolicyProbTemp);
+            const Action action = slot.eval.legalMoves[random_choice(slot.eval.policyProbSmall)];
+            if (!play_opening_move(slot.opening.state.get(), action, slot.eval.legalMoves, slot.opening.gameMoves)) {
+                add_opening(slot);
+                start_opening(slot);
+            }
+        }
+    }
+}
+
+void OpeningPool::start_opening(OpeningSlot& slot)
+{
+    // the pgn isn't modified for non-960 starting positions
+    GamePGN gamePGN;
+    slot.opening.state = init_state(variant, false, gamePGN);
+    slot.opening.gameMoves.clear();
+    const size_t plys = size_t(random_exponential<float>(1.0f/playSettings->meanInitPly) + 0.5f);
+    slot.plys = clip_ply(plys, playSettings->maxInitPly);
+}
+
+bool OpeningPool::prepare_slot(OpeningSlot& slot)
+{
+    StateObj* state = slot.opening.state.get();
+    while (slot.opening.gameMoves.size() < slot.plys) {
+        slot.eval.legalMoves = state->legal_actions();
+        if (slot.eval.legalMoves.size() > 1) {
+            return true;
+        }
+        // a forced move doesn't require a network evaluation
+        if (!play_opening_move(state, slot.eval.legalMoves[0], slot.eval.legalMoves, slot.opening.gameMoves)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+void OpeningPool::add_opening(OpeningSlot& slot)
+{
+    {
+        lock_guard<mutex> lock(poolMutex);
+        openings.emplace_back(std::move(slot.opening));
+    }
+    openingAvailable.notify_one();
+}
+
+unique_ptr<StateObj> OpeningPool::get_opening(GamePGN& gamePGN)
+{
+    unique_lock<mutex> lock(poolMutex);
+    if (openings.empty()) {
+        ++numberWaits;
+        openingAvailable.wait(lock, [this]{ return !openings.empty(); });
+    }
+    Opening opening = std::move(openings.front());
+    openings.pop_front();
+    lock.unlock();
+    openingRequired.notify_one();
+
+    gamePGN.gameMoves.insert(gamePGN.gameMoves.end(), opening.gameMoves.begin(), opening.gameMoves.end());
+    return std::move(opening.state);
+}
+
+size_t OpeningPool::get_number_waits()
+{
+    lock_guard<mutex> lock(poolMutex);
+    return numberWaits;
+}
+
+bool play_opening_move(StateObj* state, Action action, const vector<Action>& legalMoves, vector<string>& gameMoves)
+{
+    const string san = state->action_to_san(action, legalMoves, false, true);
+    const bool givesCheck = state->gives_check(action);
+    state->do_action(action);
+    if (state->check_result(givesCheck) != NO_RESULT) {
+        state->undo_action(action);
+        return false;
+    }
+    gameMoves.push_back(san);
+    return true;
+}
+#endif
@@ -0,0 +1,140 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: openingpool.h
+ * Created on 19.10.2026
+ * @author: agent
+ *
+ * Pool of selfplay starting positions which are sampled from the raw network policy in a background thread.
+ * The openings of a whole batch of prospective games are advanced by one ply per network evaluation.
+ */
+
+#ifndef OPENINGPOOL_H
+#define OPENINGPOOL_H
+
+#ifdef USE_RL
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "gamepgn.h"
+#include "../evalinfo.h"
+#include "../stateobj.h"
+#include "../nn/neuralnetapiuser.h"
+#include "../agents/config/playsettings.h"
+
+/**
+ * @brief The Opening struct is a generated starting position together with the moves which lead to it
+ */
+struct Opening
+{
+    unique_ptr<StateObj> state;
+    vector<string> gameMoves;
+};
+
+/**
+ * @brief The OpeningSlot struct is an opening of the current batch which is still being generated
+ */
+struct OpeningSlot
+{
+    Opening opening;
+    // number of plys which are sampled from the raw policy
+    size_t plys;
+    EvalInfo eval;
+};
+
+class OpeningPool : public NeuralNetAPIUser
+{
+private:
+    PlaySettings* playSettings;
+    Variant variant;
+    float rawPolicyProbTemp;
+    size_t capacity;
+    // finished openings (protected by poolMutex)
+    deque<Opening> openings;
+    mutex poolMutex;
+    condition_variable openingAvailable;
+    condition_variable openingRequired;
+    bool running;
+    // number of game starts which had to wait for an opening
+    size_t numberWaits;
+    thread generator;
+
+    /**
+     * @brief generate_openings Refills the pool until the pool is stopped
+     */
+    void generate_openings();
+
+    /**
+     * @brief start_opening Initializes the slot with a new starting position and a random number of plys
+     */
+    void start_opening(OpeningSlot& slot);
+
+    /**
+     * @brief prepare_slot Plays forced moves of the slot and returns true if the slot requires a network evaluation.
+     * If false is returned, the opening of the slot is finished.
+     */
+    bool prepare_slot(OpeningSlot& slot);
+
+    /**
+     * @brief add_opening Moves the finished opening of the slot into the pool
+     */
+    void add_opening(OpeningSlot& slot);
+
+public:
+    /**
+     * @brief OpeningPool Starts the background generation of the openings
+     * @param net Network which is exclusively used by the pool. All samples of its batch are generated concurrently.
+     * @param playSettings Play settings which define the distribution of the number of plys
+     * @param variant Variant to generate openings for
+     * @param rawPolicyProbTemp Probability for which a temperature scaling > 1.0f is applied (see apply_raw_policy_temp())
+     * @param capacity Number of openings which are kept ready. The generation continues whenever fewer openings are available.
+     */
+    OpeningPool(NeuralNetAPI* net, PlaySettings* playSettings, Variant variant, float rawPolicyProbTemp, size_t capacity);
+    ~OpeningPool();
+    OpeningPool(const OpeningPool&) = delete;
+    OpeningPool& operator=(const OpeningPool&) = delete;
+
+    /**
+     * @brief get_opening Returns the next opening and waits if the pool is empty. This method is thread-safe.
+     * @param gamePGN Game pgn struct which receives the moves of the opening
+     * @return Starting position
+     */
+    unique_ptr<StateObj> get_opening(GamePGN& gamePGN);
+
+    /**
+     * @brief get_number_waits Returns the number of game starts which had to wait for an opening
+     */
+    size_t get_number_waits();
+};
+
+/**
+ * @brief play_opening_move Plays the given move unless it leads to a terminal state and adds its SAN to the move list.
+ * In contrast to State::leads_to_terminal() the state isn't cloned, the move is undone if it leads to a terminal state.
+ * @param state Current position
+ * @param action Move to play
+ * @param legalMoves Legal moves of the position
+ * @param gameMoves Move list of the opening
+ * @return True if the move has been played, false if it leads to a terminal state
+ */
+bool play_opening_move(StateObj* state, Action action, const vector<Action>& legalMoves, vector<string>& gameMoves);
+#endif
+
+#endif // OPENINGPOOL_H
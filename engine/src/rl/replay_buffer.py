@@ -0,0 +1,91 @@
+"""
+@file: replay_buffer.py
+Created on 19.10.26
+@project: crazy_ara
+@author: agent
+
+Consumer of the memory-mapped selfplay replay buffer (see replaybuffer.h for the layout).
+The samples are returned as numpy views into the shared mapping, so that they are not copied before training.
+"""
+
+import numpy as np
+
+REPLAY_BUFFER_MAGIC = b"CZREPLAY"
+REPLAY_BUFFER_VERSION = 1
+
+
+class ReplayBufferReader:
+    """
+    Reads the samples which are appended to a replay buffer by one or more selfplay processes on the same host
+    """
+
+    def __init__(self, file_path):
+        """
+        Constructor
+        :param file_path: File of the replay buffer (e.g. "/dev/shm/crazyara_replay")
+        """
+        header = np.memmap(file_path, dtype=np.uint8, mode="r+", shape=(56,))
+        if bytes(header[:8]) != REPLAY_BUFFER_MAGIC or header[8:12].view("<u4")[0] != REPLAY_BUFFER_VERSION:
+            raise Exception("The file %s isn't a replay buffer of version %d" % (file_path, REPLAY_BUFFER_VERSION))
+        header_size = int(header[12:16].view("<u4")[0])
+        self.capacity = int(header[16:24].view("<u8")[0])
+        slot_size = int(header[24:32].view("<u8")[0])
+        nb_values = int(header[32:36].view("<u4")[0])
+        nb_labels = int(header[36:40].view("<u4")[0])
+        # write index (40) and read index (48)
+        self.indices = header[40:56].view("<u8")
+
+        slot_dtype = np.dtype({
+            "names": ["sequence", "y_value", "is_game_start", "y_best_move_q", "x", "y_policy"],
+            "formats": ["<u8", "<i2", "<u2", "<f4", ("<i2", (nb_values,)), ("<f4", (nb_labels,))],
+            "offsets": [0, 8, 10, 12, 16, 16 + 2 * nb_values],
+            "itemsize": slot_size,
+        })
+        self.slots = np.memmap(file_path, dtype=slot_dtype, mode="r+", offset=header_size, shape=(self.capacity,))
+
+    def get_write_idx(self):
+        """
+        Returns the number of samples which have been reserved by the producers so far
+        """
+        return int(self.indices[0])
+
+    def get_read_idx(self):
+        """
+        Returns the number of samples which have been consumed so far
+        """
+        return int(self.indices[1])
+
+    def poll(self, max_samples=None):
+        """
+        Returns the consecutive complete samples after the read index without copying them.
+        Samples which have already been overwritten are skipped. The returned range never wraps around the end
+        of the buffer, so that it can be returned as a single view.
+        :param max_samples: Maximum number of samples to return, all available samples if None
+        :return: start_idx - index of the first returned sample
+                 samples - structured numpy view with the fields y_value, is_game_start, y_best_move_q, x, y_policy
+        """
+        write_idx = self.get_write_idx()
+        start_idx = max(self.get_read_idx(), write_idx - self.capacity)
+        end_idx = write_idx if max_samples is None else min(write_idx, start_idx + max_samples)
+        # stop at the end of the buffer
+        slot_idx = start_idx % self.capacity
+        end_idx = min(end_idx, start_idx + self.capacity - slot_idx)
+        samples = self.slots[slot_idx:slot_idx + end_idx - start_idx]
+        expected = np.arange(start_idx + 1, end_idx + 1, dtype=np.uint64)
+        # stop at the first sample which is incomplete or has been overwritten in the meantime
+        incomplete = np.flatnonzero(samples["sequence"] != expected)
+        if len(incomplete) > 0:
+            samples = samples[:incomplete[0]]
+        return start_idx, samples
+
+    def commit(self, start_idx, samples):
+        """
+        Marks the samples of poll() as consumed
+        :param start_idx: Index of the first sample returned by poll()
+        :param samples: Samples returned by poll()
+        :return: Boolean mask of the samples which haven't been overwritten while they were used
+        """
+        expected = np.arange(start_idx + 1, start_idx + len(samples) + 1, dtype=np.uint64)
+        is_valid = samples["sequence"] == expected
+        self.indices[1] = max(self.get_read_idx(), start_idx + len(samples))
+        return is_valid
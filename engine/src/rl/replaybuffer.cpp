@@ -0,0 +1,217 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: replaybuffer.cpp
+ * Created on 19.10.2026
+ * @author: agent
+ */
+
+#ifdef USE_RL
+#include "replaybuffer.h"
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// the atomics are shared between processes, which requires them to be lock-free
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "The replay buffer requires lock-free 64-bit atomics");
+static_assert(sizeof(ReplayBufferHeader) <= REPLAY_BUFFER_HEADER_SIZE, "The replay buffer header exceeds its size");
+static_assert(sizeof(ReplayBufferSlot) == 16, "Unexpected size of the replay buffer slot");
+
+const char REPLAY_BUFFER_MAGIC[8] = {'C', 'Z', 'R', 'E', 'P', 'L', 'A', 'Y'};
+
+ReplayBuffer::ReplayBuffer(const string& fileName, size_t capacity):
+    fileName(fileName),
+    capacity(capacity),
+    overwrittenSamples(0),
+    abortedSamples(0)
+{
+    if (capacity == 0) {
+        throw invalid_argument("The capacity of the replay buffer must be greater than 0");
+    }
+    const size_t sampleSize = sizeof(ReplayBufferSlot) + NB_VALUES_TOTAL * sizeof(int16_t) + NB_LABELS * sizeof(float);
+    slotSize = (sampleSize + REPLAY_BUFFER_SLOT_ALIGNMENT - 1) / REPLAY_BUFFER_SLOT_ALIGNMENT * REPLAY_BUFFER_SLOT_ALIGNMENT;
+    fileSize = REPLAY_BUFFER_HEADER_SIZE + capacity * slotSize;
+
+    fileDescriptor = open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fileDescriptor == -1) {
+        throw invalid_argument("The replay buffer " + fileName + " can't be opened: " + strerror(errno));
+    }
+    // the file lock makes sure that only a single process initializes a new buffer
+    flock(fileDescriptor, LOCK_EX);
+    struct stat fileStat;
+    fstat(fileDescriptor, &fileStat);
+    const bool isNewFile = fileStat.st_size == 0;
+    if ((isNewFile && ftruncate(fileDescriptor, off_t(fileSize)) != 0) || (!isNewFile && size_t(fileStat.st_size) != fileSize)) {
+        flock(fileDescriptor, LOCK_UN);
+        close(fileDescriptor);
+        throw invalid_argument("The replay buffer " + fileName + " has " + to_string(fileStat.st_size) + " bytes instead of " + to_string(fileSize));
+    }
+    void* mapping = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+    if (mapping == MAP_FAILED) {
+        flock(fileDescriptor, LOCK_UN);
+        close(fileDescriptor);
+        throw invalid_argument("The replay buffer " + fileName + " can't be mapped: " + strerror(errno));
+    }
+    data = static_cast<char*>(mapping);
+    header = reinterpret_cast<ReplayBufferHeader*>(data);
+    if (isNewFile) {
+        initialize_header();
+    }
+    flock(fileDescriptor, LOCK_UN);
+    if (!isNewFile) {
+        try {
+            check_header();
+        }
+        catch (...) {
+            munmap(data, fileSize);
+            close(fileDescriptor);
+            throw;
+        }
+    }
+}
+
+ReplayBuffer::~ReplayBuffer()
+{
+    munmap(data, fileSize);
+    close(fileDescriptor);
+}
+
+void ReplayBuffer::initialize_header()
+{
+    // the new file is zero-filled, so all slots have the invalid sequence 0
+    new (header) ReplayBufferHeader();
+    header->version = REPLAY_BUFFER_VERSION;
+    header->headerSize = REPLAY_BUFFER_HEADER_SIZE;
+    header->capacity = capacity;
+    header->slotSize = slotSize;
+    header->numberValues = NB_VALUES_TOTAL;
+    header->numberLabels = NB_LABELS;
+    header->writeIdx.store(0);
+    header->readIdx.store(0);
+    // the magic is written last, so that a consumer only uses a fully initialized header
+    atomic_thread_fence(memory_order_release);
+    memcpy(header->magic, REPLAY_BUFFER_MAGIC, sizeof(REPLAY_BUFFER_MAGIC));
+}
+
+void ReplayBuffer::check_header() const
+{
+    if (memcmp(header->magic, REPLAY_BUFFER_MAGIC, sizeof(REPLAY_BUFFER_MAGIC)) != 0 || header->version != REPLAY_BUFFER_VERSION) {
+        throw invalid_argument("The file " + fileName + " isn't a replay buffer of version " + to_string(REPLAY_BUFFER_VERSION));
+    }
+    if (header->capacity != capacity || header->slotSize != slotSize || header->numberValues != NB_VALUES_TOTAL || header->numberLabels != NB_LABELS) {
+        throw invalid_argument("The replay buffer " + fileName + " was created with a different capacity or input representation");
+    }
+}
+
+ReplayBufferSlot* ReplayBuffer::get_slot(uint64_t sampleIdx) const
+{
+    return reinterpret_cast<ReplayBufferSlot*>(data + REPLAY_BUFFER_HEADER_SIZE + (sampleIdx % capacity) * slotSize);
+}
+
+bool ReplayBuffer::claim_slot(ReplayBufferSlot* slot, uint64_t sampleIdx)
+{
+    uint64_t sequence = slot->sequence.load(memory_order_acquire);
+    size_t yields = 0;
+    while (true) {
+        if ((sequence & ~REPLAY_BUFFER_WRITING_FLAG) > sampleIdx) {
+            // a lapping producer has already claimed the slot for a newer sample
+            return false;
+        }
+        if (sequence & REPLAY_BUFFER_WRITING_FLAG) {
+            // an older sample is still being written, its writer may still be running, so the slot is never taken over.
+            // A write which is more than one lap old has already been waited for by the previous lap.
+            const uint64_t writtenIdx = (sequence & ~REPLAY_BUFFER_WRITING_FLAG) - 1;
+            if (yields == REPLAY_BUFFER_MAX_CLAIM_YIELDS || writtenIdx + capacity < sampleIdx) {
+                return false;
+            }
+            this_thread::yield();
+            ++yields;
+            sequence = slot->sequence.load(memory_order_acquire);
+            continue;
+        }
+        if (slot->sequence.compare_exchange_weak(sequence, REPLAY_BUFFER_WRITING_FLAG | (sampleIdx + 1), memory_order_acq_rel)) {
+            return true;
+        }
+    }
+}
+
+uint64_t ReplayBuffer::append_game(const GameSamples& game, size_t numberSamples)
+{
+    if (numberSamples == 0) {
+        return header->writeIdx.load();
+    }
+    const bool sparsePolicy = game.gamePolicy.empty();
+    const uint64_t firstIdx = header->writeIdx.fetch_add(numberSamples);
+    const uint64_t lastIdx = firstIdx + numberSamples;
+    const uint64_t readIdx = header->readIdx.load(memory_order_relaxed);
+    if (lastIdx > readIdx + capacity) {
+        overwrittenSamples += min<uint64_t>(numberSamples, lastIdx - capacity - readIdx);
+    }
+
+    for (uint64_t sampleIdx = firstIdx; sampleIdx < lastIdx; ++sampleIdx) {
+        const size_t idx = sampleIdx - firstIdx;
+        ReplayBufferSlot* slot = get_slot(sampleIdx);
+        // invalidate the slot before it's overwritten
+        if (!claim_slot(slot, sampleIdx)) {
+            ++abortedSamples;
+            continue;
+        }
+        atomic_thread_fence(memory_order_release);
+
+        slot->value = game.gameValue[idx];
+        slot->isGameStart = idx == 0;
+        slot->bestMoveQ = game.gameBestMoveQ[idx];
+        int16_t* planes = reinterpret_cast<int16_t*>(slot + 1);
+        copy(game.gameX.begin() + idx * NB_VALUES_TOTAL, game.gameX.begin() + (idx + 1) * NB_VALUES_TOTAL, planes);
+        float* policy = reinterpret_cast<float*>(planes + NB_VALUES_TOTAL);
+        if (sparsePolicy) {
+            fill(policy, policy + NB_LABELS, 0.0f);
+            const size_t firstEntry = idx == 0 ? 0 : size_t(game.gamePolicyEnds[idx - 1]);
+            for (size_t entryIdx = firstEntry; entryIdx < size_t(game.gamePolicyEnds[idx]); ++entryIdx) {
+                policy[game.gamePolicyIndices[entryIdx]] = game.gamePolicyValues[entryIdx];
+            }
+        }
+        else {
+            copy(game.gamePolicy.begin() + idx * NB_LABELS, game.gamePolicy.begin() + (idx + 1) * NB_LABELS, policy);
+        }
+        // publish the sample, no other sample can claim the slot while it's being written
+        slot->sequence.store(sampleIdx + 1, memory_order_release);
+    }
+    return firstIdx;
+}
+
+size_t ReplayBuffer::get_overwritten_samples() const
+{
+    return overwrittenSamples;
+}
+
+size_t ReplayBuffer::get_aborted_samples() const
+{
+    return abortedSamples;
+}
+
+#endif
@@ -0,0 +1,165 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: replaybuffer.h
+ * Created on 19.10.2026
+ * @author: agent
+ *
+ * Memory-mapped ring buffer which streams the finished selfplay samples to a training process on the same host
+ * (e.g. a file in /dev/shm). Several selfplay processes can append to the same buffer.
+ * The oldest samples are overwritten when the buffer is full, the producers never wait for the consumer.
+ *
+ * Layout (little endian):
+ * - Header (REPLAY_BUFFER_HEADER_SIZE bytes, see ReplayBufferHeader)
+ *   0: magic "CZREPLAY", 8: uint32 version, 12: uint32 header size, 16: uint64 capacity (number of slots),
+ *   24: uint64 slot size in bytes, 32: uint32 number of plane values, 36: uint32 number of policy labels,
+ *   40: uint64 write index (number of reserved samples), 48: uint64 read index (number of consumed samples)
+ * - capacity slots of slot size bytes, the sample with index i is stored in slot i % capacity
+ *   0: uint64 sequence, 8: int16 value, 10: uint16 game start flag, 12: float32 best move Q-value,
+ *   16: int16 planes[number of plane values], followed by float32 policy[number of policy labels]
+ *
+ * A producer reserves a range of samples by incrementing the write index atomically. It claims the slot of each sample i
+ * by a compare-and-swap of the sequence to REPLAY_BUFFER_WRITING_FLAG | (i + 1), writes the sample and finally publishes it
+ * by a compare-and-swap to i + 1. If a producer lapped another one, the slot may already belong to a newer sample.
+ * The older sample is then aborted. A newer sample waits until the older write of its slot has been published.
+ * A slot is never taken over while its write is unfinished, because the older writer may still be copying into it.
+ * If the older write doesn't finish in time (e.g. because its process was killed), the newer sample is aborted instead,
+ * so the slot of a killed write stays unused until the buffer is recreated.
+ * A consumer reads the sample i if the sequence of its slot equals i + 1 before and after reading it,
+ * otherwise the sample is either incomplete, aborted or has already been overwritten.
+ * The read index is only updated by the consumer and used by the producers to count the overwritten samples.
+ * See rl/replay_buffer.py for a consumer.
+ */
+
+#ifndef REPLAYBUFFER_H
+#define REPLAYBUFFER_H
+
+#ifdef USE_RL
+#include <atomic>
+#include <string>
+#include "traindataexporter.h"
+
+using namespace std;
+
+const uint32_t REPLAY_BUFFER_VERSION = 1;
+const size_t REPLAY_BUFFER_HEADER_SIZE = 4096;
+const size_t REPLAY_BUFFER_SLOT_ALIGNMENT = 64;
+// marks the sequence of a slot which is currently written
+const uint64_t REPLAY_BUFFER_WRITING_FLAG = uint64_t(1) << 63;
+// number of yields after which a newer sample is aborted because the older write of its slot hasn't finished
+const size_t REPLAY_BUFFER_MAX_CLAIM_YIELDS = 100000;
+
+/**
+ * @brief The ReplayBufferHeader struct is stored at the beginning of the mapped file
+ */
+struct ReplayBufferHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t capacity;
+    uint64_t slotSize;
+    uint32_t numberValues;
+    uint32_t numberLabels;
+    atomic<uint64_t> writeIdx;
+    atomic<uint64_t> readIdx;
+};
+
+/**
+ * @brief The ReplayBufferSlot struct is the fixed part of each slot which is followed by the planes and the policy
+ */
+struct ReplayBufferSlot
+{
+    atomic<uint64_t> sequence;
+    int16_t value;
+    uint16_t isGameStart;
+    float bestMoveQ;
+};
+
+class ReplayBuffer
+{
+private:
+    string fileName;
+    int fileDescriptor;
+    char* data;
+    size_t fileSize;
+    size_t capacity;
+    size_t slotSize;
+    ReplayBufferHeader* header;
+    // number of unread samples which were overwritten by the samples of this object
+    atomic<size_t> overwrittenSamples;
+    // number of samples of this object which were aborted because their slot already belongs to a newer sample
+    atomic<size_t> abortedSamples;
+
+    /**
+     * @brief initialize_header Sets the header of a newly created buffer
+     */
+    void initialize_header();
+
+    /**
+     * @brief check_header Throws an invalid_argument exception if the header of an existing buffer doesn't match
+     */
+    void check_header() const;
+
+    ReplayBufferSlot* get_slot(uint64_t sampleIdx) const;
+
+    /**
+     * @brief claim_slot Marks the slot of the given sample as being written
+     * @param slot Slot of the sample
+     * @param sampleIdx Index of the sample
+     * @return False, if the slot already belongs to a newer sample or its older write didn't finish in time
+     * and the write must be aborted
+     */
+    bool claim_slot(ReplayBufferSlot* slot, uint64_t sampleIdx);
+
+public:
+    /**
+     * @brief ReplayBuffer Opens the buffer with the given file name or creates it if it doesn't exist yet
+     * @param fileName File which is mapped into memory (e.g. "/dev/shm/crazyara_replay")
+     * @param capacity Number of samples which the buffer holds, must match the capacity of an existing buffer
+     */
+    ReplayBuffer(const string& fileName, size_t capacity);
+    ~ReplayBuffer();
+    ReplayBuffer(const ReplayBuffer&) = delete;
+    ReplayBuffer& operator=(const ReplayBuffer&) = delete;
+
+    /**
+     * @brief append_game Appends the first numberSamples samples of a finished game (with the game result already applied).
+     * Dense and sparse policies are both stored as dense policies. This method is thread- and process-safe.
+     * @param game Samples of the game
+     * @param numberSamples Number of samples to append
+     * @return Index of the first sample of the game in the buffer
+     */
+    uint64_t append_game(const GameSamples& game, size_t numberSamples);
+
+    /**
+     * @brief get_overwritten_samples Returns the number of unread samples which were overwritten by the samples of this object
+     */
+    size_t get_overwritten_samples() const;
+
+    /**
+     * @brief get_aborted_samples Returns the number of samples of this object which weren't stored because a lapping producer
+     * already claimed their slot for a newer sample or the older write of their slot didn't finish in time
+     */
+    size_t get_aborted_samples() const;
+};
+#endif
+
+#endif // REPLAYBUFFER_H
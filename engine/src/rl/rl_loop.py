@@ -61,9 +61,23 @@ def compress_zarr_dataset(data, file_path, compression='lz4', clevel=5, start_id
     store = zarr.ZipStore(file_path, mode="w")
     zarr_file = zarr.group(store=store, overwrite=True)
 
+    # the flat arrays of a sparse policy are indexed by the policy offsets instead of the sample index
+    sparse_policy_keys = ["y_policy_indices", "y_policy_values"]
+    if "y_policy_offsets" in data.keys():
+        policy_ends = np.maximum.accumulate(np.array(data["y_policy_offsets"], dtype=np.int64))
+        if end_idx == 0:
+            entry_start_idx, entry_end_idx = 0, int(policy_ends[-1])
+        else:
+            entry_start_idx = int(policy_ends[start_idx - 1]) if start_idx > 0 else 0
+            entry_end_idx = int(policy_ends[end_idx - 1])
+
     nan_detected = False
     for key in data.keys():
-        if end_idx == 0:
+        if key in sparse_policy_keys:
+            x = data[key][entry_start_idx:entry_end_idx]
+        elif key == "y_policy_offsets":
+            x = policy_ends - entry_start_idx if end_idx == 0 else policy_ends[start_idx:end_idx] - entry_start_idx
+        elif end_idx == 0:
             x = data[key]
         else:
             x = data[key][start_idx:end_idx]
@@ -72,7 +86,7 @@ def compress_zarr_dataset(data, file_path, compression='lz4', clevel=5, start_id
             nan_detected = True
 
         array_shape = list(x.shape)
-        array_shape[0] = 128
+        array_shape[0] = 128 * 64 if key in sparse_policy_keys else 128
         # export array
         zarr_file.create_dataset(
             name=key,
@@ -30,6 +30,11 @@
 #include "thread.h"
 #include <iostream>
 #include <fstream>
+#include <thread>
+#include <functional>
+#include <sstream>
+#include <cstdio>
+#include <unistd.h>
 #include "uci.h"
 #include "chess_related/variants.h"
 #include "util/blazeutil.h"
@@ -49,7 +54,8 @@ void play_move_and_update(const EvalInfo& evalInfo, StateObj* state, GamePGN& ga
 
 SelfPlay::SelfPlay(RawNetAgent* rawAgent, MCTSAgent* mctsAgent, SearchLimits* searchLimits, PlaySettings* playSettings, RLSettings* rlSettings):
     rawAgent(rawAgent), mctsAgent(mctsAgent), searchLimits(searchLimits), playSettings(playSettings), rlSettings(rlSettings),
-    gameIdx(0), gamesPerMin(0), samplesPerMin(0)
+    gameIdx(0), gamesPerMin(0), samplesPerMin(0), generatedSamples(0), startedGames(0), exportedGames(0), resumedGames(0),
+    startedArenaPairs(0)
 {
     bool is960 = true;
 #ifdef MODE_CRAZYHOUSE
@@ -67,12 +73,34 @@ SelfPlay::SelfPlay(RawNetAgent* rawAgent, MCTSAgent* mctsAgent, SearchLimits* se
     gamePGN.date = "?";  // TODO: Change this later
     gamePGN.round = "?";
     gamePGN.is960 = false;
-    this->exporter = new TrainDataExporter(string("data_") + mctsAgent->get_device_name() + string(".zarr"),
-                                           rlSettings->numberChunks, rlSettings->chunkSize);
     filenamePGNSelfplay = string("games_") + mctsAgent->get_device_name() + string(".pgn");
     filenamePGNArena = string("arena_games_")+ mctsAgent->get_device_name() + string(".pgn");
     fileNameGameIdx = string("gameIdx_") + mctsAgent->get_device_name() + string(".txt");
-
+    fileNameCheckpoint = string("checkpoint_") + mctsAgent->get_device_name() + string(".bin");
+
+    const string fileNameExport = string("data_") + mctsAgent->get_device_name() + string(".zarr");
+    SelfPlayCheckpoint checkpoint;
+    const bool resume = rlSettings->checkpointGames != 0 && read_resumable_checkpoint(fileNameExport, checkpoint);
+    this->exporter = new TrainDataExporter(fileNameExport, rlSettings->numberChunks, rlSettings->chunkSize, rlSettings->packPlanes,
+                                           rlSettings->exportCompressor, rlSettings->exportCompressionLevel, rlSettings->sparsePolicy,
+                                           resume ? &checkpoint.exportCheckpoint : nullptr);
+    if (resume) {
+        // remove the games which were finished after the checkpoint
+        if (truncate(filenamePGNSelfplay.c_str(), off_t(checkpoint.pgnFileSize)) != 0) {
+            info_string("Warning: the pgn file couldn't be truncated:", filenamePGNSelfplay);
+        }
+        // every game thread continues with the generator state after its last exported game
+        resumedGeneratorStates = checkpoint.randomGeneratorStates;
+        resumedGames = checkpoint.generatedGames;
+        exportedGames = resumedGames;
+        info_string("resumed selfplay after game", resumedGames);
+    }
+    replayBuffer = nullptr;
+    openingPool = nullptr;
+    if (rlSettings->replayBufferFile != "") {
+        replayBuffer = new ReplayBuffer(rlSettings->replayBufferFile, rlSettings->replayBufferCapacity);
+        exporter->set_replay_buffer(replayBuffer);
+    }
     backupNodes = searchLimits->nodes;
     backupQValueWeight = mctsAgent->get_q_value_weight();
     backupDirichletEpsilon = mctsAgent->get_dirichlet_noise();
@@ -80,7 +108,52 @@ SelfPlay::SelfPlay(RawNetAgent* rawAgent, MCTSAgent* mctsAgent, SearchLimits* se
 
 SelfPlay::~SelfPlay()
 {
+    // the writer thread of the exporter appends to the replay buffer until it's stopped
     delete exporter;
+    delete replayBuffer;
+}
+
+bool SelfPlay::read_resumable_checkpoint(const string& fileNameExport, SelfPlayCheckpoint& checkpoint)
+{
+    try {
+        if (!read_checkpoint(fileNameCheckpoint, checkpoint)) {
+            return false;
+        }
+    }
+    catch (const invalid_argument& e) {
+        info_string("Warning: the selfplay checkpoint is ignored:", e.what());
+        return false;
+    }
+    const ExportCheckpoint& exported = checkpoint.exportCheckpoint;
+    if (exported.numberChunks != rlSettings->numberChunks || exported.chunkSize != rlSettings->chunkSize
+            || exported.packPlanes != rlSettings->packPlanes || exported.sparsePolicy != rlSettings->sparsePolicy) {
+        info_string("Warning: the selfplay checkpoint uses a different export format and is ignored");
+        return false;
+    }
+    if (!file_exists(fileNameExport) || get_file_size(filenamePGNSelfplay) < checkpoint.pgnFileSize) {
+        info_string("Warning: the data of the selfplay checkpoint is missing, the checkpoint is ignored");
+        return false;
+    }
+    return true;
+}
+
+void SelfPlay::request_checkpoint()
+{
+    SelfPlayCheckpoint checkpoint;
+    checkpoint.generatedGames = exportedGames;
+    checkpoint.pgnFileSize = get_file_size(filenamePGNSelfplay);
+    checkpoint.randomGeneratorStates = gameGeneratorStates;
+    // the checkpoint file is written by the writer thread of the exporter after the previously exported games
+    const string fileName = fileNameCheckpoint;
+    exporter->request_checkpoint([checkpoint, fileName](const ExportCheckpoint& exportCheckpoint) mutable {
+        checkpoint.exportCheckpoint = exportCheckpoint;
+        write_checkpoint(fileName, checkpoint);
+    });
+}
+
+void SelfPlay::set_opening_pool(OpeningPool* openingPool)
+{
+    this->openingPool = openingPool;
 }
 
 void SelfPlay::adjust_node_count(SearchLimits* searchLimits, int randInt)
@@ -95,14 +168,14 @@ bool SelfPlay::is_quick_search() {
     if (rlSettings->quickSearchProbability < 0.01f) {
         return false;
     }
-    return float(rand()) / RAND_MAX < rlSettings->quickSearchProbability;
+    return float(random_int()) / RAND_MAX < rlSettings->quickSearchProbability;
 }
 
 bool SelfPlay::is_resignation_allowed() {
     if (rlSettings->resignProbability < 0.01f) {
         return false;
     }
-    return float(rand()) / RAND_MAX < rlSettings->resignProbability;
+    return float(random_int()) / RAND_MAX < rlSettings->resignProbability;
 }
 
 void SelfPlay::check_for_resignation(const bool allowResingation, const EvalInfo &evalInfo, const StateObj* state, Result &gameResult)
@@ -120,76 +193,143 @@ void SelfPlay::check_for_resignation(const bool allowResingation, const EvalInfo
     }
 }
 
-void SelfPlay::reset_search_params(bool isQuickSearch)
+void SelfPlay::reset_search_params(SelfPlayGame& game, bool isQuickSearch)
 {
-    searchLimits->nodes = backupNodes;
+    game.searchLimits.nodes = backupNodes;
     if (isQuickSearch) {
-        mctsAgent->update_q_value_weight(backupQValueWeight);
-        mctsAgent->update_dirichlet_epsilon(backupDirichletEpsilon);
+        game.mctsAgent->update_q_value_weight(backupQValueWeight);
+        game.mctsAgent->update_dirichlet_epsilon(backupDirichletEpsilon);
     }
 }
 
-void SelfPlay::generate_game(Variant variant, bool verbose)
+void SelfPlay::generate_game(SelfPlayGame& game, Variant variant, size_t gameThreadIdx, bool verbose)
 {
-    chrono::steady_clock::time_point gameStartTime = chrono::steady_clock::now();
-
-    size_t ply = size_t(random_exponential<float>(1.0f/playSettings->meanInitPly) + 0.5f);
-    ply = clip_ply(ply, playSettings->maxInitPly);
-
-    srand(unsigned(int(time(nullptr))));
-    unique_ptr<StateObj> state= init_starting_state_from_raw_policy(*rawAgent, ply, gamePGN, variant, rlSettings->rawPolicyProbabilityTemperature);
+    unique_ptr<StateObj> state;
+    if (openingPool != nullptr) {
+        state = openingPool->get_opening(game.gamePGN);
+    }
+    else {
+        // the raw agent is shared by all game threads
+        lock_guard<mutex> lock(rawAgentMutex);
+        size_t ply = size_t(random_exponential<float>(1.0f/playSettings->meanInitPly) + 0.5f);
+        ply = clip_ply(ply, playSettings->maxInitPly);
+        state = init_starting_state_from_raw_policy(*rawAgent, ply, game.gamePGN, variant, rlSettings->rawPolicyProbabilityTemperature);
+    }
     EvalInfo evalInfo;
     Result gameResult;
-    exporter->new_game();
 
-    size_t generatedSamples = 0;
     const bool allowResignation = is_resignation_allowed();
     do {
-        searchLimits->startTime = now();
-        const int randInt = rand();
+        // a failed game thread or export stops all games after their current move
+        if (is_stopped()) {
+            clean_up(game.gamePGN, game.mctsAgent);
+            return;
+        }
+        game.searchLimits.startTime = now();
+        const int randInt = random_int();
         const bool isQuickSearch = is_quick_search();
 
         if (isQuickSearch) {
-            searchLimits->nodes = rlSettings->quickSearchNodes;
-            mctsAgent->update_q_value_weight(rlSettings->quickSearchQValueWeight);
-            mctsAgent->update_dirichlet_epsilon(rlSettings->quickDirichletEpsilon);
+            game.searchLimits.nodes = rlSettings->quickSearchNodes;
+            game.mctsAgent->update_q_value_weight(rlSettings->quickSearchQValueWeight);
+            game.mctsAgent->update_dirichlet_epsilon(rlSettings->quickDirichletEpsilon);
         }
-        adjust_node_count(searchLimits, randInt);
-        mctsAgent->set_search_settings(state.get(), searchLimits, &evalInfo);
-        mctsAgent->perform_action();
+        adjust_node_count(&game.searchLimits, randInt);
+        game.mctsAgent->set_search_settings(state.get(), &game.searchLimits, &evalInfo);
+        game.mctsAgent->perform_action();
         if (rlSettings->reuseTreeForSelpay) {
-            mctsAgent->apply_move_to_tree(evalInfo.bestMove, true);
+            game.mctsAgent->apply_move_to_tree(evalInfo.bestMove, true);
         }
 
         if (!isQuickSearch && !exporter->is_file_full()) {
             if (rlSettings->lowPolicyClipThreshold > 0) {
                 sharpen_distribution(evalInfo.policyProbSmall, rlSettings->lowPolicyClipThreshold);
             }
-            exporter->save_sample(state.get(), evalInfo);
-            ++generatedSamples;
+            exporter->save_sample(game.samples, state.get(), evalInfo);
         }
-        play_move_and_update(evalInfo, state.get(), gamePGN, gameResult);
-        reset_search_params(isQuickSearch);
+        play_move_and_update(evalInfo, state.get(), game.gamePGN, gameResult);
+        reset_search_params(game, isQuickSearch);
         check_for_resignation(allowResignation, evalInfo, state.get(), gameResult);
     }
     while(gameResult == NO_RESULT);
 
     // export all training samples of the generated game
-    exporter->export_game_samples(gameResult);
-
-    set_game_result_to_pgn(gameResult);
-    write_game_to_pgn(filenamePGNSelfplay, verbose);
-    clean_up(gamePGN, mctsAgent);
+    const size_t gameSamples = game.samples.numberSamples;
+    set_game_result_to_pgn(game.gamePGN, gameResult);
+    {
+        lock_guard<mutex> lock(checkpointMutex);
+        exporter->export_game_samples(game.samples, gameResult);
+        write_game_to_pgn(filenamePGNSelfplay, game.gamePGN, verbose);
+        ++exportedGames;
+        gameGeneratorStates[gameThreadIdx] = get_generator_state();
+        if (rlSettings->checkpointGames != 0 && exportedGames % rlSettings->checkpointGames == 0) {
+            request_checkpoint();
+        }
+    }
+    clean_up(game.gamePGN, game.mctsAgent);
 
     // measure time statistics
+    lock_guard<mutex> lock(statisticsMutex);
+    ++gameIdx;
+    generatedSamples += gameSamples;
     if (verbose) {
-        const float elapsedTimeMin = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - gameStartTime).count() / 60000.f;
-        speed_statistic_report(elapsedTimeMin, generatedSamples);
+        speed_statistic_report();
     }
-    ++gameIdx;
 }
 
-Result SelfPlay::generate_arena_game(MCTSAgent* whitePlayer, MCTSAgent* blackPlayer, Variant variant, bool verbose)
+void SelfPlay::generate_games(MCTSAgent* mctsAgent, size_t numberOfGames, Variant variant, size_t gameThreadIdx)
+{
+    // the generator of this thread samples the openings, the Dirichlet noise and the moves of all games of this thread
+    if (gameThreadIdx < resumedGeneratorStates.size()) {
+        set_generator_state(resumedGeneratorStates[gameThreadIdx]);
+    }
+    {
+        lock_guard<mutex> lock(checkpointMutex);
+        gameGeneratorStates[gameThreadIdx] = get_generator_state();
+    }
+    SelfPlayGame game;
+    game.samples = GameSamples(GAME_SAMPLES_CAPACITY, rlSettings->sparsePolicy);
+    game.mctsAgent = mctsAgent;
+    game.searchLimits = *searchLimits;
+    game.gamePGN = gamePGN;
+    game.gamePGN.white = mctsAgent->get_name();
+    game.gamePGN.black = mctsAgent->get_name();
+
+    try {
+        while (!is_stopped()) {
+            if (numberOfGames == 0) {
+                if (exporter->is_file_full()) {
+                    return;
+                }
+            }
+            else if (startedGames.fetch_add(1) >= numberOfGames) {
+                return;
+            }
+            generate_game(game, variant, gameThreadIdx, true);
+        }
+    }
+    catch (...) {
+        // an exception would terminate the program in a game thread, so it's rethrown by go_parallel() instead
+        lock_guard<mutex> lock(gameErrorMutex);
+        if (gameError == nullptr) {
+            gameError = current_exception();
+        }
+    }
+}
+
+bool SelfPlay::is_stopped()
+{
+    {
+        lock_guard<mutex> lock(gameErrorMutex);
+        if (gameError != nullptr) {
+            return true;
+        }
+    }
+    return exporter->has_writer_error();
+}
+
+Result SelfPlay::generate_arena_game(MCTSAgent* whitePlayer, MCTSAgent* blackPlayer, SearchLimits& gameSearchLimits, GamePGN& gamePGN,
+                                     Variant variant, bool verbose)
 {
     gamePGN.white = whitePlayer->get_name();
     gamePGN.black = blackPlayer->get_name();
@@ -201,7 +341,7 @@ Result SelfPlay::generate_arena_game(MCTSAgent* whitePlayer, MCTSAgent* blackPla
     // preserve the current active states
     Result gameResult;
     do {
-        searchLimits->startTime = now();
+        gameSearchLimits.startTime = now();
         if (state->side_to_move() == WHITE) {
             activePlayer = whitePlayer;
             passivePlayer = blackPlayer;
@@ -210,7 +350,7 @@ Result SelfPlay::generate_arena_game(MCTSAgent* whitePlayer, MCTSAgent* blackPla
             activePlayer = blackPlayer;
             passivePlayer = whitePlayer;
         }
-        activePlayer->set_search_settings(state.get(), searchLimits, &evalInfo);
+        activePlayer->set_search_settings(state.get(), &gameSearchLimits, &evalInfo);
         activePlayer->perform_action();
         activePlayer->apply_move_to_tree(evalInfo.bestMove, true);
         if (state->steps_from_null() != 0) {
@@ -219,8 +359,8 @@ Result SelfPlay::generate_arena_game(MCTSAgent* whitePlayer, MCTSAgent* blackPla
         play_move_and_update(evalInfo, state.get(), gamePGN, gameResult);
     }
     while(gameResult == NO_RESULT);
-    set_game_result_to_pgn(gameResult);
-    write_game_to_pgn(filenamePGNArena, verbose);
+    set_game_result_to_pgn(gamePGN, gameResult);
+    write_game_to_pgn(filenamePGNArena, gamePGN, verbose);
     clean_up(gamePGN, whitePlayer);
     blackPlayer->clear_game_history();
     return gameResult;
@@ -232,8 +372,9 @@ void clean_up(GamePGN& gamePGN, MCTSAgent* mctsAgent)
     mctsAgent->clear_game_history();
 }
 
-void SelfPlay::write_game_to_pgn(const std::string& pngFileName, bool verbose)
+void SelfPlay::write_game_to_pgn(const std::string& pngFileName, const GamePGN& gamePGN, bool verbose)
 {
+    lock_guard<mutex> lock(pgnMutex);
     ofstream pgnFile;
     pgnFile.open(pngFileName, std::ios_base::app);
     if (verbose) {
@@ -243,7 +384,7 @@ void SelfPlay::write_game_to_pgn(const std::string& pngFileName, bool verbose)
     pgnFile.close();
 }
 
-void SelfPlay::set_game_result_to_pgn(Result res)
+void SelfPlay::set_game_result_to_pgn(GamePGN& gamePGN, Result res)
 {
     gamePGN.result = result[res];
 }
@@ -253,13 +394,17 @@ void SelfPlay::reset_speed_statistics()
     gameIdx = 0;
     gamesPerMin = 0;
     samplesPerMin = 0;
+    generatedSamples = 0;
+    startedGames = 0;
+    selfplayStartTime = chrono::steady_clock::now();
 }
 
-void SelfPlay::speed_statistic_report(float elapsedTimeMin, size_t generatedSamples)
+void SelfPlay::speed_statistic_report()
 {
-    // compute running cumulative average
-    gamesPerMin = (gameIdx * gamesPerMin + (1 / elapsedTimeMin)) / (gameIdx + 1);
-    samplesPerMin = (gameIdx * samplesPerMin + (generatedSamples / elapsedTimeMin)) / (gameIdx + 1);
+    // the rates are computed over the wall clock time, so that all concurrently generated games are included
+    const float elapsedTimeMin = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - selfplayStartTime).count() / 60000.f;
+    gamesPerMin = (gameIdx - resumedGames) / elapsedTimeMin;
+    samplesPerMin = generatedSamples / elapsedTimeMin;
 
     cout << "    games    |  games/min  | samples/min " << endl
          << "-------------+-------------+-------------" << endl
@@ -279,54 +424,110 @@ void SelfPlay::export_number_generated_games() const
 
 
 void SelfPlay::go(size_t numberOfGames, Variant variant)
+{
+    go_parallel(numberOfGames, variant, {mctsAgent});
+}
+
+void SelfPlay::go_parallel(size_t numberOfGames, Variant variant, const vector<MCTSAgent*>& gameAgents)
 {
     reset_speed_statistics();
-    gamePGN.white = mctsAgent->get_name();
-    gamePGN.black = mctsAgent->get_name();
+    // the games of a resumed run count towards the requested number of games
+    gameIdx = resumedGames;
+    startedGames = resumedGames;
+    // rand() is only used by the search threads (e.g. random playouts) and isn't part of a checkpoint
+    srand(unsigned(int(time(nullptr))));
+    gameGeneratorStates.assign(gameAgents.size(), "");
+    vector<thread> gameThreads;
+    for (size_t idx = 1; idx < gameAgents.size(); ++idx) {
+        gameThreads.emplace_back(&SelfPlay::generate_games, this, gameAgents[idx], numberOfGames, variant, idx);
+    }
+    generate_games(gameAgents.front(), numberOfGames, variant, 0);
+    for (thread& gameThread : gameThreads) {
+        gameThread.join();
+    }
+    if (gameError != nullptr) {
+        const exception_ptr error = gameError;
+        gameError = nullptr;
+        rethrow_exception(error);
+    }
+    // rethrows an error of the writer thread if no game has received it
+    exporter->flush();
+    export_number_generated_games();
+    // the run is complete, so that the next run starts a new data set
+    remove(fileNameCheckpoint.c_str());
+    resumedGames = 0;
+    resumedGeneratorStates.clear();
+}
 
-    if (numberOfGames == 0) {
-        while(!exporter->is_file_full()) {
-            generate_game(variant, true);
-        }
+void add_game_result(TournamentResult& result, Result gameResult, bool isFirstPlayerWhite)
+{
+    if (gameResult == DRAWN) {
+        ++result.numberDraws;
+    }
+    else if ((gameResult == WHITE_WIN) == isFirstPlayerWhite) {
+        ++result.numberWins;
     }
     else {
-        for (size_t idx = 0; idx < numberOfGames; ++idx) {
-            generate_game(variant, true);
-        }
+        ++result.numberLosses;
     }
-    export_number_generated_games();
 }
 
-TournamentResult SelfPlay::go_arena(MCTSAgent *mctsContender, size_t numberOfGames, Variant variant)
+void SelfPlay::generate_arena_pairs(MCTSAgent* contender, MCTSAgent* producer, size_t numberOfGames, Variant variant, const SPRTSettings& sprtSettings)
 {
-    TournamentResult tournamentResult;
-    tournamentResult.playerA = mctsContender->get_name();
-    tournamentResult.playerB = mctsAgent->get_name();
-    Result gameResult;
-    for (size_t idx = 0; idx < numberOfGames; ++idx) {
-        if (idx % 2 == 0) {
-            gameResult = generate_arena_game(mctsContender, mctsAgent, variant, true);
-            if (gameResult == WHITE_WIN) {
-                ++tournamentResult.numberWins;
-            }
-            else {
-                ++tournamentResult.numberLosses;
+    SearchLimits gameSearchLimits = *searchLimits;
+    GamePGN arenaPGN = gamePGN;
+    while (true) {
+        size_t pairIdx;
+        {
+            lock_guard<mutex> lock(arenaMutex);
+            if (arenaResult.sprtResult != SPRT_UNDECIDED || 2 * startedArenaPairs >= numberOfGames) {
+                return;
             }
+            pairIdx = startedArenaPairs++;
         }
-        else {
-            gameResult = generate_arena_game(mctsAgent, mctsContender, variant, true);
-            if (gameResult == BLACK_WIN) {
-                ++tournamentResult.numberWins;
-            }
-            else {
-                ++tournamentResult.numberLosses;
-            }
+        // the contender plays white in the first game and black in the second game of the pair
+        TournamentResult pairResult;
+        add_game_result(pairResult, generate_arena_game(contender, producer, gameSearchLimits, arenaPGN, variant, true), true);
+        if (2 * pairIdx + 1 < numberOfGames) {
+            add_game_result(pairResult, generate_arena_game(producer, contender, gameSearchLimits, arenaPGN, variant, true), false);
         }
-        if (gameResult == DRAWN) {
-            ++tournamentResult.numberDraws;
+
+        lock_guard<mutex> lock(arenaMutex);
+        if (arenaResult.sprtResult == SPRT_UNDECIDED) {
+            arenaResult.numberWins += pairResult.numberWins;
+            arenaResult.numberDraws += pairResult.numberDraws;
+            arenaResult.numberLosses += pairResult.numberLosses;
+            if (sprtSettings.is_enabled()) {
+                arenaResult.update_sprt(sprtSettings);
+            }
         }
     }
-    return tournamentResult;
+}
+
+TournamentResult SelfPlay::go_arena(MCTSAgent *mctsContender, size_t numberOfGames, Variant variant)
+{
+    return go_arena_parallel(numberOfGames, variant, {mctsContender}, {mctsAgent});
+}
+
+TournamentResult SelfPlay::go_arena_parallel(size_t numberOfGames, Variant variant, const vector<MCTSAgent*>& contenders,
+                                             const vector<MCTSAgent*>& producers)
+{
+    arenaResult = TournamentResult();
+    arenaResult.playerA = contenders.front()->get_name();
+    arenaResult.playerB = producers.front()->get_name();
+    startedArenaPairs = 0;
+    const SPRTSettings sprtSettings = {rlSettings->sprtElo0, rlSettings->sprtElo1, rlSettings->sprtAlpha, rlSettings->sprtBeta};
+
+    vector<thread> pairThreads;
+    for (size_t idx = 1; idx < contenders.size(); ++idx) {
+        pairThreads.emplace_back(&SelfPlay::generate_arena_pairs, this, contenders[idx], producers[idx], numberOfGames, variant, cref(sprtSettings));
+    }
+    generate_arena_pairs(contenders.front(), producers.front(), numberOfGames, variant, sprtSettings);
+    for (thread& pairThread : pairThreads) {
+        pairThread.join();
+    }
+    arenaResult.numberGamesSaved = numberOfGames - min(numberOfGames, 2 * startedArenaPairs);
+    return arenaResult;
 }
 
 unique_ptr<StateObj> init_state(Variant variant, bool is960, GamePGN& gamePGN)
@@ -362,13 +563,9 @@ unique_ptr<StateObj> init_starting_state_from_raw_policy(RawNetAgent &rawAgent,
         const size_t moveIdx = random_choice(eval.policyProbSmall);
         eval.bestMove = eval.legalMoves[moveIdx];
 
-        if (state->leads_to_terminal(eval.bestMove)) {
+        if (!play_opening_move(state.get(), eval.bestMove, eval.legalMoves, gamePGN.gameMoves)) {
             break;
         }
-        else {
-            gamePGN.gameMoves.push_back(state->action_to_san(eval.legalMoves[moveIdx], eval.legalMoves, false, true));
-            state->do_action(eval.bestMove);
-        }
     }
     return state;
 }
@@ -376,16 +573,16 @@ unique_ptr<StateObj> init_starting_state_from_raw_policy(RawNetAgent &rawAgent,
 size_t clip_ply(size_t ply, size_t maxPly)
 {
     if (ply > maxPly) {
-        return size_t(rand()) % maxPly;
+        return size_t(random_int()) % maxPly;
     }
     return ply;
 }
 
 void apply_raw_policy_temp(EvalInfo &eval, float rawPolicyProbTemp)
 {
-    if (float(rand()) / RAND_MAX < rawPolicyProbTemp) {
+    if (float(random_int()) / RAND_MAX < rawPolicyProbTemp) {
         float temp = 2.0f;
-        const float prob = float(rand()) / INT_MAX;
+        const float prob = float(random_int()) / INT_MAX;
         if (prob < 0.05f) {
             temp = 10.0f;
         }
@@ -31,9 +31,15 @@
 #include "../agents/mctsagent.h"
 #include "../agents/rawnetagent.h"
 #include "gamepgn.h"
+#include "openingpool.h"
+#include "replaybuffer.h"
+#include "selfplaycheckpoint.h"
 #include "tournamentresult.h"
 #include "../agents/config/rlsettings.h"
 #include "../stateobj.h"
+#include <mutex>
+#include <atomic>
+#include <exception>
 
 
 #ifdef USE_RL
@@ -47,6 +53,19 @@
  */
 void play_move_and_update(const EvalInfo& evalInfo, StateObj* state, GamePGN& gamePGN, Result& gameResult);
 
+/**
+ * @brief The SelfPlayGame struct holds everything which belongs to a single game in selfplay mode,
+ * so that several games can be generated concurrently by the same SelfPlay object
+ */
+struct SelfPlayGame
+{
+    // agent with its own search tree and search settings
+    MCTSAgent* mctsAgent;
+    SearchLimits searchLimits;
+    GamePGN gamePGN;
+    GameSamples samples;
+};
+
 
 class SelfPlay
 {
@@ -58,12 +77,42 @@ private:
     RLSettings* rlSettings;
     GamePGN gamePGN;
     TrainDataExporter* exporter;
+    // optional replay buffer which streams the samples to a training process on the same host
+    ReplayBuffer* replayBuffer;
+    // optional pool of pre-generated starting positions, otherwise the openings are generated by the raw agent
+    OpeningPool* openingPool;
     string filenamePGNSelfplay;
     string filenamePGNArena;
     string fileNameGameIdx;
+    string fileNameCheckpoint;
     size_t gameIdx;
     float gamesPerMin;
     float samplesPerMin;
+    size_t generatedSamples;
+    chrono::steady_clock::time_point selfplayStartTime;
+    // number of games which have been started by all game threads
+    atomic<size_t> startedGames;
+    // number of games which have been exported and written to the pgn file (protected by checkpointMutex)
+    size_t exportedGames;
+    // number of games which had been generated before the run was resumed from a checkpoint
+    size_t resumedGames;
+    // random generator state of each game thread after its last exported game (protected by checkpointMutex)
+    vector<string> gameGeneratorStates;
+    // generator states of the game threads of the checkpoint from which the run was resumed
+    vector<string> resumedGeneratorStates;
+    // keeps the order of the exported games and the games in the pgn file equal, so that a checkpoint covers the same games
+    mutex checkpointMutex;
+    // protect the opening generation by the raw agent, the pgn file and the speed statistics
+    mutex rawAgentMutex;
+    mutex pgnMutex;
+    mutex statisticsMutex;
+    // result of the current arena match and the number of game pairs which have been started (protected by arenaMutex)
+    TournamentResult arenaResult;
+    size_t startedArenaPairs;
+    mutex arenaMutex;
+    // first exception of a game thread, which is rethrown by go_parallel() on the calling thread (protected by gameErrorMutex)
+    exception_ptr gameError;
+    mutex gameErrorMutex;
     size_t backupNodes;
     float backupDirichletEpsilon;
     float backupQValueWeight;
@@ -80,6 +129,12 @@ public:
     SelfPlay(RawNetAgent* rawAgent, MCTSAgent* mctsAgent,  SearchLimits* searchLimits, PlaySettings* playSettings, RLSettings* rlSettings);
     ~SelfPlay();
 
+    /**
+     * @brief set_opening_pool Sets the pool which provides the starting positions of the selfplay games
+     * @param openingPool Opening pool which must outlive the game generation (nullptr to use the raw agent)
+     */
+    void set_opening_pool(OpeningPool* openingPool);
+
     /**
      * @brief go Starts the self play game generation for a given number of games
      * @param numberOfGames Number of games to generate
@@ -87,6 +142,19 @@ public:
      */
     void go(size_t numberOfGames, Variant variant);
 
+    /**
+     * @brief go_parallel Generates the games concurrently with one game per given agent.
+     * Each game uses its own search tree and applies the RL settings independently.
+     * The agents are expected to share their networks (see SharedBatchAPI), so that the leaf evaluations of all games
+     * are batched together.
+     * If a game thread or the writer thread of the exporter fails, all games stop and the first exception is rethrown
+     * on the calling thread.
+     * @param numberOfGames Number of games to generate in total (0 generates games until the export file is full)
+     * @param variant Variant to generate games for
+     * @param gameAgents Agents which generate the games, the first agent is used by the calling thread
+     */
+    void go_parallel(size_t numberOfGames, Variant variant, const vector<MCTSAgent*>& gameAgents);
+
     /**
      * @brief go_arena Starts comparision matches between the original mctsAgent with the old NN weights and
      * the mctsContender which uses the new updated wieghts
@@ -98,34 +166,93 @@ public:
      */
     TournamentResult go_arena(MCTSAgent *mctsContender, size_t numberOfGames, Variant variant);
 
+    /**
+     * @brief go_arena_parallel Plays the arena match in game pairs with swapped colors. Each pair of agents plays its game pairs
+     * in a separate thread. If an SPRT is configured (see RLSettings), it is evaluated after each game pair and the match stops
+     * as soon as the contender is accepted or rejected. Game pairs which are still running at this point aren't counted.
+     * @param numberOfGames Maximum number of games to play
+     * @param variant Variant to generate games for
+     * @param contenders Agents using the new NN weights, one for each concurrent game pair
+     * @param producers Agents using the current NN weights, one for each concurrent game pair
+     * @return Result in respect to the contender
+     */
+    TournamentResult go_arena_parallel(size_t numberOfGames, Variant variant, const vector<MCTSAgent*>& contenders,
+                                       const vector<MCTSAgent*>& producers);
+
 private:
     /**
      * @brief generate_game Generates a new game in self play mode
+     * @param game Agent and state of the game slot
+     * @param variant Current chess variant
+     * @param gameThreadIdx Index of the calling game thread
+     */
+    void generate_game(SelfPlayGame& game, Variant variant, size_t gameThreadIdx, bool verbose);
+
+    /**
+     * @brief generate_games Generates games with the given agent until the requested number of games has been started
+     * @param mctsAgent Agent which is used for all games of this thread
+     * @param numberOfGames Number of games to generate in total (0 generates games until the export file is full)
+     * @param variant Current chess variant
+     * @param gameThreadIdx Index of the game thread, which selects its generator state in a checkpoint
+     */
+    void generate_games(MCTSAgent* mctsAgent, size_t numberOfGames, Variant variant, size_t gameThreadIdx);
+
+    /**
+     * @brief is_stopped Returns true if a game thread or the writer thread of the exporter has failed
+     */
+    bool is_stopped();
+
+    /**
+     * @brief generate_arena_pairs Plays game pairs with the given agents until all games have been started or the SPRT is decided
+     * @param contender MCTSAgent using the new NN weights
+     * @param producer MCTSAgent using the current NN weights
+     * @param numberOfGames Maximum number of games of the arena match
      * @param variant Current chess variant
+     * @param sprtSettings SPRT which is evaluated after each game pair
      */
-    void generate_game(Variant variant, bool verbose);
+    void generate_arena_pairs(MCTSAgent* contender, MCTSAgent* producer, size_t numberOfGames, Variant variant, const SPRTSettings& sprtSettings);
 
     /**
      * @brief generate_arena_game Generates a game of the current NN weights vs the new acquired weights
      * @param whitePlayer MCTSAgent which will play with the white pieces
      * @param blackPlayer MCTSAgent which will play with the black pieces
+     * @param gameSearchLimits Search limits of the game
+     * @param gamePGN Game log which receives the moves
      * @param variant Current chess variant
      * @param verbose If true the games will printed to stdout
      */
-    Result generate_arena_game(MCTSAgent *whitePlayer, MCTSAgent *blackPlayer, Variant variant, bool verbose);
+    Result generate_arena_game(MCTSAgent *whitePlayer, MCTSAgent *blackPlayer, SearchLimits& gameSearchLimits, GamePGN& gamePGN,
+                               Variant variant, bool verbose);
+
+    /**
+     * @brief read_resumable_checkpoint Reads the checkpoint of a previous run and checks if the run can be resumed
+     * with the current settings
+     * @param fileNameExport File name of the data set
+     * @param checkpoint Receives the checkpoint
+     * @return True if the run can be resumed
+     */
+    bool read_resumable_checkpoint(const string& fileNameExport, SelfPlayCheckpoint& checkpoint);
+
+    /**
+     * @brief request_checkpoint Requests a checkpoint of the current run, which is written by the writer thread of the exporter.
+     * checkpointMutex must be held.
+     */
+    void request_checkpoint();
 
     /**
      * @brief write_game_to_pgn Writes the game log to a pgn file
      * @param pngFileName Filename to export
+     * @param gamePGN Game to export
      * @param verbose If true, game will also be printed to stdout
      */
-    void write_game_to_pgn(const std::string& pngFileName, bool verbose);
+    void write_game_to_pgn(const std::string& pngFileName, const GamePGN& gamePGN, bool verbose);
 
     /**
      * @brief set_game_result Sets the game result to the gamePGN object
+     * @param gamePGN Game which receives the result
      * @param res Game result
      */
-    void set_game_result_to_pgn(Result res);
+    void set_game_result_to_pgn(GamePGN& gamePGN, Result res);
 
     /**
      * @brief reset_speed_statistics Resets the interal measurements for gameIdx, gamesPerMin and samplesPerMin
@@ -133,9 +260,10 @@ private:
     void reset_speed_statistics();
 
     /**
-     * @brief speed_statistic_report Updates the speed statistics and prints a summary to std-out
+     * @brief speed_statistic_report Updates the speed statistics after a finished game and prints a summary to std-out.
+     * The rates are measured over the wall clock time since the start of the selfplay, so that they include all concurrent games.
      */
-    void speed_statistic_report(float elapsedTimeMin, size_t generatedSamples);
+    void speed_statistic_report();
 
     /**
      * @brief export_number_generated_games Creates a file which describes how many games have been generated in the newly created .zip-file
@@ -172,9 +300,10 @@ private:
 
     /**
      * @brief reset_search_params Resets all search parameters to their initial values
+     * @param game Game slot whose agent and search limits are reset
      * @param Signals if a quick search was done
      */
-    void reset_search_params(bool isQuickSearch);
+    void reset_search_params(SelfPlayGame& game, bool isQuickSearch);
 };
 #endif
 
@@ -188,6 +317,14 @@ private:
  */
 void clean_up(GamePGN& gamePGN, MCTSAgent* mctsAgent);
 
+/**
+ * @brief add_game_result Adds the result of a single game to the tournament result of the first player
+ * @param result Tournament result with respect to the first player
+ * @param gameResult Result of the game
+ * @param isFirstPlayerWhite True if the first player played with the white pieces
+ */
+void add_game_result(TournamentResult& result, Result gameResult, bool isFirstPlayerWhite);
+
 /**
  * @brief init_board Initialies a new board with the starting position of the variant
  * @param variant Variant to be played
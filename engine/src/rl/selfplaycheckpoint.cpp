@@ -0,0 +1,165 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: selfplaycheckpoint.cpp
+ * Created on 19.10.2026
+ * @author: agent
+ */
+
+#ifdef USE_RL
+#include "selfplaycheckpoint.h"
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+template<typename T>
+void write_array(ofstream& file, const vector<T>& values)
+{
+    file.write(reinterpret_cast<const char*>(values.data()), streamsize(values.size() * sizeof(T)));
+}
+
+template<typename T>
+void read_array(ifstream& file, vector<T>& values, size_t length)
+{
+    values.resize(length);
+    file.read(reinterpret_cast<char*>(values.data()), streamsize(length * sizeof(T)));
+}
+
+void write_checkpoint(const string& fileName, const SelfPlayCheckpoint& checkpoint)
+{
+    const ExportCheckpoint& exported = checkpoint.exportCheckpoint;
+    const GameSamples& staged = exported.stagedSamples;
+    nlohmann::json header;
+    header["version"] = SELFPLAY_CHECKPOINT_VERSION;
+    header["numberValues"] = NB_VALUES_TOTAL;
+    header["numberLabels"] = NB_LABELS;
+    header["numberChunks"] = exported.numberChunks;
+    header["chunkSize"] = exported.chunkSize;
+    header["packPlanes"] = exported.packPlanes;
+    header["sparsePolicy"] = exported.sparsePolicy;
+    header["gameIdx"] = exported.gameIdx;
+    header["startIdx"] = exported.startIdx;
+    header["startEntryIdx"] = exported.startEntryIdx;
+    header["stagedSamples"] = staged.numberSamples;
+    header["stagedPolicyEntries"] = exported.stagedPolicyIndices.size();
+    header["startIndices"] = exported.startIndices.size();
+    header["generatedGames"] = checkpoint.generatedGames;
+    header["pgnFileSize"] = checkpoint.pgnFileSize;
+    header["randomGeneratorStates"] = checkpoint.randomGeneratorStates;
+
+    const string tmpFileName = fileName + ".tmp";
+    ofstream file(tmpFileName, ios::binary | ios::trunc);
+    file << header.dump() << '\n';
+    write_array(file, staged.gameX);
+    write_array(file, staged.gameValue);
+    write_array(file, staged.gameBestMoveQ);
+    if (exported.sparsePolicy) {
+        write_array(file, staged.gamePolicyEnds);
+    }
+    else {
+        write_array(file, staged.gamePolicy);
+    }
+    write_array(file, exported.stagedPolicyIndices);
+    write_array(file, exported.stagedPolicyValues);
+    write_array(file, exported.startIndices);
+    file.close();
+    if (!file) {
+        throw invalid_argument("The checkpoint " + tmpFileName + " can't be written");
+    }
+    // the previous checkpoint is replaced atomically
+    if (rename(tmpFileName.c_str(), fileName.c_str()) != 0) {
+        throw invalid_argument("The checkpoint " + tmpFileName + " can't be renamed to " + fileName);
+    }
+}
+
+bool read_checkpoint(const string& fileName, SelfPlayCheckpoint& checkpoint)
+{
+    ifstream file(fileName, ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    string headerLine;
+    getline(file, headerLine);
+    nlohmann::json header;
+    try {
+        header = nlohmann::json::parse(headerLine);
+        if (header.at("version").get<int>() != SELFPLAY_CHECKPOINT_VERSION || header.at("numberValues").get<size_t>() != NB_VALUES_TOTAL
+                || header.at("numberLabels").get<size_t>() != NB_LABELS) {
+            throw invalid_argument("The checkpoint " + fileName + " was created by a different version or input representation");
+        }
+        ExportCheckpoint& exported = checkpoint.exportCheckpoint;
+        exported.numberChunks = header.at("numberChunks").get<size_t>();
+        exported.chunkSize = header.at("chunkSize").get<size_t>();
+        exported.packPlanes = header.at("packPlanes").get<bool>();
+        exported.sparsePolicy = header.at("sparsePolicy").get<bool>();
+        exported.gameIdx = header.at("gameIdx").get<size_t>();
+        exported.startIdx = header.at("startIdx").get<size_t>();
+        exported.startEntryIdx = header.at("startEntryIdx").get<size_t>();
+        checkpoint.generatedGames = header.at("generatedGames").get<size_t>();
+        checkpoint.pgnFileSize = header.at("pgnFileSize").get<size_t>();
+        checkpoint.randomGeneratorStates = header.at("randomGeneratorStates").get<vector<string>>();
+    }
+    catch (const nlohmann::json::exception& e) {
+        throw invalid_argument("The checkpoint " + fileName + " has an invalid header: " + e.what());
+    }
+
+    ExportCheckpoint& exported = checkpoint.exportCheckpoint;
+    GameSamples& staged = exported.stagedSamples;
+    staged.clear();
+    staged.numberSamples = header["stagedSamples"].get<size_t>();
+    const size_t stagedPolicyEntries = header["stagedPolicyEntries"].get<size_t>();
+    if (staged.numberSamples >= exported.chunkSize || stagedPolicyEntries >= exported.chunkSize * SPARSE_POLICY_CHUNK_ENTRIES_PER_SAMPLE
+            || header["startIndices"].get<size_t>() > exported.chunkSize) {
+        throw invalid_argument("The checkpoint " + fileName + " has invalid array lengths");
+    }
+    read_array(file, staged.gameX, staged.numberSamples * NB_VALUES_TOTAL);
+    read_array(file, staged.gameValue, staged.numberSamples);
+    read_array(file, staged.gameBestMoveQ, staged.numberSamples);
+    if (exported.sparsePolicy) {
+        read_array(file, staged.gamePolicyEnds, staged.numberSamples);
+    }
+    else {
+        read_array(file, staged.gamePolicy, staged.numberSamples * NB_LABELS);
+    }
+    read_array(file, exported.stagedPolicyIndices, stagedPolicyEntries);
+    read_array(file, exported.stagedPolicyValues, stagedPolicyEntries);
+    read_array(file, exported.startIndices, header["startIndices"].get<size_t>());
+    if (!file || file.peek() != EOF) {
+        throw invalid_argument("The checkpoint " + fileName + " is truncated or has trailing data");
+    }
+    return true;
+}
+
+size_t get_file_size(const string& fileName)
+{
+    struct stat fileStat;
+    if (stat(fileName.c_str(), &fileStat) != 0) {
+        return 0;
+    }
+    return size_t(fileStat.st_size);
+}
+
+bool file_exists(const string& fileName)
+{
+    struct stat fileStat;
+    return stat(fileName.c_str(), &fileStat) == 0;
+}
+#endif
@@ -0,0 +1,89 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: selfplaycheckpoint.h
+ * Created on 19.10.2026
+ * @author: agent
+ *
+ * Checkpoint of a selfplay run which allows a restarted process to continue the data set and the pgn file
+ * of a crashed process. The checkpoint file is replaced atomically by renaming a temporary file.
+ *
+ * Layout: a single line with a json header which describes the scalar values and the array lengths,
+ * followed by the arrays of the ExportCheckpoint in binary form (native byte order):
+ * int16 planes, int16 values, float32 best move Q-values, float32 dense policies or int64 policy ends,
+ * int16 sparse policy indices, float32 sparse policy values, int32 start indices
+ */
+
+#ifndef SELFPLAYCHECKPOINT_H
+#define SELFPLAYCHECKPOINT_H
+
+#ifdef USE_RL
+#include <string>
+#include "traindataexporter.h"
+
+using namespace std;
+
+const int SELFPLAY_CHECKPOINT_VERSION = 2;
+
+/**
+ * @brief The SelfPlayCheckpoint struct describes the state of a selfplay run after a number of finished games
+ */
+struct SelfPlayCheckpoint
+{
+    ExportCheckpoint exportCheckpoint;
+    // number of finished games, including the games which weren't exported (e.g. without any samples)
+    size_t generatedGames;
+    // size of the pgn file which contains exactly the finished games
+    size_t pgnFileSize;
+    // random generator state of each game thread after its last exported game. The generator of a game thread draws
+    // the openings, the node count randomization, quick searches, resignations, Dirichlet noise and sampled moves.
+    // Only the generator of the opening pool's thread and rand() of the search threads (random playouts) aren't saved.
+    vector<string> randomGeneratorStates;
+};
+
+/**
+ * @brief write_checkpoint Writes the checkpoint to a temporary file and renames it to the given file name,
+ * so that the file always contains a complete checkpoint
+ * @param fileName Checkpoint file
+ * @param checkpoint Checkpoint to write
+ */
+void write_checkpoint(const string& fileName, const SelfPlayCheckpoint& checkpoint);
+
+/**
+ * @brief read_checkpoint Reads a checkpoint which has been written by write_checkpoint().
+ * Throws an invalid_argument exception if the file isn't a valid checkpoint.
+ * @param fileName Checkpoint file
+ * @param checkpoint Receives the checkpoint
+ * @return False if the file doesn't exist, else true
+ */
+bool read_checkpoint(const string& fileName, SelfPlayCheckpoint& checkpoint);
+
+/**
+ * @brief get_file_size Returns the size of a file in bytes or 0 if it doesn't exist
+ */
+size_t get_file_size(const string& fileName);
+
+/**
+ * @brief file_exists Returns true if a file or directory with the given name exists
+ */
+bool file_exists(const string& fileName);
+#endif
+
+#endif // SELFPLAYCHECKPOINT_H
@@ -25,11 +25,20 @@
 
 #include "tournamentresult.h"
 #include <iomanip>
+#include <cmath>
+
+bool SPRTSettings::is_enabled() const
+{
+    return elo1 > elo0 && alpha > 0 && beta > 0;
+}
 
 TournamentResult::TournamentResult() :
     numberWins(0),
     numberDraws(0),
-    numberLosses(0)
+    numberLosses(0),
+    llr(0),
+    sprtResult(SPRT_UNDECIDED),
+    numberGamesSaved(0)
 {
 }
 
@@ -44,11 +53,41 @@ float TournamentResult::score() const
     return (numberWins + numberDraws * 0.5f)/ numberGames();
 }
 
+void TournamentResult::update_sprt(const SPRTSettings& settings)
+{
+    const size_t games = numberGames();
+    if (games == 0) {
+        return;
+    }
+    const double win = double(numberWins) / games;
+    const double draw = double(numberDraws) / games;
+    const double mean = win + draw / 2;
+    const double variance = win + draw / 4 - mean * mean;
+    // the variance is still unknown if all games had the same result
+    if (variance <= 0) {
+        return;
+    }
+    const double score0 = elo_to_score(settings.elo0);
+    const double score1 = elo_to_score(settings.elo1);
+    llr = float(games * (score1 - score0) * (2 * mean - score0 - score1) / (2 * variance));
+    if (llr >= log((1 - settings.beta) / settings.alpha)) {
+        sprtResult = SPRT_ACCEPTED;
+    }
+    else if (llr <= log(settings.beta / (1 - settings.alpha))) {
+        sprtResult = SPRT_REJECTED;
+    }
+}
+
+float elo_to_score(float elo)
+{
+    return 1.0f / (1.0f + pow(10.0f, -elo / 400.0f));
+}
+
 std::ostream &operator<<(std::ostream &os, const TournamentResult &result)
 {
     os << result.playerA << "-" << result.playerB << ": " << result.numberWins
        << " - " << result.numberDraws << " - " << result.numberLosses << " [" <<
-          std::setprecision(2) << result.score() << "]";
+          std::setprecision(2) << result.score() << "] LLR: " << result.llr;
     return os;
 }
 
@@ -58,6 +97,7 @@ void write_tournament_result_to_csv(const TournamentResult &result, const string
     const char delim = ',';
     csvFile.open(csvFileName, std::ios_base::app);
     csvFile << result.playerA << delim << result.playerB << delim
-         << result.numberWins << delim << result.numberDraws << delim << result.numberLosses << endl;
+         << result.numberWins << delim << result.numberDraws << delim << result.numberLosses << delim
+         << result.llr << delim << result.numberGamesSaved << endl;
     csvFile.close();
 }
@@ -37,6 +37,30 @@
 
 using namespace std;
 
+enum SPRTResult {
+    SPRT_UNDECIDED,
+    SPRT_ACCEPTED,
+    SPRT_REJECTED
+};
+
+/**
+ * @brief The SPRTSettings struct describes a sequential probability ratio test of the hypothesis H1: elo >= elo1
+ * against H0: elo <= elo0 with respect to the first player
+ */
+struct SPRTSettings {
+    float elo0;
+    float elo1;
+    // probability of accepting H1 although H0 is true
+    float alpha;
+    // probability of accepting H0 although H1 is true
+    float beta;
+
+    /**
+     * @brief is_enabled Returns true if the elo bounds describe a valid test
+     */
+    bool is_enabled() const;
+};
+
 struct TournamentResult {
 
     string playerA;
@@ -44,6 +68,11 @@ struct TournamentResult {
     size_t numberWins;
     size_t numberDraws;
     size_t numberLosses;
+    // log-likelihood ratio of the sequential probability ratio test after the last game pair
+    float llr;
+    SPRTResult sprtResult;
+    // number of games which weren't played because the test was decided early
+    size_t numberGamesSaved;
 
     TournamentResult();
 
@@ -59,11 +88,23 @@ struct TournamentResult {
      * @return score value
      */
      float score() const;
+
+    /**
+     * @brief update_sprt Computes the log-likelihood ratio of the current result with the trinomial model
+     * and sets the SPRT result if one of the bounds log(beta / (1 - alpha)) or log((1 - beta) / alpha) is reached
+     * @param settings Elo bounds and error rates of the test
+     */
+    void update_sprt(const SPRTSettings& settings);
 };
 
+/**
+ * @brief elo_to_score Returns the expected score for a given elo difference
+ */
+float elo_to_score(float elo);
+
 /**
  * @brief operator << Returns ostream for trounament result summary in the form
- *  "<PLAYER_A>-<PLAYER_B>: <NUMBER_WINS> - <NUMBER_DRAWS> - <NUMBER_LOSSES> [<SCORE>]"
+ *  "<PLAYER_A>-<PLAYER_B>: <NUMBER_WINS> - <NUMBER_DRAWS> - <NUMBER_LOSSES> [<SCORE>] LLR: <LLR>"
  * @param os ostream
  * @param result Tournament result to print
  * @return osream
@@ -72,7 +113,7 @@ extern std::ostream& operator<<(std::ostream& os, const TournamentResult& result
 
 /**
  * @brief write_tournament_result_to_csv Appends the result of the tournamet to a given csvFile.
- * <playerA>,<playerB>,<numberWinsA>,<numberDrawsA>,<numberLossesA>,
+ * <playerA>,<playerB>,<numberWinsA>,<numberDrawsA>,<numberLossesA>,<llr>,<numberGamesSaved>
  * @param csvFileName Filename of the csv
  */
 void write_tournament_result_to_csv(const TournamentResult& result, const std::string& csvFileName);
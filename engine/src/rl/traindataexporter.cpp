@@ -26,93 +26,533 @@
 #ifdef USE_RL
 #include "traindataexporter.h"
 #include <inttypes.h>
+#include <cstdio>
+#include <stdexcept>
+#include "xtensor/xadapt.hpp"
+#include "replaybuffer.h"
 #include "../util/communication.h"
 
-void TrainDataExporter::save_sample(const StateObj* pos, const EvalInfo& eval)
+GameSamples::GameSamples(size_t capacity, bool sparsePolicy):
+    numberSamples(0)
 {
-    if (startIdx+curSampleIdx >= numberSamples) {
+    gameX.reserve(capacity * NB_VALUES_TOTAL);
+    gameValue.reserve(capacity);
+    if (sparsePolicy) {
+        gamePolicyIndices.reserve(capacity * SPARSE_POLICY_CHUNK_ENTRIES_PER_SAMPLE);
+        gamePolicyValues.reserve(capacity * SPARSE_POLICY_CHUNK_ENTRIES_PER_SAMPLE);
+        gamePolicyEnds.reserve(capacity);
+    }
+    else {
+        gamePolicy.reserve(capacity * NB_LABELS);
+    }
+    gameBestMoveQ.reserve(capacity);
+}
+
+void GameSamples::clear()
+{
+    gameX.clear();
+    gameValue.clear();
+    gamePolicy.clear();
+    gameBestMoveQ.clear();
+    gamePolicyIndices.clear();
+    gamePolicyValues.clear();
+    gamePolicyEnds.clear();
+    numberSamples = 0;
+}
+
+void TrainDataExporter::save_sample(GameSamples& game, const StateObj* pos, const EvalInfo& eval)
+{
+    if (game.numberSamples >= numberSamples) {
         info_string("Extended number of maximum samples");
         return;
     }
-    save_planes(pos);
-    save_policy(eval.legalMoves, eval.policyProbSmall, Color(pos->side_to_move()));
-    save_best_move_q(eval);
-    save_side_to_move(Color(pos->side_to_move()));
-    ++curSampleIdx;
+    save_planes(game, pos);
+    save_policy(game, eval.legalMoves, eval.policyProbSmall, Color(pos->side_to_move()));
+    save_best_move_q(game, eval);
+    save_side_to_move(game, Color(pos->side_to_move()));
     // value will be set later in export_game_result()
-    firstMove = false;
+    ++game.numberSamples;
 }
 
-void TrainDataExporter::save_best_move_q(const EvalInfo &eval)
+void TrainDataExporter::save_best_move_q(GameSamples& game, const EvalInfo &eval)
 {
     // Q value of "best" move (a.k.a selected move after mcts search)
-    xt::xarray<float> qArray({ 1 }, eval.bestMoveQ[0]);
+    game.gameBestMoveQ.push_back(eval.bestMoveQ[0]);
+}
 
-    if (firstMove) {
-        gameBestMoveQ = qArray;
+void TrainDataExporter::save_side_to_move(GameSamples& game, Color col)
+{
+    // in the case of WHITE a +1 is saved else -1 for BLACK
+    game.gameValue.push_back(int16_t(-(col * 2 - 1)));
+}
+
+void TrainDataExporter::export_game_samples(GameSamples& game, Result result) {
+    unique_lock<mutex> lock(mtx);
+    // backpressure: wait for the writer if too many games are queued
+    queueCondition.wait(lock, [&]{ return exportQueue.size() < EXPORT_QUEUE_CAPACITY || writerError != nullptr; });
+    rethrow_writer_error();
+    if (startIdx >= numberSamples || game.numberSamples == 0) {
+        if (game.numberSamples != 0) {
+            info_string("Extended number of maximum samples");
+        }
+        game.clear();
+        return;
+    }
+
+    // game value update
+    apply_result_to_value(game, result);
+
+    // reserve the range of the game, the games are queued in the order of their ranges
+    ExportJob job;
+    // drop the samples which exceed the data set (e.g. when several games were generated concurrently)
+    job.numberSamples = min(game.numberSamples, numberSamples - startIdx);
+    if (sparsePolicy) {
+        while (job.numberSamples != 0 && startEntryIdx + size_t(game.gamePolicyEnds[job.numberSamples - 1]) > policyEntryCapacity) {
+            --job.numberSamples;
+        }
+        if (job.numberSamples == 0) {
+            info_string("Extended number of maximum policy entries");
+            // the data set is treated as full
+            startIdx = numberSamples;
+            game.clear();
+            return;
+        }
+        startEntryIdx += size_t(game.gamePolicyEnds[job.numberSamples - 1]);
+    }
+    startIdx += job.numberSamples;
+    gameIdx++;
+    job.nextGameIdx = gameIdx;
+    job.nextStartIdx = startIdx;
+    job.nextEntryIdx = startEntryIdx;
+
+    // hand the buffers over to the writer and continue with recycled ones
+    swap(job.samples, game);
+    if (!freeBuffers.empty()) {
+        swap(game, freeBuffers.back());
+        freeBuffers.pop_back();
     }
     else {
-        // concatenate the sample to array for the current game
-        gameBestMoveQ = xt::concatenate(xtuple(gameBestMoveQ, qArray));
+        game = GameSamples(GAME_SAMPLES_CAPACITY, sparsePolicy);
     }
+    exportQueue.emplace_back(move(job));
+    maxQueueDepth = max(maxQueueDepth, exportQueue.size());
+    queueDepthSum += exportQueue.size();
+    ++numberQueuedGames;
+    lock.unlock();
+    queueCondition.notify_all();
 }
 
-void TrainDataExporter::save_side_to_move(Color col)
+void TrainDataExporter::stage_game(ExportJob& job)
 {
-    // in the case of WHITE a +1 is saved else -1 for BLACK
-    xt::xarray<int16_t> valueArray({ 1 }, -(col * 2 - 1));
+    const GameSamples& game = job.samples;
+    if (pendingStartIndices.empty()) {
+        firstPendingGameIdx = job.nextGameIdx;
+    }
+    pendingStartIndices.push_back(int32_t(job.nextStartIdx));
+    if (job.nextGameIdx % chunkSize == 0) {
+        startIndicesTail.clear();
+    }
+    startIndicesTail.push_back(int32_t(job.nextStartIdx));
+    writtenGameIdx = job.nextGameIdx;
+    writtenStartIdx = job.nextStartIdx;
+    writtenEntryIdx = job.nextEntryIdx;
+
+    size_t copiedSamples = 0;
+    while (copiedSamples < job.numberSamples) {
+        const size_t length = min(job.numberSamples - copiedSamples, chunkSize - stagedChunk.numberSamples);
+        const size_t first = copiedSamples;
+        const size_t last = copiedSamples + length;
+        stagedChunk.gameX.insert(stagedChunk.gameX.end(), game.gameX.begin() + first * NB_VALUES_TOTAL, game.gameX.begin() + last * NB_VALUES_TOTAL);
+        stagedChunk.gameValue.insert(stagedChunk.gameValue.end(), game.gameValue.begin() + first, game.gameValue.begin() + last);
+        if (sparsePolicy) {
+            stage_policy_entries(game, first, last);
+        }
+        else {
+            stagedChunk.gamePolicy.insert(stagedChunk.gamePolicy.end(), game.gamePolicy.begin() + first * NB_LABELS, game.gamePolicy.begin() + last * NB_LABELS);
+        }
+        stagedChunk.gameBestMoveQ.insert(stagedChunk.gameBestMoveQ.end(), game.gameBestMoveQ.begin() + first, game.gameBestMoveQ.begin() + last);
+        stagedChunk.numberSamples += length;
+        isStagedChunkWritten = false;
+        copiedSamples = last;
+        if (stagedChunk.numberSamples == chunkSize) {
+            write_staged_chunk();
+        }
+    }
+}
+
+void TrainDataExporter::write_staged_chunk()
+{
+    const size_t stagedSamples = stagedChunk.numberSamples;
+    if (stagedSamples != 0 && !isStagedChunkWritten) {
+        // the buffers are wrapped without copying them
+        const vector<size_t> shapeValue = { stagedSamples };
+        auto chunkValue = xt::adapt(stagedChunk.gameValue.data(), stagedSamples, xt::no_ownership(), shapeValue);
+        auto chunkBestMoveQ = xt::adapt(stagedChunk.gameBestMoveQ.data(), stagedSamples, xt::no_ownership(), shapeValue);
+
+        // write value to roi
+        z5::types::ShapeType offset = { stagedChunkIdx };
+        if (packPlanes) {
+            pack_staged_planes();
+            const vector<size_t> shapePacked = { stagedSamples, NB_CHANNELS_TOTAL };
+            auto chunkMasks = xt::adapt(packedMasks.data(), packedMasks.size(), xt::no_ownership(), shapePacked);
+            auto chunkScalars = xt::adapt(packedScalars.data(), packedScalars.size(), xt::no_ownership(), shapePacked);
+            z5::types::ShapeType offsetPacked = { stagedChunkIdx, 0 };
+            z5::multiarray::writeSubarray<uint64_t>(dxPacked, chunkMasks, offsetPacked.begin());
+            z5::multiarray::writeSubarray<int16_t>(dxScalars, chunkScalars, offsetPacked.begin());
+        }
+        else {
+            const vector<size_t> shapePlanes = { stagedSamples, NB_CHANNELS_TOTAL, BOARD_HEIGHT, BOARD_WIDTH };
+            auto chunkX = xt::adapt(stagedChunk.gameX.data(), stagedSamples * NB_VALUES_TOTAL, xt::no_ownership(), shapePlanes);
+            z5::types::ShapeType offsetPlanes = { stagedChunkIdx, 0, 0, 0 };
+            z5::multiarray::writeSubarray<int16_t>(dx, chunkX, offsetPlanes.begin());
+        }
+        z5::multiarray::writeSubarray<int16_t>(dValue, chunkValue, offset.begin());
+        z5::multiarray::writeSubarray<float>(dbestMoveQ, chunkBestMoveQ, offset.begin());
+        if (sparsePolicy) {
+            auto chunkPolicyEnds = xt::adapt(stagedChunk.gamePolicyEnds.data(), stagedSamples, xt::no_ownership(), shapeValue);
+            z5::multiarray::writeSubarray<int64_t>(dPolicyOffsets, chunkPolicyEnds, offset.begin());
+        }
+        else {
+            const vector<size_t> shapePolicy = { stagedSamples, NB_LABELS };
+            auto chunkPolicy = xt::adapt(stagedChunk.gamePolicy.data(), stagedSamples * NB_LABELS, xt::no_ownership(), shapePolicy);
+            z5::types::ShapeType offsetPolicy = { stagedChunkIdx, 0 };
+            z5::multiarray::writeSubarray<float>(dPolicy, chunkPolicy, offsetPolicy.begin());
+        }
+        writtenChunkSamples += chunkSize;
+        isStagedChunkWritten = true;
+    }
 
-    if (firstMove) {
-        gameValue = valueArray;
+    if (!pendingStartIndices.empty()) {
+        // gameStartIdx
+        const vector<size_t> shapeStartIdx = { pendingStartIndices.size() };
+        auto arrayGameStartIdx = xt::adapt(pendingStartIndices.data(), pendingStartIndices.size(), xt::no_ownership(), shapeStartIdx);
+        z5::types::ShapeType offsetStartIdx = { firstPendingGameIdx };
+        z5::multiarray::writeSubarray<int32_t>(dStartIndex, arrayGameStartIdx, offsetStartIdx.begin());
+        pendingStartIndices.clear();
     }
-    else {
-        // concatenate the sample to array for the current game
-        gameValue = xt::concatenate(xtuple(gameValue, valueArray));
+
+    // a partially filled chunk is kept, so that it's written again as a whole when it is complete
+    if (stagedSamples == chunkSize) {
+        stagedChunk.clear();
+        stagedChunkIdx += chunkSize;
+        isStagedChunkWritten = false;
     }
 }
 
-void TrainDataExporter::export_game_samples(Result result) {
-    if (startIdx >= numberSamples) {
-        info_string("Extended number of maximum samples");
+void TrainDataExporter::stage_policy_entries(const GameSamples& game, size_t first, size_t last)
+{
+    const size_t firstEntry = first == 0 ? 0 : size_t(game.gamePolicyEnds[first - 1]);
+    const size_t lastEntry = size_t(game.gamePolicyEnds[last - 1]);
+    // the end offsets of the game are converted into offsets of the data set
+    const int64_t entryOffset = int64_t(stagedEntryIdx + stagedPolicyIndices.size()) - int64_t(firstEntry);
+    for (size_t idx = first; idx < last; ++idx) {
+        stagedChunk.gamePolicyEnds.push_back(game.gamePolicyEnds[idx] + entryOffset);
+    }
+    stagedPolicyIndices.insert(stagedPolicyIndices.end(), game.gamePolicyIndices.begin() + firstEntry, game.gamePolicyIndices.begin() + lastEntry);
+    stagedPolicyValues.insert(stagedPolicyValues.end(), game.gamePolicyValues.begin() + firstEntry, game.gamePolicyValues.begin() + lastEntry);
+    isStagedEntryChunkWritten = false;
+    while (stagedPolicyIndices.size() >= policyEntryChunkSize) {
+        write_staged_policy_entries();
+    }
+}
+
+void TrainDataExporter::write_staged_policy_entries()
+{
+    const size_t stagedEntries = min(stagedPolicyIndices.size(), policyEntryChunkSize);
+    if (stagedEntries == 0 || isStagedEntryChunkWritten) {
         return;
     }
+    const vector<size_t> shapeEntries = { stagedEntries };
+    auto chunkIndices = xt::adapt(stagedPolicyIndices.data(), stagedEntries, xt::no_ownership(), shapeEntries);
+    auto chunkValues = xt::adapt(stagedPolicyValues.data(), stagedEntries, xt::no_ownership(), shapeEntries);
+    z5::types::ShapeType offset = { stagedEntryIdx };
+    z5::multiarray::writeSubarray<int16_t>(dPolicyIndices, chunkIndices, offset.begin());
+    z5::multiarray::writeSubarray<float>(dPolicyValues, chunkValues, offset.begin());
+
+    // a partially filled chunk is kept, so that it's written again as a whole when it is complete
+    if (stagedEntries == policyEntryChunkSize) {
+        stagedPolicyIndices.erase(stagedPolicyIndices.begin(), stagedPolicyIndices.begin() + stagedEntries);
+        stagedPolicyValues.erase(stagedPolicyValues.begin(), stagedPolicyValues.begin() + stagedEntries);
+        stagedEntryIdx += policyEntryChunkSize;
+        isStagedEntryChunkWritten = false;
+    }
+    else {
+        isStagedEntryChunkWritten = true;
+    }
+}
 
-    // game value update
-    apply_result_to_value(result);
+void TrainDataExporter::pack_staged_planes()
+{
+    const size_t planeSize = BOARD_HEIGHT * BOARD_WIDTH;
+    const size_t numberPlanes = stagedChunk.numberSamples * NB_CHANNELS_TOTAL;
+    packedMasks.resize(numberPlanes);
+    packedScalars.resize(numberPlanes);
+    const int16_t* plane = stagedChunk.gameX.data();
+    for (size_t planeIdx = 0; planeIdx < numberPlanes; ++planeIdx, plane += planeSize) {
+        uint64_t mask = 0;
+        int16_t value = 0;
+        for (size_t squareIdx = 0; squareIdx < planeSize; ++squareIdx) {
+            if (plane[squareIdx] != 0) {
+                if (value == 0) {
+                    value = plane[squareIdx];
+                }
+                else if (plane[squareIdx] != value) {
+                    throw invalid_argument("The input plane " + to_string(planeIdx % NB_CHANNELS_TOTAL) + " has different non-zero values "
+                                           "and can't be packed. Disable Selfplay_Pack_Planes for this input representation.");
+                }
+                mask |= uint64_t(1) << squareIdx;
+            }
+        }
+        packedMasks[planeIdx] = mask;
+        packedScalars[planeIdx] = value;
+    }
+}
 
-    // write value to roi
-    z5::types::ShapeType offset = { startIdx };
-    z5::types::ShapeType offsetPlanes = { startIdx, 0, 0, 0 };
-    z5::multiarray::writeSubarray<int16_t>(dx, gameX, offsetPlanes.begin());
-    z5::multiarray::writeSubarray<int16_t>(dValue, gameValue, offset.begin());
-    z5::multiarray::writeSubarray<float>(dbestMoveQ, gameBestMoveQ, offset.begin());
-    z5::types::ShapeType offsetPolicy = { startIdx, 0 };
-    z5::multiarray::writeSubarray<float>(dPolicy, gamePolicy, offsetPolicy.begin());
-
-    startIdx += curSampleIdx;
-    gameIdx++;
-    save_start_idx();
+size_t TrainDataExporter::sample_bytes() const
+{
+    const size_t planeBytes = packPlanes ? NB_CHANNELS_TOTAL * (sizeof(uint64_t) + sizeof(int16_t)) : NB_VALUES_TOTAL * sizeof(int16_t);
+    size_t policyBytes = NB_LABELS * sizeof(float);
+    if (sparsePolicy) {
+        policyBytes = sizeof(int64_t);
+        if (writtenSamples != 0) {
+            policyBytes += writtenPolicyEntries * (sizeof(int16_t) + sizeof(float)) / writtenSamples;
+        }
+    }
+    return planeBytes + sizeof(int16_t) + policyBytes + sizeof(float);
+}
+
+void TrainDataExporter::run_writer()
+{
+    unique_lock<mutex> lock(mtx);
+    while (true) {
+        queueCondition.wait(lock, [&]{ return !exportQueue.empty() || flushRequested || stopWriter; });
+        if (writerError != nullptr) {
+            // after the first error the queued games are dropped and nothing is written anymore
+            for (ExportJob& queuedJob : exportQueue) {
+                queuedJob.samples.clear();
+                freeBuffers.emplace_back(move(queuedJob.samples));
+            }
+            exportQueue.clear();
+            flushRequested = false;
+            queueCondition.notify_all();
+            if (stopWriter) {
+                return;
+            }
+            continue;
+        }
+        const bool writeQueuedGame = !exportQueue.empty();
+        // the writer stops after the queue has been drained and the partially filled chunk has been written
+        const bool stop = !writeQueuedGame && stopWriter;
+        ExportJob job;
+        if (writeQueuedGame) {
+            job = move(exportQueue.front());
+            exportQueue.pop_front();
+        }
+        lock.unlock();
+        queueCondition.notify_all();
+
+        const bool writeCheckpoint = writeQueuedGame && job.onCheckpoint;
+        const bool writeGame = writeQueuedGame && !writeCheckpoint;
+
+        const chrono::steady_clock::time_point writeStart = chrono::steady_clock::now();
+        exception_ptr error = nullptr;
+        try {
+            if (writeGame) {
+                stage_game(job);
+                if (replayBuffer != nullptr) {
+                    replayBuffer->append_game(job.samples, job.numberSamples);
+                }
+            }
+            else if (writeCheckpoint) {
+                write_partial_chunks();
+                job.onCheckpoint(get_written_checkpoint());
+            }
+            else {
+                // all queued games have been staged, the remaining samples are written as a partial chunk
+                write_partial_chunks();
+            }
+        }
+        catch (...) {
+            error = current_exception();
+        }
+        const chrono::nanoseconds elapsed = chrono::steady_clock::now() - writeStart;
+        const size_t jobPolicyEntries = writeGame && sparsePolicy && job.numberSamples != 0 ? size_t(job.samples.gamePolicyEnds[job.numberSamples - 1]) : 0;
+        job.samples.clear();
+
+        lock.lock();
+        writeTime += elapsed;
+        if (writeGame) {
+            writtenSamples += job.numberSamples;
+            writtenPolicyEntries += jobPolicyEntries;
+            freeBuffers.emplace_back(move(job.samples));
+        }
+        else if (!writeQueuedGame) {
+            flushRequested = false;
+        }
+        if (error != nullptr && writerError == nullptr) {
+            writerError = error;
+        }
+        queueCondition.notify_all();
+        if (stop) {
+            return;
+        }
+    }
+}
+
+void TrainDataExporter::rethrow_writer_error()
+{
+    if (writerError != nullptr) {
+        rethrow_exception(writerError);
+    }
+}
+
+void TrainDataExporter::write_partial_chunks()
+{
+    write_staged_chunk();
+    if (sparsePolicy) {
+        write_staged_policy_entries();
+    }
 }
 
-TrainDataExporter::TrainDataExporter(const string& fileName, size_t numberChunks, size_t chunkSize):
+ExportCheckpoint TrainDataExporter::get_written_checkpoint() const
+{
+    ExportCheckpoint checkpoint;
+    checkpoint.numberChunks = numberChunks;
+    checkpoint.chunkSize = chunkSize;
+    checkpoint.packPlanes = packPlanes;
+    checkpoint.sparsePolicy = sparsePolicy;
+    checkpoint.gameIdx = writtenGameIdx;
+    checkpoint.startIdx = writtenStartIdx;
+    checkpoint.startEntryIdx = writtenEntryIdx;
+    // after a flush the staged data begins at the last chunk boundary and ends at the written indices
+    checkpoint.stagedSamples = stagedChunk;
+    checkpoint.stagedPolicyIndices = stagedPolicyIndices;
+    checkpoint.stagedPolicyValues = stagedPolicyValues;
+    checkpoint.startIndices = startIndicesTail;
+    return checkpoint;
+}
+
+void TrainDataExporter::request_checkpoint(function<void(const ExportCheckpoint&)> onCheckpoint)
+{
+    ExportJob job;
+    job.numberSamples = 0;
+    job.onCheckpoint = move(onCheckpoint);
+    {
+        lock_guard<mutex> lock(mtx);
+        rethrow_writer_error();
+        // the request doesn't wait for free queue capacity, so that the caller never blocks
+        exportQueue.emplace_back(move(job));
+    }
+    queueCondition.notify_all();
+}
+
+void TrainDataExporter::flush()
+{
+    unique_lock<mutex> lock(mtx);
+    flushRequested = true;
+    queueCondition.notify_all();
+    queueCondition.wait(lock, [&]{ return !flushRequested || writerError != nullptr; });
+    rethrow_writer_error();
+    if (numberQueuedGames == 0) {
+        return;
+    }
+    const size_t sampleBytes = sample_bytes();
+    const double writeTimeSec = writeTime.count() / 1e9;
+    info_string("export queue depth (max/avg):", to_string(maxQueueDepth) + "/" + to_string(float(queueDepthSum) / numberQueuedGames));
+    info_string("export bytes per sample (uncompressed):", sampleBytes);
+    if (sparsePolicy) {
+        info_string("export policy entries per sample:", writtenSamples > 0 ? float(writtenPolicyEntries) / writtenSamples : 0);
+    }
+    info_string("export write throughput (samples/s):", writeTimeSec > 0 ? writtenSamples / writeTimeSec : 0);
+    info_string("export write throughput (MiB/s):", writeTimeSec > 0 ? writtenSamples * sampleBytes / writeTimeSec / (1024 * 1024) : 0);
+    info_string("export time per 1000 samples (ms):", writtenSamples > 0 ? writeTimeSec * 1e6 / writtenSamples : 0);
+    info_string("export write amplification:", writtenSamples > 0 ? float(writtenChunkSamples) / writtenSamples : 0);
+    if (replayBuffer != nullptr) {
+        info_string("replay buffer overwritten unread samples:", replayBuffer->get_overwritten_samples());
+        info_string("replay buffer aborted samples:", replayBuffer->get_aborted_samples());
+    }
+}
+
+TrainDataExporter::TrainDataExporter(const string& fileName, size_t numberChunks, size_t chunkSize, bool packPlanes,
+                                     const string& compressor, int compressionLevel, bool sparsePolicy,
+                                     const ExportCheckpoint* resumePoint):
+    fileName(fileName),
     numberChunks(numberChunks),
     chunkSize(chunkSize),
     numberSamples(numberChunks * chunkSize),
-    firstMove(true),
+    packPlanes(packPlanes),
+    compressor(compressor),
+    compressionLevel(compressionLevel),
+    sparsePolicy(sparsePolicy),
+    policyEntryCapacity(numberSamples * SPARSE_POLICY_CAPACITY_PER_SAMPLE),
+    policyEntryChunkSize(chunkSize * SPARSE_POLICY_CHUNK_ENTRIES_PER_SAMPLE),
     gameIdx(0),
     startIdx(0),
-    curSampleIdx(0)
+    startEntryIdx(0),
+    stopWriter(false),
+    flushRequested(false),
+    writerError(nullptr),
+    replayBuffer(nullptr),
+    stagedChunk(chunkSize, sparsePolicy),
+    stagedChunkIdx(0),
+    isStagedChunkWritten(false),
+    firstPendingGameIdx(0),
+    stagedEntryIdx(0),
+    isStagedEntryChunkWritten(false),
+    writtenGameIdx(0),
+    writtenStartIdx(0),
+    writtenEntryIdx(0),
+    startIndicesTail(1, 0),
+    maxQueueDepth(0),
+    queueDepthSum(0),
+    numberQueuedGames(0),
+    writtenSamples(0),
+    writtenPolicyEntries(0),
+    writtenChunkSamples(0),
+    writeTime(0)
 {
+    if (packPlanes && BOARD_HEIGHT * BOARD_WIDTH > 64) {
+        throw invalid_argument("Packed planes are only supported for boards with at most 64 squares");
+    }
     // get handle to a File on the filesystem
     z5::filesystem::handle::File file(fileName);
 
-    if (file.exists()) {
-        cout << "Warning: Export file already exists. It will be overwritten" << endl;
-        open_dataset_from_file(file);
+    if (resumePoint != nullptr) {
+        if (!file.exists()) {
+            throw invalid_argument("The export file " + fileName + " can't be resumed because it doesn't exist");
+        }
+        open_datasets(file);
+        resume(*resumePoint);
     }
     else {
-        create_new_dataset_file(file);
+        if (file.exists()) {
+            cout << "Warning: Export file already exists. It will be overwritten" << endl;
+        }
+        else {
+            // create the file in zarr format
+            const bool createAsZarr = true;
+            z5::createFile(file, createAsZarr);
+        }
+        open_datasets(file);
+        save_start_idx(0, 0);
+    }
+    writerThread = thread(&TrainDataExporter::run_writer, this);
+}
+
+TrainDataExporter::~TrainDataExporter()
+{
+    {
+        lock_guard<mutex> lock(mtx);
+        stopWriter = true;
     }
+    // the writer finishes all queued games and the partial chunk before it stops
+    queueCondition.notify_all();
+    writerThread.join();
+}
+
+void TrainDataExporter::set_replay_buffer(ReplayBuffer* buffer)
+{
+    replayBuffer = buffer;
 }
 
 size_t TrainDataExporter::get_number_samples() const
@@ -120,44 +560,42 @@ size_t TrainDataExporter::get_number_samples() const
     return numberSamples;
 }
 
-bool TrainDataExporter::is_file_full()
+bool TrainDataExporter::has_writer_error()
 {
-    return startIdx >= numberSamples;
+    lock_guard<mutex> lock(mtx);
+    return writerError != nullptr;
 }
 
-void TrainDataExporter::new_game()
+bool TrainDataExporter::is_file_full()
 {
-    firstMove = true;
-    curSampleIdx = 0;
+    lock_guard<mutex> lock(mtx);
+    return startIdx >= numberSamples;
 }
 
-void TrainDataExporter::save_planes(const StateObj *pos)
+void TrainDataExporter::save_planes(GameSamples& game, const StateObj *pos)
 {
     // x / plane representation
     float inputPlanes[NB_VALUES_TOTAL];
     pos->get_state_planes(false, inputPlanes);
-    // write array to roi
-    xt::xarray<int16_t>::shape_type planesShape = { 1, NB_CHANNELS_TOTAL, BOARD_HEIGHT, BOARD_WIDTH };
-    xt::xarray<int16_t> planes(planesShape);
+    // append the planes to the buffer of the current game
+    const size_t offset = game.gameX.size();
+    game.gameX.resize(offset + NB_VALUES_TOTAL);
     for (size_t idx = 0; idx < NB_VALUES_TOTAL; ++idx) {
-        planes.data()[idx] = int16_t(inputPlanes[idx]);
-    }
-
-    if (firstMove) {
-        gameX = planes;
-    }
-    else {
-        // concatenate the sample to array for the current game
-        gameX = xt::concatenate(xtuple(gameX, planes));
+        game.gameX[offset + idx] = int16_t(inputPlanes[idx]);
     }
 }
 
-void TrainDataExporter::save_policy(const vector<Action>& legalMoves, const DynamicVector<float>& policyProbSmall, Color sideToMove)
+void TrainDataExporter::save_policy(GameSamples& game, const vector<Action>& legalMoves, const DynamicVector<float>& policyProbSmall, Color sideToMove)
 {
     assert(legalMoves.size() == policyProbSmall.size());
 
-    xt::xarray<float>::shape_type shapePolicy = { 1, NB_LABELS };
-    xt::xarray<float> policy(shapePolicy, 0);
+    float* policy = nullptr;
+    if (!sparsePolicy) {
+        // append a zero initialized policy to the buffer of the current game
+        const size_t offset = game.gamePolicy.size();
+        game.gamePolicy.resize(offset + NB_LABELS, 0.0f);
+        policy = game.gamePolicy.data() + offset;
+    }
 
     for (size_t idx = 0; idx < legalMoves.size(); ++idx) {
         size_t policyIdx;
@@ -167,62 +605,147 @@ void TrainDataExporter::save_policy(const vector<Action>& legalMoves, const Dyna
         else {
             policyIdx = MV_LOOKUP_MIRRORED_CLASSIC[legalMoves[idx]];
         }
-        policy[policyIdx] = policyProbSmall[idx];
-    }
-
-    if (firstMove) {
-        gamePolicy = policy;
+        if (!sparsePolicy) {
+            policy[policyIdx] = policyProbSmall[idx];
+        }
+        else if (policyProbSmall[idx] != 0) {
+            // moves which have been clipped (e.g. by sharpen_distribution()) aren't stored
+            game.gamePolicyIndices.push_back(int16_t(policyIdx));
+            game.gamePolicyValues.push_back(policyProbSmall[idx]);
+        }
     }
-    else {
-        // concatenate the sample to array for the current game
-        gamePolicy = xt::concatenate(xtuple(gamePolicy, policy));
+    if (sparsePolicy) {
+        game.gamePolicyEnds.push_back(int64_t(game.gamePolicyIndices.size()));
     }
 }
 
-void TrainDataExporter::save_start_idx()
+void TrainDataExporter::save_start_idx(size_t idx, size_t gameStartIdx)
 {
     // gameStartIdx
     // write value to roi
-    z5::types::ShapeType offsetStartIdx = { gameIdx };
-    xt::xarray<int32_t> arrayGameStartIdx({ 1 }, int32_t(startIdx));
+    z5::types::ShapeType offsetStartIdx = { idx };
+    xt::xarray<int32_t> arrayGameStartIdx({ 1 }, int32_t(gameStartIdx));
     z5::multiarray::writeSubarray<int32_t>(dStartIndex, arrayGameStartIdx, offsetStartIdx.begin());
 }
 
-void TrainDataExporter::open_dataset_from_file(const z5::filesystem::handle::File& file)
+std::unique_ptr<z5::Dataset> TrainDataExporter::open_or_create_dataset(const z5::filesystem::handle::File& file, const string& key,
+                                                                     const string& dtype, const vector<size_t>& shape, const vector<size_t>& chunks)
 {
-    dStartIndex = z5::openDataset(file, "start_indices");
-    dx = z5::openDataset(file, "x");
-    dValue = z5::openDataset(file, "y_value");
-    dPolicy = z5::openDataset(file, "y_policy");
-    dbestMoveQ = z5::openDataset(file, "y_best_move_q");
+    z5::filesystem::handle::Dataset handle(file, key);
+    if (handle.exists()) {
+        return z5::openDataset(file, key);
+    }
+    if (compressor == "raw") {
+        return z5::createDataset(file, key, dtype, shape, chunks);
+    }
+    // the byte shuffle groups the equal bytes of neighbouring values, which helps for the sparse masks and policies
+    z5::types::CompressionOptions compressionOptions;
+    compressionOptions["codec"] = compressor;
+    compressionOptions["level"] = compressionLevel;
+    compressionOptions["shuffle"] = 1;
+    return z5::createDataset(file, key, dtype, shape, chunks, "blosc", compressionOptions);
 }
 
-void TrainDataExporter::create_new_dataset_file(const z5::filesystem::handle::File &file)
+void TrainDataExporter::open_datasets(const z5::filesystem::handle::File& file)
 {
-    // create the file in zarr format
-    const bool createAsZarr = true;
-    z5::createFile(file, createAsZarr);
+    dStartIndex = open_or_create_dataset(file, "start_indices", "int32", { numberSamples }, { chunkSize });
+    if (packPlanes) {
+        dxPacked = open_or_create_dataset(file, "x_packed", "uint64", { numberSamples, NB_CHANNELS_TOTAL }, { chunkSize, NB_CHANNELS_TOTAL });
+        dxScalars = open_or_create_dataset(file, "x_scalars", "int16", { numberSamples, NB_CHANNELS_TOTAL }, { chunkSize, NB_CHANNELS_TOTAL });
+    }
+    else {
+        dx = open_or_create_dataset(file, "x", "int16", { numberSamples, NB_CHANNELS_TOTAL, BOARD_HEIGHT, BOARD_WIDTH },
+                                    { chunkSize, NB_CHANNELS_TOTAL, BOARD_HEIGHT, BOARD_WIDTH });
+    }
+    dValue = open_or_create_dataset(file, "y_value", "int16", { numberSamples }, { chunkSize });
+    if (sparsePolicy) {
+        dPolicyIndices = open_or_create_dataset(file, "y_policy_indices", "int16", { policyEntryCapacity }, { policyEntryChunkSize });
+        dPolicyValues = open_or_create_dataset(file, "y_policy_values", "float32", { policyEntryCapacity }, { policyEntryChunkSize });
+        dPolicyOffsets = open_or_create_dataset(file, "y_policy_offsets", "int64", { numberSamples }, { chunkSize });
+    }
+    else {
+        dPolicy = open_or_create_dataset(file, "y_policy", "float32", { numberSamples, NB_LABELS }, { chunkSize, NB_LABELS });
+    }
+    dbestMoveQ = open_or_create_dataset(file, "y_best_move_q", "float32", { numberSamples }, { chunkSize });
+}
 
-    // create a new zarr dataset
-    std::vector<size_t> shape = { numberSamples, NB_CHANNELS_TOTAL, BOARD_HEIGHT, BOARD_WIDTH };
-    std::vector<size_t> chunks = { chunkSize, NB_CHANNELS_TOTAL, BOARD_HEIGHT, BOARD_WIDTH };
-    dStartIndex = z5::createDataset(file, "start_indices", "int32", { numberSamples }, { chunkSize });
-    dx = z5::createDataset(file, "x", "int16", shape, chunks);
-    dValue = z5::createDataset(file, "y_value", "int16", { numberSamples }, { chunkSize });
-    dPolicy = z5::createDataset(file, "y_policy", "float32", { numberSamples, NB_LABELS }, { chunkSize, NB_LABELS });
-    dbestMoveQ = z5::createDataset(file, "y_best_move_q", "float32", { numberSamples }, { chunkSize });
+void TrainDataExporter::resume(const ExportCheckpoint& checkpoint)
+{
+    if (checkpoint.numberChunks != numberChunks || checkpoint.chunkSize != chunkSize || checkpoint.packPlanes != packPlanes
+            || checkpoint.sparsePolicy != sparsePolicy) {
+        throw invalid_argument("The export checkpoint was created with a different format");
+    }
+    if (checkpoint.startIdx > numberSamples || checkpoint.startEntryIdx > policyEntryCapacity
+            || checkpoint.stagedSamples.numberSamples != checkpoint.startIdx % chunkSize
+            || checkpoint.stagedPolicyIndices.size() != (sparsePolicy ? checkpoint.startEntryIdx % policyEntryChunkSize : 0)
+            || checkpoint.startIndices.size() != checkpoint.gameIdx % chunkSize + 1) {
+        throw invalid_argument("The export checkpoint is inconsistent");
+    }
+    gameIdx = writtenGameIdx = checkpoint.gameIdx;
+    startIdx = writtenStartIdx = checkpoint.startIdx;
+    startEntryIdx = writtenEntryIdx = checkpoint.startEntryIdx;
+    stagedChunkIdx = startIdx - startIdx % chunkSize;
+    stagedEntryIdx = startEntryIdx - startEntryIdx % policyEntryChunkSize;
+    const size_t firstStartIndexIdx = gameIdx - gameIdx % chunkSize;
+
+    // the chunks which were written after the checkpoint may be incomplete
+    remove_chunks("start_indices", firstStartIndexIdx / chunkSize, numberChunks, 1);
+    if (packPlanes) {
+        remove_chunks("x_packed", stagedChunkIdx / chunkSize, numberChunks, 2);
+        remove_chunks("x_scalars", stagedChunkIdx / chunkSize, numberChunks, 2);
+    }
+    else {
+        remove_chunks("x", stagedChunkIdx / chunkSize, numberChunks, 4);
+    }
+    remove_chunks("y_value", stagedChunkIdx / chunkSize, numberChunks, 1);
+    if (sparsePolicy) {
+        remove_chunks("y_policy_indices", stagedEntryIdx / policyEntryChunkSize, policyEntryCapacity / policyEntryChunkSize, 1);
+        remove_chunks("y_policy_values", stagedEntryIdx / policyEntryChunkSize, policyEntryCapacity / policyEntryChunkSize, 1);
+        remove_chunks("y_policy_offsets", stagedChunkIdx / chunkSize, numberChunks, 1);
+    }
+    else {
+        remove_chunks("y_policy", stagedChunkIdx / chunkSize, numberChunks, 2);
+    }
+    remove_chunks("y_best_move_q", stagedChunkIdx / chunkSize, numberChunks, 1);
+
+    // write the incomplete chunks of the checkpoint again
+    stagedChunk = checkpoint.stagedSamples;
+    stagedPolicyIndices = checkpoint.stagedPolicyIndices;
+    stagedPolicyValues = checkpoint.stagedPolicyValues;
+    startIndicesTail = checkpoint.startIndices;
+    pendingStartIndices = checkpoint.startIndices;
+    firstPendingGameIdx = firstStartIndexIdx;
+    isStagedChunkWritten = false;
+    isStagedEntryChunkWritten = false;
+    write_staged_chunk();
+    if (sparsePolicy) {
+        write_staged_policy_entries();
+    }
+    info_string("resumed the export at sample", startIdx);
+}
 
-    save_start_idx();
+void TrainDataExporter::remove_chunks(const string& key, size_t firstChunk, size_t numberDatasetChunks, size_t numberDimensions) const
+{
+    // the chunks of zarr datasets are stored as files named by their chunk indices, e.g. "x/3.0.0.0"
+    string trailingIndices;
+    for (size_t dim = 1; dim < numberDimensions; ++dim) {
+        trailingIndices += ".0";
+    }
+    for (size_t chunkIdx = firstChunk; chunkIdx < numberDatasetChunks; ++chunkIdx) {
+        remove((fileName + "/" + key + "/" + to_string(chunkIdx) + trailingIndices).c_str());
+    }
 }
 
-void TrainDataExporter::apply_result_to_value(Result result)
+void TrainDataExporter::apply_result_to_value(GameSamples& game, Result result)
 {
     // value
     if (result == BLACK_WIN) {
-        gameValue *= -1;
+        for (int16_t& value : game.gameValue) {
+            value *= -1;
+        }
     }
     else if (result == DRAWN) {
-        gameValue *= 0;
+        fill(game.gameValue.begin(), game.gameValue.end(), 0);
     }
 }
 
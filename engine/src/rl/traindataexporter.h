@@ -23,6 +23,18 @@
  * @author: queensgambit
  *
  * Exporter class which saves the board position in planes (x) and the target values (y) for NN training
+ *
+ * The planes are either stored densely as int16 ("x", NB_CHANNELS_TOTAL * 64 * 2 bytes per sample, 4352 bytes for crazyhouse)
+ * or packed ("x_packed" and "x_scalars", NB_CHANNELS_TOTAL * (8 + 2) bytes per sample, 340 bytes for crazyhouse).
+ * In the packed format each plane is described by a 64-bit mask of its non-zero squares and the value of these squares.
+ * Binary planes therefore use the value 1 and constant planes (e.g. pocket counts) use a full mask.
+ * A plane whose non-zero squares have different values can't be packed and stops the export with an exception.
+ * The plane is restored by multiplying the mask bits with the value (see DeepCrazyhouse/src/domain/util.py unpack_planes()).
+ *
+ * The policy is either stored densely ("y_policy", NB_LABELS floats per sample, 9088 bytes for crazyhouse) or sparse.
+ * The sparse format only stores the non-zero entries as index/value pairs in the flat arrays "y_policy_indices" (int16)
+ * and "y_policy_values" (float32). "y_policy_offsets" holds the exclusive end offset of the entries of each sample
+ * in the flat arrays (see DeepCrazyhouse/src/domain/util.py sparse_to_dense_policy()).
  */
 
 #ifndef TRAINDATAEXPORTER_H
@@ -45,83 +57,323 @@
 #include "constants.h"
 #include "node.h"
 #include "evalinfo.h"
+#include <mutex>
+#include <thread>
+#include <deque>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+
+class ReplayBuffer;
+
+// number of samples for which the buffers of a game are preallocated, longer games grow the buffers
+const size_t GAME_SAMPLES_CAPACITY = 256;
+// average number of sparse policy entries per sample for which the flat policy arrays of a data set are allocated
+const size_t SPARSE_POLICY_CAPACITY_PER_SAMPLE = 256;
+// number of sparse policy entries per sample in a single chunk of the flat policy arrays
+const size_t SPARSE_POLICY_CHUNK_ENTRIES_PER_SAMPLE = 64;
+
+/**
+ * @brief The GameSamples struct holds the training samples of a single game until the game result is known.
+ * Each concurrently generated game uses its own object. The samples are appended in place to preallocated buffers,
+ * so that saving a sample doesn't depend on the length of the game.
+ */
+struct GameSamples
+{
+    vector<int16_t> gameX;
+    vector<int16_t> gameValue;
+    vector<float> gamePolicy;
+    vector<float> gameBestMoveQ;
+    // sparse policy entries and the exclusive end offset of the entries of each sample
+    vector<int16_t> gamePolicyIndices;
+    vector<float> gamePolicyValues;
+    vector<int64_t> gamePolicyEnds;
+    size_t numberSamples;
+
+    /**
+     * @brief GameSamples
+     * @param capacity Number of samples for which the buffers are preallocated
+     * @param sparsePolicy If true, the buffers for sparse policies are preallocated instead of the dense policy buffer
+     */
+    GameSamples(size_t capacity=GAME_SAMPLES_CAPACITY, bool sparsePolicy=false);
+    /**
+     * @brief clear Removes all samples but keeps the allocated memory
+     */
+    void clear();
+};
+
+// maximum number of finished games which wait for the writer thread before export_game_samples() blocks
+const size_t EXPORT_QUEUE_CAPACITY = 16;
+
+struct ExportCheckpoint;
+
+/**
+ * @brief The ExportJob struct describes a finished game which is written by the writer thread
+ * or a checkpoint which has been requested after the previously queued games
+ */
+struct ExportJob
+{
+    // the buffers are swapped with the ones of the finished game
+    GameSamples samples = GameSamples(0);
+    // number of samples to write, the games are written in the order of their start indices
+    size_t numberSamples;
+    // index of the following game and its start index, which are written to the start indices
+    size_t nextGameIdx;
+    size_t nextStartIdx;
+    // first sparse policy entry index of the following game
+    size_t nextEntryIdx;
+    // set for a checkpoint request, which receives the state of the data set after all previously queued games
+    function<void(const ExportCheckpoint&)> onCheckpoint;
+};
+
+/**
+ * @brief The ExportCheckpoint struct describes a state of the data set up to which all games have been written.
+ * Besides the indices it holds the content of the last incomplete chunks, so that a data set can be resumed even if
+ * the chunks after the checkpoint were damaged by a crash (see TrainDataExporter::request_checkpoint()).
+ */
+struct ExportCheckpoint
+{
+    // format of the data set, a data set is only resumed with the same format
+    size_t numberChunks;
+    size_t chunkSize;
+    bool packPlanes;
+    bool sparsePolicy;
+    // number of written games, samples and sparse policy entries
+    size_t gameIdx;
+    size_t startIdx;
+    size_t startEntryIdx;
+    // samples of the incomplete chunk which contains startIdx (the policy ends are offsets of the data set)
+    GameSamples stagedSamples = GameSamples(0);
+    // sparse policy entries of the incomplete chunk which contains startEntryIdx
+    vector<int16_t> stagedPolicyIndices;
+    vector<float> stagedPolicyValues;
+    // start indices of the incomplete chunk of the start indices up to the one at gameIdx
+    vector<int32_t> startIndices;
+};
 
 class TrainDataExporter
 {
 private:
+    string fileName;
     size_t numberChunks;
     size_t chunkSize;
     size_t numberSamples;
+    // true if the planes are stored as bit masks and values instead of dense int16 planes
+    bool packPlanes;
+    // "raw" or the blosc codec which is used for newly created datasets (e.g. "lz4", "zstd")
+    string compressor;
+    int compressionLevel;
+    // true if only the non-zero policy entries are stored as index/value pairs instead of "y_policy"
+    bool sparsePolicy;
+    // number of sparse policy entries which fit into the data set and into a single chunk of the flat policy arrays
+    size_t policyEntryCapacity;
+    size_t policyEntryChunkSize;
     std::unique_ptr<z5::Dataset> dStartIndex;
     std::unique_ptr<z5::Dataset> dx;
+    std::unique_ptr<z5::Dataset> dxPacked;
+    std::unique_ptr<z5::Dataset> dxScalars;
     std::unique_ptr<z5::Dataset> dValue;
     std::unique_ptr<z5::Dataset> dPolicy;
+    std::unique_ptr<z5::Dataset> dPolicyIndices;
+    std::unique_ptr<z5::Dataset> dPolicyValues;
+    std::unique_ptr<z5::Dataset> dPolicyOffsets;
     std::unique_ptr<z5::Dataset> dbestMoveQ;
 
-    xt::xarray<int16_t> gameX;
-    xt::xarray<int16_t> gameValue;
-    xt::xarray<float> gamePolicy;
-    xt::xarray<float> gameBestMoveQ;
-    bool firstMove;
+    // protects the indices and the export queue when several games are exported concurrently
+    mutex mtx;
 
     // current number of games - 1
     size_t gameIdx;
-    // current sample index to insert
+    // current sample index to insert (the samples of queued games are already included)
     size_t startIdx;
-    size_t curSampleIdx;
+    // current sparse policy entry index to insert (the entries of queued games are already included)
+    size_t startEntryIdx;
+
+    // the data set is only written by the writer thread, so that file I/O doesn't stall the selfplay threads
+    thread writerThread;
+    deque<ExportJob> exportQueue;
+    // buffers of written games which are handed back to the selfplay threads
+    vector<GameSamples> freeBuffers;
+    condition_variable queueCondition;
+    bool stopWriter;
+    bool flushRequested;
+    // first error of the writer thread, the writer doesn't write anything after it
+    exception_ptr writerError;
+    // optional sink which receives every written game in addition to the data set
+    ReplayBuffer* replayBuffer;
+
+    // the writer collects the samples of a whole chunk before it is written, so that z5 never has to read,
+    // decompress and merge a partially filled chunk (only used by the writer thread)
+    GameSamples stagedChunk;
+    // first sample index of the staged chunk, always a multiple of chunkSize
+    size_t stagedChunkIdx;
+    // true if the staged samples have already been written as a partial chunk
+    bool isStagedChunkWritten;
+    // start indices of the games which haven't been written yet, beginning at the game index firstPendingGameIdx
+    vector<int32_t> pendingStartIndices;
+    size_t firstPendingGameIdx;
+    // sparse policy entries which haven't been written as a whole chunk of the flat policy arrays yet.
+    // The end offsets of the staged samples are stored in stagedChunk.gamePolicyEnds.
+    vector<int16_t> stagedPolicyIndices;
+    vector<float> stagedPolicyValues;
+    // first entry index of the staged entries, always a multiple of policyEntryChunkSize
+    size_t stagedEntryIdx;
+    bool isStagedEntryChunkWritten;
+    // packed planes of the staged chunk (only used by the writer thread)
+    vector<uint64_t> packedMasks;
+    vector<int16_t> packedScalars;
+    // indices after the last staged game and the start indices of the chunk of the start indices which contains
+    // the start index of writtenGameIdx (only used by the writer thread)
+    size_t writtenGameIdx;
+    size_t writtenStartIdx;
+    size_t writtenEntryIdx;
+    vector<int32_t> startIndicesTail;
+
+    // writer statistics
+    size_t maxQueueDepth;
+    size_t queueDepthSum;
+    size_t numberQueuedGames;
+    size_t writtenSamples;
+    size_t writtenPolicyEntries;
+    // number of samples of all chunks which have been (re-)written, a partial chunk is counted as a full chunk
+    size_t writtenChunkSamples;
+    chrono::nanoseconds writeTime;
+
+    /**
+     * @brief run_writer Main loop of the writer thread which writes the queued games to the data set
+     */
+    void run_writer();
+
+    /**
+     * @brief stage_game Appends the samples of a game to the staged chunk and writes every completed chunk
+     */
+    void stage_game(ExportJob& job);
+
+    /**
+     * @brief write_staged_chunk Writes the staged samples and the pending start indices to the data set.
+     * The staged samples are only removed if the chunk is complete.
+     */
+    void write_staged_chunk();
+
+    /**
+     * @brief stage_policy_entries Appends the sparse policy entries of the given samples of a game to the staged entries
+     * and writes every completed chunk of the flat policy arrays
+     * @param game Samples of the game
+     * @param first Index of the first sample
+     * @param last Index after the last sample
+     */
+    void stage_policy_entries(const GameSamples& game, size_t first, size_t last);
+
+    /**
+     * @brief write_staged_policy_entries Writes the first chunk of the staged sparse policy entries.
+     * The entries are only removed if the chunk is complete.
+     */
+    void write_staged_policy_entries();
+
+    /**
+     * @brief pack_staged_planes Converts the planes of the staged chunk into bit masks and values.
+     * Throws an invalid_argument exception if the non-zero squares of a plane have different values.
+     */
+    void pack_staged_planes();
+
+    /**
+     * @brief sample_bytes Returns the uncompressed size of a single sample in the data set.
+     * For a sparse policy the average number of entries of the written samples is used.
+     */
+    size_t sample_bytes() const;
+
+    /**
+     * @brief write_partial_chunks Writes the staged samples and sparse policy entries as partially filled chunks
+     */
+    void write_partial_chunks();
+
+    /**
+     * @brief get_written_checkpoint Returns the state of the data set after the staged games have been written.
+     * Must only be called by the writer thread after write_partial_chunks().
+     */
+    ExportCheckpoint get_written_checkpoint() const;
+
+    /**
+     * @brief resume Continues the data set after the given checkpoint. The chunks from the checkpoint on are removed,
+     * because they might have been damaged by a crash, and the incomplete chunks of the checkpoint are written again.
+     */
+    void resume(const ExportCheckpoint& checkpoint);
+
+    /**
+     * @brief remove_chunks Removes the chunk files of a dataset beginning at the given chunk index
+     * @param key Name of the dataset
+     * @param firstChunk Index of the first chunk to remove along the first dimension
+     * @param numberDatasetChunks Number of chunks of the dataset along the first dimension
+     * @param numberDimensions Number of dimensions of the dataset
+     */
+    void remove_chunks(const string& key, size_t firstChunk, size_t numberDatasetChunks, size_t numberDimensions) const;
+
+    /**
+     * @brief rethrow_writer_error Rethrows the first exception of the writer thread in the calling thread. The lock must be held.
+     */
+    void rethrow_writer_error();
 
     /**
      * @brief export_planes Exports the board in plane representation (x)
+     * @param game Samples of the current game
      * @param pos Board position to export
      */
-    void save_planes(const StateObj* pos);
+    void save_planes(GameSamples& game, const StateObj* pos);
 
     /**
      * @brief save_policy Saves the policy (e.g. mctsPolicy) to the matrix
+     * @param game Samples of the current game
      * @param legalMoves List of legal moves
      * @param policyProbSmall Probability for each move
      * @param sideToMove Current side to move
      */
-    void save_policy(const vector<Action>& legalMoves, const DynamicVector<float>& policyProbSmall, Color sideToMove);
+    void save_policy(GameSamples& game, const vector<Action>& legalMoves, const DynamicVector<float>& policyProbSmall, Color sideToMove);
 
     /**
      * @brief save_best_move_q Saves the Q-value of the move which was selected after MCTS search(Optional training sample feature)
+     * @param game Samples of the current game
      * @param eval Filled EvalInfo struct after mcts search
      */
-    void save_best_move_q(const EvalInfo& eval);
+    void save_best_move_q(GameSamples& game, const EvalInfo& eval);
 
     /**
      * @brief save_side_to_move Saves the current side to move as a +1 for WHITE and -1 for BLACK.
      * The current side to move is either WHITE(0) or BLACK(1).
      * Later if WHITE won the game the value array is inverted.
      * For a draw it will be multiplied by 0.
+     * @param game Samples of the current game
      * @param col current side to move
      */
-    void save_side_to_move(Color col);
+    void save_side_to_move(GameSamples& game, Color col);
 
     /**
-     * @brief save_start_idx Saves the current starting index where the next game starts to the game array
+     * @brief save_start_idx Saves the starting index where the given game starts to the game array
+     * @param idx Index of the game
+     * @param gameStartIdx First sample index of the game
      */
-    void save_start_idx();
+    void save_start_idx(size_t idx, size_t gameStartIdx);
 
     /**
-     * @brief open_dataset_from_file Reads a previously exported training set back into memory
+     * @brief open_or_create_dataset Opens the dataset with the given key or creates it using the configured compressor
      * @param file filesystem handle
      */
-    void open_dataset_from_file(const z5::filesystem::handle::File& file);
+    std::unique_ptr<z5::Dataset> open_or_create_dataset(const z5::filesystem::handle::File& file, const string& key, const string& dtype,
+                                                        const vector<size_t>& shape, const vector<size_t>& chunks);
 
     /**
-     * @brief open_dataset_from_file Creates a new zarr data set given a filesystem handle
+     * @brief open_datasets Opens the datasets of a previously exported training set. Missing datasets (e.g. of the other plane format)
+     * are created, the existing ones keep their compressor.
      * @param file filesystem handle
      */
-    void create_new_dataset_file(const z5::filesystem::handle::File& file);
+    void open_datasets(const z5::filesystem::handle::File& file);
 
     /**
      * @brief apply_result_to_value Inverts the gameValue array if WHITE lost the game.
      * In the case of a draw, all entries are set to 0.
+     * @param game Samples of the current game
      * @param result Possible values DRAWN, WHITE_WIN, BLACK_WIN,
      */
-    void apply_result_to_value(Result result);
+    void apply_result_to_value(GameSamples& game, Result result);
 public:
     /**
      * @brief TrainDataExporter
@@ -129,35 +381,79 @@ public:
      * @param numberChunks Defines how many chunks a single file should contain.
      * The product of the number of chunks and its chunk size yields the total number of samples of a file.
      * @param chunkSize Defines the chunk size of a single chunk
+     * @param packPlanes If true, the planes are stored as bit masks and values ("x_packed", "x_scalars") instead of "x"
+     * @param compressor "raw" or a blosc codec ("blosclz", "lz4", "lz4hc", "zlib", "zstd")
+     * @param compressionLevel Compression level of the blosc codec (0-9)
+     * @param sparsePolicy If true, the non-zero policy entries are stored as index/value pairs instead of "y_policy"
+     * @param resumePoint Checkpoint of an existing data set which is continued or nullptr to overwrite an existing data set.
+     * The checkpoint must have been created with the same format.
      */
-    TrainDataExporter(const string& fileNameExport, size_t numberChunks=200, size_t chunkSize=128);
+    TrainDataExporter(const string& fileNameExport, size_t numberChunks=200, size_t chunkSize=128, bool packPlanes=false,
+                      const string& compressor="raw", int compressionLevel=5, bool sparsePolicy=false,
+                      const ExportCheckpoint* resumePoint=nullptr);
+    ~TrainDataExporter();
+    TrainDataExporter(const TrainDataExporter&) = delete;
+    TrainDataExporter& operator=(const TrainDataExporter&) = delete;
 
     /**
      * @brief export_pos Saves a given board position, policy and Q-value to the specific game arrays
+     * @param game Samples of the current game
      * @param pos Current board position
      * @param eval Filled EvalInfo struct after mcts search
      */
-    void save_sample(const StateObj* pos, const EvalInfo& eval);
+    void save_sample(GameSamples& game, const StateObj* pos, const EvalInfo& eval);
 
     /**
      * @brief export_game_samples Assigns the game result, (Monte-Carlo value result) to every training sample.
      * The value is inversed after each step and export all training samples of a single game.
+     * The samples which don't fit into the data set anymore (or whose sparse policy entries don't fit) are dropped.
+     * The game is handed over to the writer thread and the given game receives empty (preallocated) buffers.
+     * The call only blocks if EXPORT_QUEUE_CAPACITY games are already waiting to be written.
+     * This method is thread-safe.
+     * @param game Samples of the finished game
      * @param result Game match result: LOST, DRAW, WON
      */
-    void export_game_samples(Result result);
+    void export_game_samples(GameSamples& game, Result result);
+
+    /**
+     * @brief set_replay_buffer Sets a replay buffer to which the writer thread appends every written game.
+     * Must be called before the first game is exported.
+     * @param buffer Replay buffer which must outlive the exporter or nullptr
+     */
+    void set_replay_buffer(ReplayBuffer* buffer);
+
+    /**
+     * @brief flush Waits until all queued games have been written (including a partially filled last chunk)
+     * and prints the queue depth, the sample size, the write throughput and the write amplification.
+     * If the writer thread has failed, its first exception is rethrown by this and every later export or flush.
+     */
+    void flush();
+
+    /**
+     * @brief has_writer_error Returns true if the writer thread has failed. All further games are dropped in this case.
+     * This method is thread-safe.
+     */
+    bool has_writer_error();
+
+    /**
+     * @brief request_checkpoint Queues a checkpoint behind the previously exported games and returns immediately.
+     * When the writer thread reaches the checkpoint, it writes the partially filled last chunks and passes the state
+     * of the data set to the callback, so that the checkpoint contains exactly the games which were exported before.
+     * The callback is called by the writer thread. An exception of the callback is rethrown by the next export or flush.
+     * This method is thread-safe.
+     * @param onCheckpoint Receives a state which can be passed to the constructor to resume the data set
+     */
+    void request_checkpoint(function<void(const ExportCheckpoint&)> onCheckpoint);
 
     size_t get_number_samples() const;
 
     /**
-     * @brief is_file_full Returns true if the exported data set contains as many samples as initially specified, else false
+     * @brief is_file_full Returns true if the exported data set contains as many samples as initially specified
+     * or no sparse policy entries can be added anymore, else false
      * @return bool
      */
     bool is_file_full();
 
-    /**
-     * @brief new_game Sets firstMove to true
-     */
-    void new_game();
 };
 #endif
 
@@ -32,7 +32,9 @@
 
 #include <stdlib.h>
 #include <climits>
+#include <chrono>
 #include "util/blazeutil.h"
+#include "util/threadbudget.h"
 
 
 size_t SearchThread::get_max_depth() const
@@ -42,7 +44,11 @@ size_t SearchThread::get_max_depth() const
 
 SearchThread::SearchThread(NeuralNetAPI *netBatch, SearchSettings* searchSettings, MapWithMutex* mapWithMutex):
     NeuralNetAPIUser(netBatch),
-    isRunning(false), mapWithMutex(mapWithMutex), searchSettings(searchSettings)
+    isRunning(false), mapWithMutex(mapWithMutex), searchSettings(searchSettings),
+    subtreeScheduler(nullptr), threadIdx(0),
+    tbHits(0), depthSum(0), depthMax(0), visitsPreSearch(0),
+    descents(0), collisions(0), effectiveRollouts(0), hashTableLocks(0), filledSamples(0), computedSamples(0),
+    batchSizeController(searchSettings->batchSize)
 {
     searchLimits = nullptr;  // will be set by set_search_limits() every time before go()
 
@@ -50,6 +56,20 @@ SearchThread::SearchThread(NeuralNetAPI *netBatch, SearchSettings* searchSetting
     newNodeSideToMove = make_unique<FixedVector<SideToMove>>(searchSettings->batchSize);
     transpositionNodes = make_unique<FixedVector<Node*>>(searchSettings->batchSize*2);
     collisionNodes = make_unique<FixedVector<Node*>>(searchSettings->batchSize);
+
+    init_trajectories(newTrajectories, newNodes->capacity());
+    init_trajectories(transpositionTrajectories, transpositionNodes->capacity());
+    init_trajectories(collisionTrajectories, collisionNodes->capacity());
+    trajectoryBuffer.reserve(RESERVED_TRAJECTORY_LENGTH);
+    actionsBuffer.reserve(RESERVED_TRAJECTORY_LENGTH);
+}
+
+void init_trajectories(vector<Trajectory>& trajectories, size_t numberSlots)
+{
+    trajectories.resize(numberSlots);
+    for (Trajectory& trajectory : trajectories) {
+        trajectory.reserve(RESERVED_TRAJECTORY_LENGTH);
+    }
 }
 
 void SearchThread::set_root_node(Node *value)
@@ -76,6 +96,7 @@ void SearchThread::set_is_running(bool value)
 NodeBackup SearchThread::add_new_node_to_tree(StateObj* newState, Node* parentNode, size_t childIdx, bool inCheck)
 {
     mapWithMutex->mtx.lock();
+    ++hashTableLocks;
     unordered_map<Key, Node*>::const_iterator it = mapWithMutex->hashTable.find(newState->hash_key());
     if(searchSettings->useTranspositionTable && it != mapWithMutex->hashTable.end() &&
             is_transposition_verified(it, newState)) {
@@ -113,6 +134,11 @@ SearchLimits *SearchThread::get_search_limits() const
     return searchLimits;
 }
 
+const SearchSettings* SearchThread::get_search_settings() const
+{
+    return searchSettings;
+}
+
 void random_root_playout(NodeDescription& description, Node* currentNode, size_t& childIdx)
 {
     if (description.depth == 0 && size_t(currentNode->get_visits()) % RANDOM_MOVE_COUNTER == 0 && currentNode->get_visits() > RANDOM_MOVE_THRESH) {
@@ -146,25 +172,42 @@ Node* SearchThread::get_new_child_to_evaluate(size_t& childIdx, NodeDescription&
 {
     description.depth = 0;
     Node* currentNode = rootNode;
-    vector<Action> actions;
+    actionsBuffer.clear();
+    // the number of visits can only decrease along the trajectory
+    uint16_t numberVisits = searchSettings->useMultiVisit ? min(searchSettings->batchSize, unsigned(MAX_MULTI_VISITS)) : 1;
 
     while (true) {
         childIdx = INT_MAX;
         if (searchSettings->useRandomPlayout) {
             random_root_playout(description, currentNode, childIdx);
         }
+        if (description.depth == 0 && childIdx == INT_MAX && subtreeScheduler != nullptr) {
+            subtreeScheduler->pick_root_child(threadIdx, childIdx);
+        }
         currentNode->lock();
         if (childIdx == INT_MAX) {
             childIdx = currentNode->select_child_node(searchSettings);
+            if (numberVisits > 1) {
+                numberVisits = currentNode->get_consecutive_visits(childIdx, numberVisits, searchSettings);
+            }
+        }
+        else {
+            numberVisits = 1;
         }
-        currentNode->apply_virtual_loss_to_child(childIdx, searchSettings->virtualLoss);
-        trajectory.emplace_back(NodeAndIdx(currentNode, childIdx));
 
         Node* nextNode = currentNode->get_child_node(childIdx);
+        if (numberVisits > 1 && nextNode != nullptr && nextNode->is_transposition()) {
+            // the transposition return assumes a single pending visit on the edge
+            numberVisits = 1;
+        }
+        for (uint16_t idx = 0; idx < numberVisits; ++idx) {
+            currentNode->apply_virtual_loss_to_child(childIdx, searchSettings->virtualLoss);
+        }
+        trajectory.emplace_back(NodeAndIdx(currentNode, childIdx, numberVisits));
         description.depth++;
         if (nextNode == nullptr) {
             newState = unique_ptr<StateObj>(rootState->clone());
-            for (Action action : actions) {
+            for (Action action : actionsBuffer) {
                 newState->do_action(action);
             }
             const bool inCheck = newState->gives_check(currentNode->get_action(childIdx));
@@ -210,7 +253,7 @@ Node* SearchThread::get_new_child_to_evaluate(size_t& childIdx, NodeDescription&
             return currentNode;
         }
         currentNode->unlock();
-        actions.emplace_back(currentNode->get_action(childIdx));
+        actionsBuffer.emplace_back(currentNode->get_action(childIdx));
         currentNode = nextNode;
     }
 }
@@ -220,6 +263,17 @@ void SearchThread::set_root_state(StateObj* value)
     rootState = value;
 }
 
+size_t SearchThread::get_thread_idx() const
+{
+    return threadIdx;
+}
+
+void SearchThread::set_subtree_scheduler(SubtreeScheduler* scheduler, size_t threadIdx)
+{
+    subtreeScheduler = scheduler;
+    this->threadIdx = threadIdx;
+}
+
 size_t SearchThread::get_tb_hits() const
 {
     return tbHits;
@@ -230,12 +284,56 @@ void SearchThread::reset_stats()
     tbHits = 0;
     depthMax = 0;
     depthSum = 0;
+    descents = 0;
+    collisions = 0;
+    effectiveRollouts = 0;
+    hashTableLocks = 0;
+    filledSamples = 0;
+    computedSamples = 0;
+}
+
+size_t SearchThread::get_hash_table_locks() const
+{
+    return hashTableLocks;
+}
+
+size_t SearchThread::get_filled_samples() const
+{
+    return filledSamples;
+}
+
+size_t SearchThread::get_computed_samples() const
+{
+    return computedSamples;
+}
+
+size_t SearchThread::get_descents() const
+{
+    return descents;
+}
+
+size_t SearchThread::get_collisions() const
+{
+    return collisions;
+}
+
+size_t SearchThread::get_effective_rollouts() const
+{
+    return effectiveRollouts;
 }
 
 void fill_nn_results(size_t batchIdx, bool is_policy_map, const float* valueOutputs, const float* probOutputs, Node *node, size_t& tbHits, SideToMove sideToMove, const SearchSettings* searchSettings)
 {
-    node->set_probabilities_for_moves(get_policy_data_batch(batchIdx, probOutputs, is_policy_map), sideToMove);
-    node_post_process_policy(node, searchSettings->nodePolicyTemperature, is_policy_map, searchSettings);
+    node->set_prior_policy(get_policy_data_batch(batchIdx, probOutputs, is_policy_map), sideToMove, !is_policy_map, searchSettings->nodePolicyTemperature);
+    node->enhance_moves(searchSettings);
+    node_assign_value(node, valueOutputs, tbHits, batchIdx);
+    node->enable_has_nn_results();
+}
+
+void fill_sparse_nn_results(size_t batchIdx, const float* valueOutputs, const SparsePolicy& sparsePolicy, Node *node, size_t& tbHits, const SearchSettings* searchSettings)
+{
+    node->set_sparse_prior_policy(sparsePolicy.probabilities.data() + sparsePolicy.offsets[batchIdx], searchSettings->nodePolicyTemperature);
+    node->enhance_moves(searchSettings);
     node_assign_value(node, valueOutputs, tbHits, batchIdx);
     node->enable_has_nn_results();
 }
@@ -245,13 +343,42 @@ void SearchThread::set_nn_results_to_child_nodes()
     size_t batchIdx = 0;
     for (auto node: *newNodes) {
         if (!node->is_terminal()) {
-            fill_nn_results(batchIdx, net->is_policy_map(), valueOutputs, probOutputs, node, tbHits, newNodeSideToMove->get_element(batchIdx), searchSettings);
+            if (searchSettings->useSparsePolicy) {
+                fill_sparse_nn_results(batchIdx, valueOutputs, sparsePolicy, node, tbHits, searchSettings);
+            }
+            else {
+                fill_nn_results(batchIdx, net->is_policy_map(), valueOutputs, probOutputs, node, tbHits, newNodeSideToMove->get_element(batchIdx), searchSettings);
+            }
         }
         ++batchIdx;
-        mapWithMutex->mtx.lock();
+    }
+    publish_new_nodes();
+}
+
+size_t SearchThread::predict_new_nodes()
+{
+    const size_t numberNewNodes = newNodes->size();
+    filledSamples += numberNewNodes;
+    if (!searchSettings->useSparsePolicy) {
+        return net->predict_samples(inputPlanes, valueOutputs, probOutputs, numberNewNodes);
+    }
+    sparsePolicy.clear();
+    for (size_t batchIdx = 0; batchIdx < numberNewNodes; ++batchIdx) {
+        newNodes->get_element(batchIdx)->append_policy_indices(newNodeSideToMove->get_element(batchIdx), sparsePolicy.indices);
+        sparsePolicy.finish_sample();
+    }
+    return net->predict_sparse(inputPlanes, valueOutputs, probOutputs, numberNewNodes, sparsePolicy);
+}
+
+void SearchThread::publish_new_nodes()
+{
+    // all new nodes of the batch are inserted with a single lock acquisition
+    mapWithMutex->mtx.lock();
+    ++hashTableLocks;
+    for (auto node: *newNodes) {
         mapWithMutex->hashTable.insert({node->hash_key(), node});
-        mapWithMutex->mtx.unlock();
     }
+    mapWithMutex->mtx.unlock();
 }
 
 void SearchThread::backup_value_outputs()
@@ -266,7 +393,6 @@ void SearchThread::backup_collisions() {
         backup_collision(searchSettings->virtualLoss, collisionTrajectories[idx]);
     }
     collisionNodes->reset_idx();
-    collisionTrajectories.clear();
 }
 
 bool SearchThread::nodes_limits_ok()
@@ -293,50 +419,93 @@ void SearchThread::create_mini_batch()
     size_t childIdx;
     size_t numTerminalNodes = 0;
 
-    while (!newNodes->is_full() &&
+    const size_t batchSize = batchSizeController.get_batch_size();
+
+    while (newNodes->size() < batchSize &&
            !collisionNodes->is_full() &&
            !transpositionNodes->is_full() &&
            numTerminalNodes < TERMINAL_NODE_CACHE) {
 
-        Trajectory trajectory;
-        parentNode = get_new_child_to_evaluate(childIdx, description, trajectory);
+        trajectoryBuffer.clear();
+        parentNode = get_new_child_to_evaluate(childIdx, description, trajectoryBuffer);
         Node* newNode = parentNode->get_child_node(childIdx);
         depthSum += description.depth;
         depthMax = max(depthMax, description.depth);
+        ++descents;
+        if (description.type != NODE_COLLISION) {
+            effectiveRollouts += trajectoryBuffer.back().numberVisits;
+        }
 
+        // the trajectory is swapped into its batch slot which hands back a buffer of the last batch with reserved capacity
         if(description.type == NODE_TERMINAL) {
             ++numTerminalNodes;
-            backup_value(newNode->get_value(), searchSettings->virtualLoss, trajectory);
+            backup_value(newNode->get_value(), searchSettings->virtualLoss, trajectoryBuffer);
         }
         else if (description.type == NODE_COLLISION) {
             // store a pointer to the collision node in order to revert the virtual loss of the forward propagation
+            collisionTrajectories[collisionNodes->size()].swap(trajectoryBuffer);
             collisionNodes->add_element(newNode);
-            collisionTrajectories.emplace_back(trajectory);
+            ++collisions;
         }
         else if (description.type == NODE_TRANSPOSITION) {
+            transpositionTrajectories[transpositionNodes->size()].swap(trajectoryBuffer);
             transpositionNodes->add_element(newNode);
-            transpositionTrajectories.emplace_back(trajectory);
         }
         else {  // NODE_NEW_NODE
+            newTrajectories[newNodes->size()].swap(trajectoryBuffer);
             newNodes->add_element(newNode);
-            newTrajectories.emplace_back(trajectory);
         }
     }
 }
 
 void SearchThread::thread_iteration()
 {
+    // a new network is only used at the beginning of a mini-batch
+    apply_net_swap();
+    const bool useAdaptiveBatchSize = searchSettings->useAdaptiveBatchSize;
+    chrono::steady_clock::time_point iterationStart;
+    if (useAdaptiveBatchSize) {
+        iterationStart = chrono::steady_clock::now();
+    }
+    const size_t descentsPreIteration = descents;
+    const size_t collisionsPreIteration = collisions;
+    float latencyMS = 0;
+
     create_mini_batch();
-    if (newNodes->size() != 0) {
-        net->predict(inputPlanes, valueOutputs, probOutputs);
+    const size_t numberNewNodes = newNodes->size();
+    if (numberNewNodes != 0) {
+        chrono::steady_clock::time_point predictStart;
+        if (useAdaptiveBatchSize) {
+            predictStart = chrono::steady_clock::now();
+        }
+        computedSamples += predict_new_nodes();
+        if (useAdaptiveBatchSize) {
+            latencyMS = chrono::duration<float, milli>(chrono::steady_clock::now() - predictStart).count();
+        }
         set_nn_results_to_child_nodes();
     }
     backup_value_outputs();
     backup_collisions();
+
+    if (useAdaptiveBatchSize) {
+        batchSizeController.update(numberNewNodes, descents - descentsPreIteration, collisions - collisionsPreIteration,
+                                   chrono::duration<float, milli>(chrono::steady_clock::now() - iterationStart).count(), latencyMS);
+    }
+}
+
+size_t SearchThread::get_batch_size() const
+{
+    return batchSizeController.get_batch_size();
+}
+
+float SearchThread::get_batch_latency() const
+{
+    return batchSizeController.get_latency();
 }
 
 void run_search_thread(SearchThread *t)
 {
+    pin_search_thread(t->get_thread_idx());
     t->set_is_running(true);
     t->reset_stats();
     while(t->is_running() && t->nodes_limits_ok() && t->is_root_node_unsolved()) {
@@ -345,7 +514,7 @@ void run_search_thread(SearchThread *t)
     t->set_is_running(false);
 }
 
-void SearchThread::backup_values(FixedVector<Node*>* nodes, vector<Trajectory>& trajectories) {
+void SearchThread::backup_values(FixedVector<Node*>* nodes, const vector<Trajectory>& trajectories) {
     for (size_t idx = 0; idx < nodes->size(); ++idx) {
         const Node* node = nodes->get_element(idx);
         if (!isnan(node->get_value())){
@@ -353,7 +522,6 @@ void SearchThread::backup_values(FixedVector<Node*>* nodes, vector<Trajectory>&
         }
     }
     nodes->reset_idx();
-    trajectories.clear();
 }
 
 void node_assign_value(Node *node, const float* valueOutputs, size_t& tbHits, size_t batchIdx)
@@ -370,15 +538,6 @@ void node_assign_value(Node *node, const float* valueOutputs, size_t& tbHits, si
     }
 }
 
-void node_post_process_policy(Node *node, float temperature, bool isPolicyMap, const SearchSettings* searchSettings)
-{
-    if (!isPolicyMap) {
-        node->apply_softmax_to_policy();
-    }
-    node->enhance_moves(searchSettings);
-    node->apply_temperature_to_prior_policy(temperature);
-}
-
 bool is_transposition_verified(const unordered_map<Key,Node*>::const_iterator& it, const StateObj* state) {
     return  it->second->has_nn_results() &&
             it->second->plies_from_null() == state->steps_from_null() &&
@@ -34,6 +34,8 @@
 #include "config/searchlimits.h"
 #include "util/fixedvector.h"
 #include "nn/neuralnetapiuser.h"
+#include "manager/subtreescheduler.h"
+#include "manager/batchsizecontroller.h"
 
 
 // wrapper for unordered_map with a mutex for thread safe access
@@ -72,19 +74,39 @@ private:
     unique_ptr<FixedVector<Node*>> transpositionNodes;
     unique_ptr<FixedVector<Node*>> collisionNodes;
 
+    // preallocated trajectory slots which are indexed by the batch slot of the according node vector and reused every batch
     vector<Trajectory> newTrajectories;
     vector<Trajectory> transpositionTrajectories;
     vector<Trajectory> collisionTrajectories;
+    // scratch buffers for the current rollout, the trajectory is swapped into its batch slot afterwards
+    Trajectory trajectoryBuffer;
+    vector<Action> actionsBuffer;
 
     bool isRunning;
 
     MapWithMutex* mapWithMutex;
     SearchSettings* searchSettings;
     SearchLimits* searchLimits;
+    // optional scheduler which assigns the root child node for each rollout (nullptr if disabled)
+    SubtreeScheduler* subtreeScheduler;
+    size_t threadIdx;
     size_t tbHits;
     size_t depthSum;
     size_t depthMax;
     size_t visitsPreSearch;
+    // number of descents from the root, collision events and visits which have been backed up (> descents for multi-visits)
+    size_t descents;
+    size_t collisions;
+    size_t effectiveRollouts;
+    // number of lock acquisitions on the shared hash table
+    size_t hashTableLocks;
+    // number of filled batch slots and number of samples which were computed by the neural network
+    size_t filledSamples;
+    size_t computedSamples;
+    // legal move indices and prior probabilities of the new nodes if a sparse policy is used
+    SparsePolicy sparsePolicy;
+    // number of leaves which are gathered for each neural network request
+    BatchSizeController batchSizeController;
 public:
     /**
      * @brief SearchThread
@@ -103,7 +125,8 @@ public:
     void create_mini_batch();
 
     /**
-     * @brief thread_iteration Runs multiple mcts-rollouts as long as a new batch is filled
+     * @brief thread_iteration Runs multiple mcts-rollouts as long as a new batch is filled.
+     * If the adaptive batch size is enabled, the collisions and latency of the iteration are passed to the batch size controller.
      */
     void thread_iteration();
 
@@ -149,12 +172,42 @@ public:
     void reset_stats();
 
     void set_root_state(StateObj* value);
+
+    /**
+     * @brief set_subtree_scheduler Sets the scheduler which selects the root child node for each rollout
+     * @param scheduler Subtree scheduler which is shared by all search threads (nullptr disables the subtree affinity)
+     * @param threadIdx Index of this thread for the scheduler
+     */
+    void set_subtree_scheduler(SubtreeScheduler* scheduler, size_t threadIdx);
+
+    size_t get_thread_idx() const;
     size_t get_tb_hits() const;
 
     size_t get_avg_depth();
 
     size_t get_max_depth() const;
 
+    /**
+     * @brief get_batch_size Returns the current number of leaves which are gathered for each neural network request
+     * @return Batch size
+     */
+    size_t get_batch_size() const;
+
+    /**
+     * @brief get_batch_latency Returns the average neural network latency in ms of the last measurement interval
+     * @return latency in ms
+     */
+    float get_batch_latency() const;
+
+    const SearchSettings* get_search_settings() const;
+
+    size_t get_descents() const;
+    size_t get_collisions() const;
+    size_t get_effective_rollouts() const;
+    size_t get_hash_table_locks() const;
+    size_t get_filled_samples() const;
+    size_t get_computed_samples() const;
+
     float get_transposition_q_value(uint32_t transposVisits, double transposQsum, uint32_t masterVisits, double masterQsum);
 
 private:
@@ -163,6 +216,17 @@ private:
      */
     void set_nn_results_to_child_nodes();
 
+    /**
+     * @brief predict_new_nodes Runs the neural network on the new nodes of the mini-batch
+     * @return Number of samples which have been computed
+     */
+    size_t predict_new_nodes();
+
+    /**
+     * @brief publish_new_nodes Inserts all newly expanded nodes of the current batch into the hash table using a single lock acquisition
+     */
+    void publish_new_nodes();
+
     /**
      * @brief backup_value_outputs Backpropagates all newly received value evaluations from the neural network accross the visited search paths
      */
@@ -185,13 +249,24 @@ private:
      */
     Node* get_new_child_to_evaluate(size_t& childIdx, NodeDescription& description, Trajectory& trajectory);
 
-    void backup_values(FixedVector<Node*>* nodes, vector<Trajectory>& trajectories);
+    void backup_values(FixedVector<Node*>* nodes, const vector<Trajectory>& trajectories);
 };
 
 void run_search_thread(SearchThread *t);
 
+/**
+ * @brief init_trajectories Allocates the given number of trajectory slots and reserves memory for each of them
+ * @param trajectories Trajectory slots
+ * @param numberSlots Number of slots (capacity of the according node vector)
+ */
+void init_trajectories(vector<Trajectory>& trajectories, size_t numberSlots);
+
 void fill_nn_results(size_t batchIdx, bool isPolicyMap, const float* valueOutputs, const float* probOutputs, Node *node, size_t& tbHits, SideToMove sideToMove, const SearchSettings* searchSettings);
-void node_post_process_policy(Node *node, float temperature, bool isPolicyMap, const SearchSettings* searchSettings);
+
+/**
+ * @brief fill_sparse_nn_results Version of fill_nn_results() for a policy which was gathered and normalized over the legal moves
+ */
+void fill_sparse_nn_results(size_t batchIdx, const float* valueOutputs, const SparsePolicy& sparsePolicy, Node *node, size_t& tbHits, const SearchSettings* searchSettings);
 void node_assign_value(Node *node, const float* valueOutputs, size_t& tbHits, size_t batchIdx);
 
 bool is_transposition_verified(const unordered_map<Key,Node*>::const_iterator& it, const StateObj* state);
@@ -24,3 +24,19 @@
  */
 
 #include "randomgen.h"
+
+#include <sstream>
+
+thread_local std::default_random_engine generator(std::random_device{}());
+
+std::string get_generator_state()
+{
+    std::ostringstream state;
+    state << generator;
+    return state.str();
+}
+
+void set_generator_state(const std::string& state)
+{
+    std::istringstream(state) >> generator;
+}
@@ -29,10 +29,12 @@
 #define RANDOMGEN_H
 
 #include <random>
+#include <cstdlib>
+#include <string>
 
-// random generator used for all sort of distributions
-static std::random_device r;
-static std::default_random_engine generator(r());
+// random generator used for all sort of distributions.
+// Every thread uses its own generator, so that concurrent games (e.g. in selfplay) don't share the state of the engine.
+extern thread_local std::default_random_engine generator;
 
 /**
  * @brief random_exponential Generates a random sample from a exponential distribution with a given mean.
@@ -45,4 +47,23 @@ T random_exponential(T lambda) {
     return distribution(generator);
 }
 
+/**
+ * @brief random_int Generates a random integer in [0, RAND_MAX] like rand(), but with the generator of the calling thread
+ * @return Generated value
+ */
+inline int random_int() {
+    std::uniform_int_distribution<int> distribution(0, RAND_MAX);
+    return distribution(generator);
+}
+
+/**
+ * @brief get_generator_state Returns the serialized state of the generator of the calling thread
+ */
+std::string get_generator_state();
+
+/**
+ * @brief set_generator_state Restores the generator of the calling thread from a state of get_generator_state()
+ */
+void set_generator_state(const std::string& state);
+
 #endif // RANDOMGEN_H
@@ -0,0 +1,114 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: threadbudget.cpp
+ * Created on 19.10.2026
+ * @author: agent
+ */
+
+#include "threadbudget.h"
+#include <algorithm>
+#include <thread>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "communication.h"
+
+using namespace std;
+
+static ThreadBudget threadBudget;
+
+ThreadBudget create_thread_budget(size_t centiInferenceCores, size_t numberNets, bool pinThreads, size_t numberCores)
+{
+    ThreadBudget budget;
+    budget.numberCores = numberCores != 0 ? numberCores : max(1u, thread::hardware_concurrency());
+    if (centiInferenceCores == 0) {
+        budget.searchCores = budget.numberCores;
+        return budget;
+    }
+    budget.enabled = true;
+    budget.pinThreads = pinThreads;
+    if (budget.numberCores == 1) {
+        // search and inference have to share the only core
+        budget.searchCores = 1;
+        budget.inferenceCores = 1;
+        budget.pinThreads = false;
+    }
+    else {
+        // each class of threads gets at least one core
+        budget.inferenceCores = min(budget.numberCores - 1, max(size_t(1), (budget.numberCores * centiInferenceCores + 50) / 100));
+        budget.searchCores = budget.numberCores - budget.inferenceCores;
+    }
+    budget.inferenceThreadsPerNet = max(size_t(1), budget.inferenceCores / max(size_t(1), numberNets));
+    return budget;
+}
+
+void set_thread_budget(const ThreadBudget& budget)
+{
+    threadBudget = budget;
+    if (!budget.enabled) {
+        return;
+    }
+    info_string("search cores:", budget.searchCores);
+    info_string("inference cores:", budget.inferenceCores);
+    info_string("inference threads per network:", budget.inferenceThreadsPerNet);
+}
+
+bool is_inference_budget_adjustable()
+{
+#ifdef NATIVE_CPU
+    return true;
+#else
+    return false;
+#endif
+}
+
+const ThreadBudget& get_thread_budget()
+{
+    return threadBudget;
+}
+
+/**
+ * @brief pin_current_thread Pins the calling thread to the core firstCore + threadIdx % numberCores
+ */
+static void pin_current_thread(size_t firstCore, size_t numberCores, size_t threadIdx)
+{
+#ifdef __linux__
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(firstCore + threadIdx % numberCores, &cpuSet);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet);
+#endif
+}
+
+void pin_search_thread(size_t threadIdx)
+{
+    if (threadBudget.pinThreads) {
+        pin_current_thread(0, threadBudget.searchCores, threadIdx);
+    }
+}
+
+void pin_inference_thread(size_t threadIdx)
+{
+    if (threadBudget.pinThreads) {
+        pin_current_thread(threadBudget.searchCores, threadBudget.inferenceCores, threadIdx);
+    }
+}
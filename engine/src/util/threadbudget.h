@@ -0,0 +1,85 @@
+/*
+  CrazyAra, a deep learning chess variant engine
+  Copyright (C) 2018       Johannes Czech, Moritz Willig, Alena Beyer
+  Copyright (C) 2019-2020  Johannes Czech
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * @file: threadbudget.h
+ * Created on 19.10.2026
+ * @author: agent
+ *
+ * Global CPU thread budget which splits the available cores between the search threads and the intra-op threads
+ * of the native CPU back-end, so that both don't oversubscribe the cores.
+ * Optionally, each class of threads is pinned to its own disjoint set of cores (Linux only).
+ */
+
+#ifndef THREADBUDGET_H
+#define THREADBUDGET_H
+
+#include <cstddef>
+
+/**
+ * @brief The ThreadBudget struct describes the split of the cores.
+ * The cores [0, searchCores) are used by the search threads and [searchCores, numberCores) by the inference threads.
+ */
+struct ThreadBudget {
+    // if false, the budget isn't used and the back-ends choose their thread counts themselves
+    bool enabled = false;
+    bool pinThreads = false;
+    size_t numberCores = 1;
+    size_t searchCores = 1;
+    size_t inferenceCores = 0;
+    // number of intra-op threads of each neural network object
+    size_t inferenceThreadsPerNet = 1;
+};
+
+/**
+ * @brief create_thread_budget Splits the cores between the search and the inference threads
+ * @param centiInferenceCores Percentage of cores for inference, 0 disables the budget
+ * @param numberNets Number of neural network objects which are used by the search threads
+ * @param pinThreads True, if the threads shall be pinned to the cores of their class
+ * @param numberCores Number of available cores (0 for the number of hardware threads)
+ */
+ThreadBudget create_thread_budget(size_t centiInferenceCores, size_t numberNets, bool pinThreads, size_t numberCores=0);
+
+/**
+ * @brief set_thread_budget Sets the global thread budget, which is applied to the networks that are created afterwards.
+ * Only the native CPU back-end uses the inference threads of the budget, the other back-ends keep their own thread counts.
+ */
+void set_thread_budget(const ThreadBudget& budget);
+
+/**
+ * @brief is_inference_budget_adjustable Returns true if the back-end applies a changed thread budget to its inference threads.
+ * This is only the case for the native CPU back-end, which receives the number of inference threads whenever a network is created.
+ */
+bool is_inference_budget_adjustable();
+
+const ThreadBudget& get_thread_budget();
+
+/**
+ * @brief pin_search_thread Pins the calling thread to one of the search cores (round robin over threadIdx)
+ * if thread pinning is enabled
+ */
+void pin_search_thread(size_t threadIdx);
+
+/**
+ * @brief pin_inference_thread Pins the calling thread to one of the inference cores (round robin over threadIdx)
+ * if thread pinning is enabled
+ */
+void pin_inference_thread(size_t threadIdx);
+
+#endif // THREADBUDGET_H
@@ -38,10 +38,233 @@
 #include "stateobj.h"
 #include "chess_related/inputrepresentation.h"
 #include "legacyconstants.h"
+#include "searchthread.h"
+#include "nn/neuralnetapi.h"
+#include "nn/sharedbatchapi.h"
+#include "agents/config/searchsettings.h"
+#include "agents/config/searchlimits.h"
+#include "agents/config/playsettings.h"
+#include "agents/mctsagent.h"
+#include "util/communication.h"
+#include "rl/tournamentresult.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <new>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#ifdef USE_RL
+#include <csignal>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "rl/traindataexporter.h"
+#include "rl/selfplaycheckpoint.h"
+#include "rl/openingpool.h"
+#include "rl/replaybuffer.h"
+#include "util/randomgen.h"
+#include "rl/selfplay.h"
+#endif
+#ifdef NATIVE_CPU
+#include "nn/nativecpuapi.h"
+#include "nn/util/cpukernels.h"
+#include "chess_related/chessbatchstream.h"
+#endif
 using namespace Catch::literals;
 using namespace std;
 using namespace OptionsUCI;
 
+/**
+ * @brief The AllocationHook struct is notified about the heap blocks which the thread that installed it allocates and releases
+ */
+struct AllocationHook
+{
+    virtual ~AllocationHook() {}
+    virtual void on_allocation(void* ptr) = 0;
+    virtual void on_release(void* ptr) = 0;
+};
+
+// hook of the current thread, operator new and delete only forward to malloc and free if no hook is installed
+static thread_local AllocationHook* allocationHook = nullptr;
+
+/**
+ * @brief The AllocationHookScope struct installs the given hook for the current thread during its lifetime
+ */
+struct AllocationHookScope
+{
+    AllocationHook* outerHook;
+    AllocationHookScope(AllocationHook* hook):
+        outerHook(allocationHook) {
+        allocationHook = hook;
+    }
+    ~AllocationHookScope() {
+        allocationHook = outerHook;
+    }
+};
+
+void* operator new(size_t size)
+{
+    void* ptr = malloc(size);
+    if (ptr == nullptr) {
+        throw bad_alloc();
+    }
+    if (allocationHook != nullptr) {
+        allocationHook->on_allocation(ptr);
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (allocationHook != nullptr && ptr != nullptr) {
+        allocationHook->on_release(ptr);
+    }
+    free(ptr);
+}
+
+/**
+ * @brief The UniformNetAPI class is a neural network stub which returns a draw value and a uniform policy for every sample
+ */
+class UniformNetAPI : public NeuralNetAPI
+{
+public:
+    UniformNetAPI(unsigned int batchSize, bool isPolicyMap=false):
+        NeuralNetAPI("cpu", 0, batchSize, "model/", false)
+    {
+        this->isPolicyMap = isPolicyMap;
+        if (isPolicyMap) {
+            policyOutputLength = StateConstants::NB_LABELS_POLICY_MAP() * batchSize;
+        }
+        modelName = "uniform";
+    }
+    void predict(float* inputPlanes, float* valueOutput, float* probOutputs) override {
+        fill(valueOutput, valueOutput + batchSize, 0.0f);
+        fill(probOutputs, probOutputs + policyOutputLength, 0.0f);
+    }
+protected:
+    void load_model() override {}
+    void load_parameters() override {}
+    void bind_executor() override {}
+    void check_if_policy_map() override {}
+};
+
+/**
+ * @brief The EchoNetAPI class is a neural network stub which returns the first input value of each sample as its value and policy
+ */
+class EchoNetAPI : public UniformNetAPI
+{
+public:
+    EchoNetAPI(unsigned int batchSize, bool isPolicyMap):
+        UniformNetAPI(batchSize, isPolicyMap) {}
+    void predict(float* inputPlanes, float* valueOutput, float* probOutputs) override {
+        const size_t policySize = policyOutputLength / batchSize;
+        for (size_t sampleIdx = 0; sampleIdx < batchSize; ++sampleIdx) {
+            const float input = inputPlanes[sampleIdx * StateConstants::NB_VALUES_TOTAL()];
+            valueOutput[sampleIdx] = input;
+            fill(probOutputs + sampleIdx * policySize, probOutputs + (sampleIdx + 1) * policySize, input);
+        }
+    }
+};
+
+#if defined(MODE_CRAZYHOUSE) || defined(MODE_CHESS)
+/**
+ * @brief The BlockRecorder class records the heap blocks which are allocated while isRecording is true and tracks their release
+ */
+class BlockRecorder : public AllocationHook
+{
+public:
+    // the storage is reserved in advance, so that the hook itself never allocates
+    vector<void*> blocks;
+    bool isRecording = false;
+    // number of blocks which didn't fit into the reserved storage
+    size_t numberDroppedBlocks = 0;
+    // number of recorded blocks which were released while isRecording was still true
+    size_t numberTransientBlocks = 0;
+
+    BlockRecorder(size_t capacity) {
+        blocks.reserve(capacity);
+    }
+    void on_allocation(void* ptr) override {
+        if (!isRecording) {
+            return;
+        }
+        if (blocks.size() < blocks.capacity()) {
+            blocks.push_back(ptr);
+        }
+        else {
+            ++numberDroppedBlocks;
+        }
+    }
+    void on_release(void* ptr) override {
+        auto it = find(blocks.begin(), blocks.end(), ptr);
+        if (it != blocks.end()) {
+            *it = nullptr;
+            if (isRecording) {
+                ++numberTransientBlocks;
+            }
+        }
+    }
+    size_t number_remaining_blocks() const {
+        return size_t(count_if(blocks.begin(), blocks.end(), [](void* ptr){ return ptr != nullptr; }));
+    }
+};
+
+/**
+ * @brief The StateAllocationScope struct hides all allocations of a state object from the installed hook during its lifetime
+ */
+struct StateAllocationScope : AllocationHookScope
+{
+    StateAllocationScope():
+        AllocationHookScope(nullptr) {
+    }
+};
+
+/**
+ * @brief The NodeCreationState class is a state whose allocations are excluded from the recorded allocations.
+ * The search clones the root state for every node creation, so all states of the search are of this type.
+ */
+class NodeCreationState : public StateObj
+{
+public:
+    NodeCreationState* clone() const override {
+        StateAllocationScope scope;
+        return new NodeCreationState(*this);
+    }
+    vector<Action> legal_actions() const override {
+        StateAllocationScope scope;
+        return StateObj::legal_actions();
+    }
+    void do_action(Action action) override {
+        StateAllocationScope scope;
+        StateObj::do_action(action);
+    }
+    void undo_action(Action action) override {
+        StateAllocationScope scope;
+        StateObj::undo_action(action);
+    }
+    bool gives_check(Action action) const override {
+        StateAllocationScope scope;
+        return StateObj::gives_check(action);
+    }
+    TerminalType is_terminal(size_t numberLegalMoves, bool inCheck, float& customTerminalValue) const override {
+        StateAllocationScope scope;
+        return StateObj::is_terminal(numberLegalMoves, inCheck, customTerminalValue);
+    }
+    Result check_result(bool inCheck) const override {
+        StateAllocationScope scope;
+        return StateObj::check_result(inCheck);
+    }
+    void get_state_planes(bool normalize, float* inputPlanes) const override {
+        StateAllocationScope scope;
+        StateObj::get_state_planes(normalize, inputPlanes);
+    }
+};
+#endif
+
 void init() {
     OptionsUCI::init(Options);
     Bitboards::init();
@@ -227,6 +450,1296 @@ TEST_CASE("Chess_Input_Planes"){
 }
 #endif
 
+#if defined(MODE_CRAZYHOUSE) || defined(MODE_CHESS)
+TEST_CASE("Allocation-free rollouts in an unsolved tree"){
+    init();
+    StateConstants::init(false);
+    SearchSettings searchSettings;
+    searchSettings.batchSize = 4;
+    searchSettings.useRandomPlayout = false;
+    SearchLimits searchLimits;
+    UniformNetAPI net(searchSettings.batchSize);
+    vector<float> valueOutputs(1, 0.0f);
+    vector<float> probOutputs(StateConstants::NB_LABELS(), 0.0f);
+    size_t numberCollisions = 0;
+
+    // a mini-batch can't expand or link the nodes which it creates itself, so every block which is allocated by a single
+    // iteration outside of the state objects must belong to the tree, which covers the new node, collision and transposition slots
+    for (size_t warmupIterations : {20, 35, 50, 65, 80}) {
+        MapWithMutex mapWithMutex;
+        // avoids a rehashing during the recorded iteration
+        mapWithMutex.hashTable.reserve(1 << 16);
+        SearchThread searchThread(&net, &searchSettings, &mapWithMutex);
+        NodeCreationState state;
+#ifdef MODE_CRAZYHOUSE
+        state.set(StartFENs[CRAZYHOUSE_VARIANT], false, CRAZYHOUSE_VARIANT);
+#else
+        state.set(StartFENs[CHESS_VARIANT], false, CHESS_VARIANT);
+#endif
+        Node* rootNode = new Node(&state, false, nullptr, 0, &searchSettings);
+        size_t tbHits = 0;
+        fill_nn_results(0, false, valueOutputs.data(), probOutputs.data(), rootNode, tbHits, state.side_to_move(), &searchSettings);
+        rootNode->prepare_node_for_visits();
+        searchThread.set_root_node(rootNode);
+        searchThread.set_root_state(&state);
+        searchThread.set_search_limits(&searchLimits);
+        searchThread.reset_stats();
+        for (size_t iteration = 0; iteration < warmupIterations; ++iteration) {
+            searchThread.thread_iteration();
+        }
+        REQUIRE(rootNode->get_node_type() == UNSOLVED);
+
+        const size_t collisionsPreIteration = searchThread.get_collisions();
+        BlockRecorder recorder(1 << 16);
+        AllocationHookScope hookScope(&recorder);
+        recorder.isRecording = true;
+        searchThread.thread_iteration();
+        recorder.isRecording = false;
+        numberCollisions += searchThread.get_collisions() - collisionsPreIteration;
+        REQUIRE(recorder.numberDroppedBlocks == 0);
+        REQUIRE(recorder.numberTransientBlocks == 0);
+
+        // the deletion of the tree releases all blocks which belong to it
+        GCThread<Node> gcThread;
+        delete_subtree_and_hash_entries(rootNode, mapWithMutex.hashTable, gcThread);
+        gcThread.delete_elements();
+        REQUIRE(recorder.number_remaining_blocks() == 0);
+    }
+    REQUIRE(numberCollisions != 0);
+}
+
+/**
+ * @brief reference_prior_policy Sets the prior policy of the node with the separate steps which Node::set_prior_policy() fuses
+ */
+void reference_prior_policy(Node* node, const float* probOutputs, SideToMove sideToMove, bool isLogits, float temperature, const SearchSettings* searchSettings)
+{
+    node->set_probabilities_for_moves(probOutputs, sideToMove);
+    if (isLogits) {
+        node->apply_softmax_to_policy();
+    }
+    node->enhance_moves(searchSettings);
+    node->apply_temperature_to_prior_policy(temperature);
+    node->sort_moves_by_probabilities();
+}
+
+TEST_CASE("Fused prior policy"){
+    init();
+    StateConstants::init(false);
+    SearchSettings searchSettings;
+    StateObj state;
+#ifdef MODE_CRAZYHOUSE
+    state.set("r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R[] w KQkq - 4 4", false, CRAZYHOUSE_VARIANT);
+#else
+    state.set("r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4", false, CHESS_VARIANT);
+#endif
+    mt19937 generator(42);
+    uniform_real_distribution<float> distribution(-5.0f, 5.0f);
+    vector<float> logits(StateConstants::NB_LABELS());
+    vector<float> probabilities(StateConstants::NB_LABELS());
+    float sum = 0;
+    for (size_t idx = 0; idx < logits.size(); ++idx) {
+        logits[idx] = distribution(generator);
+        probabilities[idx] = exp(logits[idx]);
+        sum += probabilities[idx];
+    }
+    for (float& prob : probabilities) {
+        prob /= sum;
+    }
+
+    for (bool isLogits : {true, false}) {
+        const vector<float>& probOutputs = isLogits ? logits : probabilities;
+        for (float temperature : {1.0f, 1.7f}) {
+            Node reference(&state, false, nullptr, 0, &searchSettings);
+            reference_prior_policy(&reference, probOutputs.data(), state.side_to_move(), isLogits, temperature, &searchSettings);
+
+            Node fused(&state, false, nullptr, 0, &searchSettings);
+            fused.set_prior_policy(probOutputs.data(), state.side_to_move(), isLogits, temperature);
+            // the moves must not be sorted again before the first visit
+            REQUIRE(fused.is_sorted());
+            REQUIRE(fused.get_legal_actions() == reference.get_legal_actions());
+            for (size_t idx = 0; idx < fused.get_number_child_nodes(); ++idx) {
+                REQUIRE(fused.get_policy_prob_small()[idx] == Approx(reference.get_policy_prob_small()[idx]).margin(1e-6));
+            }
+        }
+    }
+
+    // cost of the policy processing per node expansion before and after the fusion
+    const size_t numberIterations = 100000;
+    Node node(&state, false, nullptr, 0, &searchSettings);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t iteration = 0; iteration < numberIterations; ++iteration) {
+        reference_prior_policy(&node, logits.data(), state.side_to_move(), true, 1.7f, &searchSettings);
+    }
+    const float separateNs = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count() / float(numberIterations);
+    start = chrono::steady_clock::now();
+    for (size_t iteration = 0; iteration < numberIterations; ++iteration) {
+        node.set_prior_policy(logits.data(), state.side_to_move(), true, 1.7f);
+    }
+    const float fusedNs = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count() / float(numberIterations);
+    info_string("policy processing per node (ns) separate:", separateNs);
+    info_string("policy processing per node (ns) fused:", fusedNs);
+}
+
+/**
+ * @brief The UniformMCTSAgent struct is an MCTSAgent with uniform networks which samples every move
+ */
+struct UniformMCTSAgent
+{
+    SearchSettings searchSettings;
+    PlaySettings playSettings;
+    UniformNetAPI netSingle;
+    vector<unique_ptr<NeuralNetAPI>> netBatches;
+    unique_ptr<MCTSAgent> agent;
+
+    UniformMCTSAgent():
+        netSingle(1)
+    {
+        searchSettings.multiPV = 1;
+        searchSettings.threads = 1;
+        searchSettings.batchSize = 4;
+        searchSettings.allowEarlyStopping = false;
+        searchSettings.useNPSTimemanager = false;
+        searchSettings.useTablebase = false;
+        searchSettings.useRandomPlayout = false;
+        playSettings.initTemperature = 1.0;
+        playSettings.temperatureMoves = 100;
+        playSettings.temperatureDecayFactor = 1.0;
+        playSettings.quantileClipping = 0;
+        netBatches.emplace_back(make_unique<UniformNetAPI>(searchSettings.batchSize));
+        agent = make_unique<MCTSAgent>(&netSingle, netBatches, &searchSettings, &playSettings);
+    }
+};
+
+/**
+ * @brief play_sampled_moves Plays a game from the starting position with Dirichlet noise and sampled moves
+ * @return Number of played plies
+ */
+size_t play_sampled_moves(MCTSAgent* agent, Variant variant, size_t maxPlies) {
+    StateObj state;
+    state.set(StartFENs[variant], false, variant);
+    SearchLimits searchLimits;
+    searchLimits.nodes = 32;
+    EvalInfo evalInfo;
+    size_t plies = 0;
+    Result result = NO_RESULT;
+    while (plies < maxPlies && result == NO_RESULT) {
+        searchLimits.startTime = now();
+        agent->set_search_settings(&state, &searchLimits, &evalInfo);
+        agent->perform_action();
+        const bool givesCheck = state.gives_check(evalInfo.bestMove);
+        state.do_action(evalInfo.bestMove);
+        result = state.check_result(givesCheck);
+        ++plies;
+    }
+    agent->clear_game_history();
+    return plies;
+}
+
+TEST_CASE("Concurrent games with sampled moves"){
+    init();
+    StateConstants::init(false);
+    const Variant variant = UCI::variant_from_name(Options["UCI_Variant"]);
+    // both games draw their moves and their Dirichlet noise at the same time,
+    // build with USE_THREAD_SANITIZER to check that they don't share a random generator
+    UniformMCTSAgent agentA;
+    UniformMCTSAgent agentB;
+    size_t pliesA = 0;
+    thread gameThread([&]() { pliesA = play_sampled_moves(agentA.agent.get(), variant, 20); });
+    const size_t pliesB = play_sampled_moves(agentB.agent.get(), variant, 20);
+    gameThread.join();
+    REQUIRE(pliesA != 0);
+    REQUIRE(pliesB != 0);
+}
+#endif
+
+#ifdef USE_RL
+// number of sparse policy entries of each test sample
+const size_t TEST_POLICY_ENTRIES = 20;
+
+size_t test_game_length(size_t gameIdx) {
+    return 1 + gameIdx % 7;
+}
+
+/**
+ * @brief fill_test_game Fills the game with samples whose content is derived from their index in the data set.
+ * If sparsePolicy is false, the same policy entries are stored as a dense policy.
+ */
+void fill_test_game(GameSamples& game, size_t firstSampleIdx, size_t length, bool sparsePolicy=true) {
+    for (size_t sampleIdx = firstSampleIdx; sampleIdx < firstSampleIdx + length; ++sampleIdx) {
+        game.gameX.insert(game.gameX.end(), NB_VALUES_TOTAL, int16_t(sampleIdx % 1000 + 1));
+        game.gameValue.push_back(1);
+        game.gameBestMoveQ.push_back(float(sampleIdx));
+        const size_t policyOffset = game.gamePolicy.size();
+        if (!sparsePolicy) {
+            game.gamePolicy.insert(game.gamePolicy.end(), NB_LABELS, 0.0f);
+        }
+        for (size_t entryIdx = 0; entryIdx < TEST_POLICY_ENTRIES; ++entryIdx) {
+            if (sparsePolicy) {
+                game.gamePolicyIndices.push_back(int16_t((sampleIdx + entryIdx) % NB_LABELS));
+                game.gamePolicyValues.push_back(float(entryIdx));
+            }
+            else {
+                game.gamePolicy[policyOffset + (sampleIdx + entryIdx) % NB_LABELS] = float(entryIdx);
+            }
+        }
+        if (sparsePolicy) {
+            game.gamePolicyEnds.push_back(int64_t(game.gamePolicyIndices.size()));
+        }
+        ++game.numberSamples;
+    }
+}
+
+/**
+ * @brief export_test_games Exports test games until the data set is full and requests a checkpoint after every third game
+ */
+void export_test_games(TrainDataExporter& exporter, size_t firstGameIdx, size_t firstSampleIdx, const string& checkpointFile) {
+    GameSamples game(GAME_SAMPLES_CAPACITY, true);
+    size_t sampleIdx = firstSampleIdx;
+    for (size_t gameIdx = firstGameIdx; !exporter.is_file_full(); ++gameIdx) {
+        fill_test_game(game, sampleIdx, test_game_length(gameIdx));
+        sampleIdx += test_game_length(gameIdx);
+        exporter.export_game_samples(game, WHITE_WIN);
+        if (gameIdx % 3 == 2) {
+            SelfPlayCheckpoint checkpoint;
+            checkpoint.generatedGames = gameIdx + 1;
+            checkpoint.pgnFileSize = 0;
+            exporter.request_checkpoint([checkpoint, checkpointFile](const ExportCheckpoint& exportCheckpoint) mutable {
+                checkpoint.exportCheckpoint = exportCheckpoint;
+                write_checkpoint(checkpointFile, checkpoint);
+            });
+        }
+        // gives the killing process the chance to interrupt the writer at any point
+        this_thread::sleep_for(chrono::microseconds(200));
+    }
+}
+
+template<typename T>
+vector<T> read_test_dataset(const z5::filesystem::handle::File& file, const string& key) {
+    unique_ptr<z5::Dataset> dataset = z5::openDataset(file, key);
+    xt::xarray<T> values = xt::xarray<T>::from_shape(dataset->shape());
+    z5::types::ShapeType offset(dataset->shape().size(), 0);
+    z5::multiarray::readSubarray<T>(dataset, values, offset.begin());
+    return vector<T>(values.begin(), values.end());
+}
+
+TEST_CASE("Selfplay resume after kill -9"){
+    const string fileName = "resume_test.zarr";
+    const string checkpointFile = "resume_test_checkpoint.bin";
+    const size_t numberChunks = 32;
+    const size_t chunkSize = 16;
+    const size_t numberSamples = numberChunks * chunkSize;
+    REQUIRE(system(("rm -rf " + fileName + " " + checkpointFile).c_str()) == 0);
+
+    const pid_t pid = fork();
+    REQUIRE(pid >= 0);
+    if (pid == 0) {
+        int exitCode = 0;
+        try {
+            TrainDataExporter exporter(fileName, numberChunks, chunkSize, true, "raw", 5, true);
+            export_test_games(exporter, 0, 0, checkpointFile);
+        }
+        catch (const exception& e) {
+            cerr << e.what() << endl;
+            exitCode = 1;
+        }
+        // the child must not return into the test session of the parent
+        _exit(exitCode);
+    }
+    // kill the process at a random point after a third of the games
+    const chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::seconds(60);
+    SelfPlayCheckpoint checkpoint;
+    int status = 0;
+    bool isChildRunning = true;
+    while ((!read_checkpoint(checkpointFile, checkpoint) || checkpoint.generatedGames < 40) && chrono::steady_clock::now() < deadline) {
+        if (waitpid(pid, &status, WNOHANG) == pid) {
+            isChildRunning = false;
+            break;
+        }
+        this_thread::sleep_for(chrono::microseconds(100));
+    }
+    if (isChildRunning) {
+        random_device randomDevice;
+        this_thread::sleep_for(chrono::microseconds(randomDevice() % 3000));
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+    }
+    REQUIRE(chrono::steady_clock::now() < deadline);
+    // the child may have finished the data set just before it was killed
+    REQUIRE((WIFSIGNALED(status) || (WIFEXITED(status) && WEXITSTATUS(status) == 0)));
+
+    REQUIRE(read_checkpoint(checkpointFile, checkpoint));
+    {
+        TrainDataExporter exporter(fileName, numberChunks, chunkSize, true, "raw", 5, true, &checkpoint.exportCheckpoint);
+        export_test_games(exporter, checkpoint.generatedGames, checkpoint.exportCheckpoint.startIdx, checkpointFile);
+        exporter.flush();
+    }
+
+    z5::filesystem::handle::File file(fileName);
+    const vector<float> bestMoveQ = read_test_dataset<float>(file, "y_best_move_q");
+    const vector<int16_t> values = read_test_dataset<int16_t>(file, "y_value");
+    const vector<uint64_t> masks = read_test_dataset<uint64_t>(file, "x_packed");
+    const vector<int16_t> scalars = read_test_dataset<int16_t>(file, "x_scalars");
+    const vector<int64_t> policyOffsets = read_test_dataset<int64_t>(file, "y_policy_offsets");
+    const vector<int16_t> policyIndices = read_test_dataset<int16_t>(file, "y_policy_indices");
+    const vector<float> policyValues = read_test_dataset<float>(file, "y_policy_values");
+    const vector<int32_t> startIndices = read_test_dataset<int32_t>(file, "start_indices");
+    size_t numberMismatches = 0;
+    for (size_t sampleIdx = 0; sampleIdx < numberSamples; ++sampleIdx) {
+        numberMismatches += bestMoveQ[sampleIdx] != float(sampleIdx) || values[sampleIdx] != 1;
+        for (size_t channel = 0; channel < NB_CHANNELS_TOTAL; ++channel) {
+            numberMismatches += masks[sampleIdx * NB_CHANNELS_TOTAL + channel] != ~uint64_t(0);
+            numberMismatches += scalars[sampleIdx * NB_CHANNELS_TOTAL + channel] != int16_t(sampleIdx % 1000 + 1);
+        }
+        numberMismatches += policyOffsets[sampleIdx] != int64_t((sampleIdx + 1) * TEST_POLICY_ENTRIES);
+        for (size_t entryIdx = 0; entryIdx < TEST_POLICY_ENTRIES; ++entryIdx) {
+            numberMismatches += policyIndices[sampleIdx * TEST_POLICY_ENTRIES + entryIdx] != int16_t((sampleIdx + entryIdx) % NB_LABELS);
+            numberMismatches += policyValues[sampleIdx * TEST_POLICY_ENTRIES + entryIdx] != float(entryIdx);
+        }
+    }
+    size_t startIdx = 0;
+    for (size_t gameIdx = 0; startIdx < numberSamples; ++gameIdx) {
+        numberMismatches += startIndices[gameIdx] != int32_t(startIdx);
+        startIdx = min(startIdx + test_game_length(gameIdx), numberSamples);
+    }
+    REQUIRE(numberMismatches == 0);
+    REQUIRE(system(("rm -rf " + fileName + " " + checkpointFile).c_str()) == 0);
+}
+
+/**
+ * @brief export_round_trip_mismatches Exports test games without checkpoints, reads the data set back
+ * and returns the number of entries which differ from the exported samples.
+ * The game lengths aren't aligned with the chunk size, so that several games straddle a chunk boundary.
+ * @param numberExportSamples The export stops after the game which reaches this number of samples. The last chunk
+ * stays partially filled unless the data set is full, in which case the last game is truncated.
+ */
+size_t export_round_trip_mismatches(const string& fileName, bool packPlanes, bool sparsePolicy, size_t numberExportSamples) {
+    const size_t numberChunks = 5;
+    const size_t chunkSize = 16;
+    const size_t numberSamples = numberChunks * chunkSize;
+    if (system(("rm -rf " + fileName).c_str()) != 0) {
+        return numberSamples;
+    }
+    vector<size_t> gameStartIndices = {0};
+    {
+        TrainDataExporter exporter(fileName, numberChunks, chunkSize, packPlanes, "raw", 5, sparsePolicy);
+        GameSamples game(GAME_SAMPLES_CAPACITY, sparsePolicy);
+        while (gameStartIndices.back() < numberExportSamples) {
+            const size_t gameLength = test_game_length(gameStartIndices.size() - 1);
+            fill_test_game(game, gameStartIndices.back(), gameLength, sparsePolicy);
+            exporter.export_game_samples(game, WHITE_WIN);
+            gameStartIndices.push_back(min(gameStartIndices.back() + gameLength, numberSamples));
+        }
+        exporter.flush();
+    }
+    const size_t exportedSamples = gameStartIndices.back();
+
+    z5::filesystem::handle::File file(fileName);
+    const vector<float> bestMoveQ = read_test_dataset<float>(file, "y_best_move_q");
+    const vector<int16_t> values = read_test_dataset<int16_t>(file, "y_value");
+    const vector<int32_t> startIndices = read_test_dataset<int32_t>(file, "start_indices");
+    vector<uint64_t> masks;
+    vector<int16_t> scalars;
+    vector<int16_t> planes;
+    if (packPlanes) {
+        masks = read_test_dataset<uint64_t>(file, "x_packed");
+        scalars = read_test_dataset<int16_t>(file, "x_scalars");
+    }
+    else {
+        planes = read_test_dataset<int16_t>(file, "x");
+    }
+    vector<float> policy;
+    vector<int64_t> policyOffsets;
+    vector<int16_t> policyIndices;
+    vector<float> policyValues;
+    if (sparsePolicy) {
+        policyOffsets = read_test_dataset<int64_t>(file, "y_policy_offsets");
+        policyIndices = read_test_dataset<int16_t>(file, "y_policy_indices");
+        policyValues = read_test_dataset<float>(file, "y_policy_values");
+    }
+    else {
+        policy = read_test_dataset<float>(file, "y_policy");
+    }
+
+    // the samples after the exported ones keep the fill value
+    size_t numberMismatches = 0;
+    for (size_t sampleIdx = 0; sampleIdx < numberSamples; ++sampleIdx) {
+        const bool isExported = sampleIdx < exportedSamples;
+        const int16_t planeValue = isExported ? int16_t(sampleIdx % 1000 + 1) : 0;
+        numberMismatches += bestMoveQ[sampleIdx] != (isExported ? float(sampleIdx) : 0.0f);
+        numberMismatches += values[sampleIdx] != (isExported ? 1 : 0);
+        if (packPlanes) {
+            for (size_t channel = 0; channel < NB_CHANNELS_TOTAL; ++channel) {
+                numberMismatches += masks[sampleIdx * NB_CHANNELS_TOTAL + channel] != (isExported ? ~uint64_t(0) : 0);
+                numberMismatches += scalars[sampleIdx * NB_CHANNELS_TOTAL + channel] != planeValue;
+            }
+        }
+        else {
+            numberMismatches += size_t(count_if(planes.begin() + sampleIdx * NB_VALUES_TOTAL, planes.begin() + (sampleIdx + 1) * NB_VALUES_TOTAL,
+                                                [planeValue](int16_t value) { return value != planeValue; }));
+        }
+        if (sparsePolicy) {
+            numberMismatches += policyOffsets[sampleIdx] != (isExported ? int64_t((sampleIdx + 1) * TEST_POLICY_ENTRIES) : 0);
+        }
+        else {
+            vector<float> expectedPolicy(NB_LABELS, 0.0f);
+            for (size_t entryIdx = 0; isExported && entryIdx < TEST_POLICY_ENTRIES; ++entryIdx) {
+                expectedPolicy[(sampleIdx + entryIdx) % NB_LABELS] = float(entryIdx);
+            }
+            numberMismatches += !equal(expectedPolicy.begin(), expectedPolicy.end(), policy.begin() + sampleIdx * NB_LABELS);
+        }
+    }
+    for (size_t entryIdx = 0; sparsePolicy && entryIdx < policyIndices.size(); ++entryIdx) {
+        const bool isExported = entryIdx < exportedSamples * TEST_POLICY_ENTRIES;
+        const size_t sampleIdx = entryIdx / TEST_POLICY_ENTRIES;
+        numberMismatches += policyIndices[entryIdx] != (isExported ? int16_t((sampleIdx + entryIdx % TEST_POLICY_ENTRIES) % NB_LABELS) : 0);
+        numberMismatches += policyValues[entryIdx] != (isExported ? float(entryIdx % TEST_POLICY_ENTRIES) : 0.0f);
+    }
+    // the start index after the last game marks the end of the last game
+    for (size_t gameIdx = 0; gameIdx < gameStartIndices.size(); ++gameIdx) {
+        numberMismatches += startIndices[gameIdx] != int32_t(gameStartIndices[gameIdx]);
+    }
+    if (system(("rm -rf " + fileName).c_str()) != 0) {
+        ++numberMismatches;
+    }
+    return numberMismatches;
+}
+
+TEST_CASE("Export round trip across chunk boundaries"){
+    // 71 samples end within the fifth chunk of 16 samples
+    REQUIRE(export_round_trip_mismatches("round_trip_test.zarr", false, false, 70) == 0);
+    // the last game is truncated to the 80 samples of the data set
+    REQUIRE(export_round_trip_mismatches("round_trip_test.zarr", false, false, 80) == 0);
+}
+
+TEST_CASE("Sparse policy export round trip across chunk boundaries"){
+    // the flat policy arrays use chunks of 64 entries per sample, so the policy chunks end within other samples
+    REQUIRE(export_round_trip_mismatches("sparse_round_trip_test.zarr", false, true, 70) == 0);
+    REQUIRE(export_round_trip_mismatches("sparse_round_trip_test.zarr", true, true, 80) == 0);
+}
+
+TEST_CASE("Concurrent game export"){
+    const string fileName = "concurrent_export_test.zarr";
+    const size_t numberChunks = 8;
+    const size_t chunkSize = 16;
+    const size_t numberSamples = numberChunks * chunkSize;
+    // the samples of the n-th started game begin with the id n * maxGameLength
+    const size_t maxGameLength = 8;
+    REQUIRE(system(("rm -rf " + fileName).c_str()) == 0);
+    {
+        TrainDataExporter exporter(fileName, numberChunks, chunkSize, false, "raw", 5, true);
+        atomic<size_t> startedGames(0);
+        vector<thread> gameThreads;
+        for (size_t threadIdx = 0; threadIdx < 4; ++threadIdx) {
+            gameThreads.emplace_back([&]() {
+                GameSamples game(GAME_SAMPLES_CAPACITY, true);
+                while (!exporter.is_file_full()) {
+                    const size_t gameIdx = startedGames++;
+                    fill_test_game(game, gameIdx * maxGameLength, test_game_length(gameIdx));
+                    exporter.export_game_samples(game, WHITE_WIN);
+                }
+            });
+        }
+        for (thread& gameThread : gameThreads) {
+            gameThread.join();
+        }
+        exporter.flush();
+    }
+
+    z5::filesystem::handle::File file(fileName);
+    const vector<float> bestMoveQ = read_test_dataset<float>(file, "y_best_move_q");
+    const vector<int16_t> planes = read_test_dataset<int16_t>(file, "x");
+    const vector<int64_t> policyOffsets = read_test_dataset<int64_t>(file, "y_policy_offsets");
+    const vector<int32_t> startIndices = read_test_dataset<int32_t>(file, "start_indices");
+    // every game is stored contiguously and in one piece, only the last game may be truncated
+    size_t numberMismatches = 0;
+    vector<bool> isGameExported;
+    for (size_t gameIdx = 0; size_t(startIndices[gameIdx]) < numberSamples; ++gameIdx) {
+        const size_t first = size_t(startIndices[gameIdx]);
+        const size_t last = size_t(startIndices[gameIdx + 1]);
+        const size_t firstId = size_t(bestMoveQ[first]);
+        const size_t exportedGameIdx = firstId / maxGameLength;
+        numberMismatches += firstId % maxGameLength != 0 || last <= first;
+        numberMismatches += last != numberSamples && last - first != test_game_length(exportedGameIdx);
+        isGameExported.resize(max(isGameExported.size(), exportedGameIdx + 1), false);
+        numberMismatches += isGameExported[exportedGameIdx];
+        isGameExported[exportedGameIdx] = true;
+        for (size_t sampleIdx = first; sampleIdx < last; ++sampleIdx) {
+            const size_t id = firstId + sampleIdx - first;
+            numberMismatches += bestMoveQ[sampleIdx] != float(id);
+            numberMismatches += planes[sampleIdx * NB_VALUES_TOTAL] != int16_t(id % 1000 + 1);
+            numberMismatches += policyOffsets[sampleIdx] != int64_t((sampleIdx + 1) * TEST_POLICY_ENTRIES);
+        }
+    }
+    REQUIRE(numberMismatches == 0);
+    REQUIRE(system(("rm -rf " + fileName).c_str()) == 0);
+}
+
+TEST_CASE("Replay buffer with concurrent producers"){
+    const string fileName = "replay_buffer_test.bin";
+    remove(fileName.c_str());
+    const size_t capacity = 7;
+    const size_t numberProducers = 4;
+    const size_t numberGames = 200;
+    const size_t gameLength = 3;
+    // every producer uses its own object like a separate selfplay process, the tag of a sample identifies its game
+    vector<unique_ptr<ReplayBuffer>> producers;
+    for (size_t producerIdx = 0; producerIdx < numberProducers; ++producerIdx) {
+        producers.emplace_back(make_unique<ReplayBuffer>(fileName, capacity));
+    }
+    const size_t numberSamples = numberProducers * numberGames * gameLength;
+    vector<int16_t> sampleTags(numberSamples);
+    vector<thread> threads;
+    for (size_t producerIdx = 0; producerIdx < numberProducers; ++producerIdx) {
+        threads.emplace_back([&, producerIdx]() {
+            GameSamples game(gameLength, false);
+            for (size_t gameIdx = 0; gameIdx < numberGames; ++gameIdx) {
+                game.clear();
+                const int16_t tag = int16_t((producerIdx * numberGames + gameIdx) * gameLength);
+                for (size_t idx = 0; idx < gameLength; ++idx) {
+                    game.gameX.insert(game.gameX.end(), NB_VALUES_TOTAL, int16_t(tag + idx));
+                    game.gameValue.push_back(int16_t(tag + idx));
+                    game.gameBestMoveQ.push_back(float(tag + idx));
+                    game.gamePolicy.insert(game.gamePolicy.end(), NB_LABELS, float(tag + idx));
+                    ++game.numberSamples;
+                }
+                const uint64_t firstIdx = producers[producerIdx]->append_game(game, gameLength);
+                // each sample index is reserved by exactly one game
+                for (size_t idx = 0; idx < gameLength; ++idx) {
+                    sampleTags[firstIdx + idx] = int16_t(tag + idx);
+                }
+            }
+        });
+    }
+    for (thread& producer : threads) {
+        producer.join();
+    }
+
+    // without a consumer, all but the last capacity samples count as overwritten and only those can be aborted
+    size_t overwrittenSamples = 0;
+    size_t abortedSamples = 0;
+    for (const unique_ptr<ReplayBuffer>& producer : producers) {
+        overwrittenSamples += producer->get_overwritten_samples();
+        abortedSamples += producer->get_aborted_samples();
+    }
+    REQUIRE(overwrittenSamples == numberSamples - capacity);
+    REQUIRE(abortedSamples <= overwrittenSamples);
+
+    // the newest sample of each slot is never aborted and holds exactly the sample which reserved its index
+    ifstream file(fileName, ios::binary);
+    vector<char> data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    uint64_t slotSize;
+    memcpy(&slotSize, data.data() + 24, sizeof(slotSize));
+    REQUIRE(data.size() == REPLAY_BUFFER_HEADER_SIZE + capacity * slotSize);
+    for (size_t slotIdx = 0; slotIdx < capacity; ++slotIdx) {
+        const char* slot = data.data() + REPLAY_BUFFER_HEADER_SIZE + slotIdx * slotSize;
+        uint64_t sequence;
+        memcpy(&sequence, slot, sizeof(sequence));
+        REQUIRE(sequence > numberSamples - capacity);
+        REQUIRE(sequence <= numberSamples);
+        REQUIRE((sequence - 1) % capacity == slotIdx);
+        const int16_t tag = sampleTags[sequence - 1];
+        int16_t value;
+        float bestMoveQ;
+        memcpy(&value, slot + 8, sizeof(value));
+        memcpy(&bestMoveQ, slot + 12, sizeof(bestMoveQ));
+        REQUIRE(value == tag);
+        REQUIRE(bestMoveQ == float(tag));
+        vector<int16_t> planes(NB_VALUES_TOTAL);
+        memcpy(planes.data(), slot + sizeof(ReplayBufferSlot), NB_VALUES_TOTAL * sizeof(int16_t));
+        REQUIRE(count(planes.begin(), planes.end(), tag) == NB_VALUES_TOTAL);
+        vector<float> policy(NB_LABELS);
+        memcpy(policy.data(), slot + sizeof(ReplayBufferSlot) + NB_VALUES_TOTAL * sizeof(int16_t), NB_LABELS * sizeof(float));
+        REQUIRE(count(policy.begin(), policy.end(), float(tag)) == NB_LABELS);
+    }
+    producers.clear();
+    REQUIRE(remove(fileName.c_str()) == 0);
+}
+
+TEST_CASE("Opening pool with a uniform policy"){
+    init();
+    StateConstants::init(false);
+    const Variant variant = UCI::variant_from_name(Options["UCI_Variant"]);
+    PlaySettings playSettings;
+    playSettings.meanInitPly = 8;
+    playSettings.maxInitPly = 16;
+    UniformNetAPI net(8);
+    size_t numberMismatches = 0;
+    size_t numberOpeningMoves = 0;
+    {
+        // the pool holds fewer openings than its batch generates, so the generator has to wait for free capacity
+        OpeningPool openingPool(&net, &playSettings, variant, 0.0f, 4);
+        for (size_t openingIdx = 0; openingIdx < 64; ++openingIdx) {
+            GamePGN gamePGN;
+            unique_ptr<StateObj> opening = openingPool.get_opening(gamePGN);
+            numberOpeningMoves += gamePGN.gameMoves.size();
+            numberMismatches += gamePGN.gameMoves.size() > playSettings.maxInitPly;
+            // an opening never ends the game
+            numberMismatches += opening->legal_actions().empty();
+
+            // the moves of the pgn lead from the starting position to the opening
+            unique_ptr<StateObj> state = init_state(variant, false, gamePGN);
+            for (const string& move : gamePGN.gameMoves) {
+                const vector<Action> legalMoves = state->legal_actions();
+                const auto it = find_if(legalMoves.begin(), legalMoves.end(), [&](Action action) {
+                    return state->action_to_san(action, legalMoves, false, true) == move; });
+                if (it == legalMoves.end()) {
+                    ++numberMismatches;
+                    break;
+                }
+                state->do_action(*it);
+            }
+            numberMismatches += state->fen() != opening->fen();
+        }
+    }
+    REQUIRE(numberMismatches == 0);
+    REQUIRE(numberOpeningMoves > 0);
+}
+
+TEST_CASE("Checkpoint restores the random generators"){
+    const string checkpointFile = "generator_test_checkpoint.bin";
+    SelfPlayCheckpoint checkpoint;
+    checkpoint.exportCheckpoint.numberChunks = 2;
+    checkpoint.exportCheckpoint.chunkSize = 4;
+    checkpoint.exportCheckpoint.packPlanes = false;
+    checkpoint.exportCheckpoint.sparsePolicy = true;
+    checkpoint.exportCheckpoint.gameIdx = 0;
+    checkpoint.exportCheckpoint.startIdx = 0;
+    checkpoint.exportCheckpoint.startEntryIdx = 0;
+    checkpoint.generatedGames = 0;
+    checkpoint.pgnFileSize = 0;
+    // each game thread saves its own generator
+    vector<int> expectedDraws;
+    for (size_t gameThreadIdx = 0; gameThreadIdx < 2; ++gameThreadIdx) {
+        thread([&]() {
+            random_int();
+            checkpoint.randomGeneratorStates.push_back(get_generator_state());
+            expectedDraws.push_back(random_int());
+        }).join();
+    }
+    write_checkpoint(checkpointFile, checkpoint);
+
+    SelfPlayCheckpoint resumed;
+    REQUIRE(read_checkpoint(checkpointFile, resumed));
+    REQUIRE(resumed.randomGeneratorStates == checkpoint.randomGeneratorStates);
+    for (size_t gameThreadIdx = 0; gameThreadIdx < 2; ++gameThreadIdx) {
+        set_generator_state(resumed.randomGeneratorStates[gameThreadIdx]);
+        REQUIRE(random_int() == expectedDraws[gameThreadIdx]);
+    }
+    REQUIRE(remove(checkpointFile.c_str()) == 0);
+}
+
+TEST_CASE("Packed planes reject lossy planes"){
+    const string fileName = "lossy_test.zarr";
+    REQUIRE(system(("rm -rf " + fileName).c_str()) == 0);
+    {
+        TrainDataExporter exporter(fileName, 2, 4, true, "raw", 5, true);
+        GameSamples game(GAME_SAMPLES_CAPACITY, true);
+        fill_test_game(game, 0, 2);
+        // the first plane of the first sample gets two different non-zero values
+        game.gameX[1] = 2;
+        exporter.export_game_samples(game, WHITE_WIN);
+        REQUIRE_THROWS_AS(exporter.flush(), invalid_argument);
+        REQUIRE(exporter.has_writer_error());
+        // the writer stops on the first error, so every later export and flush fails as well
+        fill_test_game(game, 2, 2);
+        REQUIRE_THROWS_AS(exporter.export_game_samples(game, WHITE_WIN), invalid_argument);
+        REQUIRE_THROWS_AS(exporter.flush(), invalid_argument);
+    }
+    REQUIRE(system(("rm -rf " + fileName).c_str()) == 0);
+}
+#endif
+
+TournamentResult get_tournament_result(size_t numberWins, size_t numberDraws, size_t numberLosses) {
+    TournamentResult result;
+    result.numberWins = numberWins;
+    result.numberDraws = numberDraws;
+    result.numberLosses = numberLosses;
+    return result;
+}
+
+TEST_CASE("SPRT log-likelihood ratio"){
+    const SPRTSettings settings = {0, 20, 0.05f, 0.05f};
+    REQUIRE(settings.is_enabled());
+    // H1 is accepted above log(0.95 / 0.05) and rejected below log(0.05 / 0.95)
+    TournamentResult undecided = get_tournament_result(30, 40, 20);
+    undecided.update_sprt(settings);
+    REQUIRE(undecided.llr == Approx(0.784641f).epsilon(1e-4));
+    REQUIRE(undecided.sprtResult == SPRT_UNDECIDED);
+
+    TournamentResult accepted = get_tournament_result(100, 100, 60);
+    accepted.update_sprt(settings);
+    REQUIRE(accepted.llr == Approx(3.160668f).epsilon(1e-4));
+    REQUIRE(accepted.sprtResult == SPRT_ACCEPTED);
+
+    TournamentResult rejected = get_tournament_result(60, 100, 100);
+    rejected.update_sprt(settings);
+    REQUIRE(rejected.llr == Approx(-4.613494f).epsilon(1e-4));
+    REQUIRE(rejected.sprtResult == SPRT_REJECTED);
+
+    // an even score is evidence for H0 but doesn't decide the test yet
+    TournamentResult even = get_tournament_result(50, 100, 50);
+    even.update_sprt(settings);
+    REQUIRE(even.llr == Approx(-0.661278f).epsilon(1e-4));
+    REQUIRE(even.sprtResult == SPRT_UNDECIDED);
+
+    // the variance is unknown as long as all games have the same result
+    TournamentResult onlyWins = get_tournament_result(10, 0, 0);
+    onlyWins.update_sprt(settings);
+    REQUIRE(onlyWins.llr == 0);
+    REQUIRE(onlyWins.sprtResult == SPRT_UNDECIDED);
+}
+
+#ifdef USE_RL
+TEST_CASE("SPRT disabled by default"){
+    init();
+    const SPRTSettings settings = {float(Options["SPRT_Elo0"]), float(Options["SPRT_Elo1"]),
+                                   Options["Centi_SPRT_Alpha"] / 100.0f, Options["Centi_SPRT_Beta"] / 100.0f};
+    REQUIRE(!settings.is_enabled());
+    const SPRTSettings invertedBounds = {20, 0, 0.05f, 0.05f};
+    REQUIRE(!invertedBounds.is_enabled());
+}
+#endif
+
+TEST_CASE("Shared batch with policy map"){
+    const unsigned int clientBatchSize = 2;
+    EchoNetAPI net(2 * clientBatchSize, true);
+    SharedBatchServer server(&net, 2);
+    SharedBatchAPI clientA(&server, clientBatchSize);
+    SharedBatchAPI clientB(&server, clientBatchSize);
+    REQUIRE(clientA.is_policy_map());
+    REQUIRE(clientA.get_policy_output_length() == StateConstants::NB_LABELS_POLICY_MAP() * clientBatchSize);
+
+    // each client receives the outputs of its own samples, which echo the client id
+    const size_t numberBatches = 50;
+    atomic<size_t> numberMismatches(0);
+    auto run_client = [&](SharedBatchAPI* client, float clientId) {
+        vector<float> inputPlanes(clientBatchSize * StateConstants::NB_VALUES_TOTAL(), clientId);
+        vector<float> valueOutputs(clientBatchSize);
+        vector<float> probOutputs(client->get_policy_output_length());
+        for (size_t batchIdx = 0; batchIdx < numberBatches; ++batchIdx) {
+            client->predict(inputPlanes.data(), valueOutputs.data(), probOutputs.data());
+            numberMismatches += count_if(valueOutputs.begin(), valueOutputs.end(), [&](float value) { return value != clientId; });
+            numberMismatches += count_if(probOutputs.begin(), probOutputs.end(), [&](float prob) { return prob != clientId; });
+        }
+    };
+    thread threadA(run_client, &clientA, 1.0f);
+    thread threadB(run_client, &clientB, 2.0f);
+    threadA.join();
+    threadB.join();
+    REQUIRE(numberMismatches == 0);
+}
+
+#ifdef NATIVE_CPU
+vector<float> get_uniform_values(size_t length, float low, float high, unsigned int seed) {
+    mt19937 generator(seed);
+    uniform_real_distribution<float> distribution(low, high);
+    vector<float> values(length);
+    for (float& value : values) {
+        value = distribution(generator);
+    }
+    return values;
+}
+
+float get_max_abs_difference(const vector<float>& valuesA, const vector<float>& valuesB) {
+    REQUIRE(valuesA.size() == valuesB.size());
+    float maxDifference = 0;
+    for (size_t idx = 0; idx < valuesA.size(); ++idx) {
+        maxDifference = max(maxDifference, abs(valuesA[idx] - valuesB[idx]));
+    }
+    return maxDifference;
+}
+
+/**
+ * @brief reference_conv2d_nhwc Naive convolution in the layouts of conv2d_nhwc(). If depthwise is true, the weights have the
+ * layout of depthwise_conv2d_nhwc() and outChannels must be equal to inChannels.
+ */
+vector<float> reference_conv2d_nhwc(const vector<float>& input, const vector<float>& weights, const vector<float>& bias, const float* residual,
+                                    size_t batchSize, size_t height, size_t width, size_t inChannels, size_t outChannels,
+                                    size_t kernelH, size_t kernelW, const size_t pads[4], bool relu, bool depthwise) {
+    const size_t outHeight = height + pads[0] + pads[2] - kernelH + 1;
+    const size_t outWidth = width + pads[1] + pads[3] - kernelW + 1;
+    vector<float> output(batchSize * outHeight * outWidth * outChannels);
+    for (size_t b = 0; b < batchSize; ++b) {
+        for (size_t oy = 0; oy < outHeight; ++oy) {
+            for (size_t ox = 0; ox < outWidth; ++ox) {
+                for (size_t co = 0; co < outChannels; ++co) {
+                    double sum = bias[co];
+                    for (size_t ky = 0; ky < kernelH; ++ky) {
+                        for (size_t kx = 0; kx < kernelW; ++kx) {
+                            const int y = int(oy + ky) - int(pads[0]);
+                            const int x = int(ox + kx) - int(pads[1]);
+                            if (y < 0 || y >= int(height) || x < 0 || x >= int(width)) {
+                                continue;
+                            }
+                            const float* pixel = input.data() + ((b * height + y) * width + x) * inChannels;
+                            const size_t k = ky * kernelW + kx;
+                            if (depthwise) {
+                                sum += double(pixel[co]) * weights[k * outChannels + co];
+                                continue;
+                            }
+                            for (size_t ci = 0; ci < inChannels; ++ci) {
+                                sum += double(pixel[ci]) * weights[(k * inChannels + ci) * outChannels + co];
+                            }
+                        }
+                    }
+                    const size_t outIdx = ((b * outHeight + oy) * outWidth + ox) * outChannels + co;
+                    if (residual != nullptr) {
+                        sum += residual[outIdx];
+                    }
+                    output[outIdx] = relu ? max(float(sum), 0.0f) : float(sum);
+                }
+            }
+        }
+    }
+    return output;
+}
+
+vector<float> reference_softmax(const vector<float>& input, size_t batchSize, size_t length) {
+    vector<float> output(input.size());
+    for (size_t b = 0; b < batchSize; ++b) {
+        const float* row = input.data() + b * length;
+        const double maxValue = *max_element(row, row + length);
+        double sum = 0;
+        for (size_t idx = 0; idx < length; ++idx) {
+            sum += exp(row[idx] - maxValue);
+        }
+        for (size_t idx = 0; idx < length; ++idx) {
+            output[b * length + idx] = float(exp(row[idx] - maxValue) / sum);
+        }
+    }
+    return output;
+}
+
+/**
+ * @brief The ConvolutionCase struct describes a convolution whose channel and pixel counts aren't multiples of the vector and
+ * register block sizes of the kernels, so that the tail handling is tested as well
+ */
+struct ConvolutionCase {
+    size_t batchSize;
+    size_t height;
+    size_t width;
+    size_t inChannels;
+    size_t outChannels;
+    size_t kernelH;
+    size_t kernelW;
+    size_t pads[4];
+    bool relu;
+    bool residual;
+
+    size_t out_height() const {
+        return height + pads[0] + pads[2] - kernelH + 1;
+    }
+    size_t out_width() const {
+        return width + pads[1] + pads[3] - kernelW + 1;
+    }
+};
+
+const vector<ConvolutionCase> CONVOLUTION_CASES = {
+    {3, 8, 8, 13, 37, 3, 3, {1, 1, 1, 1}, true, true},
+    {2, 5, 7, 3, 17, 3, 3, {1, 1, 1, 1}, false, false},
+    {1, 6, 9, 40, 33, 1, 1, {0, 0, 0, 0}, true, false},
+    {2, 7, 5, 5, 9, 5, 3, {2, 1, 0, 1}, false, true},
+    {1, 1, 1, 19, 70, 1, 1, {0, 0, 0, 0}, true, true},
+    {1, 9, 11, 1, 1, 3, 3, {1, 1, 1, 1}, true, false}
+};
+
+TEST_CASE("Native CPU convolution kernels"){
+    info_string("native cpu kernels:", simd_instruction_set());
+    vector<float> workspace;
+    unsigned int seed = 0;
+    for (const ConvolutionCase& conv : CONVOLUTION_CASES) {
+        const size_t outSize = conv.batchSize * conv.out_height() * conv.out_width() * conv.outChannels;
+        const vector<float> input = get_uniform_values(conv.batchSize * conv.height * conv.width * conv.inChannels, -1, 1, ++seed);
+        const vector<float> weights = get_uniform_values(conv.kernelH * conv.kernelW * conv.inChannels * conv.outChannels, -0.5f, 0.5f, ++seed);
+        const vector<float> bias = get_uniform_values(conv.outChannels, -0.5f, 0.5f, ++seed);
+        const vector<float> residual = get_uniform_values(outSize, -1, 1, ++seed);
+        const float* residualPtr = conv.residual ? residual.data() : nullptr;
+
+        vector<float> output(outSize);
+        conv2d_nhwc(input.data(), weights.data(), bias.data(), residualPtr, output.data(), workspace, conv.batchSize, conv.height, conv.width,
+                    conv.inChannels, conv.outChannels, conv.kernelH, conv.kernelW, conv.pads, conv.relu);
+        const vector<float> expected = reference_conv2d_nhwc(input, weights, bias, residualPtr, conv.batchSize, conv.height, conv.width,
+                                                             conv.inChannels, conv.outChannels, conv.kernelH, conv.kernelW, conv.pads, conv.relu, false);
+        REQUIRE(get_max_abs_difference(output, expected) < 1e-4f);
+
+        // the depthwise convolution uses the output channels of the same case
+        const size_t channels = conv.outChannels;
+        const size_t depthwiseSize = conv.batchSize * conv.out_height() * conv.out_width() * channels;
+        const vector<float> depthwiseInput = get_uniform_values(conv.batchSize * conv.height * conv.width * channels, -1, 1, ++seed);
+        const vector<float> depthwiseWeights = get_uniform_values(conv.kernelH * conv.kernelW * channels, -0.5f, 0.5f, ++seed);
+        vector<float> depthwiseOutput(depthwiseSize);
+        depthwise_conv2d_nhwc(depthwiseInput.data(), depthwiseWeights.data(), bias.data(), residualPtr, depthwiseOutput.data(), workspace,
+                              conv.batchSize, conv.height, conv.width, channels, conv.kernelH, conv.kernelW, conv.pads, conv.relu);
+        const vector<float> depthwiseExpected = reference_conv2d_nhwc(depthwiseInput, depthwiseWeights, bias, residualPtr, conv.batchSize, conv.height, conv.width,
+                                                                      channels, channels, conv.kernelH, conv.kernelW, conv.pads, conv.relu, true);
+        REQUIRE(get_max_abs_difference(depthwiseOutput, depthwiseExpected) < 1e-5f);
+    }
+}
+
+TEST_CASE("Native CPU dense, pooling and softmax kernels"){
+    const size_t batchSize = 3;
+    unsigned int seed = 100;
+    for (size_t inFeatures : {1, 37, 256}) {
+        for (size_t outFeatures : {1, 5, 67}) {
+            const vector<float> input = get_uniform_values(batchSize * inFeatures, -1, 1, ++seed);
+            const vector<float> weights = get_uniform_values(inFeatures * outFeatures, -0.5f, 0.5f, ++seed);
+            const vector<float> bias = get_uniform_values(outFeatures, -0.5f, 0.5f, ++seed);
+            for (bool relu : {false, true}) {
+                vector<float> output(batchSize * outFeatures);
+                fully_connected(input.data(), weights.data(), bias.data(), output.data(), batchSize, inFeatures, outFeatures, relu);
+                vector<float> expected(output.size());
+                for (size_t b = 0; b < batchSize; ++b) {
+                    for (size_t out = 0; out < outFeatures; ++out) {
+                        double sum = bias[out];
+                        for (size_t in = 0; in < inFeatures; ++in) {
+                            sum += double(input[b * inFeatures + in]) * weights[in * outFeatures + out];
+                        }
+                        expected[b * outFeatures + out] = relu ? max(float(sum), 0.0f) : float(sum);
+                    }
+                }
+                REQUIRE(get_max_abs_difference(output, expected) < 1e-4f);
+            }
+        }
+    }
+
+    for (size_t spatialSize : {1, 35, 64}) {
+        for (size_t channels : {1, 5, 37}) {
+            const vector<float> input = get_uniform_values(batchSize * spatialSize * channels, -1, 1, ++seed);
+            vector<float> output(batchSize * channels);
+            global_avg_pool_nhwc(input.data(), output.data(), batchSize, spatialSize, channels);
+            vector<float> expected(output.size());
+            for (size_t b = 0; b < batchSize; ++b) {
+                for (size_t c = 0; c < channels; ++c) {
+                    double sum = 0;
+                    for (size_t idx = 0; idx < spatialSize; ++idx) {
+                        sum += input[(b * spatialSize + idx) * channels + c];
+                    }
+                    expected[b * channels + c] = float(sum / spatialSize);
+                }
+            }
+            REQUIRE(get_max_abs_difference(output, expected) < 1e-6f);
+        }
+    }
+
+    // large logits must not overflow
+    for (size_t length : {1, 37, 67, 2272}) {
+        for (float range : {1.0f, 80.0f}) {
+            const vector<float> input = get_uniform_values(batchSize * length, -range, range, ++seed);
+            vector<float> output(input.size());
+            softmax(input.data(), output.data(), batchSize, length);
+            REQUIRE(get_max_abs_difference(output, reference_softmax(input, batchSize, length)) < 1e-6f);
+            for (size_t b = 0; b < batchSize; ++b) {
+                REQUIRE(accumulate(output.begin() + b * length, output.begin() + (b + 1) * length, 0.0) == Approx(1.0));
+            }
+        }
+    }
+}
+
+/**
+ * @brief The ProtoWriter struct serializes the protobuf fields which are needed to generate small ONNX models
+ */
+struct ProtoWriter {
+    string data;
+
+    void write_varint(uint64_t value) {
+        while (value >= 0x80) {
+            data += char((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        data += char(value);
+    }
+    void write_int(uint32_t field, int64_t value) {
+        write_varint(field << 3);
+        write_varint(uint64_t(value));
+    }
+    void write_bytes(uint32_t field, const string& bytes) {
+        write_varint((field << 3) | 2);
+        write_varint(bytes.size());
+        data += bytes;
+    }
+};
+
+/**
+ * @brief The OnnxModelWriter class generates ONNX models with a single input and float parameters for the native CPU back-end
+ */
+class OnnxModelWriter
+{
+private:
+    ProtoWriter graph;
+
+    string get_value_info(const string& name, const vector<int64_t>& dims) const {
+        ProtoWriter shape;
+        for (int64_t dim : dims) {
+            ProtoWriter dimension;
+            dimension.write_int(1, dim);
+            shape.write_bytes(1, dimension.data);
+        }
+        ProtoWriter tensorType;
+        tensorType.write_int(1, 1);
+        tensorType.write_bytes(2, shape.data);
+        ProtoWriter type;
+        type.write_bytes(1, tensorType.data);
+        ProtoWriter valueInfo;
+        valueInfo.write_bytes(1, name);
+        valueInfo.write_bytes(2, type.data);
+        return valueInfo.data;
+    }
+
+public:
+    void add_initializer(const string& name, const vector<int64_t>& dims, const vector<float>& values) {
+        ProtoWriter tensor;
+        for (int64_t dim : dims) {
+            tensor.write_int(1, dim);
+        }
+        tensor.write_int(2, 1);
+        tensor.write_bytes(8, name);
+        tensor.write_bytes(9, string(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float)));
+        graph.write_bytes(5, tensor.data);
+    }
+
+    /**
+     * @brief add_node Adds a node with a single output. All attributes are stored as lists of integers.
+     */
+    void add_node(const string& opType, const vector<string>& inputs, const string& output,
+                  const vector<pair<string, vector<int64_t>>>& attributes = {}) {
+        ProtoWriter node;
+        for (const string& input : inputs) {
+            node.write_bytes(1, input);
+        }
+        node.write_bytes(2, output);
+        node.write_bytes(3, output);
+        node.write_bytes(4, opType);
+        for (const pair<string, vector<int64_t>>& attribute : attributes) {
+            ProtoWriter attributeProto;
+            attributeProto.write_bytes(1, attribute.first);
+            for (int64_t value : attribute.second) {
+                attributeProto.write_int(8, value);
+            }
+            node.write_bytes(5, attributeProto.data);
+        }
+        graph.write_bytes(1, node.data);
+    }
+
+    void save(const string& filePath, const string& inputName, const vector<int64_t>& inputDims, const vector<string>& outputNames) const {
+        ProtoWriter fullGraph = graph;
+        fullGraph.write_bytes(11, get_value_info(inputName, inputDims));
+        for (const string& outputName : outputNames) {
+            fullGraph.write_bytes(12, get_value_info(outputName, {}));
+        }
+        ProtoWriter model;
+        model.write_int(1, 7);
+        model.write_bytes(7, fullGraph.data);
+        ofstream file(filePath, ios::binary);
+        file << model.data;
+    }
+};
+
+const size_t NATIVE_CPU_TEST_BATCH_SIZE = 3;
+const string NATIVE_CPU_TEST_MODEL_DIR = "native_cpu_test_model/";
+
+/**
+ * @brief write_mean_plane_model Writes a model which averages the input planes into a single plane. The value is the tanh of the
+ * mean of this plane and the policy logit of move idx is the entry (idx % planeSize) of this plane plus 0.001 * idx.
+ */
+void write_mean_plane_model(const string& filePath) {
+    const int64_t channels = StateConstants::NB_CHANNELS_TOTAL();
+    const int64_t planeSize = StateConstants::BOARD_HEIGHT() * StateConstants::BOARD_WIDTH();
+    const int64_t numberLabels = StateConstants::NB_LABELS();
+    OnnxModelWriter writer;
+    writer.add_initializer("mean_weight", {1, channels, 1, 1}, vector<float>(channels, 1.0f / channels));
+    writer.add_initializer("mean_bias", {1}, {0.0f});
+    writer.add_node("Conv", {"data", "mean_weight", "mean_bias"}, "mean_conv", {{"pads", {0, 0, 0, 0}}, {"strides", {1, 1}}});
+    writer.add_node("Relu", {"mean_conv"}, "mean");
+
+    writer.add_node("GlobalAveragePool", {"mean"}, "value_pool");
+    writer.add_node("Flatten", {"value_pool"}, "value_flatten");
+    writer.add_node("Tanh", {"value_flatten"}, "value_out");
+
+    vector<float> policyWeights(planeSize * numberLabels, 0.0f);
+    vector<float> policyBias(numberLabels);
+    for (int64_t label = 0; label < numberLabels; ++label) {
+        policyWeights[(label % planeSize) * numberLabels + label] = 1;
+        policyBias[label] = 0.001f * label;
+    }
+    writer.add_initializer("policy_weight", {planeSize, numberLabels}, policyWeights);
+    writer.add_initializer("policy_bias", {numberLabels}, policyBias);
+    writer.add_node("Flatten", {"mean"}, "policy_flatten");
+    writer.add_node("Gemm", {"policy_flatten", "policy_weight", "policy_bias"}, "policy_logits");
+    writer.add_node("Softmax", {"policy_logits"}, "policy_out");
+    writer.save(filePath, "data", {int64_t(NATIVE_CPU_TEST_BATCH_SIZE), channels, StateConstants::BOARD_HEIGHT(), StateConstants::BOARD_WIDTH()},
+                {"value_out", "policy_out"});
+}
+
+TEST_CASE("Native CPU back-end with a generated ONNX model"){
+    REQUIRE(system(("mkdir -p " + NATIVE_CPU_TEST_MODEL_DIR).c_str()) == 0);
+    write_mean_plane_model(NATIVE_CPU_TEST_MODEL_DIR + "mean-bsize-" + to_string(NATIVE_CPU_TEST_BATCH_SIZE) + ".onnx");
+
+    const size_t batchSize = NATIVE_CPU_TEST_BATCH_SIZE;
+    const size_t channels = StateConstants::NB_CHANNELS_TOTAL();
+    const size_t planeSize = StateConstants::BOARD_HEIGHT() * StateConstants::BOARD_WIDTH();
+    const size_t numberLabels = StateConstants::NB_LABELS();
+    vector<float> inputPlanes = get_uniform_values(batchSize * channels * planeSize, -1, 1, 7);
+    vector<float> expectedValues(batchSize);
+    vector<float> expectedLogits(batchSize * numberLabels);
+    for (size_t b = 0; b < batchSize; ++b) {
+        vector<double> meanPlane(planeSize, 0.0);
+        for (size_t c = 0; c < channels; ++c) {
+            for (size_t idx = 0; idx < planeSize; ++idx) {
+                meanPlane[idx] += inputPlanes[(b * channels + c) * planeSize + idx] / channels;
+            }
+        }
+        for (double& value : meanPlane) {
+            value = max(value, 0.0);
+        }
+        expectedValues[b] = float(tanh(accumulate(meanPlane.begin(), meanPlane.end(), 0.0) / planeSize));
+        for (size_t label = 0; label < numberLabels; ++label) {
+            expectedLogits[b * numberLabels + label] = float(meanPlane[label % planeSize] + 0.001 * label);
+        }
+    }
+    const vector<float> expectedPolicy = reference_softmax(expectedLogits, batchSize, numberLabels);
+
+    // the second thread evaluates a smaller chunk of the batch
+    for (size_t numberThreads : {1, 2}) {
+        NativeCPUAPI net(0, batchSize, NATIVE_CPU_TEST_MODEL_DIR, numberThreads);
+        REQUIRE(!net.is_policy_map());
+        REQUIRE(net.get_policy_output_length() == numberLabels * batchSize);
+        vector<float> valueOutputs(batchSize);
+        vector<float> probOutputs(net.get_policy_output_length());
+        net.predict(inputPlanes.data(), valueOutputs.data(), probOutputs.data());
+        REQUIRE(get_max_abs_difference(valueOutputs, expectedValues) < 1e-5f);
+        REQUIRE(get_max_abs_difference(probOutputs, expectedPolicy) < 1e-6f);
+    }
+    REQUIRE(system(("rm -rf " + NATIVE_CPU_TEST_MODEL_DIR).c_str()) == 0);
+}
+
+TEST_CASE("Native CPU int8 convolution kernel"){
+    // the channel counts aren't multiples of the int8 input group or output lane sizes of the VNNI and AVX2 paths
+    info_string("native cpu int8 kernels:", int8_instruction_set());
+    vector<uint8_t> workspace;
+    vector<float> floatWorkspace;
+    unsigned int seed = 200;
+    for (const ConvolutionCase& conv : CONVOLUTION_CASES) {
+        const size_t outSize = conv.batchSize * conv.out_height() * conv.out_width() * conv.outChannels;
+        const size_t kernelSize = conv.kernelH * conv.kernelW;
+        const vector<float> input = get_uniform_values(conv.batchSize * conv.height * conv.width * conv.inChannels, -1, 1, ++seed);
+        const vector<float> weights = get_uniform_values(kernelSize * conv.inChannels * conv.outChannels, -0.5f, 0.5f, ++seed);
+        const vector<float> bias = get_uniform_values(conv.outChannels, -0.5f, 0.5f, ++seed);
+        const vector<float> residual = get_uniform_values(outSize, -1, 1, ++seed);
+        const float* residualPtr = conv.residual ? residual.data() : nullptr;
+
+        vector<int8_t> weightsInt8;
+        vector<float> weightScales;
+        vector<int32_t> compensation;
+        quantize_weights_int8(weights.data(), kernelSize, conv.inChannels, conv.outChannels, weightsInt8, weightScales, compensation);
+        const float inputScale = max_abs(input.data(), input.size()) / 127.0f;
+        vector<float> outputScales(conv.outChannels);
+        for (size_t co = 0; co < conv.outChannels; ++co) {
+            outputScales[co] = inputScale * weightScales[co];
+        }
+
+        vector<float> output(outSize);
+        conv2d_nhwc_int8(input.data(), inputScale, weightsInt8.data(), outputScales.data(), compensation.data(), bias.data(), residualPtr,
+                         output.data(), workspace, conv.batchSize, conv.height, conv.width, conv.inChannels, conv.outChannels,
+                         conv.kernelH, conv.kernelW, conv.pads, conv.relu);
+        vector<float> expected(outSize);
+        conv2d_nhwc(input.data(), weights.data(), bias.data(), residualPtr, expected.data(), floatWorkspace, conv.batchSize, conv.height, conv.width,
+                    conv.inChannels, conv.outChannels, conv.kernelH, conv.kernelW, conv.pads, conv.relu);
+
+        // the input (at most 1) and the weights (at most 0.5) are off by at most half a quantization step in each product
+        const float maxWeightScale = *max_element(weightScales.begin(), weightScales.end());
+        const float productBound = 0.5f * inputScale * 0.5f + 0.5f * maxWeightScale * 1.0f + 0.25f * inputScale * maxWeightScale;
+        const float errorBound = kernelSize * conv.inChannels * productBound;
+        const float maxError = get_max_abs_difference(output, expected);
+        REQUIRE(maxError <= errorBound);
+        REQUIRE(maxError < 0.02f * max_abs(expected.data(), expected.size()));
+    }
+}
+
+/**
+ * @brief write_residual_model Writes a model with random parameters which consists of a convolution, a residual block,
+ * a dense value head and a policy head with a 1x1 convolution
+ */
+void write_residual_model(const string& filePath, unsigned int seed) {
+    const int64_t inChannels = StateConstants::NB_CHANNELS_TOTAL();
+    const int64_t channels = 13;
+    const int64_t planeSize = StateConstants::BOARD_HEIGHT() * StateConstants::BOARD_WIDTH();
+    const int64_t numberLabels = StateConstants::NB_LABELS();
+    OnnxModelWriter writer;
+    auto add_conv = [&](const string& input, const string& name, int64_t convInChannels, int64_t outChannels, int64_t kernel) {
+        const float range = sqrt(3.0f / (convInChannels * kernel * kernel));
+        const int64_t pad = kernel / 2;
+        writer.add_initializer(name + "_weight", {outChannels, convInChannels, kernel, kernel},
+                               get_uniform_values(outChannels * convInChannels * kernel * kernel, -range, range, ++seed));
+        writer.add_initializer(name + "_bias", {outChannels}, get_uniform_values(outChannels, -0.1f, 0.1f, ++seed));
+        writer.add_node("Conv", {input, name + "_weight", name + "_bias"}, name, {{"pads", {pad, pad, pad, pad}}});
+    };
+    auto add_batch_norm = [&](const string& input, const string& name) {
+        writer.add_initializer(name + "_gamma", {channels}, get_uniform_values(channels, 0.5f, 1.5f, ++seed));
+        writer.add_initializer(name + "_beta", {channels}, get_uniform_values(channels, -0.1f, 0.1f, ++seed));
+        writer.add_initializer(name + "_mean", {channels}, get_uniform_values(channels, -0.1f, 0.1f, ++seed));
+        writer.add_initializer(name + "_var", {channels}, get_uniform_values(channels, 0.5f, 2.0f, ++seed));
+        writer.add_node("BatchNormalization", {input, name + "_gamma", name + "_beta", name + "_mean", name + "_var"}, name);
+    };
+    add_conv("data", "conv0", inChannels, channels, 3);
+    add_batch_norm("conv0", "bn0");
+    writer.add_node("Relu", {"bn0"}, "relu0");
+    add_conv("relu0", "conv1", channels, channels, 3);
+    add_batch_norm("conv1", "bn1");
+    writer.add_node("Relu", {"bn1"}, "relu1");
+    add_conv("relu1", "conv2", channels, channels, 3);
+    writer.add_node("Add", {"conv2", "relu0"}, "add2");
+    writer.add_node("Relu", {"add2"}, "relu2");
+
+    writer.add_node("GlobalAveragePool", {"relu2"}, "value_pool");
+    writer.add_node("Flatten", {"value_pool"}, "value_flatten");
+    writer.add_initializer("value_weight", {channels, 1}, get_uniform_values(channels, -1, 1, ++seed));
+    writer.add_initializer("value_bias", {1}, {0.0f});
+    writer.add_node("Gemm", {"value_flatten", "value_weight", "value_bias"}, "value_dense");
+    writer.add_node("Tanh", {"value_dense"}, "value_out");
+
+    add_conv("relu2", "policy_conv", channels, 2, 1);
+    writer.add_node("Flatten", {"policy_conv"}, "policy_flatten");
+    writer.add_initializer("policy_weight", {2 * planeSize, numberLabels}, get_uniform_values(2 * planeSize * numberLabels, -0.2f, 0.2f, ++seed));
+    writer.add_initializer("policy_bias", {numberLabels}, get_uniform_values(numberLabels, -0.1f, 0.1f, ++seed));
+    writer.add_node("Gemm", {"policy_flatten", "policy_weight", "policy_bias"}, "policy_logits");
+    writer.add_node("Softmax", {"policy_logits"}, "policy_out");
+    writer.save(filePath, "data", {int64_t(NATIVE_CPU_TEST_BATCH_SIZE), inChannels, StateConstants::BOARD_HEIGHT(), StateConstants::BOARD_WIDTH()},
+                {"value_out", "policy_out"});
+}
+
+#ifndef MODE_POMMERMAN
+TEST_CASE("Native CPU back-end in float32 and int8"){
+    // the shared models are cached by their directory, so this model needs its own one
+    const string modelDir = "native_cpu_int8_test_model/";
+    REQUIRE(system(("mkdir -p " + modelDir).c_str()) == 0);
+    write_residual_model(modelDir + "residual-bsize-" + to_string(NATIVE_CPU_TEST_BATCH_SIZE) + ".onnx", 300);
+
+    const size_t batchSize = NATIVE_CPU_TEST_BATCH_SIZE;
+    vector<float> inputPlanes = generate_sample_planes(batchSize);
+    REQUIRE(inputPlanes.size() == batchSize * StateConstants::NB_VALUES_TOTAL());
+    NativeCPUAPI netFloat(0, batchSize, modelDir, 1, "float32");
+    NativeCPUAPI netInt8(0, batchSize, modelDir, 1, "int8");
+    vector<float> valueFloat(batchSize);
+    vector<float> valueInt8(batchSize);
+    vector<float> policyFloat(netFloat.get_policy_output_length());
+    vector<float> policyInt8(netInt8.get_policy_output_length());
+    netFloat.predict(inputPlanes.data(), valueFloat.data(), policyFloat.data());
+    netInt8.predict(inputPlanes.data(), valueInt8.data(), policyInt8.data());
+
+    const size_t numberLabels = StateConstants::NB_LABELS();
+    REQUIRE(get_max_abs_difference(valueFloat, valueInt8) < 0.05f);
+    for (size_t b = 0; b < batchSize; ++b) {
+        double policyError = 0;
+        for (size_t label = b * numberLabels; label < (b + 1) * numberLabels; ++label) {
+            policyError += abs(policyFloat[label] - policyInt8[label]);
+        }
+        REQUIRE(policyError < 0.1);
+    }
+    REQUIRE(system(("rm -rf " + modelDir).c_str()) == 0);
+}
+#endif
+#endif
+
 TEST_CASE("LABELS length"){
     StateConstants::init(true);
     REQUIRE(OutputRepresentation::LABELS.size() == size_t(StateConstants::NB_LABELS()));